@@ -0,0 +1,217 @@
+// 端到端背压: 下游 outputBuffer_ 在高低水位之间来回时, 上游的停读/恢复对不对, 一轮要多久
+//
+// 同一个进程里起一个 TcpServer(高水位 high_mb, 低水位 low_mb), 用阻塞 socket 连上两条: down 和 up, down->addBackpressurePeer(up).
+// 每一轮: down 发 2 * high 字节(客户端不读, 越过高水位) -> 客户端读到队列落在高低水位之间 -> 再发一批(又越过高水位)
+//        -> 客户端读完(降到低水位以下). 越过高水位后 up 必须停读, 读完后 up 必须恢复读, 不对直接退出 1, 可以当冒烟测试跑.
+// 打印每轮耗时和 highWaterEvents 对应的轮数.
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+#include "TcpServer.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    std::mutex g_mutex;
+    std::map<uint16_t, TcpConnectionPtr> g_conns; // 按客户端端口找服务端这一侧的连接
+
+    int connectTo(uint16_t port, int rcvbuf)
+    {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        // TcpServer::start() 的 listen 是投递到 server loop 里做的, 刚 start 完可能还没开始监听, 被拒就重试一会儿
+        for (int attempt = 0;; ++attempt)
+        {
+            const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (rcvbuf > 0)
+            {
+                ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)); // 要在 connect 之前设, 关掉自动调大
+            }
+            if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+            {
+                return fd;
+            }
+            const int savedErrno = errno;
+            ::close(fd);
+            if (savedErrno != ECONNREFUSED || attempt >= 1000)
+            {
+                errno = savedErrno;
+                perror("connect");
+                exit(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    TcpConnectionPtr serverSide(int fd)
+    {
+        sockaddr_in local{};
+        socklen_t len = sizeof(local);
+        ::getsockname(fd, reinterpret_cast<sockaddr *>(&local), &len);
+        const uint16_t port = ntohs(local.sin_port);
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(g_mutex);
+                if (auto it = g_conns.find(port); it != g_conns.end())
+                {
+                    return it->second;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // isReading 只能在连接自己的 loop 里看
+    bool reading(const TcpConnectionPtr &conn)
+    {
+        std::promise<bool> result;
+        conn->getLoop()->runInLoop([&] { result.set_value(conn->isReading()); });
+        return result.get_future().get();
+    }
+
+    void waitQueued(const TcpConnectionPtr &conn, size_t atLeast)
+    {
+        while (conn->outputQueuedBytes() < atLeast)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    void readBytes(int fd, size_t n, char *buf, size_t bufSize)
+    {
+        while (n > 0)
+        {
+            const ssize_t r = ::read(fd, buf, std::min(n, bufSize));
+            if (r <= 0)
+            {
+                perror("read");
+                exit(1);
+            }
+            n -= static_cast<size_t>(r);
+        }
+    }
+
+    void expect(bool ok, int round, const char *what)
+    {
+        if (!ok)
+        {
+            fprintf(stderr, "FAIL round %d: %s\n", round, what);
+            exit(1);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: backpressure_bench [rounds=20] [high_mb=4] [low_mb=1] [io_threads=2] [port=19986]\n");
+        return 1;
+    }
+    const int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    const size_t high = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 4) << 20;
+    const size_t low = static_cast<size_t>(argc > 3 ? atoi(argv[3]) : 1) << 20;
+    const int ioThreads = argc > 4 ? atoi(argv[4]) : 2;
+    const uint16_t port = static_cast<uint16_t>(argc > 5 ? atoi(argv[5]) : 19986);
+
+    Logger::instance().setLogLevel(LogLevel::ERROR);
+
+    EventLoopThread serverThread({}, "server");
+    EventLoop *serverLoop = serverThread.startLoop();
+    TcpServer server(serverLoop, InetAddress(port), "backpressure");
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            const int sndbuf = 64 * 1024; // 内核缓冲小一点, 排队的字节基本都在 outputBuffer_ 里
+            ::setsockopt(conn->fd(), SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_conns[conn->peerAddress().toPort()] = conn;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.setHighWaterMarkCallback([](const TcpConnectionPtr &, size_t) {}, high);
+    server.setLowWaterMarkCallback([](const TcpConnectionPtr &, size_t) {}, low);
+    server.setThreadNum(ioThreads);
+    server.start();
+
+    const int downFd = connectTo(port, 64 * 1024);
+    const int upFd = connectTo(port, 0);
+    const TcpConnectionPtr down = serverSide(downFd);
+    const TcpConnectionPtr up = serverSide(upFd);
+    {
+        std::promise<void> done;
+        down->getLoop()->runInLoop([&] {
+            down->addBackpressurePeer(up);
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    const std::string batch(2 * high, 'x');
+    std::string scratch(256 * 1024, '\0');
+    const size_t middle = (high + low) / 2;
+    printf("rounds=%d high=%zuMiB low=%zuMiB io_threads=%d\n", rounds, high >> 20, low >> 20, ioThreads);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 1; round <= rounds; ++round)
+    {
+        // 1. 越过高水位, up 被压住
+        down->send(batch);
+        waitQueued(down, high);
+        expect(!reading(up), round, "upstream still reading above the high water mark");
+
+        // 2. 读到队列落在高低水位之间, 还没到低水位, up 照样压着
+        size_t received = 0;
+        while (down->outputQueuedBytes() > middle)
+        {
+            readBytes(downFd, 64 * 1024, scratch.data(), scratch.size());
+            received += 64 * 1024;
+        }
+        expect(down->outputQueuedBytes() > low, round, "drained below the low water mark too early");
+        expect(!reading(up), round, "upstream resumed between the water marks");
+
+        // 3. 再越过高水位
+        down->send(batch);
+        waitQueued(down, high);
+
+        // 4. 全部读完, 降到低水位以下, up 必须恢复读
+        readBytes(downFd, 2 * batch.size() - received, scratch.data(), scratch.size());
+        while (down->outputQueuedBytes() > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1)); // 松开是 runInLoop 到 up 的 loop 上的
+        expect(reading(up), round, "upstream still paused after draining below the low water mark");
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("ok: %d rounds, %.2f ms/round, %.1f MiB/s through the downstream\n",
+           rounds, seconds * 1000 / rounds, static_cast<double>(rounds) * 2 * batch.size() / (1 << 20) / seconds);
+
+    ::close(downFd);
+    ::close(upFd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // 让服务端处理完关闭
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_conns.clear();
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// HttpServer 吞吐: 长连接 + 流水线
+//
+// 同一个进程里起一个 HttpServer(GET 回固定的 body), 客户端 loops 上开 connections 条长连接,
+// 每条连接保持 pipeline_depth 个请求在途(收到一个响应补发一个), 跑 seconds 秒, 打印 req/s.
+// cached=1 时响应放进 HttpResponseCache, 走缓存命中的路径.
+// 要压外部进程的话, 用 wrk -c<connections> -t<threads> --latency 打 port 上的同一个服务更好.
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include "HttpResponseCache.h"
+#include "HttpServer.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "TcpClient.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    std::atomic<bool> g_stop{false};
+    std::atomic<uint64_t> g_responses{0};
+
+    // 一个完整响应的长度, 不完整返回 0. 只认 Content-Length, 服务端回的都是这种
+    size_t responseLength(const Buffer *buf)
+    {
+        const std::string_view view(buf->peek(), buf->readableBytes());
+        const size_t end = view.find("\r\n\r\n");
+        if (end == std::string_view::npos)
+        {
+            return 0;
+        }
+        const size_t cl = view.substr(0, end).find("Content-Length: ");
+        const size_t bodyLen = cl == std::string_view::npos ? 0 : strtoul(view.data() + cl + 16, nullptr, 10);
+        return view.size() >= end + 4 + bodyLen ? end + 4 + bodyLen : 0;
+    }
+
+    void sendRequests(const TcpConnectionPtr &conn, const std::string &request, int n)
+    {
+        std::string batch;
+        batch.reserve(request.size() * n);
+        for (int i = 0; i < n; ++i)
+        {
+            batch += request;
+        }
+        conn->send(batch);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: http_bench [seconds=5] [connections=64] [pipeline_depth=1] [body_bytes=13] [server_threads=4] [client_threads=2] [port=19981] [cached=0]\n");
+        return 1;
+    }
+    const int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    const int connections = argc > 2 ? atoi(argv[2]) : 64;
+    const int depth = argc > 3 ? atoi(argv[3]) : 1;
+    const size_t bodyBytes = argc > 4 ? static_cast<size_t>(atol(argv[4])) : 13;
+    const int serverThreads = argc > 5 ? atoi(argv[5]) : 4;
+    const int clientThreads = argc > 6 ? atoi(argv[6]) : 2;
+    const uint16_t port = static_cast<uint16_t>(argc > 7 ? atoi(argv[7]) : 19981);
+    const bool cached = argc > 8 && atoi(argv[8]) != 0;
+
+    Logger::instance().setLogLevel(LogLevel::ERROR);
+
+    // 服务端
+    const std::string body(bodyBytes, 'x');
+    EventLoopThread serverThread({}, "http");
+    EventLoop *serverLoop = serverThread.startLoop();
+    HttpServer server(serverLoop, InetAddress(port), "http");
+    server.setHttpCallback([&body](const HttpRequest &, HttpResponse *resp) {
+        resp->setContentType("text/plain");
+        resp->setBodyView(body);
+    });
+    if (cached)
+    {
+        // 同样的响应放进 HttpResponseCache, 命中时不走 HttpCallback, 对比两种路径
+        auto cache = std::make_shared<HttpResponseCache>("bench");
+        HttpResponse response(false);
+        response.setContentType("text/plain");
+        response.setBody(body);
+        cache->put(HttpRequest::Method::kGet, "/bench", response);
+        server.setResponseCache(std::move(cache));
+    }
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    // 客户端
+    EventLoop baseLoop;
+    EventLoopThreadPool clientPool(&baseLoop, "client");
+    clientPool.setThreadNum(clientThreads);
+    clientPool.start();
+    const std::vector<EventLoop *> loops = clientPool.getAllLoops();
+
+    const std::string request = "GET /bench HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\n\r\n";
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        auto client = std::make_unique<TcpClient>(loops[i % loops.size()], InetAddress(port, "127.0.0.1"), "bench");
+        client->setConnectionCallback([&request, depth](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                sendRequests(conn, request, depth);
+            }
+        });
+        client->setMessageCallback([&request](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            int done = 0;
+            while (const size_t n = responseLength(buf))
+            {
+                buf->retrieve(n);
+                ++done;
+            }
+            g_responses.fetch_add(done, std::memory_order_relaxed);
+            if (done > 0 && !g_stop.load(std::memory_order_relaxed))
+            {
+                sendRequests(conn, request, done);
+            }
+        });
+        client->connect();
+        clients.push_back(std::move(client));
+    }
+
+    printf("seconds=%d connections=%d pipeline_depth=%d body_bytes=%zu server_threads=%d client_threads=%d cached=%d\n",
+           seconds, connections, depth, bodyBytes, serverThreads, clientThreads, cached);
+    uint64_t last = 0;
+    for (int i = 0; i < seconds; ++i)
+    {
+        sleep(1);
+        const uint64_t now = g_responses.load(std::memory_order_relaxed);
+        printf("%3ds %12lu req/s\n", i + 1, static_cast<unsigned long>(now - last));
+        fflush(stdout);
+        last = now;
+    }
+    g_stop = true;
+    printf("total %12.0f req/s\n", static_cast<double>(g_responses.load()) / seconds);
+
+    for (auto &client : clients)
+    {
+        client->disconnect();
+    }
+    usleep(100 * 1000);
+    // TcpClient 必须在它的 loop 线程还活着时析构, clientPool 在 clients 之前声明, 最后析构
+    clients.clear();
+    return 0;
+}
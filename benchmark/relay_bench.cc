@@ -0,0 +1,161 @@
+// TcpRelay 回环吞吐: 客户端 -> 代理 -> echo 后端, 对比 splice / Buffer 拷贝 / 不经过代理
+//
+// 同一个进程里起 echo 后端和代理(每个前端连接在自己的 loop 上用 TcpClient 连后端, 连上后 TcpRelay::start),
+// 客户端 sessions 条连接各发 block_bytes 字节, 收到多少回多少(pingpong), 数据在代理里来回各过一次.
+// 每秒打印客户端收到的 MiB/s. mode: splice(默认), copy(两个方向都给一个空 inspect, 走 Buffer 拷贝), direct(直连后端, 基线).
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "TcpRelay.h"
+#include "TcpServer.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    std::atomic<bool> g_stop{false};
+    std::atomic<uint64_t> g_bytes{0};
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: relay_bench [seconds=5] [sessions=16] [block_bytes=65536] [mode=splice|copy|direct] [proxy_threads=2] [server_threads=2] [client_threads=2] [port=19984]\n");
+        return 1;
+    }
+    const int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    const int sessions = argc > 2 ? atoi(argv[2]) : 16;
+    const size_t blockBytes = argc > 3 ? static_cast<size_t>(atol(argv[3])) : 65536;
+    const std::string mode = argc > 4 ? argv[4] : "splice";
+    const int proxyThreads = argc > 5 ? atoi(argv[5]) : 2;
+    const int serverThreads = argc > 6 ? atoi(argv[6]) : 2;
+    const int clientThreads = argc > 7 ? atoi(argv[7]) : 2;
+    const uint16_t port = static_cast<uint16_t>(argc > 8 ? atoi(argv[8]) : 19984);
+    const uint16_t backendPort = static_cast<uint16_t>(port + 1);
+    if (mode != "splice" && mode != "copy" && mode != "direct")
+    {
+        fprintf(stderr, "unknown mode %s\n", mode.c_str());
+        return 1;
+    }
+
+    Logger::instance().setLogLevel(LogLevel::ERROR);
+
+    // echo 后端
+    EventLoopThread backendThread({}, "backend");
+    EventLoop *backendLoop = backendThread.startLoop();
+    TcpServer backend(backendLoop, InetAddress(backendPort), "backend");
+    backend.setConnectionCallback([](const TcpConnectionPtr &) {});
+    backend.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        buf->retrieveAll();
+    });
+    backend.setThreadNum(serverThreads);
+    backend.start();
+
+    // 代理
+    EventLoopThread proxyThread({}, "proxy");
+    EventLoop *proxyLoop = proxyThread.startLoop();
+    TcpServer proxy(proxyLoop, InetAddress(port), "proxy");
+    const bool copy = mode == "copy";
+    proxy.setConnectionCallback([backendPort, copy](const TcpConnectionPtr &front) {
+        if (!front->connected())
+        {
+            front->setContext({}); // TcpClient 在 front 的 loop 线程里析构
+            return;
+        }
+        front->stopRead(); // 后端连上之前先别读
+        auto client = std::make_shared<TcpClient>(front->getLoop(), InetAddress(backendPort, "127.0.0.1"), "upstream");
+        client->setConnectionCallback([weakFront = std::weak_ptr<TcpConnection>(front), copy](const TcpConnectionPtr &upstream) {
+            if (!upstream->connected())
+            {
+                return;
+            }
+            TcpConnectionPtr front = weakFront.lock();
+            if (!front)
+            {
+                upstream->forceClose();
+                return;
+            }
+            if (copy)
+            {
+                auto look = [](Buffer *) {};
+                TcpRelay::start(front, upstream, look, look);
+            }
+            else
+            {
+                TcpRelay::start(front, upstream);
+            }
+            front->startRead(); // 自己停的自己恢复
+        });
+        client->connect();
+        front->setContext(std::move(client));
+    });
+    proxy.setThreadNum(proxyThreads);
+    proxy.start();
+
+    // 客户端
+    EventLoop baseLoop;
+    EventLoopThreadPool clientPool(&baseLoop, "client");
+    clientPool.setThreadNum(clientThreads);
+    clientPool.start();
+    const std::vector<EventLoop *> loops = clientPool.getAllLoops();
+
+    const std::string block(blockBytes, 'x');
+    const uint16_t target = mode == "direct" ? backendPort : port;
+    std::vector<std::unique_ptr<TcpClient>> clients;
+    for (int i = 0; i < sessions; ++i)
+    {
+        auto client = std::make_unique<TcpClient>(loops[i % loops.size()], InetAddress(target, "127.0.0.1"), "bench");
+        client->setConnectionCallback([&block](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->setTcpNoDelay(true);
+                conn->send(block);
+            }
+        });
+        client->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            g_bytes.fetch_add(buf->readableBytes(), std::memory_order_relaxed);
+            if (g_stop.load(std::memory_order_relaxed))
+            {
+                buf->retrieveAll();
+                return;
+            }
+            conn->send(buf);
+            buf->retrieveAll();
+        });
+        client->connect();
+        clients.push_back(std::move(client));
+    }
+
+    printf("seconds=%d sessions=%d block_bytes=%zu mode=%s proxy_threads=%d server_threads=%d client_threads=%d\n",
+           seconds, sessions, blockBytes, mode.c_str(), proxyThreads, serverThreads, clientThreads);
+    uint64_t last = 0;
+    for (int i = 0; i < seconds; ++i)
+    {
+        sleep(1);
+        const uint64_t now = g_bytes.load(std::memory_order_relaxed);
+        printf("%3ds %10.1f MiB/s\n", i + 1, static_cast<double>(now - last) / (1024 * 1024));
+        fflush(stdout);
+        last = now;
+    }
+    g_stop = true;
+    printf("total %10.1f MiB/s\n", static_cast<double>(g_bytes.load()) / (1024 * 1024) / seconds);
+
+    usleep(200 * 1000); // 客户端不再回数据, 等在途的收完, 断开时走正常的 FIN 而不是 RST
+    clients.clear();
+    usleep(200 * 1000); // 让代理处理完关闭
+    return 0;
+}
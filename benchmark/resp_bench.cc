@@ -0,0 +1,251 @@
+// RespServer 吞吐: 一个够 redis-benchmark 用的内存 KV(PING/ECHO/SET/GET/INCR/DEL/EXISTS/CONFIG GET), 加一个内置的压测客户端
+//
+// 客户端的用法和输出对齐 redis-benchmark -q: connections 条连接, 每条保持 pipeline 条命令在途, 依次压 PING/SET/GET
+// 各 seconds 秒, 打印 "SET: 123456.78 requests per second". server_only=1 时只起服务端, 用真的 redis-benchmark 打:
+//   redis-benchmark -p 16379 -t ping,set,get,incr -P 16 -c 50 -n 1000000 -q
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "RespServer.h"
+#include "TcpClient.h"
+
+#include <any>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // 按 key 的哈希分 64 段加锁, 各 loop 之间基本碰不到同一把锁
+    class Store
+    {
+    public:
+        template <typename F>
+        auto with(std::string_view key, F &&f)
+        {
+            Shard &shard = shards_[std::hash<std::string_view>()(key) % shards_.size()];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            return f(shard.map);
+        }
+
+    private:
+        struct Shard
+        {
+            std::mutex mutex;
+            std::unordered_map<std::string, std::string> map;
+        };
+        std::array<Shard, 64> shards_;
+    };
+
+    void handle(Store &store, const RespCommand &cmd, RespWriter *reply)
+    {
+        if (cmd.is("PING"))
+        {
+            cmd.size() > 1 ? reply->bulk(cmd[1]) : reply->status("PONG");
+        }
+        else if (cmd.is("ECHO") && cmd.size() == 2)
+        {
+            reply->bulk(cmd[1]);
+        }
+        else if (cmd.is("SET") && cmd.size() >= 3)
+        {
+            store.with(cmd[1], [&](auto &map) { map[std::string(cmd[1])].assign(cmd[2].data(), cmd[2].size()); });
+            reply->ok();
+        }
+        else if (cmd.is("GET") && cmd.size() == 2)
+        {
+            // 在锁里写回复, 省一次拷贝
+            store.with(cmd[1], [&](auto &map) {
+                auto it = map.find(std::string(cmd[1]));
+                it == map.end() ? reply->null() : reply->bulk(it->second);
+            });
+        }
+        else if (cmd.is("INCR") && cmd.size() == 2)
+        {
+            const int64_t value = store.with(cmd[1], [&](auto &map) {
+                std::string &v = map[std::string(cmd[1])];
+                const int64_t n = atoll(v.c_str()) + 1;
+                v = std::to_string(n);
+                return n;
+            });
+            reply->integer(value);
+        }
+        else if (cmd.is("DEL") && cmd.size() >= 2)
+        {
+            int64_t removed = 0;
+            for (size_t i = 1; i < cmd.size(); ++i)
+            {
+                removed += store.with(cmd[i], [&](auto &map) { return static_cast<int64_t>(map.erase(std::string(cmd[i]))); });
+            }
+            reply->integer(removed);
+        }
+        else if (cmd.is("EXISTS") && cmd.size() >= 2)
+        {
+            int64_t found = 0;
+            for (size_t i = 1; i < cmd.size(); ++i)
+            {
+                found += store.with(cmd[i], [&](auto &map) { return static_cast<int64_t>(map.count(std::string(cmd[i]))); });
+            }
+            reply->integer(found);
+        }
+        else if (cmd.is("CONFIG") && cmd.size() == 3)
+        {
+            // redis-benchmark 启动时会查 save/appendonly, 回一对空值就行
+            reply->map(1);
+            reply->bulk(cmd[2]);
+            reply->bulk("");
+        }
+        else
+        {
+            reply->error("ERR unknown command '" + std::string(cmd.name()) + "'");
+        }
+    }
+
+    std::atomic<bool> g_stop{false};
+    std::atomic<uint64_t> g_replies{0};
+
+    struct Test
+    {
+        const char *name;
+        std::string command; // 一条命令的线上格式
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: resp_bench [seconds=3] [connections=50] [pipeline=16] [value_bytes=3] [server_threads=4] [client_threads=2] [port=16379] [server_only=0]\n");
+        return 1;
+    }
+    const int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    const int connections = argc > 2 ? atoi(argv[2]) : 50;
+    const int pipeline = argc > 3 ? atoi(argv[3]) : 16;
+    const size_t valueBytes = argc > 4 ? static_cast<size_t>(atol(argv[4])) : 3;
+    const int serverThreads = argc > 5 ? atoi(argv[5]) : 4;
+    const int clientThreads = argc > 6 ? atoi(argv[6]) : 2;
+    const uint16_t port = static_cast<uint16_t>(argc > 7 ? atoi(argv[7]) : 16379);
+    const bool serverOnly = argc > 8 && atoi(argv[8]) != 0;
+
+    Logger::instance().setLogLevel(LogLevel::ERROR);
+
+    // 服务端
+    Store store;
+    EventLoopThread serverThread({}, "resp");
+    EventLoop *serverLoop = serverThread.startLoop();
+    RespServer server(serverLoop, InetAddress(port), "resp");
+    server.setCommandHandler([&store](const TcpConnectionPtr &, const RespCommand *commands, size_t count, RespWriter *reply) {
+        for (size_t i = 0; i < count; ++i)
+        {
+            handle(store, commands[i], reply);
+        }
+    });
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    if (serverOnly)
+    {
+        printf("listening on %u, server_threads=%d. Ctrl-C to stop\n", port, serverThreads);
+        fflush(stdout);
+        pause();
+        return 0;
+    }
+
+    // 客户端: 和 redis-benchmark 一样, key 是 "key:__rand_int__" 这种固定前缀 + 数字, 这里用固定 key
+    const std::string value(valueBytes, 'x');
+    std::vector<Test> tests;
+    auto encode = [](std::initializer_list<std::string_view> args) {
+        Buffer buf;
+        RespWriter::appendCommand(&buf, args);
+        return buf.retrieveAllAsString();
+    };
+    tests.push_back({"PING_INLINE", "PING\r\n"});
+    tests.push_back({"PING_MBULK", encode({"PING"})});
+    tests.push_back({"SET", encode({"SET", "key:000000000042", value})});
+    tests.push_back({"GET", encode({"GET", "key:000000000042"})});
+    tests.push_back({"INCR", encode({"INCR", "counter:000000000042"})});
+
+    EventLoop baseLoop;
+    EventLoopThreadPool clientPool(&baseLoop, "client");
+    clientPool.setThreadNum(clientThreads);
+    clientPool.start();
+    const std::vector<EventLoop *> loops = clientPool.getAllLoops();
+
+    printf("seconds=%d connections=%d pipeline=%d value_bytes=%zu server_threads=%d client_threads=%d\n",
+           seconds, connections, pipeline, valueBytes, serverThreads, clientThreads);
+    for (const Test &test : tests)
+    {
+        g_stop = false;
+        g_replies = 0;
+        std::string batch;
+        for (int i = 0; i < pipeline; ++i)
+        {
+            batch += test.command;
+        }
+
+        std::vector<std::unique_ptr<TcpClient>> clients;
+        for (int i = 0; i < connections; ++i)
+        {
+            auto client = std::make_unique<TcpClient>(loops[i % loops.size()], InetAddress(port, "127.0.0.1"), "bench");
+            client->setConnectionCallback([&batch](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    conn->setTcpNoDelay(true);
+                    conn->setContext(0); // 这一批已经回来的条数
+                    conn->send(batch);
+                }
+            });
+            client->setMessageCallback([&batch, &test, pipeline](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+                int done = 0;
+                ssize_t n;
+                while ((n = RespReply::length(buf->peek(), buf->readableBytes())) > 0)
+                {
+                    if (buf->peek()[0] == '-')
+                    {
+                        fprintf(stderr, "%s: %.*s", test.name, static_cast<int>(n), buf->peek());
+                    }
+                    buf->retrieve(static_cast<size_t>(n));
+                    ++done;
+                }
+                g_replies.fetch_add(done, std::memory_order_relaxed);
+                // 和 redis-benchmark -P 一样: 一整批回来了才发下一批
+                int &got = *std::any_cast<int>(conn->getMutableContext());
+                got += done;
+                if (got >= pipeline)
+                {
+                    got -= pipeline;
+                    if (!g_stop.load(std::memory_order_relaxed))
+                    {
+                        conn->send(batch);
+                    }
+                }
+            });
+            client->connect();
+            clients.push_back(std::move(client));
+        }
+
+        usleep(static_cast<useconds_t>(seconds) * 1000 * 1000);
+        g_stop = true;
+        printf("%s: %.2f requests per second\n", test.name, static_cast<double>(g_replies.load()) / seconds);
+        fflush(stdout);
+
+        for (auto &client : clients)
+        {
+            client->disconnect();
+        }
+        usleep(100 * 1000);
+        clients.clear();
+    }
+    return 0;
+}
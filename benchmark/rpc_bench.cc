@@ -0,0 +1,193 @@
+// RpcServer/RpcChannel 回环吞吐: calls/s 和调用延迟
+//
+// 同一个进程里起一个 RpcServer(Echo: 原样返回 payload; Sum: 对一组 int64 求和), 客户端 loops 上开 channels 个 RpcChannel,
+// 每个保持 depth 个调用在途(一个回来补一个), 跑 seconds 秒, 打印每秒的 calls/s, 最后打印延迟分布(微秒).
+// depth > 1 时同一条连接上多个调用并发在途, 走的就是按请求 id 多路复用的路径.
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include "Histogram.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "RpcChannel.h"
+#include "RpcServer.h"
+#include "TscClock.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    struct EchoRequest
+    {
+        std::string_view payload; // 服务端解码不拷贝
+        auto rpcFields() { return std::tie(payload); }
+    };
+    struct EchoResponse
+    {
+        std::string_view payload;
+        auto rpcFields() { return std::tie(payload); }
+    };
+    struct SumRequest
+    {
+        std::vector<int64_t> values;
+        auto rpcFields() { return std::tie(values); }
+    };
+    struct SumResponse
+    {
+        int64_t sum = 0;
+        uint32_t count = 0;
+        auto rpcFields() { return std::tie(sum, count); }
+    };
+
+    inline constexpr RpcMethod<EchoRequest, EchoResponse> kEcho{"bench.Echo"};
+    inline constexpr RpcMethod<SumRequest, SumResponse> kSum{"bench.Sum"};
+
+    std::atomic<bool> g_stop{false};
+    std::atomic<uint64_t> g_calls{0};
+    std::atomic<uint64_t> g_errors{0};
+
+    // 每个客户端 loop 一份, 只在那个 loop 线程里写
+    struct ClientStats
+    {
+        Histogram latencyUs;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: rpc_bench [seconds=5] [channels=8] [depth=64] [payload_bytes=32] [server_threads=2] [client_threads=2] [port=19982] [method=echo|sum]\n");
+        return 1;
+    }
+    const int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    const int channels = argc > 2 ? atoi(argv[2]) : 8;
+    const int depth = argc > 3 ? atoi(argv[3]) : 64;
+    const size_t payloadBytes = argc > 4 ? static_cast<size_t>(atol(argv[4])) : 32;
+    const int serverThreads = argc > 5 ? atoi(argv[5]) : 2;
+    const int clientThreads = argc > 6 ? atoi(argv[6]) : 2;
+    const uint16_t port = static_cast<uint16_t>(argc > 7 ? atoi(argv[7]) : 19982);
+    const bool sum = argc > 8 && strcmp(argv[8], "sum") == 0;
+
+    Logger::instance().setLogLevel(LogLevel::ERROR);
+    TscClock::calibrateOnce();
+
+    // 服务端
+    EventLoopThread serverThread({}, "rpc");
+    EventLoop *serverLoop = serverThread.startLoop();
+    RpcServer server(serverLoop, InetAddress(port), "rpc");
+    server.registerMethod(kEcho, [](const EchoRequest &req, RpcReply<EchoResponse> reply) {
+        reply(EchoResponse{req.payload});
+    });
+    server.registerMethod(kSum, [](const SumRequest &req, RpcReply<SumResponse> reply) {
+        SumResponse resp;
+        for (int64_t v : req.values)
+        {
+            resp.sum += v;
+        }
+        resp.count = static_cast<uint32_t>(req.values.size());
+        reply(resp);
+    });
+    server.setThreadNum(serverThreads);
+    server.start();
+
+    // 客户端
+    EventLoop baseLoop;
+    EventLoopThreadPool clientPool(&baseLoop, "client");
+    clientPool.setThreadNum(clientThreads);
+    clientPool.start();
+    const std::vector<EventLoop *> loops = clientPool.getAllLoops();
+    std::vector<std::unique_ptr<ClientStats>> stats;
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        stats.push_back(std::make_unique<ClientStats>());
+    }
+
+    const std::string payload(payloadBytes, 'x');
+    SumRequest sumRequest;
+    sumRequest.values.resize(payloadBytes / 8 + 1, 7);
+
+    std::vector<std::unique_ptr<RpcChannel>> clients;
+    std::vector<std::function<void()>> issuers; // 每个 channel 发一个调用, 回调里再调自己
+    for (int i = 0; i < channels; ++i)
+    {
+        const size_t loopIndex = i % loops.size();
+        clients.push_back(std::make_unique<RpcChannel>(loops[loopIndex], InetAddress(port, "127.0.0.1"), "bench"));
+        clients.back()->connect();
+    }
+    issuers.resize(channels);
+    for (int i = 0; i < channels; ++i)
+    {
+        RpcChannel *channel = clients[i].get();
+        ClientStats *loopStats = stats[i % loops.size()].get();
+        std::function<void()> &issue = issuers[i];
+        issue = [channel, loopStats, &issue, &payload, &sumRequest, sum] {
+            if (g_stop.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            const uint64_t start = TscClock::now();
+            auto done = [loopStats, &issue, start](RpcStatus status, const auto &) {
+                if (status == RpcStatus::kOk)
+                {
+                    loopStats->latencyUs.record(static_cast<uint64_t>(TscClock::toMicroseconds(TscClock::now() - start)));
+                    g_calls.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    g_errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                issue();
+            };
+            if (sum)
+            {
+                channel->call(kSum, sumRequest, done);
+            }
+            else
+            {
+                channel->call(kEcho, EchoRequest{payload}, done);
+            }
+        };
+        // 在 channel 的 loop 里一次发 depth 个, 还没连上的先攒着, 连上一起发
+        channel->getLoop()->runInLoop([&issue, depth] {
+            for (int k = 0; k < depth; ++k)
+            {
+                issue();
+            }
+        });
+    }
+
+    printf("seconds=%d channels=%d depth=%d payload_bytes=%zu server_threads=%d client_threads=%d method=%s\n",
+           seconds, channels, depth, payloadBytes, serverThreads, clientThreads, sum ? "sum" : "echo");
+    uint64_t last = 0;
+    for (int i = 0; i < seconds; ++i)
+    {
+        sleep(1);
+        const uint64_t now = g_calls.load(std::memory_order_relaxed);
+        printf("%3ds %12lu calls/s\n", i + 1, static_cast<unsigned long>(now - last));
+        fflush(stdout);
+        last = now;
+    }
+    g_stop = true;
+    usleep(200 * 1000);
+
+    Histogram::Snapshot latency;
+    for (const auto &s : stats)
+    {
+        latency.merge(s->latencyUs.snapshot());
+    }
+    printf("total %12.0f calls/s, errors=%lu\n", static_cast<double>(g_calls.load()) / seconds, static_cast<unsigned long>(g_errors.load()));
+    printf("latency(us) %s\n", latency.toString().c_str());
+
+    // RpcChannel 要在它的 loop 线程还活着时析构, clientPool 在 clients 之前声明, 最后析构
+    clients.clear();
+    return 0;
+}
@@ -0,0 +1,147 @@
+// UpstreamPool 请求延迟 vs 池子大小
+//
+// 同一个进程里起一个按行回显的后端(TcpServer, 每个请求可以模拟 workUs 微秒的处理时间),
+// 客户端 loops 上跑 concurrency 个闭环请求者(收到响应立刻发下一个), 逐档换池子大小, 每档跑 seconds 秒.
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "UpstreamPool.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    void spin(int workUs)
+    {
+        const Timestamp until = addTime(Timestamp::now(), workUs / 1e6);
+        while (Timestamp::now() < until)
+        {
+        }
+    }
+
+    // 一行一个响应
+    ssize_t parseLine(const Buffer *buf)
+    {
+        const void *eol = memchr(buf->peek(), '\n', buf->readableBytes());
+        return eol ? static_cast<const char *>(eol) - buf->peek() + 1 : 0;
+    }
+
+    struct Driver
+    {
+        UpstreamPool *pool;
+        InetAddress backend;
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> ok{0};
+        std::atomic<uint64_t> errors{0};
+
+        void fire(EventLoop *loop)
+        {
+            pool->request(loop, backend, "hello\n", [this, loop](UpstreamPool::Status status, const char *, size_t) {
+                (status == UpstreamPool::Status::kOk ? ok : errors).fetch_add(1, std::memory_order_relaxed);
+                if (!stop.load(std::memory_order_relaxed))
+                {
+                    fire(loop);
+                }
+            });
+        }
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: upstream_pool_bench [seconds=5] [concurrency=64] [pipeline_depth=16] [work_us=0] [client_threads=2] [backend_threads=4]\n");
+        return 1;
+    }
+    const int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    const int concurrency = argc > 2 ? atoi(argv[2]) : 64;
+    const size_t depth = argc > 3 ? static_cast<size_t>(atoi(argv[3])) : 16;
+    const int workUs = argc > 4 ? atoi(argv[4]) : 0;
+    const int clientThreads = argc > 5 ? atoi(argv[5]) : 2;
+    const int backendThreads = argc > 6 ? atoi(argv[6]) : 4;
+
+    Logger::instance().setLogLevel(LogLevel::ERROR);
+
+    // 池子析构时没回来的请求以 kClosed 回调, 回调在 loop 里稍后执行, Driver 得活到 loops 都停了之后
+    std::vector<std::unique_ptr<Driver>> drivers;
+
+    // 后端
+    EventLoopThread backendThread({}, "backend");
+    EventLoop *backendLoop = backendThread.startLoop();
+    const InetAddress backendAddr(19980);
+    TcpServer backend(backendLoop, backendAddr, "backend");
+    backend.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true);
+        }
+    });
+    backend.setMessageCallback([workUs](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        while (const ssize_t n = parseLine(buf))
+        {
+            spin(workUs);
+            conn->send(buf->peek(), static_cast<size_t>(n));
+            buf->retrieve(static_cast<size_t>(n));
+        }
+    });
+    backend.setThreadNum(backendThreads);
+    backend.start();
+
+    // 客户端 loops
+    EventLoop baseLoop;
+    EventLoopThreadPool clientPool(&baseLoop, "client");
+    clientPool.setThreadNum(clientThreads);
+    clientPool.start();
+    const std::vector<EventLoop *> loops = clientPool.getAllLoops();
+
+    printf("seconds=%d concurrency=%d pipeline_depth=%zu work_us=%d client_threads=%d backend_threads=%d\n",
+           seconds, concurrency, depth, workUs, clientThreads, backendThreads);
+    printf("%-10s %12s %10s %10s %10s %10s %10s %8s\n", "pool_size", "req/s", "mean_us", "p50_us", "p99_us", "p999_us", "max_us", "errors");
+
+    for (size_t poolSize : {1, 2, 4, 8, 16, 32})
+    {
+        UpstreamPool::Options options;
+        options.maxConnectionsPerBackend = poolSize;
+        options.maxPipelineDepth = depth;
+        options.maxInFlightPerBackend = static_cast<size_t>(concurrency);
+        options.maxQueuedPerBackend = static_cast<size_t>(concurrency);
+        options.requestTimeout = 5.0;
+
+        Histogram::Snapshot latency;
+        Driver &driver = *drivers.emplace_back(std::make_unique<Driver>());
+        uint64_t completed = 0;
+        {
+            UpstreamPool pool(loops, "bench", parseLine, options);
+            driver.pool = &pool;
+            driver.backend = backendAddr;
+            for (int i = 0; i < concurrency; ++i)
+            {
+                driver.fire(loops[i % loops.size()]);
+            }
+            sleep(seconds);
+            driver.stop = true;
+            completed = driver.ok.load();
+            usleep(200 * 1000); // 等在途的请求回来
+            latency = pool.latencySnapshot();
+        }
+        printf("%-10zu %12.0f %10.1f %10lu %10lu %10lu %10lu %8lu\n",
+               poolSize, static_cast<double>(completed) / seconds, latency.mean(),
+               static_cast<unsigned long>(latency.percentile(0.5)), static_cast<unsigned long>(latency.percentile(0.99)),
+               static_cast<unsigned long>(latency.percentile(0.999)), static_cast<unsigned long>(latency.max),
+               static_cast<unsigned long>(driver.errors.load()));
+        fflush(stdout);
+    }
+    return 0;
+}
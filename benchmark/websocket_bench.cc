@@ -0,0 +1,95 @@
+// WebSocket 解掩码: WebSocket::unmask(按 CPU 选 AVX2/SSE2)和逐字节异或对拍 + 吞吐
+//
+// 1. 对拍: 随机长度(0~4096)、随机起点(不对齐)、随机掩码, 结果必须和逐字节版本一样, 不一致打印参数退出 1;
+// 2. 压测: 几种典型的帧大小, 在同一块内存上反复解掩码, 打印两种实现的 GB/s.
+#include "TscClock.h"
+#include "WebSocket.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void unmaskBytewise(char *data, size_t len, const uint8_t mask[4])
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            data[i] = static_cast<char>(data[i] ^ mask[i & 3]);
+        }
+    }
+
+    bool fuzz(int rounds)
+    {
+        std::mt19937_64 rng(20240601);
+        std::vector<char> a(4096 + 64), b(a.size());
+        for (int r = 0; r < rounds; ++r)
+        {
+            const size_t offset = rng() % 64;
+            const size_t len = rng() % 4097;
+            uint8_t mask[4];
+            for (uint8_t &m : mask)
+            {
+                m = static_cast<uint8_t>(rng());
+            }
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                a[i] = b[i] = static_cast<char>(rng());
+            }
+            WebSocket::unmask(a.data() + offset, len, mask);
+            unmaskBytewise(b.data() + offset, len, mask);
+            if (memcmp(a.data(), b.data(), a.size()) != 0)
+            {
+                fprintf(stderr, "MISMATCH offset=%zu len=%zu mask=%02x%02x%02x%02x\n", offset, len, mask[0], mask[1], mask[2], mask[3]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename F>
+    double gbPerSecond(F &&unmask, size_t frameBytes, size_t totalBytes)
+    {
+        std::vector<char> frame(frameBytes, 'x');
+        const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+        const size_t iterations = totalBytes / frameBytes + 1;
+        const uint64_t start = TscClock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            unmask(frame.data(), frame.size(), mask);
+            asm volatile("" : : "r"(frame.data()) : "memory"); // 别让编译器把循环合并掉
+        }
+        const double seconds = static_cast<double>(TscClock::toNanoseconds(TscClock::now() - start)) / 1e9;
+        return static_cast<double>(iterations * frameBytes) / seconds / 1e9;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+    {
+        fprintf(stderr, "Usage: websocket_bench [fuzz_rounds=200000] [megabytes_per_size=2048]\n");
+        return 1;
+    }
+    TscClock::calibrateOnce();
+    const int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+    const size_t totalBytes = (argc > 2 ? static_cast<size_t>(atol(argv[2])) : 2048) << 20;
+
+    if (!fuzz(rounds))
+    {
+        return 1;
+    }
+    printf("fuzz: %d rounds OK\n", rounds);
+
+    printf("%10s %14s %14s\n", "frame", "bytewise GB/s", "unmask GB/s");
+    for (size_t frameBytes : {64, 512, 4096, 65536, 1 << 20})
+    {
+        const double scalar = gbPerSecond(unmaskBytewise, frameBytes, totalBytes / 4);
+        const double simd = gbPerSecond(WebSocket::unmask, frameBytes, totalBytes);
+        printf("%10zu %14.2f %14.2f\n", frameBytes, scalar, simd);
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "Metrics.h"
 
 class EventLoop;
 class InetAddress;
@@ -24,6 +25,8 @@ public:
     bool listenning() const { return listenning_; }
     // 监听本地端口
     void listen();
+    // TcpServer 构造时设置, labels 形如 server="echo"
+    void setMetricsLabels(const std::string &labels);
 
 private:
     void handleRead();//处理新用户的连接事件
@@ -33,4 +36,7 @@ private:
     Channel acceptChannel_;//专门用于监听新连接的channel
     NewConnectionCallback NewConnectionCallback_;//新连接的回调函数
     bool listenning_;//是否在监听
+    Counter acceptedMetric_;
+    Counter rejectedMetric_;
+    Counter errorsMetric_;
 };
\ No newline at end of file
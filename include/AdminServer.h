@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "noncopyable.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+
+class EventLoop;
+class TcpServer;
+class Buffer;
+
+/**
+ * 内嵌的管理端口: 自己一个线程一个 EventLoop, 只说最简单的 HTTP/1.x GET, 一个请求一个连接.
+ * 抓取指标、看连接状态这些诊断请求不会占用数据路径上的任何 loop.
+ *
+ *   AdminServer admin(InetAddress(9100));
+ *   admin.addHandler("/hello", [](const std::string &query, const AdminServer::Responder &respond) {
+ *       respond(200, "text/plain", "hi\n");
+ *   });
+ *   admin.start(); // 默认带 /metrics (MetricsRegistry 的 Prometheus 文本)
+ *
+ * handler 在 admin loop 里执行, 可以保存 respond 稍后再调(比如跑一段时间的 profiling 之后), 但必须在 admin loop 里调.
+ **/
+class AdminServer : noncopyable
+{
+public:
+    using Responder = std::function<void(int status, const std::string &contentType, const std::string &body)>;
+    using Handler = std::function<void(const std::string &query, const Responder &respond)>;
+
+    explicit AdminServer(const InetAddress &listenAddr, const std::string &name = "admin");
+    ~AdminServer();
+
+    // 必须在 start() 之前调用
+    void addHandler(const std::string &path, Handler handler) { handlers_[path] = std::move(handler); }
+
+    void start();
+    EventLoop *getLoop() const { return loop_; }
+
+private:
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf);
+    static void sendResponse(const TcpConnectionPtr &conn, int status, const std::string &contentType, const std::string &body);
+
+    inline static constexpr size_t kMaxRequestSize = 8 * 1024;
+
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::map<std::string, Handler> handlers_;
+    EventLoopThread thread_;
+    EventLoop *loop_ = nullptr;
+    std::unique_ptr<TcpServer> server_; // 在 admin loop 里创建和析构
+};
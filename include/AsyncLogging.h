@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+/**
+ * 异步日志后端. 和 muduo 原版 AsyncLogging 的区别: 原版所有线程 append 时抢同一把 mutex,
+ * 这里每个写日志的线程有自己的暂存环形缓冲(单生产者单消费者, 无锁), 后台线程轮流把各个环
+ * 里的数据搬进自己的写缓冲, 再一次性写到 LogFile. 热路径上只有两次 memcpy 和一次 release store.
+ *
+ *   AsyncLogging asyncLog("/var/log/server", 500 * 1024 * 1024);
+ *   asyncLog.start();
+ *   Logger::instance().setOutput([&](const char *msg, size_t len) { asyncLog.append(msg, len); });
+ *   Logger::instance().setFlush([&] { asyncLog.flush(); });
+ *
+ * 内存上限 = 写日志的线程数 * bufferSize, 环满了按策略处理:
+ *   kDrop  丢弃这条日志并计数, 后台线程下次写文件时补一行 "dropped N messages"(默认, loop 线程不会被磁盘拖住)
+ *   kBlock 唤醒后台线程, 让出 CPU 直到有空间, 一条不丢
+ **/
+class AsyncLogging : noncopyable
+{
+public:
+    enum OverflowPolicy
+    {
+        kDrop,
+        kBlock,
+    };
+
+    AsyncLogging(const std::string &basename,
+                 off_t rollSize,
+                 int flushInterval = 3,
+                 size_t bufferSize = 1024 * 1024,
+                 OverflowPolicy policy = kDrop);
+    ~AsyncLogging();
+
+    // 都要在 start() 之前设置. 默认是文本日志: 没有文件头, 丢弃提示是一行 [ERROR] 文本
+    void setFileHeader(std::function<std::string()> header) { fileHeader_ = std::move(header); }
+    void setDroppedNotice(std::function<std::string(int64_t dropped)> notice) { droppedNotice_ = std::move(notice); }
+
+    void start();
+    void stop();
+
+    // 任意线程调用, 一条完整的日志(含换行)
+    void append(const char *logline, size_t len) { append(logline, len, policy_); }
+    // 这一条不按构造时的策略, 按 policy 处理环满. BinaryLogger 的 'D' 帧用 kBlock: 丢了它, 这个调用点之后的记录都解不出来
+    void append(const char *logline, size_t len, OverflowPolicy policy);
+    // 把已经 append 的日志都写进文件并 fflush 才返回, LOG_FATAL 退出前用
+    void flush();
+
+    int64_t droppedMessages() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * 每个线程一个, 容量是2的幂. head_ 只有后台线程写, tail_ 只有属主线程写, 都单调递增不回绕,
+     * 下标取 & mask_. 每条日志写完才发布 tail_, 所以后台线程看到的总是完整的行.
+     **/
+    struct ThreadBuffer : noncopyable
+    {
+        explicit ThreadBuffer(size_t capacity)
+            : data(new char[capacity])
+            , mask(capacity - 1)
+        {
+        }
+
+        size_t capacity() const { return mask + 1; }
+
+        std::unique_ptr<char[]> data;
+        const size_t mask;
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<bool> abandoned{false}; // 属主线程已退出, 后台线程把剩下的写完就回收
+    };
+    using ThreadBufferPtr = std::shared_ptr<ThreadBuffer>;
+
+    ThreadBuffer *localBuffer();
+    void wakeup();
+    void threadFunc();
+    // 把所有线程的环里的数据搬到 output, 返回是否搬到了东西
+    bool drainInto(std::string &output);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const size_t bufferSize_;
+    const OverflowPolicy policy_;
+
+    std::function<std::string()> fileHeader_;
+    std::function<std::string(int64_t)> droppedNotice_;
+
+    std::atomic<bool> running_{false};
+    Thread thread_;
+
+    std::mutex mutex_; // 只保护 buffers_ 的注册/回收和后台线程的睡眠, 不在 append 的热路径上
+    std::condition_variable cond_;
+    std::vector<ThreadBufferPtr> buffers_;
+    std::atomic<bool> signaled_{false}; // 已经有人叫醒过后台线程了, 后面的生产者不用再拿锁 notify
+
+    std::condition_variable flushedCond_;
+    uint64_t flushRequested_ = 0; // mutex_ 保护
+    uint64_t flushCompleted_ = 0;
+
+    std::atomic<int64_t> dropped_{0};
+    int64_t droppedReported_ = 0; // 只有后台线程读写
+};
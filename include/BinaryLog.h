@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Logger.h"
+#include "Timestamp.h"
+#include "CurrentThread.h"
+
+class AsyncLogging;
+
+/**
+ * 二进制日志: 热路径不格式化. 每个调用点有一个静态的格式描述(文件/行号/格式串/参数类型),
+ * 第一次执行时注册一次拿到 id; 之后每次只把 id + 时间戳 + tid + 参数的原始字节拷进线程局部
+ * 缓冲, 再交给 AsyncLogging 的线程环. 离线用 tools/muduo-logcat 解码成文本.
+ *
+ *   AsyncLogging backend("/var/log/server.blog", 500 * 1024 * 1024);
+ *   BinaryLogger::instance().attach(&backend); // 设置文件头和丢弃提示, 要在 backend.start() 之前
+ *   backend.start();
+ *   BLOG_INFO("conn %s read %zu bytes in %.3f ms", conn->name().c_str(), n, ms);
+ *
+ * 参数只支持 printf 的标量和 C 字符串(字符串按内容拷贝, 长度上限 kMaxStringArg).
+ * 格式串在编译期和 LOG_xxx 一样按 printf 规则检查.
+ *
+ * 文件格式(本机字节序, 只在同构机器上解码):
+ *   文件头: kMagic(8字节), 然后是到目前为止注册过的所有 'D' 帧
+ *   帧:     type(1) + payloadLen(4) + payload
+ *   'D' 格式描述: id(4) level(1) line(4) fileLen(2) file fmtLen(2) fmt nargs(1) types[nargs]
+ *   'R' 一条日志: id(4) timeUs(8) tid(4) 参数...   i/u/p: 8字节  d: double 8字节  s: len(4)+bytes
+ *   'X' 丢弃提示: count(8)
+ * 新调用点注册时, 注册线程在它的第一条记录之前写一个 'D' 帧; 解码器先扫一遍收集所有 'D' 帧再解码,
+ * 所以 'D' 帧和用它的记录不在同一个线程环里也没关系.
+ **/
+namespace binarylog
+{
+    inline constexpr char kMagic[8] = {'M', 'U', 'D', 'B', 'L', 'O', 'G', '1'};
+    inline constexpr char kFrameDescriptor = 'D';
+    inline constexpr char kFrameRecord = 'R';
+    inline constexpr char kFrameDropped = 'X';
+    inline constexpr size_t kFrameHeaderSize = 1 + 4;
+    inline constexpr size_t kMaxRecordSize = 4096;
+    inline constexpr size_t kMaxStringArg = 1024;
+
+    // 参数类型码
+    template <typename T>
+    constexpr char typeCode()
+    {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>)
+            return 's';
+        else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>)
+            return 'p';
+        else if constexpr (std::is_floating_point_v<U>)
+            return 'd';
+        else if constexpr (std::is_enum_v<U>)
+            return std::is_signed_v<std::underlying_type_t<U>> ? 'i' : 'u';
+        else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+            return 'i';
+        else if constexpr (std::is_integral_v<U>)
+            return 'u';
+        else
+            static_assert(sizeof(U) == 0, "BLOG_xxx arguments must be printf-compatible scalars or C strings");
+    }
+
+    template <typename... Args>
+    inline constexpr char kTypeCodes[] = {typeCode<Args>()..., '\0'};
+}
+
+// 调用点的静态描述, 宏里 static 定义, id 在第一次用到时分配
+struct BinaryLogSite
+{
+    const char *file;
+    int line;
+    LogLevel level;
+    const char *format;
+    std::atomic<uint32_t> id{0};
+};
+
+class BinaryLogger : noncopyable
+{
+public:
+    static BinaryLogger &instance();
+
+    // 绑定后端并设置它的文件头/丢弃提示, 必须在 backend->start() 之前
+    void attach(AsyncLogging *backend);
+    bool enabled(LogLevel level) const { return backend_ != nullptr && Logger::instance().enabled(level); }
+
+    template <typename... Args>
+    void write(BinaryLogSite &site, Args... args)
+    {
+        uint32_t id = site.id.load(std::memory_order_acquire);
+        if (__builtin_expect(id == 0, 0))
+        {
+            id = registerSite(site, binarylog::kTypeCodes<Args...>);
+        }
+
+        char *buf = t_record;
+        char *p = buf + binarylog::kFrameHeaderSize;
+        p = put(p, id);
+        p = put(p, Timestamp::now().microSecondsSinceEpoch());
+        p = put(p, static_cast<int32_t>(CurrentThread::tid()));
+        bool fits = true;
+        ((fits = fits && encode(p, buf + binarylog::kMaxRecordSize, args)), ...);
+        if (!fits)
+        {
+            return; // 超长的记录直接丢, 不截断(截断了解码器对不上参数)
+        }
+        finishFrame(buf, binarylog::kFrameRecord, p);
+    }
+
+private:
+    BinaryLogger() = default;
+
+    uint32_t registerSite(BinaryLogSite &site, const char *types);
+    // 当前所有描述拼成的文件头
+    std::string fileHeader();
+    void finishFrame(char *frame, char type, char *end);
+
+    template <typename T>
+    static char *put(char *p, T value)
+    {
+        memcpy(p, &value, sizeof(value));
+        return p + sizeof(value);
+    }
+
+    template <typename T>
+    static bool encode(char *&p, char *limit, T value)
+    {
+        constexpr char code = binarylog::typeCode<T>();
+        if constexpr (code == 's')
+        {
+            const char *str = value ? value : "(null)";
+            const size_t len = strnlen(str, binarylog::kMaxStringArg);
+            if (p + sizeof(uint32_t) + len > limit)
+            {
+                return false;
+            }
+            p = put(p, static_cast<uint32_t>(len));
+            memcpy(p, str, len);
+            p += len;
+        }
+        else
+        {
+            if (p + sizeof(uint64_t) > limit)
+            {
+                return false;
+            }
+            if constexpr (code == 'd')
+                p = put(p, static_cast<double>(value));
+            else if constexpr (code == 'p')
+                p = put(p, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+            else if constexpr (code == 'i')
+                p = put(p, static_cast<int64_t>(value));
+            else
+                p = put(p, static_cast<uint64_t>(value));
+        }
+        return true;
+    }
+
+    static std::string descriptorFrame(const BinaryLogSite &site, uint32_t id, const std::string &types);
+
+    inline static thread_local char t_record[binarylog::kMaxRecordSize];
+
+    AsyncLogging *backend_ = nullptr;
+
+    std::mutex mutex_; // 只在注册调用点和生成文件头时用
+    std::vector<std::string> descriptors_; // 已编码好的 'D' 帧, 下标 = id - 1
+};
+
+#define MUDUO_BLOG_IMPL(level, logmsgFormat, ...)                                   \
+    do                                                                              \
+    {                                                                               \
+        if constexpr (static_cast<int>(level) >= MUDUO_LOG_MIN_LEVEL)               \
+        {                                                                           \
+            if (false)                                                              \
+            {                                                                       \
+                Logger::checkFormat(logmsgFormat, ##__VA_ARGS__);                   \
+            }                                                                       \
+            if (BinaryLogger::instance().enabled(level))                            \
+            {                                                                       \
+                static BinaryLogSite muduoBlogSite{__FILE__, __LINE__, level, logmsgFormat}; \
+                BinaryLogger::instance().write(muduoBlogSite, ##__VA_ARGS__);       \
+            }                                                                       \
+        }                                                                           \
+    } while (0)
+
+#define BLOG_DEBUG(logmsgFormat, ...) MUDUO_BLOG_IMPL(LogLevel::DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define BLOG_INFO(logmsgFormat, ...) MUDUO_BLOG_IMPL(LogLevel::INFO, logmsgFormat, ##__VA_ARGS__)
+#define BLOG_ERROR(logmsgFormat, ...) MUDUO_BLOG_IMPL(LogLevel::ERROR, logmsgFormat, ##__VA_ARGS__)
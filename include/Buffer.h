@@ -36,7 +36,8 @@ class Buffer
 {
 public:
     // 惯例顺序: inline static constexpr (而非 static inline constexpr)
-    inline static constexpr size_t kCheapPrepend = 8;
+    // 原版是 8 字节(够放一个 int64 长度头). 改成 16: WebSocket 服务端帧头最长 10 字节, 也要能直接补在负载前面
+    inline static constexpr size_t kCheapPrepend = 16;
     inline static constexpr size_t kInitialSize = 1024;
 
 
@@ -50,9 +51,13 @@ public:
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }
     size_t writableBytes() const { return buffer_.size() - writerIndex_; }
     size_t prependableBytes() const { return readerIndex_; }
+    // 底层vector实际占用的内存, MemoryBudget按这个记账
+    size_t internalCapacity() const { return buffer_.capacity(); }
 
     // 返回缓冲区中可读数据的起始地址
     const char *peek() const { return begin() + readerIndex_; }
+    // 原地改可读数据用(比如 WebSocket 在 inputBuffer_ 里直接解掩码)
+    char *peek() { return begin() + readerIndex_; }
     void retrieve(size_t len)
     {
         if (len < readableBytes())
@@ -98,6 +103,17 @@ public:
     }
     char *beginWrite() { return begin() + writerIndex_; }
     const char *beginWrite() const { return begin() + writerIndex_; }
+    // 直接往 beginWrite() 里写完之后, 把写了多少告诉 Buffer
+    void hasWritten(size_t len) { writerIndex_ += len; }
+
+    // 在可读数据前面补一段(比如先写消息体, 算出长度再补长度头), 用的是 kCheapPrepend 预留的那几个字节.
+    // 调用方保证 len <= prependableBytes()
+    void prepend(const void *data, size_t len)
+    {
+        readerIndex_ -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
 
     // 从fd上读取数据
     ssize_t readFd(int fd, int *saveErrno);
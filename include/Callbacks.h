@@ -12,7 +12,10 @@ using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+using LowWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
 
 using MessageCallback = std::function<void(const TcpConnectionPtr &,
                                            Buffer *,
-                                           Timestamp)>;
\ No newline at end of file
+                                           Timestamp)>;
+
+using TimerCallback = std::function<void()>;
@@ -3,6 +3,7 @@
 #include <sys/epoll.h>
 #include <functional>
 #include <memory>
+#include <string>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
@@ -30,6 +31,9 @@ public:
     void setWriteCallback(EventCallback cb) { writeCallback_ = std::move(cb); }
     void setCloseCallback(EventCallback cb) { closeCallback_ = std::move(cb); }
     void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
+    // 出问题时(比如慢回调)用来说明这个 Channel 是谁, 不设置就只报 fd
+    void setDescribeCallback(std::function<std::string()> cb) { describeCallback_ = std::move(cb); }
+    std::string describe() const;
 
     // 防止当channel被手动remove掉 channel还在执行回调操作
     void tie(const std::shared_ptr<void> &);
@@ -82,4 +86,5 @@ private:
     EventCallback writeCallback_;
     EventCallback closeCallback_;
     EventCallback errorCallback_;
+    std::function<std::string()> describeCallback_;
 };
\ No newline at end of file
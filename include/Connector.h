@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+class Channel;
+class EventLoop;
+
+/**
+ * 主动发起连接, 相当于客户端的 Acceptor: 非阻塞 connect, 等 fd 可写后看 SO_ERROR, 成功就把 sockfd 交给 TcpClient.
+ * 失败按指数退避重试(0.5s, 1s, 2s ... 封顶 30s), 每次在 [delay/2, delay] 里随机取, 一批客户端同时断线也不会同时重连.
+ * 自连接(本机连本机端口, 内核恰好把源端口分配成目的端口)当失败处理.
+ *
+ * 必须由 shared_ptr 管理: 重试定时器和 Channel 的回调都持有 weak_ptr/tie, 先析构也不会悬空.
+ **/
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(NewConnectionCallback cb) { newConnectionCallback_ = std::move(cb); }
+    // 必须在 start() 之前调用, 单位秒
+    void setRetryDelay(double initialSeconds, double maxSeconds)
+    {
+        initRetryDelay_ = retryDelay_ = initialSeconds;
+        maxRetryDelay_ = maxSeconds;
+    }
+
+    void start();   // 线程安全
+    void restart(); // 只能在loop线程中调用, 退避从头算
+    void stop();    // 线程安全, 取消正在进行的连接和重试
+    // 只能在loop线程中调用: 交出去的连接断开了又不重连时调用, 回到 kDisconnected, 之后 start() 才会再连
+    void resetState() { state_ = kDisconnected; }
+
+    const InetAddress &serverAddress() const { return serverAddr_; }
+
+private:
+    enum StateE
+    {
+        kDisconnected,
+        kConnecting,
+        kConnected
+    };
+
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void retry(int sockfd);
+    int removeAndResetChannel();
+
+    EventLoop *loop_;
+    const InetAddress serverAddr_;
+    std::atomic_bool connect_;
+    StateE state_; // 只在loop线程里读写
+    std::unique_ptr<Channel> channel_;
+    NewConnectionCallback newConnectionCallback_;
+    double initRetryDelay_ = 0.5;
+    double maxRetryDelay_ = 30.0;
+    double retryDelay_ = 0.5;
+    TimerId retryTimer_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
@@ -0,0 +1,311 @@
+#pragma once
+
+/**
+ * 可选的协程层: 用顺序代码写协议状态机, 不用在 onMessage 里反复解析半包.
+ *
+ *   CoTask session(TcpConnectionPtr conn) // 必须按值持有 conn, 保证挂起期间连接对象不析构
+ *   {
+ *       while (auto line = co_await conn->readUntil("\r\n"))
+ *       {
+ *           co_await conn->write(*line);
+ *           co_await conn->getLoop()->sleep(10);
+ *       }
+ *   }
+ *   // onConnection 里: if (conn->connected()) session(conn);
+ *
+ * 库本身仍然是 C++17, 只有包含本头文件的翻译单元需要 -std=c++20.
+ * 协程总是在连接所属的 loop 线程中恢复, 读/写由 TcpConnection::handleRead/handleWrite 直接 resume,
+ * sleep 由 TimerQueue 的到期回调直接 resume, 都不经过 pendingFunctors_.
+ **/
+
+#if !defined(__cpp_impl_coroutine)
+#error "Coroutine.h requires C++20 coroutines, compile this file with -std=c++20"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+#include "noncopyable.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+
+/**
+ * 协程帧的线程局部池: 按 64 字节分档的空闲链表, 每档最多缓存 kMaxCachedPerClass 个.
+ * 每个请求一个协程时, 稳态下分配/释放都不进 malloc. 超过 kMaxPooledSize 的帧直接走 ::operator new.
+ **/
+class CoFramePool : noncopyable
+{
+public:
+    static void *allocate(size_t size)
+    {
+        if (size > kMaxPooledSize)
+        {
+            return ::operator new(size);
+        }
+        const size_t cls = sizeClass(size);
+        Cache &c = cache();
+        if (FreeNode *node = c.heads[cls])
+        {
+            c.heads[cls] = node->next;
+            --c.counts[cls];
+            return node;
+        }
+        return ::operator new((cls + 1) * kGranularity);
+    }
+
+    static void deallocate(void *p, size_t size)
+    {
+        if (size > kMaxPooledSize)
+        {
+            ::operator delete(p);
+            return;
+        }
+        const size_t cls = sizeClass(size);
+        Cache &c = cache();
+        if (c.counts[cls] >= kMaxCachedPerClass)
+        {
+            ::operator delete(p);
+            return;
+        }
+        FreeNode *node = static_cast<FreeNode *>(p);
+        node->next = c.heads[cls];
+        c.heads[cls] = node;
+        ++c.counts[cls];
+    }
+
+private:
+    inline static constexpr size_t kGranularity = 64;
+    inline static constexpr size_t kMaxPooledSize = 4096;
+    inline static constexpr size_t kNumClasses = kMaxPooledSize / kGranularity;
+    inline static constexpr size_t kMaxCachedPerClass = 1024;
+
+    struct FreeNode
+    {
+        FreeNode *next;
+    };
+
+    struct Cache
+    {
+        FreeNode *heads[kNumClasses] = {};
+        size_t counts[kNumClasses] = {};
+
+        ~Cache()
+        {
+            for (FreeNode *head : heads)
+            {
+                while (head)
+                {
+                    FreeNode *next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+    };
+
+    static size_t sizeClass(size_t size) { return (size + kGranularity - 1) / kGranularity - 1; }
+
+    static Cache &cache()
+    {
+        thread_local Cache c;
+        return c;
+    }
+};
+
+/**
+ * 一次启动、自己跑完的协程(fire-and-forget). 不需要也不能被 co_await,
+ * 结束时帧自动销毁, 帧内存来自 CoFramePool.
+ **/
+class CoTask
+{
+public:
+    struct promise_type
+    {
+        CoTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); } // 库里不用异常
+
+        static void *operator new(size_t size) { return CoFramePool::allocate(size); }
+        static void operator delete(void *p, size_t size) { CoFramePool::deallocate(p, size); }
+    };
+};
+
+/**
+ * co_await conn->readExactly(n) / conn->readUntil(delim)
+ * 返回 std::optional<std::string>: 凑够数据返回内容(readUntil 不含分隔符, 分隔符一并消费掉),
+ * 连接断开(kDisconnected)且数据不够时返回 std::nullopt. 自己 shutdown() 之后(kDisconnecting)还能照常读.
+ **/
+class ReadAwaiter
+{
+public:
+    ReadAwaiter(TcpConnection *conn, size_t n)
+        : conn_(conn), exact_(n)
+    {
+    }
+    ReadAwaiter(TcpConnection *conn, std::string_view delimiter)
+        : conn_(conn), delimiter_(delimiter)
+    {
+    }
+
+    bool await_ready() { return match() || closed(); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        handle_ = handle;
+        conn_->readWaiter_ = {&ReadAwaiter::onReadable, this};
+    }
+
+    std::optional<std::string> await_resume()
+    {
+        if (!matched_ && !match())
+        {
+            return std::nullopt;
+        }
+        std::string result(conn_->inputBuffer_.peek(), length_);
+        conn_->inputBuffer_.retrieve(consumed_);
+        return result;
+    }
+
+private:
+    // handleRead/handleClose 调用: 条件满足或连接已断开才恢复协程, 否则继续等下一次可读
+    static void onReadable(void *arg)
+    {
+        ReadAwaiter *self = static_cast<ReadAwaiter *>(arg);
+        if (self->match() || self->closed())
+        {
+            self->handle_.resume();
+        }
+        else
+        {
+            self->conn_->readWaiter_ = {&ReadAwaiter::onReadable, self};
+        }
+    }
+
+    // 只有 kDisconnected 算 EOF: kDisconnecting 只是本端写方向半关闭, 对端的数据还会到
+    bool closed() const { return conn_->state_ == TcpConnection::kDisconnected; }
+
+    bool match()
+    {
+        const Buffer &buf = conn_->inputBuffer_;
+        const size_t readable = buf.readableBytes();
+        if (delimiter_.empty())
+        {
+            if (readable >= exact_)
+            {
+                length_ = consumed_ = exact_;
+                matched_ = true;
+            }
+            return matched_;
+        }
+
+        // 记住上次扫描到的位置, 半包反复到达时不从头扫
+        const char *begin = buf.peek();
+        const char *end = begin + readable;
+        const char *found = std::search(begin + scanned_, end, delimiter_.begin(), delimiter_.end());
+        if (found != end)
+        {
+            length_ = static_cast<size_t>(found - begin);
+            consumed_ = length_ + delimiter_.size();
+            matched_ = true;
+        }
+        else if (readable >= delimiter_.size())
+        {
+            scanned_ = readable - delimiter_.size() + 1;
+        }
+        return matched_;
+    }
+
+    TcpConnection *conn_;
+    size_t exact_ = 0;
+    std::string delimiter_; // 协程挂起期间一直要用, 自己存一份, 调用方传临时 string 也不会悬空
+    size_t scanned_ = 0;
+    size_t length_ = 0;
+    size_t consumed_ = 0;
+    bool matched_ = false;
+    std::coroutine_handle<> handle_;
+};
+
+/**
+ * co_await conn->write(data): 数据立即走 sendInLoop, outputBuffer_ 发空后才恢复.
+ * 返回 false 表示连接在发送完之前断开了.
+ **/
+class WriteAwaiter
+{
+public:
+    explicit WriteAwaiter(TcpConnection *conn) : conn_(conn) {}
+
+    bool await_ready() const { return drained() || conn_->state_ == TcpConnection::kDisconnected; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        handle_ = handle;
+        conn_->writeWaiter_ = {&WriteAwaiter::onWritable, this};
+    }
+
+    bool await_resume() const { return drained() && conn_->state_ != TcpConnection::kDisconnected; }
+
+private:
+    static void onWritable(void *arg)
+    {
+        static_cast<WriteAwaiter *>(arg)->handle_.resume();
+    }
+
+    bool drained() const { return conn_->outputBuffer_.readableBytes() == 0; }
+
+    TcpConnection *conn_;
+    std::coroutine_handle<> handle_;
+};
+
+// co_await loop->sleep(ms): 由定时器回调直接恢复, 恢复时一定在 loop 线程中
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(EventLoop *loop, int milliseconds)
+        : loop_(loop), milliseconds_(milliseconds)
+    {
+    }
+
+    bool await_ready() const noexcept { return milliseconds_ <= 0 && loop_->isInLoopThread(); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        loop_->runAfter(milliseconds_ / 1000.0, [handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    EventLoop *loop_;
+    int milliseconds_;
+};
+
+inline ReadAwaiter TcpConnection::readExactly(size_t n)
+{
+    return ReadAwaiter(this, n);
+}
+
+inline ReadAwaiter TcpConnection::readUntil(std::string_view delimiter)
+{
+    return ReadAwaiter(this, delimiter);
+}
+
+inline WriteAwaiter TcpConnection::write(std::string_view data)
+{
+    if (state_ == kConnected)
+    {
+        sendInLoop(data.data(), data.size());
+    }
+    return WriteAwaiter(this);
+}
+
+inline SleepAwaiter EventLoop::sleep(int milliseconds)
+{
+    return SleepAwaiter(this, milliseconds);
+}
@@ -9,9 +9,16 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "Metrics.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
+class SleepAwaiter;
+struct LoopStats;
+class PerfCounters;
 
 // 事件循环类 主要包含了两个大模块 Channel Poller(epoll的抽象)
 class EventLoop : noncopyable // 禁止派生类的拷贝操作.
@@ -37,6 +44,32 @@ public:
     // 通过eventfd唤醒loop所在的线程, mainReactor唤醒subReactor
     void wakeup();
 
+    // 定时器, 线程安全. 回调在loop线程中执行
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    TimerId runAfter(double delaySeconds, TimerCallback cb);
+    TimerId runEvery(double intervalSeconds, TimerCallback cb);
+    void cancel(TimerId timerId);
+
+    // co_await loop->sleep(ms), 定义在 Coroutine.h 中, 只有 C++20 下包含它才能用
+    SleepAwaiter sleep(int milliseconds);
+
+    // 循环各阶段的耗时直方图(见 LoopStats.h), 默认关闭, 任意线程可开关, 下一轮循环生效.
+    // 打开时单个 Channel 回调或 pendingFunctor 超过 slowCallbackThreshold 就 LOG_ERROR 报出 fd/连接名
+    void setStatsEnabled(bool on);
+    bool statsEnabled() const { return statsEnabled_.load(std::memory_order_relaxed); }
+    void setSlowCallbackThreshold(double seconds) { slowCallbackNs_.store(static_cast<int64_t>(seconds * 1e9), std::memory_order_relaxed); }
+    const LoopStats &stats() const { return *stats_; }
+
+    // 硬件计数器(见 PerfCounters.h), 按 读分发/写/pendingFunctors/onMessage 分类累计. 任意线程可开关,
+    // 计数器在 loop 线程里第一次打开时创建. perfReport 任意线程可调, 没打开过返回空串
+    void setPerfCountersEnabled(bool on);
+    std::string perfReport() const;
+
+    // 诊断用(Inspector), 任意线程可调: 还没执行的 pendingFunctors 个数(要加一次锁)、所属线程、累计循环次数
+    size_t queueSize() const;
+    pid_t threadId() const { return threadId_; }
+    int64_t iterations() const { return iterationsMetric_.value(); }
+
     // EventLoop的方法 => Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
@@ -47,7 +80,13 @@ public:
 
 private:
     void handleRead();        // wake up 给eventfd返回的文件描述符wakeupFd_绑定的事件回调 当wakeup()时 即有事件发生时 调用handleRead()读wakeupFd_的8字节 同时唤醒阻塞的epoll_wait
+    void pollOnce();          // poller_->poll 填 activeChannels_, 外面套一层追踪埋点
     void doPendingFunctors(); // 执行上层回调
+    void dispatchWithStats();        // 打开统计时代替 for (channel : activeChannels_) handleEvent
+    void doPendingFunctorsWithStats();
+    void registerMetrics();
+    void registerPerfMetrics(PerfCounters *perf);
+    void reportSlowCallback(const char *what, const std::string &who, int64_t ns);
 
     using ChannelList = std::vector<Channel *>;
 
@@ -58,6 +97,7 @@ private:
 
     Timestamp pollReturnTime_; // Poller返回发生事件的Channels的时间点
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_; // 必须在poller_之后构造, 之前析构
 
     int wakeupFd_; // 作用：当mainLoop获取一个新用户的Channel 需通过轮询算法选择一个subLoop 通过该成员唤醒subLoop处理Channel
     std::unique_ptr<Channel> wakeupChannel_;
@@ -69,5 +109,16 @@ private:
     // 屏障 (seq_cst store), 单连接 ping pong 测试中开销约 19%. 原版 muduo 用的是 plain bool.
     bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作, 普通bool就好了.
     std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有回调操作
-    std::mutex mutex_;                        // 互斥锁 用来保护上面vector容器的线程安全操作
+    mutable std::mutex mutex_;                // 互斥锁 用来保护上面vector容器的线程安全操作
+
+    // 指标标签 loop="tid"; LoopStats 的分位数以回调 gauge 导出, 析构时注销
+    Counter iterationsMetric_;
+    Counter functorsMetric_;
+    std::vector<uint64_t> metricCallbacks_;
+
+    std::atomic<bool> statsEnabled_{false};
+    std::atomic<int64_t> slowCallbackNs_{10 * 1000 * 1000}; // 默认 10ms
+    std::unique_ptr<LoopStats> stats_;
+    // 只在 loop 线程里创建一次, 之后不再换, 析构时释放. 别的线程(Inspector、指标抓取)只读累计值
+    std::atomic<PerfCounters *> perf_{nullptr};
 };
\ No newline at end of file
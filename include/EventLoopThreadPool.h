@@ -23,6 +23,8 @@ public:
 
     // 对于这种纯获取的函数, 加上[[nodiscard]]是约束caller必须接受返回值.
     [[nodiscard]] EventLoop *getNextLoop(); // 如果工作在多线程中，baseLoop_(mainLoop)会默认以轮询的方式分配Channel给subLoop
+    // 和getNextLoop共用同一个轮询游标, 返回getAllLoops()里的下标. TcpServer用它定位该loop的连接分片
+    [[nodiscard]] size_t getNextLoopIndex();
     [[nodiscard]] std::vector<EventLoop *> getAllLoops(); // 获取所有的EventLoop
 
     bool started() const { return started_; } // 是否已经启动
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+class Buffer;
+
+/**
+ * 分帧编解码, 省得每个用户都在 MessageCallback 里手写"peek 4 字节长度 -> 等够一帧 -> retrieve".
+ *
+ *   FrameCodec codec(FrameCodec::Type::kFixed32, [](const TcpConnectionPtr &conn, std::string_view frame, Timestamp) {
+ *       ...
+ *   });
+ *   server.setMessageCallback([&codec](const TcpConnectionPtr &conn, Buffer *buf, Timestamp t) { codec.onMessage(conn, buf, t); });
+ *   codec.send(conn, "hello");
+ *
+ * 解码直接在 inputBuffer_ 里切: frame 是指向 inputBuffer_ 的视图, 不拷贝, 只在 FrameCallback 期间有效, 要留着就自己拷走.
+ * 一次 onMessage 把缓冲区里所有完整的帧都回调完, 最后统一 retrieve 一次; 全部消费完时读写下标直接归位, 不用搬数据.
+ *
+ * 帧格式:
+ *   kFixed16/kFixed32: 网络字节序的定长长度头, 长度不含头本身
+ *   kVarint:           LEB128 无符号变长长度头(protobuf 那种), 最多 10 字节
+ *   kDelimiter:        以分隔符结尾(比如 "\r\n"), 回调的 frame 不含分隔符
+ * 长度超过 maxFrameSize(分隔符模式下等了 maxFrameSize 字节还没见到分隔符)、或者头不合法, 回调 ErrorCallback,
+ * 默认是打日志 + forceClose, 缓冲区里剩下的数据丢掉.
+ *
+ * codec 本身没有按连接的状态, 一个 codec 可以给一个 TcpServer 的所有连接、所有 loop 共用.
+ **/
+class FrameCodec : noncopyable
+{
+public:
+    enum class Type
+    {
+        kFixed16,
+        kFixed32,
+        kVarint,
+        kDelimiter,
+    };
+
+    enum class Error
+    {
+        kFrameTooLarge,
+        kBadHeader, // varint 超过 10 字节或者溢出
+    };
+
+    using FrameCallback = std::function<void(const TcpConnectionPtr &, std::string_view frame, Timestamp)>;
+    using ErrorCallback = std::function<void(const TcpConnectionPtr &, Error)>;
+
+    inline static constexpr size_t kDefaultMaxFrameSize = 64 * 1024 * 1024;
+    inline static constexpr size_t kMaxVarintBytes = 10;
+
+    // 长度头模式
+    FrameCodec(Type type, FrameCallback cb, size_t maxFrameSize = kDefaultMaxFrameSize);
+    // 分隔符模式
+    FrameCodec(std::string delimiter, FrameCallback cb, size_t maxFrameSize = kDefaultMaxFrameSize);
+
+    void setErrorCallback(ErrorCallback cb) { errorCallback_ = std::move(cb); }
+
+    // 设成连接的 MessageCallback(或者在 MessageCallback 里调用)
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) const;
+
+    /**
+     * 编码:
+     * encode 把一帧(头 + 负载 或 负载 + 分隔符)追加到 out 后面. 攒几帧再一次 conn->send(&out), 一个批次一次 write.
+     * frame 原地封装: buf 里已经是整个负载(一般是直接往 Buffer 里序列化出来的), 长度头用 prepend 补到前面,
+     *       用的是 Buffer::kCheapPrepend 预留的字节, 负载不用再挪. 预留不够(buf 之前 retrieve 过头)时退回拷贝.
+     * send 是 frame 的便捷版, 任意线程可调: 负载拷进一个临时 Buffer, 补上头, 整帧一次 send(Buffer*) 出去(跨线程时是 swap 走, 不再拷).
+     *
+     * 负载超过 maxFrameSize、或者长度头放不下(kFixed16 超过 65535, kFixed32 超过 4G)时不编码, 打日志返回 false,
+     * out/buf 原样不动, 什么也没发. 这一帧丢掉还是关连接由调用方决定.
+     **/
+    bool encode(Buffer *out, std::string_view payload) const;
+    bool frame(Buffer *buf) const;
+    bool send(const TcpConnectionPtr &conn, std::string_view payload) const;
+
+    Type type() const { return type_; }
+    size_t maxFrameSize() const { return maxFrameSize_; }
+    static const char *errorName(Error error);
+
+private:
+    enum class ParseResult
+    {
+        kComplete,
+        kIncomplete,
+        kError,
+    };
+    // 从 data 开头解一帧. kComplete 时 *payloadOffset/*payloadLen 是负载的位置和长度, *frameLen 是整帧(含头/分隔符)的长度
+    ParseResult parse(const char *data, size_t len, size_t *payloadOffset, size_t *payloadLen, size_t *frameLen, Error *error) const;
+    // 长度头编码到 header 里, 返回字节数; 负载太长编不了返回 0
+    size_t encodeHeader(size_t payloadLen, char *header) const;
+
+    const Type type_;
+    const std::string delimiter_;
+    const size_t maxFrameSize_;
+    FrameCallback frameCallback_;
+    ErrorCallback errorCallback_;
+};
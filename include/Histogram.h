@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * HDR 风格的对数-线性直方图: 每个 2 的幂区间再线性切成 kSubBuckets 份, 相对误差 <= 1/kSubBuckets,
+ * 一个直方图覆盖 [0, 2^64) 全部取值, 不用事先知道量程. 记录就是一次 clz + 一次计数.
+ *
+ * 单写多读: 只有属主线程(loop 线程)调用 record, 用 relaxed load + store 代替 fetch_add, 不锁总线;
+ * 其他线程随时 snapshot() 拿一份快照, 快照可以 merge, 用来汇总多个 loop.
+ **/
+class Histogram
+{
+public:
+    inline static constexpr int kSubBucketBits = 4;
+    inline static constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+    inline static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < kSubBuckets)
+        {
+            return static_cast<size_t>(value);
+        }
+        const int exponent = 63 - __builtin_clzll(value);
+        const uint64_t sub = (value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return static_cast<size_t>((exponent - kSubBucketBits + 1) * kSubBuckets + sub);
+    }
+
+    // 桶的下界, 报告分位数时用
+    static uint64_t bucketLowerBound(size_t index)
+    {
+        if (index < kSubBuckets)
+        {
+            return index;
+        }
+        const int exponent = static_cast<int>(index / kSubBuckets) + kSubBucketBits - 1;
+        const uint64_t sub = index % kSubBuckets;
+        return (kSubBuckets + sub) << (exponent - kSubBucketBits);
+    }
+
+    struct Snapshot
+    {
+        std::array<uint64_t, kNumBuckets> counts{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // 不经过 Histogram 直接往快照里记, 非原子. 一个线程攒一批样本再整体发布的时候用(比如 TcpInfo 采样器)
+        void record(uint64_t value)
+        {
+            ++counts[bucketIndex(value)];
+            ++count;
+            sum += value;
+            if (value > max)
+            {
+                max = value;
+            }
+        }
+        void merge(const Snapshot &other);
+        // q 取 [0, 1], 返回所在桶的下界
+        uint64_t percentile(double q) const;
+        double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+        // "count=.. mean=.. p50=.. p90=.. p99=.. p999=.. max=.."
+        std::string toString() const;
+    };
+
+    void record(uint64_t value)
+    {
+        bump(counts_[bucketIndex(value)], 1);
+        bump(count_, 1);
+        bump(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot snapshot() const;
+    // 只能由属主线程调用
+    void reset();
+
+private:
+    static void bump(std::atomic<uint64_t> &counter, uint64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, kNumBuckets> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "HttpRequest.h"
+
+class Buffer;
+
+/**
+ * 每个连接一个的 HTTP/1.1 请求解析器, 挂在 TcpConnection 的 context 上.
+ *
+ * 直接在 inputBuffer_ 里解析, 不 retrieve 也不拷贝: 头收全之前只记录扫到了哪儿(下次从那儿接着找 "\r\n\r\n"),
+ * 头收全后一次性切出请求行和所有头. 请求体没跟着一起到的话, 等收全时再重新切一次头 --
+ * 中间 Buffer 可能扩容搬家, 之前的 string_view 不能留, 重新切一遍比维护偏移量简单, 而且这种情况很少.
+ * 找 "\r\n\r\n"、切行、切 name:value 都走 HttpScanner(按 CPU 选 AVX2/SSE4.2/标量), 切的同时校验
+ * 方法名和 header name 是 token、值里没有控制字符.
+ *
+ * 请求体: Content-Length, 或者 Transfer-Encoding: chunked(边收边解, 负载攒到 chunkedBody_, 容量在连接内复用);
+ * 两个都有按 RFC 9112 视为走私攻击, 直接 400.
+ *
+ *   kComplete   request() 可用, 处理完后调用方 retrieve(requestLength()) 再 reset(), 同一个 Buffer 里接着解下一个(流水线)
+ *   kIncomplete 数据还不够
+ *   kError      errorStatus() 是应该回的状态码(400/413/431/501/505), 回完关连接
+ **/
+class HttpContext
+{
+public:
+    enum class Result
+    {
+        kComplete,
+        kIncomplete,
+        kError,
+    };
+
+    inline static constexpr size_t kMaxHeaders = 100;
+
+    HttpContext(size_t maxHeaderBytes, size_t maxBodyBytes)
+        : maxHeaderBytes_(maxHeaderBytes), maxBodyBytes_(maxBodyBytes) {}
+
+    Result parse(const Buffer *buf, Timestamp receiveTime);
+    const HttpRequest &request() const { return request_; }
+    size_t requestLength() const { return requestLength_; }
+    int errorStatus() const { return errorStatus_; }
+
+    // 头里带 Expect: 100-continue、请求体还没到: 第一次调用返回 true, 调用方回一个 "100 Continue"
+    bool takeExpectContinue();
+
+    // 分块/流式响应还没写完时, 后面流水线上的请求先留在缓冲区里不解析
+    bool streaming() const { return streaming_; }
+    void setStreaming(bool on) { streaming_ = on; }
+
+    void reset();
+
+private:
+    enum class State
+    {
+        kHeaders,
+        kBody,
+        kChunkSize,
+        kChunkData,
+        kTrailers,
+    };
+
+    // 切请求行和头, 填到 request_ 里. 出错时设置 errorStatus_ 返回 false
+    bool parseHeaderBlock(const char *data, size_t len);
+    // 头切完之后决定请求体怎么收
+    bool prepareBody();
+    Result fail(int status)
+    {
+        errorStatus_ = status;
+        return Result::kError;
+    }
+
+    const size_t maxHeaderBytes_;
+    const size_t maxBodyBytes_;
+    HttpRequest request_;
+    State state_ = State::kHeaders;
+    size_t scanned_ = 0;    // 已经找过 "\r\n\r\n" 的字节数
+    size_t headerLen_ = 0;  // 含结尾的空行
+    size_t bodyLen_ = 0;    // Content-Length
+    size_t pos_ = 0;        // chunked: 下一个要解析的位置(相对 peek())
+    size_t chunkRemaining_ = 0;
+    std::string chunkedBody_;
+    size_t requestLength_ = 0;
+    int errorStatus_ = 0;
+    bool expectContinue_ = false;
+    bool streaming_ = false;
+};
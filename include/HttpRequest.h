@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "Timestamp.h"
+
+/**
+ * 解析好的 HTTP 请求. 所有 string_view 都直接指向连接的 inputBuffer_(chunked 请求体指向解析器自己攒的那块),
+ * 解析时不为任何一个头分配 std::string; 代价是只在 HttpCallback 期间有效, 要留到以后用就自己拷走.
+ **/
+class HttpRequest
+{
+public:
+    enum class Method
+    {
+        kInvalid,
+        kGet,
+        kHead,
+        kPost,
+        kPut,
+        kDelete,
+        kOptions,
+        kPatch,
+    };
+
+    enum class Version
+    {
+        kUnknown,
+        kHttp10,
+        kHttp11,
+    };
+
+    struct Header
+    {
+        std::string_view name;
+        std::string_view value; // 去掉了首尾空白
+    };
+
+    Method method() const { return method_; }
+    std::string_view methodString() const { return methodString_; }
+    Version version() const { return version_; }
+    std::string_view path() const { return path_; }   // 不含 ?query, 没做百分号解码
+    std::string_view query() const { return query_; } // 不含 '?'
+    // 名字大小写不敏感, 没有这个头返回空. 同名头出现多次时返回第一个
+    std::string_view header(std::string_view name) const;
+    // 逗号分隔的头(Connection、Upgrade 这种)里有没有 token, 大小写不敏感
+    bool headerHasToken(std::string_view name, std::string_view token) const;
+    const std::vector<Header> &headers() const { return headers_; }
+    std::string_view body() const { return body_; }
+    // HTTP/1.1 默认长连接, 除非 Connection: close; HTTP/1.0 要显式 Connection: keep-alive
+    bool keepAlive() const { return keepAlive_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+private:
+    friend class HttpContext;
+
+    Method method_ = Method::kInvalid;
+    Version version_ = Version::kUnknown;
+    std::string_view methodString_;
+    std::string_view path_;
+    std::string_view query_;
+    std::vector<Header> headers_; // 连接内复用, 容量留着, 后面的请求不再分配
+    std::string_view body_;
+    bool keepAlive_ = false;
+    Timestamp receiveTime_;
+};
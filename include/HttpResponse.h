@@ -0,0 +1,99 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "Callbacks.h"
+
+class Buffer;
+
+/**
+ * 分块(流式)响应的后续写入, HttpResponse::startStream() 拿到. 可以拷贝、保存, 任意线程调用.
+ * 写入都投递到连接的 loop 里按调用顺序执行, 所以在 HttpCallback 里面就可以开始写, 会排在响应头后面.
+ * 连接已经断了时 write 返回 false, 数据丢掉.
+ **/
+class HttpStream
+{
+public:
+    using FinishCallback = std::function<void(const TcpConnectionPtr &, bool close)>;
+
+    HttpStream() = default;
+
+    bool write(std::string_view data);
+    // 发最后一个空块(HTTP/1.0 客户端不支持 chunked, 就直接关连接表示结束), 之后这条连接才接着处理流水线上的下一个请求
+    void finish();
+
+private:
+    friend class HttpResponse;
+
+    std::weak_ptr<TcpConnection> conn_;
+    FinishCallback onFinish_;
+    bool chunked_ = true;
+    bool close_ = false;
+};
+
+/**
+ * HttpCallback 填的响应. 状态行和头由 HttpServer 写进一个 Buffer; 体小的话拷在头后面一次 send,
+ * 大的话头和体一次 writev(TcpConnection::sendv), 不为了拼在一起去拷大块的体.
+ **/
+class HttpResponse
+{
+public:
+    explicit HttpResponse(bool close) : closeConnection_(close) {}
+
+    void setStatusCode(int code) { statusCode_ = code; }
+    int statusCode() const { return statusCode_; }
+    // 不设就按状态码取标准短语
+    void setStatusMessage(std::string message) { statusMessage_ = std::move(message); }
+    void setContentType(std::string_view contentType) { addHeader("Content-Type", contentType); }
+    // 不要自己加 Content-Length/Transfer-Encoding/Connection/Date, 由 HttpServer 根据情况加
+    void addHeader(std::string_view name, std::string_view value);
+
+    void setBody(std::string body)
+    {
+        ownedBody_ = std::move(body);
+        body_ = ownedBody_;
+    }
+    // 不拷贝: data 必须活到 HttpCallback 返回(响应在回调返回后立刻发送, 没发完的部分会拷进 outputBuffer_). 静态内容用这个
+    void setBodyView(std::string_view body) { body_ = body; }
+    std::string_view body() const { return body_; }
+
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    // 改成分块响应: 头里带 Transfer-Encoding: chunked, body() 非空的话作为第一块, 后面用返回的 HttpStream 接着写
+    HttpStream startStream();
+    bool streaming() const { return streaming_; }
+
+    // 状态行 + 头(以空行结束)追加到 out
+    void appendHeadTo(Buffer *out) const;
+
+    static const char *statusMessage(int code);
+    // "Date: Sun, 19 Oct 2026 11:00:00 GMT\r\n". 每个线程按秒缓存, 同一秒内直接返回缓存;
+    // 返回的内存是线程局部的, 本线程里一直有效(内容每秒变一次)
+    static std::string_view dateHeader();
+
+private:
+    friend class HttpServer;
+    friend class HttpResponseCache; // 序列化状态行、头和体
+    // HttpServer 在调用 HttpCallback 之前设置, startStream 用. 响应只活在回调期间, 存指针就够了
+    void bindConnection(const TcpConnectionPtr *conn, bool chunkedAllowed, const HttpStream::FinishCallback *onFinish)
+    {
+        conn_ = conn;
+        chunkedAllowed_ = chunkedAllowed;
+        onStreamFinish_ = onFinish;
+    }
+
+    int statusCode_ = 200;
+    std::string statusMessage_;
+    std::string headers_; // 直接是 "Name: value\r\n..." 拼好的, 一个响应一次分配
+    std::string ownedBody_;
+    std::string_view body_;
+    bool closeConnection_;
+    bool streaming_ = false;
+    bool chunkedAllowed_ = true;
+    const TcpConnectionPtr *conn_ = nullptr;
+    const HttpStream::FinishCallback *onStreamFinish_ = nullptr;
+};
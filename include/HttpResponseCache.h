@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "noncopyable.h"
+#include "HttpRequest.h"
+#include "Metrics.h"
+
+class HttpResponse;
+
+/**
+ * 热点静态响应(健康检查、robots.txt、小的固定 JSON)的缓存: 存的是序列化好的字节, 命中时不调 HttpCallback,
+ * 不构造 HttpResponse, 不格式化任何东西, HttpServer 直接把几块内存一次 writev 出去:
+ *
+ *   [状态行 + 头 + Content-Length] [Connection: keep-alive/close] [Date(每个 loop 每秒格式化一次)] [\r\n + 体]
+ *
+ * Connection 和 Date 两行不在缓存的字节里, 所以同一条缓存对长连接/短连接、任何时刻都能用.
+ * 条目不可变, shared_ptr 共享, 发送时引用计数保证它活到 writev 之后, put/erase 替换掉也没关系.
+ *
+ * 键是 方法 + path(+ 构造时指定的几个请求头的值, 比如 Accept-Encoding), 不含 query.
+ * HEAD 请求查 GET 的条目, 只发头.
+ *
+ *   auto cache = std::make_shared<HttpResponseCache>("static");
+ *   HttpResponse ok(false);
+ *   ok.setContentType("text/plain");
+ *   ok.setBody("ok\n");
+ *   cache->put(HttpRequest::Method::kGet, "/healthz", ok);
+ *   server.setResponseCache(cache);
+ *
+ * 并发: put/erase/clear 任意线程调用, 加锁换一份新的表(写时复制, 只适合不常变的内容);
+ * lookup 在 loop 线程里调, 不加锁: 每个线程为每个缓存持有一份表的快照(几个槽, 按缓存认), 版本号变了才去锁里拿新的.
+ **/
+class HttpResponseCache : noncopyable
+{
+public:
+    class Entry
+    {
+    public:
+        // 状态行 + 头 + Content-Length, 不含 Connection、Date 和结尾的空行
+        std::string_view head() const { return std::string_view(wire_).substr(0, headLen_); }
+        // "\r\n" + 体
+        std::string_view tail() const { return std::string_view(wire_).substr(headLen_); }
+        std::string_view body() const { return tail().substr(2); }
+
+    private:
+        friend class HttpResponseCache;
+        std::string wire_;
+        size_t headLen_ = 0;
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    // varyHeaders: 参与键的请求头名字(大小写不敏感), 请求里没有这个头按空值算
+    explicit HttpResponseCache(std::string name, std::vector<std::string> varyHeaders = {});
+    ~HttpResponseCache();
+
+    // 按 response 当前的状态码、头和体序列化一份存起来, 同键覆盖. 只缓存 GET, 流式响应也不能缓存, 这两种返回 false.
+    // varyValues 和构造时的 varyHeaders 一一对应
+    bool put(HttpRequest::Method method, std::string_view path, const HttpResponse &response,
+             std::initializer_list<std::string_view> varyValues = {});
+    void erase(HttpRequest::Method method, std::string_view path, std::initializer_list<std::string_view> varyValues = {});
+    void clear();
+
+    // 没命中返回空. 只能在 loop 线程(或者说固定的几个线程)里调, 见上面的并发说明
+    EntryPtr lookup(const HttpRequest &request) const;
+
+    size_t size() const;
+    const std::string &name() const { return name_; }
+
+private:
+    using Map = std::unordered_map<std::string, EntryPtr>;
+
+    std::string makeKey(HttpRequest::Method method, std::string_view path, std::initializer_list<std::string_view> varyValues) const;
+    // 写时复制: 在锁里拷一份表, 改完换上去, 版本号 +1
+    template <typename F>
+    void update(F &&mutate);
+
+    const std::string name_;
+    const std::vector<std::string> varyHeaders_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const Map> map_; // guarded by mutex_
+    std::atomic<uint64_t> version_;
+    Counter hits_;
+    Counter misses_;
+
+    // 所有缓存共用一个版本号序列, 线程快照靠 (this, version) 认人, 旧对象的地址被新对象复用也不会认错
+    inline static std::atomic<uint64_t> nextVersion_{1};
+    // 每析构一个缓存 +1, 线程看到变了就清空自己的快照槽, 放掉析构了的缓存的表
+    inline static std::atomic<uint64_t> destroyedEpoch_{0};
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * HttpContext 解析请求头用的字节扫描, 都是"从 p 往后找第一个满足条件的字节", 没找到返回 end.
+ * 请求头解析的 CPU 基本全花在这几个循环上: 找 \r\n\r\n、切请求行、切 name:value, 顺便校验字符合法.
+ *
+ * 三档实现, 进程启动时按 CPU 选一次(函数指针, 之后每次调用就是一次间接跳转):
+ *   - kAvx2:  一次看 32 字节, 找 \r\n\r\n、找控制字符(行尾/非法字节);
+ *   - kSse42: 一次看 16 字节, header name 的 token 校验用 pcmpestri 的区间比较, 其余同上用 SSE2;
+ *   - kScalar: 逐字节查表, 也是另外两档的参照实现和收尾(不足一个向量宽度的尾巴).
+ * 默认选 kSse42, 不是最宽的 kAvx2: 一行头一般就几十字节, 32 字节一步省不下几次循环, 收尾反而更长.
+ * http_parse_bench 实测 AVX2 只在 ~750 字节的浏览器请求上快 ~3%, curl(84 字节)、API 客户端(281 字节)
+ * 这种短请求慢 5% 左右(curl 6.53M vs 6.87M req/s). 请求普遍很大的场景自己 setLevel(kAvx2).
+ * 只读 [p, end) 之内的字节, 不会越界多读, 所以直接在 Buffer::peek() 上用就行.
+ **/
+class HttpScanner
+{
+public:
+    enum class Level
+    {
+        kScalar,
+        kSse42,
+        kAvx2,
+    };
+
+    // [p, end) 里第一个 "\r\n\r\n" 的起点, 没有返回 nullptr
+    static const char *findHeaderEnd(const char *p, const char *end) { return impl_->findHeaderEnd(p, end); }
+    // 第一个不是 tchar(RFC 9110 token 字符)的字节: 方法名和 header name 用, 正常应该停在 ' ' 或 ':'
+    static const char *skipToken(const char *p, const char *end) { return impl_->skipToken(p, end); }
+    // 第一个 <= 0x20 或 DEL 的字节: request-target 用, 正常应该停在 ' '
+    static const char *skipTarget(const char *p, const char *end) { return impl_->skipTarget(p, end); }
+    // 第一个除 HTAB 以外的控制字符(含 DEL): header value 和版本号用, 正常应该停在 '\r'. obs-text(>= 0x80)放过
+    static const char *skipFieldValue(const char *p, const char *end) { return impl_->skipFieldValue(p, end); }
+
+    static Level level() { return level_; }
+    // CPU 支持的最高一档
+    static Level detect();
+    // 启动时选的一档: CPU 支持的话是 kSse42, 见上面
+    static Level preferred();
+    // 强制换一档(压测/对拍, 或者大请求为主时换 kAvx2), 超过 detect() 的按 detect() 算. 不是线程安全的, 在起 loop 之前调
+    static void setLevel(Level level);
+    static const char *levelName(Level level);
+
+private:
+    struct Impl
+    {
+        const char *(*findHeaderEnd)(const char *, const char *);
+        const char *(*skipToken)(const char *, const char *);
+        const char *(*skipTarget)(const char *, const char *);
+        const char *(*skipFieldValue)(const char *, const char *);
+    };
+    static const Impl kScalarImpl;
+    static const Impl *implFor(Level level);
+
+    // 先是标量版(常量初始化, 静态初始化期间也能用), HttpScanner.cc 里的静态对象再按 CPU 换掉
+    static const Impl *impl_;
+    static Level level_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpResponseCache.h"
+
+/**
+ * HTTP/1.1 服务端, TcpServer 上面薄薄一层, 对应原版 muduo 的 net/http, 但是:
+ *   - 请求在 inputBuffer_ 里原地解析(HttpContext), 头和体都是 string_view, 不为每个头分配 std::string;
+ *   - 长连接 + 流水线: 一次读到的多个请求依次处理, 响应按顺序攒进同一个 Buffer, 这一批只 send 一次;
+ *   - 请求体支持 Content-Length 和 chunked, 响应支持 chunked 流式输出(HttpResponse::startStream);
+ *   - 响应体大(> kGatherThreshold)时头和体 writev 一起发, 不拷贝体;
+ *   - 可选的 HttpResponseCache: 命中的 GET/HEAD 不调 HttpCallback, 直接 writev 缓存里序列化好的字节.
+ *   - 可选的 UpgradeCallback: 带 Upgrade 头的请求可以把连接整个接管走(WebSocketServer 就是这么挂上来的).
+ *
+ *   HttpServer server(&loop, InetAddress(8080), "http");
+ *   server.setHttpCallback([](const HttpRequest &req, HttpResponse *resp) {
+ *       resp->setContentType("text/plain");
+ *       resp->setBodyView("hello\n");
+ *   });
+ *   server.setThreadNum(4);
+ *   server.start();
+ *
+ * HttpCallback 在连接所属的 io loop 里同步执行, 返回时响应必须填好(流式响应除外), 不要在里面阻塞.
+ * 解析出错时回 400/413/431/501/505 并关闭连接, 不会调用 HttpCallback.
+ **/
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+    // 带 Upgrade 头的请求先给它(在 loop 线程里, HttpCallback 之前). 返回非空表示接管了这条连接: 101 响应由它自己发,
+    // 之后连接上的数据(包括同一次读到的、跟在升级请求后面的字节)都交给返回的回调, 不再按 HTTP 解析.
+    // 返回空就当普通请求, 照常交给缓存和 HttpCallback
+    using UpgradeCallback = std::function<MessageCallback(const TcpConnectionPtr &, const HttpRequest &)>;
+
+    inline static constexpr size_t kGatherThreshold = 4096;
+
+    HttpServer(EventLoop *loop,
+               const InetAddress &listenAddr,
+               const std::string &name,
+               TcpServer::Option option = TcpServer::Option::kNoReusePort);
+
+    EventLoop *getLoop() const { return loop_; }
+    // 高低水位、TCP_INFO 采样这些连接级的设置直接在 TcpServer 上调
+    TcpServer &tcpServer() { return server_; }
+
+    // 以下在 start() 之前调用
+    void setHttpCallback(HttpCallback cb) { httpCallback_ = std::move(cb); }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setMaxHeaderBytes(size_t bytes) { maxHeaderBytes_ = bytes; }
+    void setMaxBodyBytes(size_t bytes) { maxBodyBytes_ = bytes; }
+    // 先查缓存再调 HttpCallback. 缓存可以几个 HttpServer 共用, 内容随时可以改(见 HttpResponseCache)
+    void setResponseCache(std::shared_ptr<HttpResponseCache> cache) { responseCache_ = std::move(cache); }
+    void setUpgradeCallback(UpgradeCallback cb) { upgradeCallback_ = std::move(cb); }
+    // 连接建立/断开时, 在 HttpServer 自己的处理之后调用
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+
+    void start() { server_.start(); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    // 流式响应写完了: 要么关连接, 要么接着处理缓冲区里流水线上的请求
+    void onStreamFinished(const TcpConnectionPtr &conn, bool close);
+    static void sendError(const TcpConnectionPtr &conn, Buffer *out, int status);
+
+    EventLoop *loop_;
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    HttpStream::FinishCallback streamFinishCallback_;
+    std::shared_ptr<HttpResponseCache> responseCache_;
+    UpgradeCallback upgradeCallback_;
+    ConnectionCallback connectionCallback_;
+    size_t maxHeaderBytes_ = 64 * 1024;
+    size_t maxBodyBytes_ = 8 * 1024 * 1024;
+};
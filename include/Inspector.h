@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "AdminServer.h"
+
+class EventLoop;
+class TcpServer;
+
+/**
+ * 运行时诊断, 原版 muduo 的 net/inspect(Inspector/ProcessInspector/PerformanceInspector)搬到 AdminServer 上:
+ *
+ *   /inspect/connections[?server=name&limit=N]  每个连接的 loop、状态、存活时间、缓冲区大小
+ *   /inspect/tcpinfo[?server=name&limit=N]      TcpServer 最近一轮 TCP_INFO 采样的分布 + 每个连接现在的 TCP_INFO
+ *   /inspect/loops                              每个 loop 的 pendingFunctors 队列长度、循环次数、LoopStats、硬件计数器
+ *   /inspect/proc                               /proc/self/status、打开的 fd 数、线程
+ *   /pprof/profile[?seconds=N]                  CPU 采样窗口: 每个线程这 N 秒的 CPU 占用;
+ *                                               进程链接了 gperftools(-lprofiler)时同时 ProfilerStart/Stop, 返回 .prof 路径
+ *   /pprof/heap[?seconds=N]                     堆窗口: 前后两次 mallinfo2 的差值; 链接了 tcmalloc 时同时写 heap profile
+ *
+ * 两个 pprof 接口都是异步响应的: 在 admin loop 上 runAfter N 秒再回复, 不阻塞任何 loop, 同一时间只允许一个窗口.
+ * gperftools 的符号用 dlsym 找, 库本身不依赖它.
+ *
+ *   AdminServer admin(InetAddress(9100));
+ *   Inspector inspector(&admin); // 在 admin.start() 之前
+ *   inspector.addServer(&server); // server 析构前 removeServer
+ *   admin.start();
+ **/
+class Inspector : noncopyable
+{
+public:
+    explicit Inspector(AdminServer *admin);
+    ~Inspector();
+
+    // 线程安全. server 的 loops() 自动出现在 /inspect/loops 里
+    void addServer(TcpServer *server);
+    void removeServer(TcpServer *server);
+    // 不属于任何 TcpServer 的 loop(比如 baseLoop)
+    void addLoop(EventLoop *loop);
+    void removeLoop(EventLoop *loop);
+
+    inline static constexpr int kMaxProfileSeconds = 300;
+
+private:
+    // handler 和 profiling 定时器都只捕获 State 的 shared_ptr, Inspector 先析构也不会悬空
+    struct State
+    {
+        std::mutex mutex;
+        std::vector<TcpServer *> servers;
+        std::vector<EventLoop *> loops;
+        bool profiling = false; // 只在 admin loop 里读写
+    };
+
+    static std::string connections(State &state, const std::string &query);
+    static std::string tcpInfo(State &state, const std::string &query);
+    static std::string loops(State &state);
+    static std::string process();
+    static void cpuProfile(const std::shared_ptr<State> &state, EventLoop *loop, int seconds, const AdminServer::Responder &respond);
+    static void heapProfile(const std::shared_ptr<State> &state, EventLoop *loop, int seconds, const AdminServer::Responder &respond);
+
+    std::shared_ptr<State> state_;
+};
@@ -1,52 +1,63 @@
 #pragma once
 
 #include <cstdio> // 用到了snprintf
+#include <cstdlib>
+#include <functional>
+#include <type_traits>
 
 #include "noncopyable.h"
 
+/**
+ * 编译期日志级别门限: 低于它的 LOG_xxx 整条语句编译成空(参数也不求值), 默认去掉 DEBUG.
+ * -DMUDEBUG 打开 DEBUG; 也可以直接 -DMUDUO_LOG_MIN_LEVEL=2 只留 ERROR/FATAL.
+ * 数值和 LogLevel 一一对应: DEBUG=0 INFO=1 ERROR=2 FATAL=3
+ **/
+#ifndef MUDUO_LOG_MIN_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_LOG_MIN_LEVEL 0
+#else
+#define MUDUO_LOG_MIN_LEVEL 1
+#endif
+#endif
+
 // LOG_INFO("%s %d", arg1, arg2)
+// 1. 先比较运行期级别, 关掉的日志只花一次比较, 不再先 snprintf 到栈上 1KB 的 buf 里
+// 2. if (false) Logger::checkFormat(...) 不生成代码, 只是让编译器按 printf 规则检查格式串和参数(-Wformat)
+// 3. 直接格式化到 Logger 的线程局部行缓冲, 前缀(级别+时间)和正文在同一块内存, 不再多拷一次
 // ##__VA_ARGS__ 是 GCC 扩展，处理可变参数为空时消除多余逗号
 // do while(0) 使宏在语法上等价于一条语句，支持 LOG_INFO("x"); 这样的写法
-// TODO: 可用 C++17 变参模板 + fold expression 替代宏, 实现类型安全的日志:
-//   template<typename... Args> void log_info(std::string_view fmt, Args&&... args);
-//   或引入 fmtlib/std::format(C++20) 彻底告别 snprintf.
-#define LOG_INFO(logmsgFormat, ...)                                         \
+#define MUDUO_LOG_IMPL(level, logmsgFormat, ...)                            \
     do                                                                      \
     {                                                                       \
-        char buf[1024];                                                     \
-        snprintf(buf, sizeof(buf), logmsgFormat, ##__VA_ARGS__);            \
-        Logger::instance().log(LogLevel::INFO, buf);                        \
+        if constexpr (static_cast<int>(level) >= MUDUO_LOG_MIN_LEVEL)       \
+        {                                                                   \
+            if (false)                                                      \
+            {                                                               \
+                Logger::checkFormat(logmsgFormat, ##__VA_ARGS__);           \
+            }                                                               \
+            if (Logger::instance().enabled(level))                          \
+            {                                                               \
+                Logger::instance().logf(level, logmsgFormat, ##__VA_ARGS__); \
+            }                                                               \
+        }                                                                   \
     } while (0)
 
-#define LOG_ERROR(logmsgFormat, ...)                                        \
-    do                                                                      \
-    {                                                                       \
-        char buf[1024];                                                     \
-        snprintf(buf, sizeof(buf), logmsgFormat, ##__VA_ARGS__);            \
-        Logger::instance().log(LogLevel::ERROR, buf);                       \
-    } while (0)
+#define LOG_DEBUG(logmsgFormat, ...) MUDUO_LOG_IMPL(LogLevel::DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO(logmsgFormat, ...) MUDUO_LOG_IMPL(LogLevel::INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR(logmsgFormat, ...) MUDUO_LOG_IMPL(LogLevel::ERROR, logmsgFormat, ##__VA_ARGS__)
 
+// FATAL 不受任何门限影响, 一定输出, 一定退出
 #define LOG_FATAL(logmsgFormat, ...)                                        \
     do                                                                      \
     {                                                                       \
-        char buf[1024];                                                     \
-        snprintf(buf, sizeof(buf), logmsgFormat, ##__VA_ARGS__);            \
-        Logger::instance().log(LogLevel::FATAL, buf);                       \
+        if (false)                                                          \
+        {                                                                   \
+            Logger::checkFormat(logmsgFormat, ##__VA_ARGS__);               \
+        }                                                                   \
+        Logger::instance().logf(LogLevel::FATAL, logmsgFormat, ##__VA_ARGS__); \
         exit(-1);                                                           \
     } while (0)
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                                        \
-    do                                                                      \
-    {                                                                       \
-        char buf[1024];                                                     \
-        snprintf(buf, sizeof(buf), logmsgFormat, ##__VA_ARGS__);            \
-        Logger::instance().log(LogLevel::DEBUG, buf);                       \
-    } while (0)
-#else
-#define LOG_DEBUG(logmsgFormat, ...)
-#endif
-
 enum class LogLevel
 {
     DEBUG = 0,
@@ -58,10 +69,55 @@ enum class LogLevel
 class Logger : noncopyable
 {
 public:
+    // 一条完整的日志(含换行)交给 output, 默认写 stdout; 接 AsyncLogging 就换成它的 append
+    using OutputFunc = std::function<void(const char *msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
     static Logger &instance();
     void setLogLevel(LogLevel level) { logLevel_ = level; }
     LogLevel logLevel() const { return logLevel_; }
-    void log(LogLevel level, const char* msg);
+    bool enabled(LogLevel level) const { return level >= logLevel_; }
+    // 不是线程安全的, 要在其他线程开始打日志之前设置好(一般在 main 开头)
+    void setOutput(OutputFunc output) { output_ = std::move(output); }
+    void setFlush(FlushFunc flush) { flush_ = std::move(flush); }
+
+    // 调用方(宏)已经检查过级别
+    template <typename... Args>
+    void logf(LogLevel level, const char *format, Args... args)
+    {
+        // 只允许 printf 认识的类型, 传 std::string 之类进来直接编译失败, 而不是运行时读到垃圾
+        static_assert(((std::is_arithmetic_v<Args> || std::is_pointer_v<Args> || std::is_enum_v<Args> || std::is_null_pointer_v<Args>) && ...),
+                      "LOG_xxx arguments must be printf-compatible (use .c_str() for strings)");
+        size_t len = beginLine(level);
+        // 没有参数也按格式串处理(LOG_INFO("100%% done\n") 打出 100%), 和 printf 一样; 已经格式化好的字符串走 log()
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+        const int n = snprintf(t_line + len, kMaxLineSize - len, format, args...); // 格式已经在宏里用 checkFormat 检查过
+#pragma GCC diagnostic pop
+        finishLine(level, len, n);
+    }
+
+    // 只用于编译期检查, 不会被调用
+    static void checkFormat(const char *, ...) __attribute__((format(printf, 1, 2))) {}
+
+    // 兼容旧接口: 已经格式化好的消息
+    void log(LogLevel level, const char *msg);
+
 private:
+    inline static constexpr size_t kMaxLineSize = 4096;
+
+    // 写 "[INFO] 时间 : " 前缀, 返回长度
+    size_t beginLine(LogLevel level);
+    // 补换行、处理截断, 交给 output_; FATAL 顺便 flush
+    void finishLine(LogLevel level, size_t prefixLen, int bodyLen);
+
+    static void defaultOutput(const char *msg, size_t len);
+    static void defaultFlush();
+
+    inline static thread_local char t_line[kMaxLineSize];
+
     LogLevel logLevel_ = LogLevel::INFO;
+    OutputFunc output_ = defaultOutput;
+    FlushFunc flush_ = defaultFlush;
 };
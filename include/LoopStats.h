@@ -0,0 +1,25 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "Histogram.h"
+
+/**
+ * 每个 EventLoop 一份, 默认关闭(EventLoop::setStatsEnabled). 打开后每轮循环多几次 rdtsc,
+ * 时间单位都是纳秒. 只有 loop 线程写, 任何线程都可以读/快照.
+ **/
+struct LoopStats
+{
+    Histogram pollWaitNs;          // epoll_wait 阻塞的时间
+    Histogram dispatchNs;          // 单个 Channel::handleEvent 的耗时
+    Histogram pendingFunctorsNs;   // 一轮 doPendingFunctors 的总耗时
+    Histogram eventsPerIteration;  // 一轮 poll 返回的活跃 Channel 数
+    Histogram functorsPerIteration; // 一轮执行的 pendingFunctors 个数
+
+    std::atomic<uint64_t> slowCallbacks{0};
+
+    // 多行文本, 每行一个直方图
+    std::string report() const;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+/**
+ * 进程级的缓冲区内存预算: 统计所有 TcpConnection 的 inputBuffer_/outputBuffer_ 实际占用的容量.
+ * 每个线程(one loop per thread, 也就是每个 loop)一个计数器, 只有本线程写, 用 relaxed store 不用 RMW;
+ * 需要总量时(接受新连接、定时检查、导出指标)才把所有线程的计数器加起来.
+ *
+ * 超出预算时的策略(可组合):
+ *   kRejectAccept      Acceptor accept 后直接 close, 不再建立新连接
+ *   kPauseReading      Buffer 扩容时发现超预算的 TcpServer 连接立即 stopRead 自己(TcpClient 等的连接只记账不停); TcpServer 定时检查再停掉占用最大的,
+ *                      总量降到 limit * resumeRatio 以下再统一恢复
+ *   kCloseSlowConsumer TcpServer 定时检查, 关闭 outputBuffer_ 堆积最多的连接(对端读得最慢)
+ **/
+class MemoryBudget : noncopyable
+{
+public:
+    enum Policy
+    {
+        kNone = 0,
+        kRejectAccept = 1 << 0,
+        kPauseReading = 1 << 1,
+        kCloseSlowConsumer = 1 << 2,
+    };
+
+    static MemoryBudget &instance();
+
+    // limitBytes == 0 表示不限制(默认)
+    void setLimit(int64_t limitBytes) { limit_ = limitBytes; }
+    int64_t limit() const { return limit_; }
+    void setPolicy(int policy) { policy_ = policy; }
+    int policy() const { return policy_; }
+    // 暂停读之后, 总量降到 limit * resumeRatio 以下才恢复, 避免抖动
+    void setResumeRatio(double ratio) { resumeRatio_ = ratio; }
+    double resumeRatio() const { return resumeRatio_; }
+
+    bool enabled() const { return limit_ > 0; }
+    bool overBudget() const { return enabled() && usedBytes() > limit_; }
+    bool belowResumeMark() const { return usedBytes() < static_cast<int64_t>(limit_ * resumeRatio_); }
+
+    // 只加到当前线程的计数器, 不加锁不做原子RMW
+    void add(int64_t deltaBytes)
+    {
+        Counter &c = localCounter();
+        if (&c != &overflow_)
+        {
+            c.bytes.store(c.bytes.load(std::memory_order_relaxed) + deltaBytes, std::memory_order_relaxed);
+        }
+        else
+        {
+            c.bytes.fetch_add(deltaBytes, std::memory_order_relaxed);
+        }
+    }
+
+    // 汇总所有线程, O(线程数)
+    int64_t usedBytes() const;
+
+    // 指标
+    void onRejectedAccept() { rejectedAccepts_.fetch_add(1, std::memory_order_relaxed); }
+    void onPausedReading() { pausedReads_.fetch_add(1, std::memory_order_relaxed); pausedNow_.fetch_add(1, std::memory_order_relaxed); }
+    void onResumedReading() { pausedNow_.fetch_sub(1, std::memory_order_relaxed); }
+    void onClosedConnection() { closedConnections_.fetch_add(1, std::memory_order_relaxed); }
+    int64_t rejectedAccepts() const { return rejectedAccepts_.load(std::memory_order_relaxed); }
+    int64_t pausedReads() const { return pausedReads_.load(std::memory_order_relaxed); }
+    int64_t closedConnections() const { return closedConnections_.load(std::memory_order_relaxed); }
+    // 当前因超预算处于暂停读的连接数, 为0时不用去扫描恢复
+    int64_t pausedNow() const { return pausedNow_.load(std::memory_order_relaxed); }
+
+    // 各线程占用 + 各项计数, 文本格式, 给日志和诊断用
+    std::string report() const;
+
+private:
+    MemoryBudget() = default;
+
+    struct alignas(64) Counter // 独占 cache line, 避免各 loop 线程互相伪共享
+    {
+        std::atomic<int64_t> bytes{0};
+        std::atomic<pid_t> tid{0};
+    };
+
+    Counter &localCounter();
+
+    // 线程数有限(IO线程 + 少量其他线程), 固定数组免锁; 超出的线程共用最后一个槽(此时用 RMW 保证正确)
+    inline static constexpr size_t kMaxCounters = 256;
+
+    std::atomic<int64_t> limit_{0};
+    std::atomic<int> policy_{kNone};
+    std::atomic<double> resumeRatio_{0.8};
+
+    Counter counters_[kMaxCounters];
+    std::atomic<size_t> numCounters_{0};
+    Counter overflow_;
+
+    std::atomic<int64_t> rejectedAccepts_{0};
+    std::atomic<int64_t> pausedReads_{0};
+    std::atomic<int64_t> closedConnections_{0};
+    std::atomic<int64_t> pausedNow_{0};
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+
+/**
+ * 进程内指标注册表, 导出 Prometheus 文本格式(text/plain; version=0.0.4).
+ *
+ * 每个线程一块计数数组(kMaxSeries 个 int64), Counter 只是数组下标; add() 只写本线程那一格,
+ * relaxed load + store, 不加锁不做 RMW, 和 MemoryBudget 的思路一样. 抓取(scrape)时才把所有线程块加起来,
+ * 所以 gauge 也可以在不同线程里 +1/-1 (连接数在 baseLoop 里加、在 ioLoop 里减), 总和是对的.
+ * 线程退出后它的块不清零, 还给空闲链表给后来的线程接着用, 累计值不会丢.
+ *
+ *   Counter bytes = MetricsRegistry::instance().counter("muduo_bytes_received_total", "...", "server=\"echo\"");
+ *   bytes.add(n);
+ **/
+class Counter
+{
+public:
+    Counter() = default; // 下标 0 是一个不导出的空槽, 默认构造的 Counter 随便 add, 没有分支
+
+    void add(int64_t delta) const
+    {
+        std::atomic<int64_t> &slot = localValues()[index_];
+        slot.store(slot.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    void inc() const { add(1); }
+    void dec() const { add(-1); }
+
+    // 所有线程的总和, O(线程数)
+    int64_t value() const;
+
+private:
+    friend class MetricsRegistry;
+    explicit Counter(uint32_t index) : index_(index) {}
+
+    static std::atomic<int64_t> *localValues()
+    {
+        if (__builtin_expect(t_values == nullptr, 0))
+        {
+            t_values = acquireThreadBlock();
+        }
+        return t_values;
+    }
+    static std::atomic<int64_t> *acquireThreadBlock();
+
+    inline static thread_local std::atomic<int64_t> *t_values = nullptr;
+
+    uint32_t index_ = 0;
+};
+
+class MetricsRegistry : noncopyable
+{
+public:
+    inline static constexpr uint32_t kMaxSeries = 1024;
+
+    enum class Type
+    {
+        kCounter,
+        kGauge,
+    };
+
+    static MetricsRegistry &instance();
+
+    // 同名同标签重复注册返回同一个 Counter. labels 是 Prometheus 的标签体, 不带花括号: server="echo",loop="3"
+    Counter counter(const std::string &name, const std::string &help, const std::string &labels = {});
+    Counter gauge(const std::string &name, const std::string &help, const std::string &labels = {});
+
+    // 抓取时才求值的 gauge(比如汇总所有连接的 outputBuffer), 回调在抓取线程里执行, 自己保证线程安全.
+    // 返回的 id 用于 remove, 回调捕获的对象析构前必须先 remove
+    uint64_t addCallbackGauge(const std::string &name, const std::string &help, const std::string &labels,
+                              std::function<double()> callback);
+    // 直接往输出里追加整段文本(比如把直方图导出成 summary), 要自己写好 # HELP / # TYPE
+    uint64_t addCollector(std::function<void(std::string &out)> collector);
+    void remove(uint64_t callbackId);
+
+    // Prometheus 文本格式
+    std::string scrape();
+
+private:
+    friend class Counter;
+
+    struct Series
+    {
+        std::string labels;
+        uint32_t index = 0;                // 计数槽, 回调 gauge 为 0
+        uint64_t callbackId = 0;           // 回调 gauge 才有
+        std::function<double()> callback;
+    };
+    struct Family
+    {
+        std::string name;
+        std::string help;
+        Type type;
+        std::vector<Series> series;
+    };
+
+    MetricsRegistry() = default;
+
+    Counter registerSeries(const std::string &name, const std::string &help, Type type, const std::string &labels);
+    Family &family(const std::string &name, const std::string &help, Type type);
+    std::atomic<int64_t> *acquireBlock();
+    void releaseBlock(std::atomic<int64_t> *block);
+    int64_t sum(uint32_t index);
+
+    std::mutex mutex_; // 注册/抓取/线程块分配用, 都不在数据路径上
+    std::vector<Family> families_; // 按注册顺序导出
+    std::map<std::string, size_t> familyIndex_;
+    uint32_t nextIndex_ = 1;
+    uint64_t nextCallbackId_ = 1;
+    std::vector<std::pair<uint64_t, std::function<void(std::string &)>>> collectors_;
+
+    std::vector<std::unique_ptr<std::atomic<int64_t>[]>> blocks_;
+    std::vector<std::atomic<int64_t> *> freeBlocks_;
+};
+
+// TcpServer 给它的每个连接的一组计数, 按值拷进 TcpConnection(只是几个下标), 连接比 TcpServer 活得久也没关系
+struct ConnectionMetrics
+{
+    Counter bytesReceived;
+    Counter bytesSent;
+    Counter writeEagain;     // write 返回 EAGAIN / 没写完, 剩下的进 outputBuffer_
+    Counter highWaterEvents;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "noncopyable.h"
+
+struct perf_event_mmap_page;
+
+/**
+ * 每个 loop 线程一组硬件计数器(perf_event_open: cycles/instructions/cache-misses/branch-misses, 只计用户态),
+ * 按回调类别累加, 回答 "IPC 低、cache miss 多的到底是 onMessage 还是库自己".
+ *
+ * 类别是互斥计账的: 进入一个类别时先把到此为止的增量记到外层类别, 离开时记到本类别, 所以 onMessage 嵌在
+ * handleRead 里也不会重复计. 不属于任何类别的(epoll_wait 返回后的杂事、定时器、accept)都记在 kLoop.
+ *
+ * 读计数器优先用 rdpmc(mmap 的 perf_event_mmap_page 里内核允许时), 几十个周期, 不进内核;
+ * 不允许时退回 read(2). 由 EventLoop::setPerfCountersEnabled 在 loop 线程里创建, 只有这个线程写,
+ * 累计值是 relaxed 原子量, 任何线程都能读.
+ **/
+class PerfCounters : noncopyable
+{
+public:
+    enum Event
+    {
+        kCycles,
+        kInstructions,
+        kCacheMisses,
+        kBranchMisses,
+        kNumEvents
+    };
+    enum Category
+    {
+        kLoop,
+        kReadDispatch,    // TcpConnection::handleRead 里除 onMessage 以外的部分
+        kWrite,           // sendInLoop / handleWrite
+        kPendingFunctors, // doPendingFunctors
+        kUserCallback,    // onMessage
+        kNumCategories
+    };
+    static const char *eventName(int event);
+    static const char *categoryName(int category);
+
+    // 必须在要测的线程里构造, 计的就是构造它的线程. 内核不允许(perf_event_paranoid、容器)时 valid() 为 false
+    PerfCounters();
+    ~PerfCounters();
+    bool valid() const { return fds_[kCycles] >= 0; }
+
+    // 在属主线程里开关; 打开后 PerfScope 才会生效
+    void setActive(bool on);
+    static PerfCounters *current() { return t_current; }
+
+    // 返回原来的类别, 交给 leave 恢复
+    Category enter(Category category)
+    {
+        const Category prev = category_;
+        charge();
+        category_ = category;
+        return prev;
+    }
+    void leave(Category prev)
+    {
+        charge();
+        category_ = prev;
+    }
+
+    uint64_t total(int category, int event) const { return totals_[category][event].load(std::memory_order_relaxed); }
+    // 每个类别一行: cycles instructions IPC 以及每千条指令的 cache/branch miss
+    std::string report() const;
+
+private:
+    uint64_t readCounter(int event) const;
+    void charge();
+
+    int fds_[kNumEvents];
+    perf_event_mmap_page *pages_[kNumEvents];
+    uint64_t last_[kNumEvents] = {};
+    Category category_ = kLoop;
+    std::atomic<uint64_t> totals_[kNumCategories][kNumEvents] = {};
+
+    inline static thread_local PerfCounters *t_current = nullptr;
+};
+
+// 作用域内的计数记到 category 上. 没打开时只是一次 thread_local 读
+class PerfScope : noncopyable
+{
+public:
+    explicit PerfScope(PerfCounters::Category category)
+        : counters_(PerfCounters::current())
+    {
+        if (counters_)
+        {
+            prev_ = counters_->enter(category);
+        }
+    }
+    ~PerfScope()
+    {
+        if (counters_)
+        {
+            counters_->leave(prev_);
+        }
+    }
+
+private:
+    PerfCounters *counters_;
+    PerfCounters::Category prev_ = PerfCounters::kLoop;
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+class Buffer;
+
+/**
+ * Redis 协议(RESP2/RESP3)编解码. 服务端用 RespContext 解命令、RespWriter 写回复(RespServer 把它们串起来);
+ * 客户端用 RespWriter::appendCommand 编命令、RespReply 解回复(可以直接给 UpstreamPool 当 ResponseParser).
+ *
+ * 命令解析直接在 inputBuffer_ 里切, 每个参数是指向缓冲区的 string_view, 不拷贝不分配;
+ * 一条命令就是参数数组里连续的一段(RespCommand), 整批命令的参数都在同一个 vector 里, 容量复用.
+ **/
+
+// 一条命令: argv[0] 是命令名. 参数只在处理这一批命令期间有效
+class RespCommand
+{
+public:
+    RespCommand(const std::string_view *argv, size_t argc) : argv_(argv), argc_(argc) {}
+
+    size_t size() const { return argc_; }
+    std::string_view operator[](size_t i) const { return argv_[i]; }
+    const std::string_view *begin() const { return argv_; }
+    const std::string_view *end() const { return argv_ + argc_; }
+    std::string_view name() const { return argv_[0]; }
+    // 命令名大小写不敏感比较, 比如 cmd.is("GET")
+    bool is(std::string_view name) const;
+
+private:
+    const std::string_view *argv_;
+    size_t argc_;
+};
+
+/**
+ * 每个连接一个的命令解析器, 挂在 TcpConnection 的 context 上. 认两种格式:
+ *   多条批量(客户端库、redis-benchmark): *<argc>\r\n $<len>\r\n<bytes>\r\n ...
+ *   内联(telnet/nc 手敲):              SET k v\r\n, 按空白切分, 不支持引号
+ * 命令没收全时记住至少要多少字节(大 value 分好几次到的时候), 不够就不重新解析.
+ * 另外记着这个连接协商的协议版本(HELLO 2/3), RespWriter 按它决定 null/map/double 这些怎么编码.
+ **/
+class RespContext
+{
+public:
+    enum class Result
+    {
+        kComplete,
+        kIncomplete,
+        kError,
+    };
+
+    inline static constexpr size_t kDefaultMaxBulkBytes = 64 * 1024 * 1024;
+    inline static constexpr size_t kDefaultMaxArgs = 1024 * 1024;
+    inline static constexpr size_t kMaxInlineBytes = 64 * 1024;
+
+    RespContext(size_t maxBulkBytes = kDefaultMaxBulkBytes, size_t maxArgs = kDefaultMaxArgs)
+        : maxBulkBytes_(maxBulkBytes), maxArgs_(maxArgs) {}
+
+    // 从 data 开头解一条命令, 参数追加到 args 末尾. kComplete 时 consumed 是这条命令的字节数(参数个数可以是 0,
+    // 空行/"*0" 这种, 调用方跳过即可); 其余情况 args 不变. kError 时 error() 是给客户端的错误信息
+    Result parse(const char *data, size_t len, std::vector<std::string_view> *args, size_t *consumed);
+    const char *error() const { return error_; }
+
+    int protocol() const { return protocol_; }
+    void setProtocol(int protocol) { protocol_ = protocol; }
+
+private:
+    Result parseMultiBulk(const char *data, size_t len, std::vector<std::string_view> *args, size_t *consumed);
+    Result parseInline(const char *data, size_t len, std::vector<std::string_view> *args, size_t *consumed);
+    Result fail(const char *error)
+    {
+        error_ = error;
+        return Result::kError;
+    }
+
+    const size_t maxBulkBytes_;
+    const size_t maxArgs_;
+    size_t needBytes_ = 0; // 上次没收全时至少要这么多字节才可能解完
+    const char *error_ = "";
+    int protocol_ = 2;
+};
+
+/**
+ * 往 Buffer 里写回复. RESP3 独有的类型在 RESP2 连接上降级成 RESP2 的等价写法(map 写成 2n 个元素的数组,
+ * double 写成 bulk string, bool 写成 0/1, null 写成 $-1), 处理函数不用管协议版本.
+ **/
+class RespWriter
+{
+public:
+    RespWriter(Buffer *out, int protocol) : out_(out), protocol_(protocol) {}
+
+    int protocol() const { return protocol_; }
+    Buffer *buffer() const { return out_; }
+
+    void status(std::string_view s);  // +OK
+    void ok() { status("OK"); }
+    void error(std::string_view msg); // -ERR ...(msg 自带错误前缀, 比如 "ERR syntax error")
+    void integer(int64_t value);
+    void bulk(std::string_view value);
+    void null();      // 不存在的 key
+    void nullArray(); // RESP2 的 *-1(BLPOP 超时这种)
+    void array(size_t count);
+    void map(size_t pairs);
+    void set(size_t count);
+    void push(size_t count); // 发布订阅推送; RESP2 下就是数组
+    void boolean(bool value);
+    void doubleValue(double value);
+
+    // 客户端: 编一条多条批量格式的命令
+    static void appendCommand(Buffer *out, std::initializer_list<std::string_view> args);
+    static void appendCommand(Buffer *out, const std::string_view *args, size_t count);
+
+private:
+    void header(char type, int64_t n);
+
+    Buffer *const out_;
+    const int protocol_;
+};
+
+// 客户端解回复
+class RespReply
+{
+public:
+    enum class Type
+    {
+        kSimpleString, // +
+        kError,        // - 和 RESP3 的 !
+        kInteger,      // :
+        kBulkString,   // $ 和 RESP3 的 =(verbatim, str 不含 "txt:" 前缀)
+        kNull,         // _ 以及 RESP2 的 $-1 / *-1
+        kArray,        // *
+        kMap,          // % (elements 是 k1 v1 k2 v2 ...)
+        kSet,          // ~
+        kPush,         // >
+        kDouble,       // ,
+        kBoolean,      // #
+        kBigNumber,    // ( (str 是十进制文本)
+    };
+
+    struct Value
+    {
+        Type type = Type::kNull;
+        std::string_view str; // 字符串类的内容, 指向输入
+        int64_t integer = 0;  // kInteger, kBoolean(0/1)
+        double number = 0;    // kDouble
+        std::vector<Value> elements;
+    };
+
+    inline static constexpr int kMaxDepth = 64;
+
+    // data 开头一个完整回复的字节数, 0 表示还不完整, -1 表示格式错误. 不分配内存, 可以直接当 UpstreamPool 的 ResponseParser
+    static ssize_t length(const char *data, size_t len);
+    // 解一个完整回复到 out(RESP3 的属性 | 跳过), 返回同 length. out 里的字符串指向 data
+    static ssize_t parse(const char *data, size_t len, Value *out);
+};
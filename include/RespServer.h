@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "noncopyable.h"
+#include "Metrics.h"
+#include "RespCodec.h"
+#include "TcpServer.h"
+
+/**
+ * 说 Redis 协议的服务端(给自研缓存之类用), TcpServer 上薄薄一层, 和 HttpServer 一个路数:
+ *   - 一次读到的所有流水线命令先全部解出来(RespContext, 参数是指向 inputBuffer_ 的 string_view, 不分配),
+ *     整批交给 CommandHandler: commands[0..count) 一条一条处理, 每条往 reply 里写恰好一个回复;
+ *   - 这一批的回复都写进同一个 Buffer(每个 loop 线程一个, 容量复用), 最后只 send 一次;
+ *   - HELLO(切换 RESP2/RESP3)和 QUIT 由这里处理, 批里夹着它们时在那儿切开, 前后分两次交给 CommandHandler.
+ *
+ *   RespServer server(&loop, InetAddress(6380), "cache");
+ *   server.setCommandHandler([](const TcpConnectionPtr &conn, const RespCommand *commands, size_t count, RespWriter *reply) {
+ *       for (size_t i = 0; i < count; ++i) {
+ *           const RespCommand &cmd = commands[i];
+ *           if (cmd.is("PING")) reply->status("PONG");
+ *           else reply->error("ERR unknown command");
+ *       }
+ *   });
+ *   server.setThreadNum(4);
+ *   server.start();
+ *
+ * CommandHandler 在连接所属的 io loop 里同步执行, 参数只在调用期间有效, 不要在里面阻塞.
+ * 协议错误时回 "-ERR Protocol error: ..." 然后关连接(和 redis 一样), 出错前已经解出来的命令照常处理.
+ **/
+class RespServer : noncopyable
+{
+public:
+    using CommandHandler = std::function<void(const TcpConnectionPtr &, const RespCommand *commands, size_t count, RespWriter *reply)>;
+
+    // 一批最多这么多条命令. 流水线再长也是分几批处理、每批 send 一次, 参数数组和回复缓冲不会无限涨
+    inline static constexpr size_t kMaxBatch = 1024;
+
+    RespServer(EventLoop *loop,
+               const InetAddress &listenAddr,
+               const std::string &name,
+               TcpServer::Option option = TcpServer::Option::kNoReusePort);
+
+    EventLoop *getLoop() const { return loop_; }
+    TcpServer &tcpServer() { return server_; }
+
+    // 以下在 start() 之前调用
+    void setCommandHandler(CommandHandler cb) { commandHandler_ = std::move(cb); }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void setMaxBulkBytes(size_t bytes) { maxBulkBytes_ = bytes; }
+    void setMaxArgs(size_t args) { maxArgs_ = args; }
+
+    void start() { server_.start(); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    // HELLO [protover ...], 回 RESP3 的 map(RESP2 下是数组)
+    void hello(const TcpConnectionPtr &conn, RespContext *context, const RespCommand &cmd, Buffer *out);
+
+    EventLoop *loop_;
+    TcpServer server_;
+    CommandHandler commandHandler_;
+    size_t maxBulkBytes_ = RespContext::kDefaultMaxBulkBytes;
+    size_t maxArgs_ = RespContext::kDefaultMaxArgs;
+
+    Counter commands_;
+    Counter batches_;
+    Counter protocolErrors_;
+};
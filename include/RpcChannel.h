@@ -0,0 +1,139 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "FrameCodec.h"
+#include "Metrics.h"
+#include "RpcCodec.h"
+#include "TcpClient.h"
+#include "TimerId.h"
+
+/**
+ * RPC 客户端: 一条连接上多路复用, 请求带 id, 响应按 id 配对, 可以乱序返回; 在途的请求个数不设上限.
+ *
+ *   RpcChannel channel(loop, InetAddress(9000, "127.0.0.1"), "rpc");
+ *   channel.connect();
+ *   channel.call(kEcho, EchoRequest{"hi"}, [](RpcStatus status, const EchoResponse &resp) { ... }, 0.2);
+ *
+ * call 任意线程可调, 回调总是在 channel 的 loop 线程里执行, 响应里的 string_view 只在回调期间有效.
+ * 同一轮事件循环里发起的调用攒在一个 Buffer 里, 这一轮末尾一次 send(queueInLoop), 不是每个调用一次 write.
+ * 还没连上时调用先攒着, 连上再发(等的时候已经超时的不发); 连接断开时在途的调用全部以 kUnavailable 回调.
+ *
+ * 超时在 loop 里执行: 截止时间放进小根堆, 有在途调用时每 kDeadlineTick 秒检查一次堆顶, 到期的以 kDeadlineExceeded 回调,
+ * 之后再到的响应直接丢掉. 超时也随请求发给服务端, 服务端过了截止时间的回复不再发.
+ *
+ * 析构可以在任意线程, 但 loop 必须还在运行. 析构时还没完成的调用以 kUnavailable 回调.
+ **/
+class RpcChannel : noncopyable
+{
+public:
+    inline static constexpr double kDefaultTimeout = 1.0;
+    inline static constexpr double kDeadlineTick = 0.005;
+
+    RpcChannel(EventLoop *loop, const InetAddress &serverAddr, const std::string &name);
+    ~RpcChannel();
+
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    // 断线重连之类的在 TcpClient 上设
+    TcpClient &client() { return client_; }
+    EventLoop *getLoop() const { return loop_; }
+
+    // callback: void(RpcStatus, const Resp &). status != kOk 时 Resp 是默认值. timeoutSeconds <= 0 表示不限
+    template <typename Req, typename Resp, typename Callback>
+    void call(const RpcMethod<Req, Resp> &method, const Req &request, Callback callback, double timeoutSeconds = kDefaultTimeout)
+    {
+        ResponseHandler handler = [callback = std::move(callback)](RpcStatus status, RpcReader *reader) {
+            Resp response{};
+            if (status == RpcStatus::kOk)
+            {
+                RpcTraits<Resp>::decode(*reader, response);
+                if (!reader->ok())
+                {
+                    response = Resp{};
+                    status = RpcStatus::kBadMessage;
+                }
+            }
+            callback(status, response);
+        };
+        const uint32_t timeoutMs = timeoutSeconds > 0 ? static_cast<uint32_t>(timeoutSeconds * 1000 + 0.5) : 0;
+        if (loop_->isInLoopThread())
+        {
+            // 直接编码进这一轮的发送缓冲, 不经过临时 Buffer
+            const uint64_t id = nextId_++;
+            const size_t start = RpcFrame::begin(&batch_, {RpcFrame::kRequest, RpcStatus::kOk, method.id, id, timeoutMs});
+            RpcWriter w(&batch_);
+            RpcTraits<Req>::encode(w, request);
+            RpcFrame::finish(&batch_, start);
+            addPending(id, timeoutSeconds, std::move(handler));
+            scheduleFlush();
+        }
+        else
+        {
+            // 在调用线程里编码(请求里的 string_view 只在这里有效), id 到 loop 里再分配, 所以帧头里先填 0
+            Buffer frame;
+            const size_t start = RpcFrame::begin(&frame, {RpcFrame::kRequest, RpcStatus::kOk, method.id, 0, timeoutMs});
+            RpcWriter w(&frame);
+            RpcTraits<Req>::encode(w, request);
+            RpcFrame::finish(&frame, start);
+            loop_->runInLoop([this, frame = std::move(frame), timeoutSeconds, handler = std::move(handler)]() mutable {
+                callEncoded(&frame, timeoutSeconds, std::move(handler));
+            });
+        }
+    }
+
+    // 在途的调用数. 只在 loop 线程里调
+    size_t pendingCalls() const { return pending_.size(); }
+
+private:
+    using ResponseHandler = std::function<void(RpcStatus, RpcReader *)>; // 失败时 reader 为空
+    struct Pending
+    {
+        ResponseHandler handler;
+        Timestamp deadline; // 无效表示不限
+    };
+    using Deadline = std::pair<int64_t, uint64_t>; // (截止时间微秒, 请求 id), 小根堆
+
+    void callEncoded(Buffer *frame, double timeoutSeconds, ResponseHandler &&handler);
+    void addPending(uint64_t id, double timeoutSeconds, ResponseHandler &&handler);
+    void scheduleFlush();
+    void flush();
+    // 从 batch_ 里去掉已经回调过(超时)的请求, 连上时发之前调
+    void dropAbandoned();
+    void onConnection(const TcpConnectionPtr &conn);
+    void onFrame(std::string_view frame);
+    void checkDeadlines();
+    void armDeadlineTimer();
+    void compactDeadlines();
+    // 在途的全部以 status 回调
+    void failAll(RpcStatus status);
+
+    EventLoop *loop_;
+    TcpClient client_;
+    FrameCodec codec_;
+    const std::string name_;
+
+    // 以下只在 loop 线程里访问
+    TcpConnectionPtr conn_;
+    Buffer batch_; // 这一轮要发的请求
+    bool flushQueued_ = false;
+    uint64_t nextId_ = 1;
+    std::unordered_map<uint64_t, Pending> pending_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_; // 完成的不删, 到时候查 pending_ 跳过
+    TimerId deadlineTimer_;
+    bool deadlineTimerArmed_ = false;
+    // 析构标志: 投递出去的 flush/检查超时的任务可能比对象活得久, 拿 weak_ptr 看一眼
+    std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+
+    Counter calls_;
+    Counter timeouts_;
+};
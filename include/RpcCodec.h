@@ -0,0 +1,280 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Buffer.h"
+
+/**
+ * 自带的 RPC 编解码(RpcServer/RpcChannel 用), 不依赖 protobuf.
+ *
+ * 帧: [u32 长度(网络字节序, 不含自己)] [头 20 字节] [负载], 和 FrameCodec::Type::kFixed32 一样, 解帧直接用 FrameCodec.
+ *   头: u8 kind(请求/响应) | u8 status | u16 保留 | u32 方法 id | u64 请求 id | u32 超时毫秒(请求, 0 表示不限)
+ *   响应按请求 id 配对, 同一条连接上可以乱序返回.
+ *
+ * 负载的 schema 就是 C++ 类型本身, 按字段声明顺序紧凑排列, 没有字段号也没有可选字段(两端用同一个头文件):
+ *   整数/浮点/bool  定长小端
+ *   string/string_view  u32 长度 + 字节
+ *   vector<T>       u32 个数 + 元素
+ *   自定义结构      给一个 rpcFields() 返回字段引用的 tuple, 或者自己特化 RpcTraits<T>
+ *
+ *   struct EchoRequest {
+ *       std::string_view message; // 解码时直接指向接收缓冲区, 不拷贝
+ *       int32_t repeat = 1;
+ *       auto rpcFields() { return std::tie(message, repeat); }
+ *   };
+ *   inline constexpr RpcMethod<EchoRequest, EchoResponse> kEcho{"demo.Echo"};
+ *
+ * 解码出来的 string_view 指向收到的帧, 只在回调/处理函数执行期间有效, 要留着就拷成 std::string.
+ **/
+
+enum class RpcStatus : uint8_t
+{
+    kOk = 0,
+    kMethodNotFound,
+    kBadMessage,       // 负载解不出来(两端 schema 不一致)
+    kDeadlineExceeded, // 客户端等超时了
+    kUnavailable,      // 没连上/连接断了
+    kInternal,         // 服务端处理函数主动报错
+};
+const char *rpcStatusName(RpcStatus status);
+
+// 方法 id: 名字的 FNV-1a, 编译期算好. 重名/撞车在 RpcServer 注册时检查
+constexpr uint32_t rpcMethodId(std::string_view name)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : name)
+    {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+// 方法描述: 请求/响应类型 + 名字. 客户端和服务端共用一个 constexpr 常量, 调用和注册时据此生成编解码的代码
+template <typename Req, typename Resp>
+struct RpcMethod
+{
+    using Request = Req;
+    using Response = Resp;
+
+    constexpr explicit RpcMethod(std::string_view methodName) : name(methodName), id(rpcMethodId(methodName)) {}
+
+    std::string_view name;
+    uint32_t id;
+};
+
+// 往 Buffer 后面追加
+class RpcWriter
+{
+public:
+    explicit RpcWriter(Buffer *out) : out_(out) {}
+
+    template <typename T>
+    void fixed(T value)
+    {
+        static_assert(std::is_arithmetic_v<T>);
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "wire format is little-endian");
+        out_->append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+    void bytes(std::string_view data)
+    {
+        fixed(static_cast<uint32_t>(data.size()));
+        out_->append(data.data(), data.size());
+    }
+
+    Buffer *buffer() const { return out_; }
+
+private:
+    Buffer *const out_;
+};
+
+// 从一段内存里读, 越界时 ok() 变 false, 之后读到的都是零值
+class RpcReader
+{
+public:
+    explicit RpcReader(std::string_view data) : data_(data) {}
+
+    template <typename T>
+    T fixed()
+    {
+        static_assert(std::is_arithmetic_v<T>);
+        T value{};
+        if (!take(sizeof(T)))
+        {
+            return value;
+        }
+        memcpy(&value, data_.data() + pos_ - sizeof(T), sizeof(T));
+        return value;
+    }
+    std::string_view bytes()
+    {
+        const uint32_t len = fixed<uint32_t>();
+        if (!take(len))
+        {
+            return {};
+        }
+        return data_.substr(pos_ - len, len);
+    }
+    // vector 的个数. 每个元素至少占 minElementBytes(空结构按 1 算), 用剩下的字节数挡住伪造的超大个数
+    uint32_t count(size_t minElementBytes)
+    {
+        const uint32_t n = fixed<uint32_t>();
+        if (ok_ && static_cast<uint64_t>(n) * (minElementBytes > 0 ? minElementBytes : 1) > remaining())
+        {
+            ok_ = false;
+            return 0;
+        }
+        return n;
+    }
+
+    bool ok() const { return ok_; }
+    size_t remaining() const { return data_.size() - pos_; }
+
+private:
+    bool take(size_t n)
+    {
+        if (!ok_ || n > remaining())
+        {
+            ok_ = false;
+            return false;
+        }
+        pos_ += n;
+        return true;
+    }
+
+    std::string_view data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+template <typename T, typename = void>
+struct RpcTraits; // 没有特化的类型编译不过, 要么加 rpcFields(), 要么特化它
+
+template <typename T>
+struct RpcTraits<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+{
+    static constexpr size_t kMinBytes = sizeof(T);
+    static void encode(RpcWriter &w, T value) { w.fixed(value); }
+    static void decode(RpcReader &r, T &value) { value = r.fixed<T>(); }
+};
+
+template <>
+struct RpcTraits<bool>
+{
+    static constexpr size_t kMinBytes = 1;
+    static void encode(RpcWriter &w, bool value) { w.fixed(static_cast<uint8_t>(value)); }
+    static void decode(RpcReader &r, bool &value) { value = r.fixed<uint8_t>() != 0; } // 别把任意字节 memcpy 进 bool
+};
+
+template <typename T>
+struct RpcTraits<T, std::enable_if_t<std::is_enum_v<T>>>
+{
+    using U = std::underlying_type_t<T>;
+    static constexpr size_t kMinBytes = sizeof(U);
+    static void encode(RpcWriter &w, T value) { w.fixed(static_cast<U>(value)); }
+    static void decode(RpcReader &r, T &value) { value = static_cast<T>(r.fixed<U>()); }
+};
+
+template <>
+struct RpcTraits<std::string_view>
+{
+    static constexpr size_t kMinBytes = 4;
+    static void encode(RpcWriter &w, std::string_view value) { w.bytes(value); }
+    static void decode(RpcReader &r, std::string_view &value) { value = r.bytes(); }
+};
+
+template <>
+struct RpcTraits<std::string>
+{
+    static constexpr size_t kMinBytes = 4;
+    static void encode(RpcWriter &w, const std::string &value) { w.bytes(value); }
+    static void decode(RpcReader &r, std::string &value) { value = r.bytes(); }
+};
+
+template <typename T>
+struct RpcTraits<std::vector<T>>
+{
+    static constexpr size_t kMinBytes = 4;
+    static void encode(RpcWriter &w, const std::vector<T> &value)
+    {
+        w.fixed(static_cast<uint32_t>(value.size()));
+        for (const T &element : value)
+        {
+            RpcTraits<T>::encode(w, element);
+        }
+    }
+    static void decode(RpcReader &r, std::vector<T> &value)
+    {
+        value.resize(r.count(RpcTraits<T>::kMinBytes));
+        for (T &element : value)
+        {
+            RpcTraits<T>::decode(r, element);
+        }
+    }
+};
+
+template <typename Tuple>
+struct RpcFieldBytes;
+template <typename... F>
+struct RpcFieldBytes<std::tuple<F...>>
+{
+    static constexpr size_t value = (size_t{0} + ... + RpcTraits<std::decay_t<F>>::kMinBytes);
+};
+
+// 带 rpcFields() 的结构: 按 tuple 里的顺序逐个字段编解码
+template <typename T>
+struct RpcTraits<T, std::void_t<decltype(std::declval<T &>().rpcFields())>>
+{
+    static constexpr size_t kMinBytes = RpcFieldBytes<decltype(std::declval<T &>().rpcFields())>::value;
+    static void encode(RpcWriter &w, const T &value)
+    {
+        // rpcFields() 返回的是非 const 引用, 编码只读不写
+        std::apply([&w](auto &...fields) { (encodeField(w, fields), ...); }, const_cast<T &>(value).rpcFields());
+    }
+    static void decode(RpcReader &r, T &value)
+    {
+        std::apply([&r](auto &...fields) { (decodeField(r, fields), ...); }, value.rpcFields());
+    }
+
+private:
+    template <typename F>
+    static void encodeField(RpcWriter &w, const F &field) { RpcTraits<F>::encode(w, field); }
+    template <typename F>
+    static void decodeField(RpcReader &r, F &field) { RpcTraits<F>::decode(r, field); }
+};
+
+// 帧头和帧的封装. 直接写在输出 Buffer 的末尾, 长度最后回填, 负载不用挪
+class RpcFrame
+{
+public:
+    enum Kind : uint8_t
+    {
+        kRequest = 0,
+        kResponse = 1,
+    };
+
+    struct Header
+    {
+        Kind kind = kRequest;
+        RpcStatus status = RpcStatus::kOk;
+        uint32_t method = 0;
+        uint64_t id = 0;
+        uint32_t timeoutMs = 0;
+    };
+
+    inline static constexpr size_t kLengthBytes = 4;
+    inline static constexpr size_t kHeaderBytes = 20;
+
+    // 在 out 末尾开一帧(长度占位 + 头), 返回帧起点, 之后往 out 里写负载, 最后 finish
+    static size_t begin(Buffer *out, const Header &header);
+    static void finish(Buffer *out, size_t start);
+    // frame 是 FrameCodec 切出来的(不含长度). 头不合法返回 false
+    static bool parse(std::string_view frame, Header *header, std::string_view *payload);
+};
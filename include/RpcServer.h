@@ -0,0 +1,137 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "FrameCodec.h"
+#include "Metrics.h"
+#include "RpcCodec.h"
+#include "TcpServer.h"
+
+/**
+ * 回一个请求. 处理函数拿到的是值, 可以拷走/挪到别的线程里稍后回(异步), 但一个请求只能回一次.
+ * 在处理函数里同步回的话, 回复直接写进这一批的输出缓冲, 和同一次读到的其它请求的回复一起 send 一次;
+ * 之后(或者别的线程)回的单独 send. 客户端给的超时已经过了的回复直接丢掉, 反正对面也不等了.
+ **/
+class RpcResponder
+{
+public:
+    RpcResponder(const TcpConnectionPtr &conn, uint64_t id, Timestamp deadline)
+        : conn_(conn), id_(id), deadline_(deadline) {}
+
+    uint64_t requestId() const { return id_; }
+    // 按服务端收到请求的时间 + 客户端给的超时算的, 无效表示不限
+    Timestamp deadline() const { return deadline_; }
+    bool expired() const;
+
+    void fail(RpcStatus status);
+
+protected:
+    template <typename Encode>
+    void respond(RpcStatus status, Encode &&encode)
+    {
+        TcpConnectionPtr conn = conn_.lock();
+        if (!conn || expired())
+        {
+            dropped(conn);
+            return;
+        }
+        Buffer *out = beginResponse(conn);
+        const size_t start = RpcFrame::begin(out, {RpcFrame::kResponse, status, 0, id_, 0});
+        RpcWriter w(out);
+        encode(w);
+        RpcFrame::finish(out, start);
+        endResponse(conn, out);
+    }
+
+private:
+    // 同步回复时返回这一批的输出缓冲, 否则返回一个线程局部的临时缓冲
+    static Buffer *beginResponse(const TcpConnectionPtr &conn);
+    static void endResponse(const TcpConnectionPtr &conn, Buffer *out);
+    static void dropped(const TcpConnectionPtr &conn);
+
+    std::weak_ptr<TcpConnection> conn_;
+    uint64_t id_;
+    Timestamp deadline_;
+};
+
+template <typename Resp>
+class RpcReply : public RpcResponder
+{
+public:
+    using RpcResponder::RpcResponder;
+
+    void operator()(const Resp &response)
+    {
+        respond(RpcStatus::kOk, [&response](RpcWriter &w) { RpcTraits<Resp>::encode(w, response); });
+    }
+};
+
+/**
+ * RPC 服务端. 方法在 start() 之前注册, 请求/响应类型由 RpcMethod 常量带进来, 编解码的代码由模板生成:
+ *
+ *   RpcServer server(&loop, InetAddress(9000), "rpc");
+ *   server.registerMethod(kEcho, [](const EchoRequest &req, RpcReply<EchoResponse> reply) {
+ *       reply(EchoResponse{req.message});
+ *   });
+ *   server.setThreadNum(4);
+ *   server.start();
+ *
+ * 请求在 inputBuffer_ 里原地解帧(FrameCodec)、原地解码(string_view 字段直接指向缓冲区), 处理函数在连接的 io loop 里同步调用.
+ * 一次读到的所有请求处理完, 同步产生的回复一次 send 出去.
+ * 找不到方法回 kMethodNotFound, 负载解不出来回 kBadMessage, 帧头不合法直接断开.
+ **/
+class RpcServer : noncopyable
+{
+public:
+    RpcServer(EventLoop *loop,
+              const InetAddress &listenAddr,
+              const std::string &name,
+              TcpServer::Option option = TcpServer::Option::kNoReusePort);
+
+    EventLoop *getLoop() const { return loop_; }
+    TcpServer &tcpServer() { return server_; }
+
+    // 以下在 start() 之前调用
+    template <typename Req, typename Resp, typename Handler>
+    void registerMethod(const RpcMethod<Req, Resp> &method, Handler handler)
+    {
+        addMethod(method.id, method.name, [handler = std::move(handler)](const TcpConnectionPtr &conn, uint64_t id, Timestamp deadline, RpcReader &reader) {
+            Req request{};
+            RpcTraits<Req>::decode(reader, request);
+            RpcReply<Resp> reply(conn, id, deadline);
+            if (!reader.ok())
+            {
+                reply.fail(RpcStatus::kBadMessage);
+                return;
+            }
+            handler(request, std::move(reply));
+        });
+    }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    void start() { server_.start(); }
+
+private:
+    using Invoker = std::function<void(const TcpConnectionPtr &, uint64_t id, Timestamp deadline, RpcReader &)>;
+    struct Method
+    {
+        std::string name;
+        Invoker invoker;
+    };
+
+    void addMethod(uint32_t id, std::string_view name, Invoker invoker);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void onFrame(const TcpConnectionPtr &conn, std::string_view frame, Timestamp receiveTime);
+
+    EventLoop *loop_;
+    TcpServer server_;
+    FrameCodec codec_;
+    std::unordered_map<uint32_t, Method> methods_; // start() 之后只读
+
+    Counter calls_;
+    Counter notFound_;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+/**
+ * 带代数(generation)的槽位表: 插入返回 64 位 id, 查找/删除都是数组下标 O(1), 不哈希.
+ * id = generation(22位) | shard(10位) | slot(32位). 槽位被删除后 generation+1,
+ * 旧 id 再来查就对不上了, 不会误删复用该槽位的新对象.
+ * shard 字段由调用方指定, 用来在多个 SlotMap(每个 loop 一个)之间路由, SlotMap 自己只校验.
+ * 不是线程安全的.
+ **/
+template <typename T>
+class SlotMap
+{
+public:
+    using Id = uint64_t;
+
+    inline static constexpr int kSlotBits = 32;
+    inline static constexpr int kShardBits = 10;
+    inline static constexpr int kGenerationBits = 64 - kSlotBits - kShardBits;
+    inline static constexpr uint64_t kMaxShards = uint64_t(1) << kShardBits;
+
+    static uint32_t slotOf(Id id) { return static_cast<uint32_t>(id); }
+    static uint32_t shardOf(Id id) { return static_cast<uint32_t>((id >> kSlotBits) & (kMaxShards - 1)); }
+    static uint32_t generationOf(Id id) { return static_cast<uint32_t>(id >> (kSlotBits + kShardBits)); }
+
+    explicit SlotMap(uint32_t shard = 0) : shard_(shard) {}
+
+    Id insert(T value)
+    {
+        uint32_t slot;
+        if (!freeSlots_.empty())
+        {
+            slot = freeSlots_.back();
+            freeSlots_.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+        Slot &s = slots_[slot];
+        s.value = std::move(value);
+        s.occupied = true;
+        ++size_;
+        return makeId(s.generation, slot);
+    }
+
+    T *find(Id id)
+    {
+        Slot *s = lookup(id);
+        return s ? &s->value : nullptr;
+    }
+
+    // 成功返回 true, 并把值移出到 out(如果给了)
+    bool erase(Id id, T *out = nullptr)
+    {
+        Slot *s = lookup(id);
+        if (!s)
+        {
+            return false;
+        }
+        if (out)
+        {
+            *out = std::move(s->value);
+        }
+        s->value = T();
+        s->occupied = false;
+        s->generation = (s->generation + 1) & ((uint32_t(1) << kGenerationBits) - 1);
+        freeSlots_.push_back(slotOf(id));
+        --size_;
+        return true;
+    }
+
+    template <typename Func>
+    void forEach(Func &&func) const
+    {
+        for (const Slot &s : slots_)
+        {
+            if (s.occupied)
+            {
+                func(s.value);
+            }
+        }
+    }
+
+    void clear()
+    {
+        slots_.clear();
+        freeSlots_.clear();
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    uint32_t shard() const { return shard_; }
+
+private:
+    struct Slot
+    {
+        T value{};
+        uint32_t generation = 0;
+        bool occupied = false;
+    };
+
+    Id makeId(uint32_t generation, uint32_t slot) const
+    {
+        return (static_cast<uint64_t>(generation) << (kSlotBits + kShardBits))
+             | (static_cast<uint64_t>(shard_) << kSlotBits)
+             | slot;
+    }
+
+    Slot *lookup(Id id)
+    {
+        const uint32_t slot = slotOf(id);
+        if (shardOf(id) != shard_ || slot >= slots_.size())
+        {
+            return nullptr;
+        }
+        Slot &s = slots_[slot];
+        if (!s.occupied || s.generation != generationOf(id))
+        {
+            return nullptr;
+        }
+        return &s;
+    }
+
+    uint32_t shard_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+    size_t size_ = 0;
+};
@@ -3,6 +3,7 @@
 #include "noncopyable.h"
 
 class InetAddress;
+struct TcpInfoSample;
 
 // 封装socket fd
 class Socket : noncopyable
@@ -27,6 +28,9 @@ public:
     void setKeepAlive(bool on); // TCP的keep-alive
     // 这把背的八股都用上了, 只有负载均衡是之前没见过的.
 
+    // TCP_INFO + SIOCOUTQ/SIOCINQ, 失败返回 false. 不改 socket 状态, 任意线程可调(只要 fd 还没 close)
+    bool getTcpInfo(TcpInfoSample *sample) const;
+
 private:
     const int sockfd_;
 };
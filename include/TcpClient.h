@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Connector.h"
+#include "InetAddress.h"
+
+class EventLoop;
+
+/**
+ * 客户端, 一个 TcpClient 最多一条连接. 连接用的是和服务端一样的 TcpConnection/Buffer/Channel,
+ * 放在哪个 loop 上就在哪个 loop 上收发, 服务里既当服务端又调后端时不用再引一套网络库.
+ *
+ *   TcpClient client(loop, InetAddress(6379), "redis");
+ *   client.enableRetry(); // 断线自动重连
+ *   client.setMessageCallback(...);
+ *   client.connect();
+ *
+ * 析构可以在任意线程, 但 loop 必须还在运行(要在 loop 线程里摘掉连接和 Connector 的回调).
+ * 析构时连接只被自己持有就 forceClose, 用户还拿着 TcpConnectionPtr 就留给用户, 关闭时不会再回调到已析构的 TcpClient.
+ **/
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+    ~TcpClient();
+
+    void connect();    // 线程安全
+    void disconnect(); // 线程安全, 半关闭已有连接, 不再重连
+    void stop();       // 线程安全, 放弃正在进行的连接/重试
+
+    TcpConnectionPtr connection() const
+    {
+        std::scoped_lock lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    void enableRetry() { retry_ = true; }
+    // 连接失败后的退避, 见 Connector. 在 connect() 之前调用
+    void setRetryDelay(double initialSeconds, double maxSeconds) { connector_->setRetryDelay(initialSeconds, maxSeconds); }
+
+    const std::string &name() const { return name_; }
+
+    // 以下都不是线程安全的, 在 connect() 之前设置
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+    void setWriteCompleteCallback(WriteCompleteCallback cb) { writeCompleteCallback_ = std::move(cb); }
+    void setHighWaterMarkCallback(HighWaterMarkCallback cb, size_t highWaterMark)
+    { highWaterMarkCallback_ = std::move(cb); highWaterMark_ = highWaterMark; }
+
+private:
+    // 都在loop线程里执行
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr &conn);
+    void cleanupInLoop();
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    const std::shared_ptr<const std::string> namePrefix_; // "name:ip:port", 连接名字懒拼接, 和 TcpServer 一样
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    HighWaterMarkCallback highWaterMarkCallback_;
+    size_t highWaterMark_ = 64 * 1024 * 1024;
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    uint64_t nextConnId_; // 只在loop线程里递增
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_; // 受 mutex_ 保护
+};
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <any>
 #include <memory>
 #include <string>
 #include <atomic>
 #include <string_view>
+#include <vector>
 
 #include "noncopyable.h"
 #include "InetAddress.h"
@@ -11,10 +13,14 @@
 #include "Buffer.h"
 #include "Timestamp.h"
 #include "EventLoop.h"
+#include "Metrics.h"
+#include "TcpInfo.h"
 
 class Channel;
 // class EventLoop; // 写了模板函数, 不能前置申明, 而是要include了.
 class Socket;
+class ReadAwaiter;
+class WriteAwaiter;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -29,16 +35,38 @@ public:
                   int sockfd,
                   const InetAddress &localAddr,
                   const InetAddress &peerAddr);
+    // TcpServer用: 不再为每个连接拼 "name-ip:port#N", 只存共享的前缀和序号, 真正要打日志时才拼
+    TcpConnection(EventLoop *loop,
+                  std::shared_ptr<const std::string> namePrefix,
+                  uint64_t sequence,
+                  int sockfd,
+                  const InetAddress &localAddr,
+                  const InetAddress &peerAddr);
     ~TcpConnection();
 
     EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
+    // 按值返回, 懒拼接. 别在热路径上反复调用, 需要做key请用id()
+    std::string name() const;
+    // TcpServer分配的64位id(SlotMap的key), 连接建立前由TcpServer在所属loop中设置
+    uint64_t id() const { return id_; }
+    void setId(uint64_t id) { id_ = id; }
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
+    const char *stateToString() const;
+    // 构造的时间(coarseNow), Inspector 用它算连接存活了多久
+    Timestamp createTime() const { return createTime_; }
 
     void setTcpNoDelay(bool on);
+    // 旁路IO(见 setIoBypass)直接读写 fd 用
+    int fd() const;
+
+    // 内核眼里这条连接的状态(RTT、拥塞窗口、重传、发送/接收队列), 任意线程可调, 持有 TcpConnectionPtr 期间 fd 不会被关
+    bool getTcpInfo(TcpInfoSample *sample) const;
+    // 只在loop线程中调用: 采样一次并保存下来, 顺带算出距上次采样新增的重传(newRetrans). TcpServer 的采样器用
+    const TcpInfoSample &sampleTcpInfo();
+    const TcpInfoSample &lastTcpInfo() const { return tcpInfo_; } // 只在loop线程里看
 
     // 发送数据
     // 故事线如下: 
@@ -79,10 +107,37 @@ public:
     void send(const void* data, size_t len);
     // 第二个, 增加Buffer的swap逻辑, 因为Buffer底层是vector<char>, 最后可以用空Buffer来swap窃取资源. 这是真的极致优化了. 🥰🥰
     void send(Buffer* buf);
+    // 聚集写: 头和体分别在两块内存里(比如 HTTP 响应头在栈上/Buffer 里, 体是用户的大字符串), 在loop线程里且前面没有
+    // 积压时一次 writev 发出去, 不用先拼成一块; 没发完的才拷进 outputBuffer_. 跨线程调用时拼成一块再投递
+    void sendv(std::string_view head, std::string_view body);
+    // 同上, 任意多块(超过 IOV_MAX 的分几次 writev). 块指向的内存只需要活到这次调用返回
+    void sendv(const std::string_view *pieces, size_t count);
     void sendFile(int fileDescriptor, off_t offset, size_t count); 
     
     // 关闭半连接
     void shutdown();
+    // 不等数据发完, 直接关闭连接(走handleClose), 线程安全
+    void forceClose();
+
+    // 协程接口, 定义在 Coroutine.h 中(需要 C++20), 只能在本连接的 loop 线程中 co_await.
+    // 挂起的协程由 handleRead/handleWrite/handleClose 直接恢复, 不经过 pendingFunctors_ 多排一次队.
+    ReadAwaiter readExactly(size_t n);
+    ReadAwaiter readUntil(std::string_view delimiter);
+    WriteAwaiter write(std::string_view data);
+
+    // 上层协议挂在连接上的状态(比如 HTTP 解析器), 只在loop线程里用
+    void setContext(std::any context) { context_ = std::move(context); }
+    const std::any &getContext() const { return context_; }
+    std::any *getMutableContext() { return &context_; }
+
+    Buffer *inputBuffer() { return &inputBuffer_; }
+    Buffer *outputBuffer() { return &outputBuffer_; }
+
+    // 两个Buffer当前占用的内存(容量), loop线程写, 任意线程可读, MemoryBudget的超预算处理靠它挑连接
+    size_t inputBufferBytes() const { return inputBufferBytes_.load(std::memory_order_relaxed); }
+    size_t outputBufferBytes() const { return outputBufferBytes_.load(std::memory_order_relaxed); }
+    // outputBuffer_ 里还没发出去的字节数(写队列深度), 任意线程可读
+    size_t outputQueuedBytes() const { return outputQueuedBytes_.load(std::memory_order_relaxed); }
 
     // 这一坨是上层TcpServer传递给TcpConnection的.
     void setConnectionCallback(ConnectionCallback cb)
@@ -95,6 +150,58 @@ public:
     { closeCallback_ = std::move(cb); }
     void setHighWaterMarkCallback(HighWaterMarkCallback cb, size_t highWaterMark)
     { highWaterMarkCallback_ = std::move(cb); highWaterMark_ = highWaterMark; }
+    // TcpServer 在 connectEstablished 之前设置, 不设置就记到不导出的空槽里
+    void setMetrics(const ConnectionMetrics &metrics) { metrics_ = metrics; }
+    // 超过高水位之后, outputBuffer_ 降到 lowWaterMark 及以下时回调一次(滞回, 避免在阈值附近反复触发)
+    void setLowWaterMarkCallback(LowWaterMarkCallback cb, size_t lowWaterMark)
+    { lowWaterMarkCallback_ = std::move(cb); lowWaterMark_ = lowWaterMark; }
+
+    /**
+     * 暂停/恢复读(不再监听EPOLLIN, 内核接收缓冲区满后 TCP 窗口自然把对端压住), 线程安全.
+     * 停读的原因各占一位, 谁停的谁恢复, 所有位都清掉才真正恢复读: 应用 stopRead 了的连接不会因为下游排空被背压恢复.
+     **/
+    enum ReadPauseReason : uint8_t
+    {
+        kPauseByUser = 1,         // 应用自己调用 stopRead
+        kPauseByBackpressure = 2, // 至少一个下游超过高水位(见 addBackpressurePeer)
+        kPauseByBudget = 4,       // MemoryBudget 超预算(见 pauseReadingForBudget)
+        kPauseByRelay = 8,        // TcpRelay: 对端写不动, 或者这一边已经读到 EOF
+    };
+    void startRead(ReadPauseReason reason = kPauseByUser);
+    void stopRead(ReadPauseReason reason = kPauseByUser);
+    bool isReading() const { return readPauseMask_ == 0; } // 不是线程安全的, 只在loop线程里看
+
+    /**
+     * 端到端背压: 本连接(下游) outputBuffer_ 超过高水位时压住上游(停读), 降到低水位后松开.
+     * 典型场景是代理: client(上游) 读到的数据 send 给 backend(下游), backend 慢就别再读 client 了.
+     * 一个上游可以被多个下游压住, 上游记着被几个下游压着, 全部松开才恢复读.
+     * 只保存 weak_ptr, 上游先断开也没关系. 在本连接的 loop 线程中调用.
+     **/
+    void addBackpressurePeer(const TcpConnectionPtr &upstream);
+
+    /**
+     * 旁路IO: 设置之后 handleRead 不再把数据读进 inputBuffer_, messageCallback_ 也不再调用, 改为调用 readable, 由它自己读 fd;
+     * outputBuffer_ 发空之后, 或者 outputBuffer_ 是空的但用 setWantWritable 关注了可写时, 调用 writable;
+     * 连接关闭时(handleClose)先摘掉旁路再调用 closed, 之后不会再调用这三个回调. TcpRelay 用它在两条连接之间 splice.
+     * 只在loop线程里设置.
+     **/
+    struct IoBypass
+    {
+        std::function<void()> readable;
+        std::function<void()> writable;
+        std::function<void()> closed;
+    };
+    void setIoBypass(IoBypass bypass) { bypass_ = std::move(bypass); }
+    // 旁路IO自己有没写完的数据(比如 splice 管道里的)时关注可写; 关掉时 outputBuffer_ 还有数据的话照样关注. 只在loop线程里调用
+    void setWantWritable(bool on);
+
+    // MemoryBudget 超预算时暂停/恢复读, 只动 kPauseByBudget 这一位: 恢复时应用或者背压还停着的话照样停着. 线程安全
+    void pauseReadingForBudget();
+    void resumeReadingForBudget();
+    bool pausedForBudget() const { return pausedForBudget_; }
+    // 有人负责恢复的连接(TcpServer 的定时检查)才会在 inputBuffer_ 扩容超预算时自己停读, 别的(TcpClient、连接池的)只记账.
+    // TcpServer 在 connectEstablished 之前设置
+    void setBudgetManaged(bool on) { budgetManaged_ = on; }
 
     // 连接建立
     void connectEstablished();
@@ -102,6 +209,15 @@ public:
     void connectDestroyed();
 
 private:
+    // 上面两个公开构造函数都委托到这里
+    TcpConnection(EventLoop *loop,
+                  const std::string &nameArg,
+                  std::shared_ptr<const std::string> namePrefix,
+                  uint64_t sequence,
+                  int sockfd,
+                  const InetAddress &localAddr,
+                  const InetAddress &peerAddr);
+
     enum StateE
     {
         kDisconnected, // 已经断开连接
@@ -117,13 +233,47 @@ private:
     void handleClose();
     void handleError();
 
+    // 协程挂起点. notify 负责检查条件: 满足就 resume, 不满足就把自己重新登记回来
+    struct Waiter
+    {
+        void (*notify)(void *) = nullptr;
+        void *arg = nullptr;
+    };
+    static void notifyWaiter(Waiter &waiter)
+    {
+        Waiter w = waiter;
+        waiter = Waiter{};
+        if (w.notify) w.notify(w.arg);
+    }
+    friend class ReadAwaiter;
+    friend class WriteAwaiter;
+
     void sendInLoop(const void *data, size_t len);
+    void sendvInLoop(const std::string_view *pieces, size_t count);
+    // 直接写没写完的部分进 outputBuffer_, 顺带高水位检查和注册 EPOLLOUT
+    void appendOutput(const char *data, size_t len);
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void updateMemoryAccounting();
+    void startReadInLoop(uint8_t reason);
+    void stopReadInLoop(uint8_t reason);
+    // 下游压住/松开本连接(上游), 可以跨线程
+    void holdForBackpressure();
+    void releaseBackpressure();
+    void onOutputAboveHighWaterMark(size_t waterMark);
+    void onOutputBelowLowWaterMark();
+    // 越过高水位时压住的上游全部松开, 没越过什么也不做. 降到低水位、关闭、销毁时调用
+    void releaseBackpressurePeers();
     void sendFileInLoop(int fileDescriptor, off_t offset, size_t count);
     EventLoop *loop_; // 这里是baseloop还是subloop由TcpServer中创建的线程数决定 若为多Reactor 该loop_指向subloop 若为单Reactor 该loop_指向baseloop
-    const std::string name_;
+    const std::string name_;                           // 显式给定的名字, 为空时由下面两个拼
+    const std::shared_ptr<const std::string> namePrefix_; // "serverName-ip:port", 同一个TcpServer的连接共享一份
+    const uint64_t sequence_;
+    uint64_t id_;
     std::atomic_int state_;
-    bool reading_;//连接是否在监听读事件
+    const Timestamp createTime_;
+    uint8_t readPauseMask_; // ReadPauseReason 按位或, 为 0 时监听读事件
+    int backpressureHolds_; // 有几个下游正压着本连接
 
     // Socket Channel 这里和Acceptor类似    Acceptor => mainloop    TcpConnection => subloop
     std::unique_ptr<Socket> socket_;
@@ -137,10 +287,28 @@ private:
     MessageCallback messageCallback_;             // 有读写消息时的回调, main中设置的回调扔给TcpServer,再扔给TcpConnection然后扔给Channel(非监听套接字的)
     WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
     HighWaterMarkCallback highWaterMarkCallback_; // 高水位回调
+    LowWaterMarkCallback lowWaterMarkCallback_;   // 低水位回调
     CloseCallback closeCallback_; // 关闭连接的回调
     size_t highWaterMark_; // 高水位阈值
+    ConnectionMetrics metrics_;
+    size_t lowWaterMark_;  // 低水位阈值
+    bool aboveHighWaterMark_; // 越过高水位后置位, 降到低水位才清除
+    std::vector<std::weak_ptr<TcpConnection>> backpressurePeers_; // 被本连接压住的上游
+    IoBypass bypass_;
 
     // 数据缓冲区
     Buffer inputBuffer_;    // 接收数据的缓冲区
     Buffer outputBuffer_;   // 发送数据的缓冲区 用户send向outputBuffer_发
+
+    std::atomic<size_t> inputBufferBytes_{0};  // 已经计入MemoryBudget的容量
+    std::atomic<size_t> outputBufferBytes_{0};
+    std::atomic<size_t> outputQueuedBytes_{0};
+    std::atomic_bool pausedForBudget_{false};
+    bool budgetManaged_ = false;
+
+    TcpInfoSample tcpInfo_; // 上一次 sampleTcpInfo 的结果
+    std::any context_;
+
+    Waiter readWaiter_;  // 协程在等 inputBuffer_ 里的数据
+    Waiter writeWaiter_; // 协程在等 outputBuffer_ 发空
 };
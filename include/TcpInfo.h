@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Timestamp.h"
+
+/**
+ * 一次 getsockopt(TCP_INFO) + ioctl(SIOCOUTQ/SIOCINQ) 的结果, 只挑了判断"慢在网络还是慢在我们"用得上的字段.
+ * outputBuffer_ 在涨的时候: sendQueueBytes 也顶满、rtt/重传上去了, 是网络或对端的问题;
+ * sendQueueBytes 很小而 outputBuffer_ 在涨, 是我们自己没及时写(loop 被别的回调卡住了).
+ **/
+struct TcpInfoSample
+{
+    Timestamp when;              // 无效表示还没采样过
+    uint32_t rttUs = 0;          // 平滑 RTT
+    uint32_t rttVarUs = 0;
+    uint32_t rtoUs = 0;
+    uint32_t cwnd = 0;           // 拥塞窗口, 单位 MSS
+    uint32_t ssthresh = 0;
+    uint32_t mss = 0;
+    uint32_t unacked = 0;        // 已发出未确认的段数
+    uint32_t lost = 0;
+    uint32_t retransmitting = 0; // 当前这一段连续超时重传的次数(tcpi_retransmits)
+    uint32_t totalRetrans = 0;   // 连接建立以来累计重传的段数
+    uint32_t newRetrans = 0;     // 距上一次 TcpConnection::sampleTcpInfo 新增的重传, 只有采样器会填
+    int sendQueueBytes = 0;      // SIOCOUTQ: 内核发送队列里还没被对端确认的字节
+    int recvQueueBytes = 0;      // SIOCINQ: 内核接收队列里还没被我们读走的字节
+
+    // 一行文本, 给日志和 Inspector 用
+    std::string toString() const;
+};
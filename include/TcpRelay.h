@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+
+/**
+ * 中继: 把两条已经建立的连接对接起来, 一边读到的字节原样写到另一边. 典型用法是四层代理:
+ *
+ *   // 前端连接进来以后, 在它的 loop 上用 TcpClient 连后端, 后端连上时:
+ *   TcpRelay::start(front, backend);
+ *
+ * 默认用 splice(2) 经过管道搬运, socket -> pipe -> socket 都在内核里, 数据不进用户态,
+ * 省掉 inputBuffer_ 读一次、send 再拷一次. 管道从每个线程(也就是每个 loop)自己的池子里拿, 会话结束还回去,
+ * 不用每个会话 pipe2 + close 各两次. 需要看数据的方向(给了 inspect)退回 Buffer 拷贝: 读进 inputBuffer_,
+ * inspect 之后 send 给对端; 管道建不出来(fd 用完)的方向也退回拷贝.
+ *
+ * 背压: 对端写不动时(管道里的没写完, 或者拷贝时对端 outputBuffer_ 超过 kCopyHighWaterMark)停读这一边,
+ * 对端写空了再恢复, 每个方向最多积压一个管道或者一个高水位.
+ * 半关闭: 一边读到 EOF, 等这个方向积压的数据写完, 对另一边 shutdown 写端, 反方向照常转发; 两个方向都结束后关掉两条连接.
+ * 一边异常断开(RST、读写出错、被 forceClose)只关这一边, 从它那里已经收下的数据照样转给另一边, 然后关掉另一边.
+ *
+ * 中继自己停读用 kPauseByRelay 这一位, 不动别人的: 应用等后端时 stopRead 了前端的话, start 之后自己 startRead.
+ *
+ * 两条连接必须在同一个 loop 上, start 在这个 loop 线程里调用. 中继期间 messageCallback 不再调用,
+ * 连接断开时 connectionCallback 照常调用. 对象由两条连接持有, 两条都关掉以后自己释放, 返回值不用留着.
+ **/
+class TcpRelay : noncopyable, public std::enable_shared_from_this<TcpRelay>
+{
+public:
+    // 转发之前看一眼, 可以改也可以 retrieve 掉一部分, 剩下的可读字节发给对端
+    using InspectCallback = std::function<void(Buffer *)>;
+
+    inline static constexpr size_t kPipeSize = 256 * 1024;          // 设不上(超过 pipe-max-size 或管道配额)就用默认的 64K
+    inline static constexpr size_t kCopyHighWaterMark = 256 * 1024; // 拷贝方向对端 outputBuffer_ 超过它就停读
+    inline static constexpr size_t kMaxIdlePipes = 64;              // 每个线程池子里最多留几个空闲管道
+
+    // 任一条已经断开时两条都关掉, 返回空
+    static std::shared_ptr<TcpRelay> start(const TcpConnectionPtr &a,
+                                           const TcpConnectionPtr &b,
+                                           InspectCallback inspectAToB = {},
+                                           InspectCallback inspectBToA = {});
+    ~TcpRelay();
+
+    // 以下只在 loop 线程里看
+    uint64_t bytesAToB() const { return dirs_[0].bytes; }
+    uint64_t bytesBToA() const { return dirs_[1].bytes; }
+    bool splicingAToB() const { return dirs_[0].pipeRead >= 0; }
+    bool splicingBToA() const { return dirs_[1].pipeRead >= 0; }
+
+private:
+    // dirs_[i] 是 conns_[i] -> conns_[1 - i] 这个方向
+    struct Direction
+    {
+        InspectCallback inspect;
+        int pipeRead = -1; // -1 表示这个方向走拷贝
+        int pipeWrite = -1;
+        size_t piped = 0;  // 管道里还没写给对端的字节
+        uint64_t bytes = 0;
+        bool paused = false; // 因为对端写不动停了读
+        bool eof = false;    // 源头不会再有数据了
+        bool done = false;   // 已经 shutdown 对端(或者对端没了), 这个方向结束
+    };
+
+    TcpRelay(const TcpConnectionPtr &a, const TcpConnectionPtr &b, InspectCallback inspectAToB, InspectCallback inspectBToA);
+    void attach();
+
+    // side 是事件所在连接的下标
+    void onReadable(int side);
+    void onWritable(int side);
+    void onClosed(int side);
+
+    // from 是方向的源头下标
+    void forward(int from, Buffer *buf);
+    void flush(int from);
+    void pause(int from);
+    void resume(int from);
+    void onEof(int from);
+    void finishDirection(int from);
+    void checkFinished();
+    void closeIfDrained(int side);
+    // side 的 socket 读写出错
+    void fail(int side);
+
+    TcpConnectionPtr conns_[2]; // 断开后置空, 两条都断开时由连接持有的回调放掉最后的引用
+    Direction dirs_[2];
+    bool finished_ = false;
+};
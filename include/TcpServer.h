@@ -8,7 +8,8 @@
 #include <string>
 #include <memory>
 #include <atomic>
-#include <unordered_map>
+#include <mutex>
+#include <vector>
 
 #include "EventLoop.h"
 #include "Acceptor.h"
@@ -18,6 +19,8 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "SlotMap.h"
+#include "Histogram.h"
 
 // 对外的服务器编程使用的类
 class TcpServer : noncopyable
@@ -41,6 +44,11 @@ public:
     void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); } // example的main中只用到了这几个, 连接建立和断开都是这个.
     void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); } // example的main中只用到了这几个
     void setWriteCompleteCallback(WriteCompleteCallback cb) { writeCompleteCallback_ = std::move(cb); } // 没用到, 意义在于传输1GB这样的大文件
+    // 高/低水位回调, 会设置到每个新连接上. 之前TcpConnection有这个接口但TcpServer没暴露, 用户根本设置不了
+    void setHighWaterMarkCallback(HighWaterMarkCallback cb, size_t highWaterMark)
+    { highWaterMarkCallback_ = std::move(cb); highWaterMark_ = highWaterMark; }
+    void setLowWaterMarkCallback(LowWaterMarkCallback cb, size_t lowWaterMark)
+    { lowWaterMarkCallback_ = std::move(cb); lowWaterMark_ = lowWaterMark; }
 
     // 设置底层subloop的个数
     void setThreadNum(int numThreads); // example的main中只用到了这几个
@@ -51,20 +59,85 @@ public:
      */
     void start();
 
+    /**
+     * 内存占用最多的 topN 个连接 + MemoryBudget 汇总, 文本格式. 线程安全
+     **/
+    std::string memoryUsageReport(size_t topN) const;
+
+    // 所有连接的快照, 线程安全. 会逐个锁分片, 诊断/统计用, 别放在热路径上
+    std::vector<TcpConnectionPtr> connectionsSnapshot() const;
+    size_t numConnections() const;
+
+    const std::string &name() const { return name_; }
+    const std::string &ipPort() const { return ipPort_; }
+    // 所有io loop(每个连接分片一个), start() 之前为空
+    std::vector<EventLoop *> loops() const;
+
+    /**
+     * TCP_INFO 采样: 每个io loop每 interval 秒对本分片的所有连接 getsockopt(TCP_INFO) + SIOCOUTQ/SIOCINQ 一次,
+     * 结果汇成直方图, 和 outputBuffer_ 的堆积放在一起看, 能分出是网络慢还是我们慢.
+     * 0 表示关闭(默认). 必须在 start() 之前调用. 每个连接每次采样是 3 个系统调用, 连接多的时候间隔别设太小
+     **/
+    void setTcpInfoSampleInterval(double seconds) { tcpInfoInterval_ = seconds; }
+
+    // 最近一轮采样的分布, 每个连接贡献一个样本
+    struct TcpInfoStats
+    {
+        Histogram::Snapshot rttUs;
+        Histogram::Snapshot rttVarUs;
+        Histogram::Snapshot cwnd;
+        Histogram::Snapshot unacked;
+        Histogram::Snapshot newRetrans;        // 本轮采样间隔内新增的重传段数
+        Histogram::Snapshot sendQueueBytes;    // SIOCOUTQ
+        Histogram::Snapshot recvQueueBytes;    // SIOCINQ
+        Histogram::Snapshot outputQueuedBytes; // 同一时刻 outputBuffer_ 里待发的字节
+        uint64_t retransmittingConnections = 0; // 正处在超时重传中的连接数
+
+        void merge(const TcpInfoStats &other);
+        std::string toString() const;
+    };
+    // 各分片最近一轮的结果合并, 线程安全. 没开采样时全是空的
+    TcpInfoStats tcpInfoStats() const;
+
 private:
+    /**
+     * 连接分片, 每个io loop一个. 原来是baseLoop上一个 unordered_map<string, TcpConnectionPtr>,
+     * 每个连接都要拼名字、哈希字符串, 删除还要 runInLoop 切回baseLoop. 现在用 SlotMap 按64位id存,
+     * 插入和删除都在连接所属的loop线程里完成, 不再经过baseLoop.
+     **/
+    struct ConnectionShard
+    {
+        ConnectionShard(EventLoop *l, uint32_t index, const std::string &server)
+            : loop(l), connections(index), serverName(server) {}
+
+        EventLoop *loop;
+        mutable std::mutex mutex; // 只有本loop线程写; 跨线程做快照时才会竞争
+        SlotMap<TcpConnectionPtr> connections;
+        TimerId memoryCheckTimer;
+        const std::string serverName; // 日志用, 定时器回调里不能碰已经析构的TcpServer
+        Counter connectionsGauge;     // 连接数, 和 removeConnection 一样不能依赖 TcpServer 还活着
+        Counter closedCounter;
+        TimerId tcpInfoTimer;
+        std::shared_ptr<const TcpInfoStats> tcpInfo; // 受 mutex 保护, 采样器每轮整体换掉
+    };
+    using ConnectionShardPtr = std::shared_ptr<ConnectionShard>;
+
     // 陈硕: Not thread safe, but in loop  这就是one loop per thread设计哲学: 把并发问题转化成单线程问题. 这函数只会在mainloop对应的线程中执行.
     void newConnection(int sockfd, const InetAddress &peerAddr); // 这个绝对的核心!!, 后面两个和前面两个remove回调也在这里面. 以及后面的 connectionCallback_等等也在这里面.
-    // 陈硕: Thread safe. 它利用runInLoop把remove操作切回了mainLoop执行下面那个, 这里面涉及EventLoop的实现细节, 略.
-    void removeConnection(const TcpConnectionPtr &conn);
-    // 陈硕: Not thread safe, but in loop
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    // 在连接所属的io loop中执行(handleClose里回调), 直接从本loop的分片删除. 只持有分片的weak_ptr, TcpServer先析构也安全
+    static void removeConnection(const std::weak_ptr<ConnectionShard> &weakShard, const TcpConnectionPtr &conn);
+    // 每个分片在自己的loop里定时执行, 超过MemoryBudget时按策略暂停读/关闭连接, 降下来后恢复读
+    static void checkMemoryBudget(ConnectionShard &shard, size_t numShards);
+    // 每个分片在自己的loop里定时执行, 采样本分片所有连接的 TCP_INFO
+    static void sampleTcpInfo(ConnectionShard &shard);
 
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    inline static constexpr double kMemoryCheckInterval = 0.1; // 秒
 
     EventLoop *loop_; // baseloop 用户自定义的loop
 
     const std::string ipPort_;
     const std::string name_;
+    const std::shared_ptr<const std::string> namePrefix_; // "name-ip:port", 所有连接共享, 连接名字懒拼接
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainloop 任务就是监听新连接事件
 
@@ -73,11 +146,23 @@ private:
     ConnectionCallback connectionCallback_;       // 有新连接时的回调, TcpServer扔给TcpConnection然后扔给Channel
     MessageCallback messageCallback_;             // 有读写事件发生时的回调
     WriteCompleteCallback writeCompleteCallback_; // 消息发送完成后的回调, testserver中没有使用.
+    HighWaterMarkCallback highWaterMarkCallback_;
+    LowWaterMarkCallback lowWaterMarkCallback_;
+    size_t highWaterMark_ = 64 * 1024 * 1024; // 和TcpConnection的默认值一致
+    size_t lowWaterMark_ = 0;
+    double tcpInfoInterval_ = 0.0;
 
     ThreadInitCallback threadInitCallback_; // loop线程初始化的回调
     int numThreads_;//线程池中线程的数量。
     // std::atomic_int started_; // 用atomic<int>更C++morden, 然后用bool语义更明确.
     std::atomic<bool> started_;
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有的连接
+    uint64_t nextConnId_; // 只在baseLoop里递增, 只用于连接名字里的 #N
+    std::vector<ConnectionShardPtr> shards_; // 下标和 threadPool_->getAllLoops() 一致, start()之后不再变
+
+    // 指标, 标签 server="name_"
+    ConnectionMetrics connectionMetrics_; // 拷给每个连接
+    Counter openedMetric_;
+    Counter connectionsMetric_;
+    Counter closedMetric_;
+    std::vector<uint64_t> metricCallbacks_; // 回调 gauge 捕获了 this, 析构时先注销
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+// 一个定时任务: 到期时间 + 回调 + 重复间隔(秒), 只在所属 loop 线程中被 TimerQueue 访问
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++numCreated_)
+    {
+    }
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器到期后, 以本次触发时间为基准重新计算下次到期时间
+    void restart(Timestamp now)
+    {
+        expiration_ = repeat_ ? addTime(now, interval_) : Timestamp();
+    }
+
+    static int64_t numCreated() { return numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;
+    const bool repeat_;
+    const int64_t sequence_;
+
+    inline static std::atomic<int64_t> numCreated_{0};
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * 定时器的句柄, 只用于 EventLoop::cancel.
+ * 原版存 Timer* + sequence, 这里只存全局唯一的 sequence, TimerQueue 用它查表, 不会碰到悬空指针.
+ **/
+class TimerId
+{
+public:
+    TimerId() = default;
+    explicit TimerId(int64_t sequence) noexcept : sequence_(sequence) {}
+
+    int64_t sequence() const noexcept { return sequence_; }
+    bool valid() const noexcept { return sequence_ > 0; }
+
+private:
+    int64_t sequence_ = 0;
+};
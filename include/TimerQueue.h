@@ -0,0 +1,59 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+class EventLoop;
+class Timer;
+
+/**
+ * 基于 timerfd 的定时器队列: 所有定时器按到期时间排序, timerfd 只设置成最早的那个,
+ * 到期后 timerfd 可读, 和普通 Channel 一样走 epoll_wait -> handleEvent, 不需要给 poll 算超时时间.
+ **/
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全, 通常从别的线程调用. interval > 0 表示重复定时器
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // 线程安全
+    void cancel(TimerId timerId);
+
+    size_t size() const { return timers_.size(); }
+
+private:
+    // 原版用 set<pair<Timestamp, Timer*>> + 裸指针并标了 FIXME, 这里 key 用 (到期时间, sequence), value 持有所有权
+    using Entry = std::pair<Timestamp, int64_t>;
+    using TimerList = std::map<Entry, std::unique_ptr<Timer>>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd 可读时的回调
+    void handleRead();
+    // 取出所有已到期的定时器
+    std::vector<std::unique_ptr<Timer>> getExpired(Timestamp now);
+    void reset(std::vector<std::unique_ptr<Timer>> &expired, Timestamp now);
+    bool insert(std::unique_ptr<Timer> timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_; // 按到期时间排序
+
+    // cancel 用: sequence -> 到期时间, 用来在 timers_ 中定位
+    std::unordered_map<int64_t, Timestamp> activeTimers_;
+    bool callingExpiredTimers_;
+    // 在到期回调里取消自己(或同批次的重复定时器), 不能再 restart
+    std::unordered_set<int64_t> cancelingTimers_;
+};
@@ -1,16 +1,48 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 class Timestamp
 {
 public:
+    inline static constexpr int64_t kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp() = default;
     explicit Timestamp(int64_t microSecondsSinceEpoch) noexcept
         : microSecondsSinceEpoch_(microSecondsSinceEpoch) {}
     static Timestamp now(); // 静态工厂方法, now() 的职责是创造一个新的 Timestamp 对象，它在调用时根本还没有实例存在
+    // CLOCK_REALTIME_COARSE: 不到 now() 一半的开销, 精度只有一个 tick(通常 1~4ms), 适合超时/空闲检测这种粗粒度判断.
+    // loop 线程里要"本轮的时间"直接用 EventLoop::pollReturnTime(), 连系统调用都省了
+    static Timestamp coarseNow();
     std::string toString() const;
+    // "2025/01/01 12:00:00.123456" 直接写进 buf, 返回长度(不含'\0'); 年月日时分秒每个线程按秒缓存, 同一秒内不再调 localtime_r
+    size_t formatTo(char *buf, size_t size) const;
+    inline static constexpr size_t kFormattedSize = 26;
+
+    int64_t microSecondsSinceEpoch() const noexcept { return microSecondsSinceEpoch_; }
+    bool valid() const noexcept { return microSecondsSinceEpoch_ > 0; } // 默认构造的是无效时间
+
+    // 原版用 boost::less_than_comparable 生成, 这里只写定时器用到的两个
+    friend bool operator<(Timestamp lhs, Timestamp rhs) noexcept
+    { return lhs.microSecondsSinceEpoch_ < rhs.microSecondsSinceEpoch_; }
+    friend bool operator==(Timestamp lhs, Timestamp rhs) noexcept
+    { return lhs.microSecondsSinceEpoch_ == rhs.microSecondsSinceEpoch_; }
 
 private:
     int64_t microSecondsSinceEpoch_ = 0;
 };
+
+// 时间差, 单位秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// timestamp + seconds
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "TscClock.h"
+
+/**
+ * 事件追踪, 查尾延迟用. 打开后 EventLoop/Channel/pendingFunctors/TcpConnection 收发都往本线程的环形缓冲区里写
+ * 开始/结束事件, 需要时 dump 成 Chrome trace JSON, 用 chrome://tracing 或 ui.perfetto.dev 打开就是一条时间线.
+ * 跨线程的 queueInLoop 会记一对 flow 事件, 时间线上能看到 worker => runInLoop => sendInLoop 的箭头.
+ *
+ *   Tracer::setEnabled(true);
+ *   ...
+ *   Tracer::dump("/tmp/muduo.trace.json");      // 或 Tracer::dumpOnSignal(SIGUSR2, "/tmp/muduo")
+ *
+ * 关着的时候每个埋点只是一次 relaxed load + 一个不跳的分支. 开着的时候一个事件是一次 rdtsc + 三个 relaxed store,
+ * 不加锁不分配. 每个线程只保留最近 kEventsPerThread 个事件, 写满了覆盖最旧的.
+ * 事件名必须是字符串字面量(或者别的静态存储的字符串), 缓冲区里只存指针.
+ **/
+class Tracer : noncopyable
+{
+public:
+    inline static constexpr size_t kEventsPerThread = 64 * 1024; // 2 的幂, 每个线程 1.5MB, 第一次记事件时才分配
+    inline static constexpr size_t kMaxRetiredThreads = 16;      // 已退出线程的缓冲区最多留这么多个, 再多就释放最早的
+
+    static void setEnabled(bool on);
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // 'B' 开始, 'E' 结束, 'i' 瞬时事件, 's'/'f' 一对跨线程的 flow(同一个 id)
+    static void record(char phase, const char *name, uint64_t arg)
+    {
+        Ring *ring = t_ring;
+        if (__builtin_expect(ring == nullptr, 0))
+        {
+            ring = registerThread();
+        }
+        ring->push(phase, name, arg);
+    }
+
+    static void instant(const char *name, uint64_t arg = 0)
+    {
+        if (enabled())
+        {
+            record('i', name, arg);
+        }
+    }
+
+    // flow 的 id, 全局唯一, 同一对 's'/'f' 用同一个
+    static uint64_t newFlowId() { return nextFlowId_.fetch_add(1, std::memory_order_relaxed); }
+
+    // 把所有线程(包括已经退出的)缓冲区里的事件写成 Chrome trace JSON. 任意线程可调, 写的同时别的线程照常记录
+    static bool dump(const std::string &path);
+    // 收到 signo 时 dump 到 "pathPrefix.<pid>.<时间>.json". 信号处理函数只往管道里写一个字节, 真正的 dump 在后台线程里做
+    static void dumpOnSignal(int signo, const std::string &pathPrefix);
+
+private:
+    struct Ring
+    {
+        struct Slot
+        {
+            std::atomic<uint64_t> ticks{0};
+            std::atomic<const char *> name{nullptr};
+            std::atomic<uint64_t> phaseArg{0}; // 高 8 位 phase, 低 56 位 arg
+        };
+
+        void push(char phase, const char *name, uint64_t arg)
+        {
+            const uint64_t index = head.load(std::memory_order_relaxed);
+            Slot &slot = slots[index & (kEventsPerThread - 1)];
+            slot.ticks.store(TscClock::now(), std::memory_order_relaxed);
+            slot.name.store(name, std::memory_order_relaxed);
+            slot.phaseArg.store((static_cast<uint64_t>(static_cast<unsigned char>(phase)) << 56) | (arg & kArgMask),
+                                std::memory_order_relaxed);
+            head.store(index + 1, std::memory_order_release);
+        }
+
+        inline static constexpr uint64_t kArgMask = (uint64_t(1) << 56) - 1;
+
+        std::atomic<uint64_t> head{0};
+        int tid = 0;
+        std::string threadName;
+        std::unique_ptr<Slot[]> slots;
+        bool retired = false; // 线程已退出, 受 ringsMutex_ 保护
+    };
+
+    static Ring *registerThread();
+    static void retireThread(Ring *ring);
+
+    inline static std::atomic<bool> enabled_{false};
+    inline static std::atomic<uint64_t> nextFlowId_{1};
+    inline static thread_local Ring *t_ring = nullptr;
+    // 已经退出的线程的缓冲区也留着(最多 kMaxRetiredThreads 个), dump 的时候还能看到它们最后做了什么
+    inline static std::mutex ringsMutex_;
+    inline static std::vector<std::shared_ptr<Ring>> rings_;
+};
+
+/**
+ * 作用域埋点: 构造时记 'B', 析构时记 'E'. 构造时没打开追踪, 析构时也不记, 保证 B/E 成对.
+ * setArg 的值记在 'E' 上(比如读到多少字节, 开始的时候还不知道)
+ **/
+class TraceScope : noncopyable
+{
+public:
+    explicit TraceScope(const char *name, uint64_t arg = 0)
+        : name_(Tracer::enabled() ? name : nullptr)
+        , arg_(arg)
+    {
+        if (name_)
+        {
+            Tracer::record('B', name_, arg_);
+        }
+    }
+    ~TraceScope()
+    {
+        if (name_)
+        {
+            Tracer::record('E', name_, arg_);
+        }
+    }
+
+    void setArg(uint64_t arg) { arg_ = arg; }
+
+private:
+    const char *name_;
+    uint64_t arg_;
+};
+
+#define MUDUO_TRACE_CONCAT_IMPL(a, b) a##b
+#define MUDUO_TRACE_CONCAT(a, b) MUDUO_TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope MUDUO_TRACE_CONCAT(traceScope_, __LINE__)(name)
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * 基于 TSC 的单调时钟, 只用来量延迟(两个 now() 相减), 不能当墙上时间.
+ * rdtsc 大约 20 个周期, 比 clock_gettime 的 vDSO 调用便宜, 每个回调前后各打一次点也不心疼.
+ *
+ * 第一次用之前调 calibrate()(进程启动时一次, 会睡 calibrateMs 毫秒): 用 CLOCK_MONOTONIC 测出 TSC 频率.
+ * CPU 不支持 invariant TSC(频率随降频变化/各核不同步)或不是 x86 时, 自动退回 CLOCK_MONOTONIC,
+ * 调用方不用关心, ticks 的单位变成纳秒而已.
+ **/
+class TscClock
+{
+public:
+    static void calibrate(int calibrateMs = 10);
+    // 多个使用者(EventLoop 统计、Tracer)各自打开时都调这个, 整个进程只校准一次, 避免中途换算比例变了
+    static void calibrateOnce();
+    static bool usingTsc() { return usingTsc_.load(std::memory_order_acquire); }
+
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (usingTsc_.load(std::memory_order_acquire))
+        {
+            return __rdtsc();
+        }
+#endif
+        timespec ts{};
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    static double ticksPerNanosecond() { return ticksPerNanosecond_.load(std::memory_order_relaxed); }
+    static int64_t toNanoseconds(uint64_t ticks)
+    {
+        return static_cast<int64_t>(static_cast<double>(ticks) * nanosecondsPerTick_.load(std::memory_order_relaxed));
+    }
+    static int64_t toMicroseconds(uint64_t ticks) { return toNanoseconds(ticks) / 1000; }
+    static uint64_t fromNanoseconds(int64_t ns)
+    {
+        return static_cast<uint64_t>(static_cast<double>(ns) * ticksPerNanosecond_.load(std::memory_order_relaxed));
+    }
+
+private:
+    // 没校准之前 ticks 就是纳秒(CLOCK_MONOTONIC).
+    // 校准在某个线程里做, 别的线程同时在 now()/toNanoseconds(): 先写比例, 最后 release 写 usingTsc_,
+    // now() acquire 读到 true 之后再换算, 一定看得到对应的比例. x86 上这些 load 就是普通 mov
+    inline static std::atomic<bool> usingTsc_{false};
+    inline static std::atomic<double> ticksPerNanosecond_{1.0};
+    inline static std::atomic<double> nanosecondsPerTick_{1.0};
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Histogram.h"
+#include "InetAddress.h"
+#include "Metrics.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+
+class Buffer;
+class EventLoop;
+class TcpClient;
+
+/**
+ * 后端连接池, 网关调几百个后端时用: 按后端地址分组, 连接复用, 一条连接上可以流水线(pipelining)发多个请求.
+ *
+ * 每个 loop 一份独立的池子(和 TcpServer 的连接分片一个思路): 请求在哪个 loop 里发, 就用这个 loop 自己的连接,
+ * 响应回调也在这个 loop 里执行, 热路径上没有锁也没有跨线程. 代价是同一个后端每个 loop 各有一组连接,
+ * 下面的上限都是"每个 loop 每个后端".
+ *
+ * 池子不懂协议, 只要求请求/响应一一对应、按发送顺序返回(HTTP/1.1、Redis、memcached 文本协议都是这样),
+ * 用户给一个 ResponseParser 告诉它 Buffer 开头是不是一个完整的响应、有多长.
+ *
+ *   UpstreamPool pool(server.loops(), "redis", [](const Buffer *buf) -> ssize_t { ... }, options);
+ *   // 在某个 io loop 的回调里:
+ *   pool.request(InetAddress(6379, "10.0.0.8"), "PING\r\n", [](UpstreamPool::Status s, const char *data, size_t len) { ... });
+ *
+ * 连接选择: 优先空闲连接; 都忙时挑在途最少的那条流水线发, 同时(没到上限的话)新开一条, 后面的请求就能分过去.
+ * 所有连接的流水线都满, 或者在途请求到了 maxInFlightPerBackend, 请求排队, 有响应回来就补发; 队列也满了直接 kOverloaded.
+ *
+ * 每个 loop 一个巡检定时器:
+ *   - 排队/在途请求超过 requestTimeout 就失败(kTimeout). 流水线上没法跳过一个响应, 队头超时的连接直接关掉, 上面的请求都 kTimeout;
+ *   - 空闲超过 idleTimeout 的连接关掉(连接中/重连退避中的也算);
+ *   - 配了 healthCheckRequest 的话, 空闲超过 healthCheckInterval 的连接发一个探测请求, requestTimeout 内没回就关掉.
+ *     对端关闭/RST 不用等探测, 空闲连接一直在 epoll 里, 马上就会走关闭流程摘掉.
+ *
+ * 析构可以在任意线程, 但所有 loop 必须还在运行(和 TcpClient 一样, 要到每个 loop 线程里拆掉连接).
+ * 析构时还没完成的请求以 kClosed 回调.
+ **/
+class UpstreamPool : noncopyable
+{
+public:
+    enum class Status
+    {
+        kOk,
+        kClosed,        // 连接断了(对端关闭、连接失败后被回收、池子析构)
+        kTimeout,       // 超过 requestTimeout
+        kOverloaded,    // 排队队列满
+        kProtocolError, // parser 返回负数, 或者没有在途请求时收到了数据
+    };
+    static const char *statusName(Status status);
+
+    // 看 buf 开头: 返回一个完整响应的字节数, 0 表示还不完整, 负数表示协议错误(连接会被关闭). 不要改 buf
+    using ResponseParser = std::function<ssize_t(const Buffer *buf)>;
+    // 在发起请求的 loop 线程里执行. status != kOk 时 data/len 为空. data 只在回调期间有效
+    using ResponseCallback = std::function<void(Status status, const char *data, size_t len)>;
+
+    struct Options
+    {
+        size_t maxConnectionsPerBackend = 4;  // 池子大小
+        size_t maxPipelineDepth = 16;         // 一条连接上最多几个在途请求, 1 表示不流水线
+        size_t maxInFlightPerBackend = 256;   // 已经发出去还没回的
+        size_t maxQueuedPerBackend = 1024;    // 发不出去排队的
+        double requestTimeout = 1.0;          // 秒, 从 request() 算起, 排队的时间也算
+        double idleTimeout = 60.0;
+        double healthCheckInterval = 10.0;
+        std::string healthCheckRequest;       // 空表示不发探测, 只做空闲回收
+    };
+
+    // loops 通常是 TcpServer::loops(), 构造之后不能再变
+    UpstreamPool(const std::vector<EventLoop *> &loops, const std::string &name, ResponseParser parser, Options options);
+    UpstreamPool(const std::vector<EventLoop *> &loops, const std::string &name, ResponseParser parser); // 默认 Options
+    ~UpstreamPool();
+
+    // 只能在 loops 里的某个 loop 线程中调用. callback 不会在 request() 里面同步执行
+    void request(const InetAddress &backend, std::string request, ResponseCallback callback);
+    // 线程安全: 投递到指定的 loop 里发, 回调也在那个 loop 里执行
+    void request(EventLoop *loop, const InetAddress &backend, std::string request, ResponseCallback callback);
+
+    // 从 request() 到响应回调的延迟(微秒), 只统计 kOk 的, 各 loop 合并. 线程安全
+    Histogram::Snapshot latencySnapshot() const;
+    // 每个 loop 每个后端: 连接数/在途/排队, 文本格式, 诊断用. 逐个 loop 切进去取, 会等; 别在池子的 loop 线程里调用(两个 loop 互相等就死锁了)
+    std::string report() const;
+
+    const std::string &name() const { return name_; }
+
+private:
+    struct LoopPool;
+    struct Backend;
+    struct Conn;
+    using ConnPtr = std::shared_ptr<Conn>;
+
+    struct Pending
+    {
+        ResponseCallback callback; // 空的是健康探测
+        Timestamp deadline;
+        uint64_t startTicks;
+    };
+
+    struct Waiting
+    {
+        std::string request;
+        ResponseCallback callback;
+        Timestamp deadline;
+        uint64_t startTicks;
+    };
+
+    struct Conn
+    {
+        Backend *backend;
+        std::unique_ptr<TcpClient> client;
+        // 声明在 client 之后, 先于 client 析构: TcpClient 析构时发现连接只剩自己持有才会 forceClose
+        TcpConnectionPtr connection; // 连上之前为空
+        std::deque<Pending> pending;
+        Timestamp lastUsed;   // 最近一次发真实请求, 判断空闲回收
+        Timestamp lastActive; // 最近一次有收发(含探测), 判断该不该探测
+        bool retired = false; // 已经从 backend 摘下来, 迟到的回调一律忽略
+    };
+
+    struct Backend
+    {
+        LoopPool *owner;
+        InetAddress addr;
+        std::vector<ConnPtr> conns;
+        std::deque<Waiting> waiting;
+        size_t inFlight = 0; // 不含健康探测
+    };
+
+    struct LoopPool
+    {
+        EventLoop *loop;
+        std::unordered_map<uint64_t, std::unique_ptr<Backend>> backends; // key: ip << 16 | port
+        TimerId sweepTimer;
+        Histogram latencyUs;
+    };
+
+    LoopPool *localPool(EventLoop *loop) const;
+    Backend &backendFor(LoopPool &lp, const InetAddress &addr);
+    void requestInLoop(LoopPool &lp, const InetAddress &addr, std::string &&request, ResponseCallback &&callback);
+    // 挑一条连接发出去, 没有能发的返回 false(可能顺手新开了一条连接)
+    bool trySend(Backend &backend, const std::string &request, ResponseCallback &callback, Timestamp deadline, uint64_t startTicks);
+    void sendOn(Conn &conn, const std::string &request, Pending pending);
+    void drainWaiting(Backend &backend);
+    void newConn(Backend &backend);
+    void onConnection(const ConnPtr &conn, const TcpConnectionPtr &connection);
+    void onMessage(const ConnPtr &conn, Buffer *buf);
+    // 摘掉连接, 在途请求全部以 status 失败; 连接本身放到 pendingFunctors 里析构(可能正在它自己的回调里)
+    void retire(const ConnPtr &conn, Status status);
+    void fail(Backend &backend, ResponseCallback &callback, Status status);
+    void sweep(LoopPool &lp);
+    void teardown(LoopPool &lp);
+
+    const std::string name_;
+    const ResponseParser parser_;
+    const Options options_;
+    std::vector<std::unique_ptr<LoopPool>> loopPools_; // 构造后不再变, 跨线程只读
+
+    Counter requestsMetric_[5]; // 按 Status
+    Counter connectionsMetric_;
+    Counter connectsMetric_;
+};
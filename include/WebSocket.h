@@ -0,0 +1,116 @@
+#pragma once
+
+#include <any>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Timestamp.h"
+
+class Buffer;
+class WebSocket;
+using WebSocketPtr = std::shared_ptr<WebSocket>;
+
+/**
+ * 一条 WebSocket 连接(RFC 6455, 服务端). 由 WebSocketServer 在升级成功时创建, 挂在它的消息回调里, 连接断开时释放.
+ *
+ * 收: 直接在 inputBuffer_ 里解帧. 客户端的帧都带掩码, 用 SIMD 异或原地解掩码(unmask), 不拷出来;
+ *     不分片的消息回调拿到的 string_view 就指向 inputBuffer_, 回调返回后失效. 分片的消息拼到 fragments_ 里,
+ *     中间穿插的控制帧(ping/pong/close)照常处理. 文本消息校验 UTF-8.
+ * 发: 帧头写在栈上, 和负载一次 writev(TcpConnection::sendv); 广播用 makeFrame 把帧头补进负载 Buffer 的
+ *     prependable 区, 一帧构造一次, 所有连接共享同一份字节(shared_ptr), 不按连接拷贝负载.
+ * 保活: WebSocketServer 每个 loop 一个定时器扫一遍, 一段时间没收到任何帧就 ping, 超时没回 pong 就关.
+ *
+ * 发送接口任意线程可调(跨线程时投递到连接的 loop), 其余只在连接的 loop 线程里用.
+ **/
+class WebSocket : noncopyable
+{
+public:
+    enum class Opcode : uint8_t
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    // 常用的关闭码
+    inline static constexpr uint16_t kNormalClosure = 1000;
+    inline static constexpr uint16_t kGoingAway = 1001;
+    inline static constexpr uint16_t kProtocolError = 1002;
+    inline static constexpr uint16_t kInvalidPayload = 1007;
+    inline static constexpr uint16_t kPolicyViolation = 1008;
+    inline static constexpr uint16_t kMessageTooBig = 1009;
+    inline static constexpr uint16_t kInternalError = 1011;
+
+    // 服务端帧头最长 10 字节(不带掩码), 不超过 Buffer::kCheapPrepend
+    inline static constexpr size_t kMaxHeaderBytes = 10;
+
+    // payload 只在回调期间有效
+    using MessageCallback = std::function<void(const WebSocketPtr &, std::string_view payload, Opcode opcode)>;
+
+    struct Options
+    {
+        size_t maxMessageBytes = 1024 * 1024; // 单条消息(分片拼起来)的上限, 超过回 1009 关闭
+    };
+
+    WebSocket(const TcpConnectionPtr &conn, const Options &options, MessageCallback messageCallback);
+
+    // 文本/二进制消息, 一帧发完. 连接已断开或已经发过 close 时返回 false
+    bool send(std::string_view payload, Opcode opcode = Opcode::kText);
+    // makeFrame 构造好的整帧, 可以发给任意多个连接
+    bool sendFrame(const std::shared_ptr<const Buffer> &frame);
+    void ping(std::string_view payload = {});
+    // 发 close 帧然后半关闭. 之后 send 都返回 false
+    void close(uint16_t code = kNormalClosure, std::string_view reason = {});
+
+    uint64_t id() const { return id_; }
+    TcpConnectionPtr connection() const { return conn_.lock(); }
+    bool connected() const;
+
+    // 用户数据(比如订阅了哪些频道), 只在连接的 loop 线程里访问
+    void setContext(std::any context) { context_ = std::move(context); }
+    std::any *getMutableContext() { return &context_; }
+
+    // 把 payload 原样放进一个 Buffer, 帧头 prepend 到前面, 整帧只构造一次
+    static std::shared_ptr<const Buffer> makeFrame(std::string_view payload, Opcode opcode = Opcode::kText);
+    // 同上, 负载已经在 payload 里(比如直接往 Buffer 里序列化的), 帧头补进它的 prependable 区, 负载不挪
+    static std::shared_ptr<const Buffer> makeFrame(Buffer &&payload, Opcode opcode = Opcode::kText);
+    // 写服务端帧头(FIN=1, 不带掩码), 返回字节数(2/4/10). out 至少 kMaxHeaderBytes
+    static size_t writeHeader(char *out, Opcode opcode, size_t payloadLen);
+    // data[i] ^= mask[i % 4], 原地. 按 CPU 选 AVX2/SSE2/标量
+    static void unmask(char *data, size_t len, const uint8_t mask[4]);
+
+private:
+    friend class WebSocketServer;
+
+    // 连接上的消息回调, 解出所有完整的帧. self 就是 this, 回调里要交给用户
+    void onMessage(const WebSocketPtr &self, const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    // 返回 false 表示连接要关了, 别再解后面的帧
+    bool handleFrame(const WebSocketPtr &self, const TcpConnectionPtr &conn, Opcode opcode, bool fin, char *payload, size_t len);
+    bool deliver(const WebSocketPtr &self, const TcpConnectionPtr &conn, std::string_view payload, Opcode opcode);
+    void fail(const TcpConnectionPtr &conn, uint16_t code);
+    void sendControl(const TcpConnectionPtr &conn, Opcode opcode, std::string_view payload);
+
+    const std::weak_ptr<TcpConnection> conn_;
+    const uint64_t id_;
+    const Options options_;
+    MessageCallback messageCallback_;
+
+    std::string fragments_;     // 分片消息拼在这儿, 容量复用
+    Opcode fragmentOpcode_ = Opcode::kContinuation; // kContinuation 表示没有进行中的分片消息
+    std::atomic<bool> closeSent_{false};
+    std::any context_;
+
+    // 保活, 只在 loop 线程里读写
+    Timestamp lastReceive_;
+    Timestamp pingSentAt_;
+    bool awaitingPong_ = false;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "noncopyable.h"
+#include "HttpServer.h"
+#include "Metrics.h"
+#include "TimerId.h"
+#include "WebSocket.h"
+
+/**
+ * WebSocket 服务端: HttpServer 上挂一个升级回调. 普通 HTTP 请求照常走 HttpCallback(同一个端口可以同时提供
+ * 健康检查之类的接口), 带 Upgrade: websocket 的请求在这里握手, 回 101, 之后这条连接交给 WebSocket 解帧.
+ *
+ *   WebSocketServer server(&loop, InetAddress(8080), "push");
+ *   server.setOpenCallback([](const WebSocketPtr &ws, const HttpRequest &req) { ... });
+ *   server.setMessageCallback([](const WebSocketPtr &ws, std::string_view msg, WebSocket::Opcode op) { ws->send(msg, op); });
+ *   server.setThreadNum(4);
+ *   server.start();
+ *   ...
+ *   server.broadcast("{\"event\":\"tick\"}"); // 任意线程
+ *
+ * 每个 io loop 一张自己的连接表(和 UpstreamPool 一样按 loop 分片), 增删都在本 loop 线程里, 不加锁.
+ * broadcast 只构造一帧(WebSocket::makeFrame), 给每个 loop 投递一个任务, 任务里把同一个 shared_ptr<Buffer> 发给本 loop
+ * 的所有连接, 负载不按连接拷贝.
+ * 保活: 每个 loop 每秒扫一遍自己的表, pingInterval 内没收到任何帧的发 ping, ping 之后 pongTimeout 内还没动静的直接断开.
+ *
+ * 析构可以在任意线程, 但所有 loop 必须还在运行(要到每个 loop 线程里取消定时器、清空连接表).
+ **/
+class WebSocketServer : noncopyable
+{
+public:
+    // 握手成功、101 已经发出之后. 可以在这里 setContext、ws->send
+    using OpenCallback = std::function<void(const WebSocketPtr &, const HttpRequest &)>;
+    using CloseCallback = std::function<void(const WebSocketPtr &)>;
+
+    WebSocketServer(EventLoop *loop,
+                    const InetAddress &listenAddr,
+                    const std::string &name,
+                    TcpServer::Option option = TcpServer::Option::kNoReusePort);
+    ~WebSocketServer();
+
+    // 以下在 start() 之前调用
+    void setOpenCallback(OpenCallback cb) { openCallback_ = std::move(cb); }
+    void setMessageCallback(WebSocket::MessageCallback cb) { messageCallback_ = std::move(cb); }
+    void setCloseCallback(CloseCallback cb) { closeCallback_ = std::move(cb); }
+    void setThreadNum(int numThreads) { httpServer_.setThreadNum(numThreads); }
+    void setMaxMessageBytes(size_t bytes) { options_.maxMessageBytes = bytes; }
+    // 0 表示不发 ping
+    void setPingInterval(double seconds) { pingInterval_ = seconds; }
+    void setPongTimeout(double seconds) { pongTimeout_ = seconds; }
+    // 非升级请求的处理, HttpCallback 之类的在这上面设
+    HttpServer &httpServer() { return httpServer_; }
+
+    // 在 baseLoop 里完成启动(不在 baseLoop 线程时投递过去), 保证开始 accept 之前每个 loop 的连接表都建好了
+    void start();
+
+    // 线程安全. start() 之前调用什么也不做
+    void broadcast(std::string_view payload, WebSocket::Opcode opcode = WebSocket::Opcode::kText);
+    // 已经构造好的帧(WebSocket::makeFrame)
+    void broadcast(const std::shared_ptr<const Buffer> &frame);
+
+    // 当前连接数, 各 loop 合并. 线程安全
+    int64_t connectionCount() const { return connections_.value(); }
+
+private:
+    struct LoopState
+    {
+        EventLoop *loop = nullptr;
+        std::unordered_map<uint64_t, WebSocketPtr> sockets; // 键是 TcpConnection::id()
+        TimerId sweepTimer;
+    };
+
+    void startInLoop();
+    LoopState *localState(EventLoop *loop) const;
+    MessageCallback onUpgrade(const TcpConnectionPtr &conn, const HttpRequest &request);
+    void onConnection(const TcpConnectionPtr &conn);
+    void sweep(LoopState &state);
+
+    EventLoop *loop_;
+    const std::string name_;
+    WebSocket::Options options_;
+    OpenCallback openCallback_;
+    WebSocket::MessageCallback messageCallback_;
+    CloseCallback closeCallback_;
+    double pingInterval_ = 30.0;
+    double pongTimeout_ = 10.0;
+
+    std::vector<std::unique_ptr<LoopState>> loopStates_; // startInLoop 之后不再变, 跨线程只读
+    std::atomic<bool> started_{false};                   // loopStates_ 建好了, 给 broadcast 看的
+
+    Counter connections_;
+    Counter handshakeFailures_;
+
+    // 放在最后: 最先析构, TcpServer 拆连接时回调到 onConnection, 上面的成员都还在
+    HttpServer httpServer_;
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "EventLoop.h"
+
+/**
+ * Chase-Lev 无锁双端队列 (Chase & Lev, SPAA'05; 内存序取自 Lê et al., PPoPP'13)
+ * 属主线程在 bottom 端 push/pop (LIFO, 刚压入的任务还在cache里), 其他线程从 top 端 steal (FIFO).
+ * T 必须是指针类型, 空队列/偷取竞争失败统一返回 nullptr.
+ **/
+template <typename T>
+class ChaseLevDeque : noncopyable
+{
+    static_assert(std::is_pointer_v<T>, "ChaseLevDeque only stores pointers");
+
+public:
+    explicit ChaseLevDeque(size_t capacity = 256)
+        : top_(0)
+        , bottom_(0)
+        , array_(new Array(roundUpPowerOfTwo(capacity)))
+    {
+        garbage_.emplace_back(array_.load(std::memory_order_relaxed));
+    }
+
+    // 只能由属主线程调用
+    void push(T item)
+    {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_acquire);
+        Array *a = array_.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->capacity) - 1) // 满了, 扩容
+        {
+            a = a->grow(t, b);
+            garbage_.emplace_back(a); // 旧数组不能立即释放, 偷取线程可能还在读, 统一到析构时释放
+            array_.store(a, std::memory_order_release);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 只能由属主线程调用
+    T pop()
+    {
+        const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        T item = nullptr;
+        if (t <= b)
+        {
+            item = a->get(b);
+            if (t == b) // 只剩最后一个, 和偷取者抢
+            {
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 任意线程都可以调用
+    T steal()
+    {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t < b)
+        {
+            Array *a = array_.load(std::memory_order_acquire);
+            T item = a->get(t);
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            return item;
+        }
+        return nullptr;
+    }
+
+    // 近似值, 只用于统计和"是否值得去偷"的判断
+    size_t sizeApprox() const
+    {
+        const int64_t b = bottom_.load(std::memory_order_relaxed);
+        const int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(size_t cap)
+            : capacity(cap)
+            , mask(cap - 1)
+            , slots(new std::atomic<T>[cap])
+        {
+        }
+
+        T get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T item) { slots[i & mask].store(item, std::memory_order_relaxed); }
+
+        Array *grow(int64_t top, int64_t bottom) const
+        {
+            Array *a = new Array(capacity * 2);
+            for (int64_t i = top; i != bottom; ++i)
+            {
+                a->put(i, get(i));
+            }
+            return a;
+        }
+
+        const size_t capacity;
+        const size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    static size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t cap = 1;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    // top_ 被所有偷取者争抢, bottom_ 只有属主写, 分到不同 cache line 避免伪共享
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    alignas(64) std::atomic<Array *> array_;
+    std::vector<std::unique_ptr<Array>> garbage_; // 只有属主线程在push中修改
+};
+
+/**
+ * 计算线程池, 给 onMessage 里的耗时计算用, 不要在 subReactor 里阻塞.
+ * 每个 worker 一个 Chase-Lev 队列: worker 内部派生的子任务压自己的队列, 空闲时去别人队列尾部偷;
+ * IO 线程(非 worker)提交的任务先进注入队列, 由 worker 批量领取.
+ *
+ * 典型用法(onMessage 中):
+ *     pool.offload(conn->getLoop(),
+ *                  [msg] { return heavyCompute(msg); },              // worker 线程
+ *                  [conn](std::string result) { conn->send(result); }); // 回到 conn 所在的 subLoop
+ **/
+class WorkStealingPool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(const std::string &nameArg = "WorkStealingPool");
+    ~WorkStealingPool();
+
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    void start();
+    // 等待已提交的任务执行完再退出
+    void stop();
+
+    // 线程安全. 在 worker 线程中调用时直接压入自己的队列, 不走锁.
+    // stop() 之后从外部提交的任务不会执行, 记一条 ERROR 返回 false(任务直接析构, 不会泄漏)
+    bool submit(Task task);
+
+    /**
+     * 在池中执行 work, 完成后把 continuation 投递回 loop 所在线程执行(queueInLoop, 不是 runInLoop).
+     * work 有返回值时 continuation 以返回值为参数; 返回值要求可拷贝(Functor 是 std::function).
+     * 池已经 stop() 时返回 false, work 和 continuation 都不会执行, 调用方自己回错误.
+     **/
+    template <typename Work, typename Continuation>
+    bool offload(EventLoop *loop, Work &&work, Continuation &&continuation)
+    {
+        using Result = std::invoke_result_t<std::decay_t<Work>>;
+        return submit([loop,
+                work = std::forward<Work>(work),
+                continuation = std::forward<Continuation>(continuation)]() mutable {
+            if constexpr (std::is_void_v<Result>)
+            {
+                work();
+                loop->queueInLoop(std::move(continuation));
+            }
+            else
+            {
+                loop->queueInLoop([continuation = std::move(continuation), result = work()]() mutable {
+                    continuation(std::move(result));
+                });
+            }
+        });
+    }
+
+    const std::string &name() const { return name_; }
+    size_t numThreads() const { return workers_.size(); }
+    bool started() const { return started_; }
+    // 近似的排队任务数(注入队列 + 所有 worker 队列)
+    size_t pendingTasks() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        ChaseLevDeque<Task *> deque;
+        std::unique_ptr<Thread> thread;
+    };
+
+    void workerLoop(size_t index);
+    Task *findTask(size_t index);
+    void runTask(Task *task);
+    void notifyIfIdle();
+
+    inline static constexpr int kSpinRounds = 64; // 睡眠前的自旋偷取次数
+
+    std::string name_;
+    int numThreads_ = 0;
+    bool started_ = false;
+    std::atomic_bool stopping_{false};
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex injectMutex_;
+    std::deque<Task *> injectQueue_; // 非 worker 线程提交的任务
+
+    // 空闲 worker 的睡眠/唤醒. pending_ 与 idle_ 都用 seq_cst, 保证提交者和将要睡眠的 worker 至少一方看到对方.
+    std::atomic<size_t> pending_{0};
+    std::atomic<int> idle_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCond_;
+};
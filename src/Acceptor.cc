@@ -6,6 +6,7 @@
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "MemoryBudget.h"
 
 static int createNonblocking()
 {
@@ -33,6 +34,7 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     acceptChannel_.setReadCallback([this](Timestamp) { // std::bind的可读性真的垃圾.
         handleRead();
     });
+    acceptChannel_.setDescribeCallback([] { return std::string("acceptor"); });
 }
 
 Acceptor::~Acceptor()
@@ -41,6 +43,14 @@ Acceptor::~Acceptor()
     acceptChannel_.remove();        // 调用EventLoop->removeChannel => Poller->removeChannel 把Poller的ChannelMap对应的部分删除
 }
 
+void Acceptor::setMetricsLabels(const std::string &labels)
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    acceptedMetric_ = registry.counter("muduo_accepted_total", "Connections accepted by the listening socket", labels);
+    rejectedMetric_ = registry.counter("muduo_accept_rejected_total", "Accepted connections closed at once (memory budget)", labels);
+    errorsMetric_ = registry.counter("muduo_accept_errors_total", "accept() failures, e.g. EMFILE", labels);
+}
+
 void Acceptor::listen()
 {
     listenning_ = true;
@@ -56,6 +66,16 @@ void Acceptor::handleRead()
     int connfd = acceptSocket_.accept(&peerAddr);
     if (connfd >= 0)
     {
+        acceptedMetric_.inc();
+        MemoryBudget &budget = MemoryBudget::instance();
+        if ((budget.policy() & MemoryBudget::kRejectAccept) && budget.overBudget())
+        {
+            // 内存已经超预算, 新连接进来只会更糟. 先accept再close, 不然listenfd一直可读(LT模式)会空转
+            ::close(connfd);
+            budget.onRejectedAccept();
+            rejectedMetric_.inc();
+            return;
+        }
         if (NewConnectionCallback_) // 这个回调在TcpServer中, 这个很关键, 这个就是轮询分发给subReactor, 并不是main函数中设置的setConnectionCallback, 后者是在前者里面, 妙蛙, 梳理通了.
         {
             NewConnectionCallback_(connfd, peerAddr); // 轮询找到subLoop 唤醒并分发当前的新客户端的Channel
@@ -67,6 +87,7 @@ void Acceptor::handleRead()
     }
     else
     {
+        errorsMetric_.inc();
         LOG_ERROR("%s:%s:%d accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
         if (errno == EMFILE) // 文件描述符fd耗尽, 与inode耗尽(磁盘相关)完全不是一个概念
         { // 这里还有个优化点, 略, 不重要啊.
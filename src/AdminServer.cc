@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <future>
+#include <string_view>
+
+#include "AdminServer.h"
+#include "TcpServer.h"
+#include "Metrics.h"
+#include "Logger.h"
+
+namespace
+{
+    const char *statusText(int status)
+    {
+        switch (status)
+        {
+        case 200:
+            return "OK";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Unknown";
+        }
+    }
+}
+
+AdminServer::AdminServer(const InetAddress &listenAddr, const std::string &name)
+    : listenAddr_(listenAddr)
+    , name_(name)
+    , thread_({}, name)
+{
+    addHandler("/metrics", [](const std::string &, const Responder &respond) {
+        respond(200, "text/plain; version=0.0.4", MetricsRegistry::instance().scrape());
+    });
+}
+
+AdminServer::~AdminServer()
+{
+    if (loop_)
+    {
+        // TcpServer(里面的 Acceptor/Channel)必须在它自己的 loop 线程里析构. 等它析构完再让 thread_ 退出,
+        // 否则 quit 之后这个回调可能就没机会执行了
+        std::promise<void> done;
+        loop_->runInLoop([this, &done] {
+            server_.reset();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void AdminServer::start()
+{
+    loop_ = thread_.startLoop();
+    std::promise<void> started;
+    loop_->runInLoop([this, &started] {
+        server_ = std::make_unique<TcpServer>(loop_, listenAddr_, name_);
+        server_->setConnectionCallback([](const TcpConnectionPtr &) {});
+        server_->setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            onMessage(conn, buf);
+        });
+        server_->start();
+        started.set_value();
+    });
+    started.get_future().wait();
+    LOG_INFO("AdminServer [%s] listening on %s\n", name_.c_str(), listenAddr_.toIpPort().c_str());
+}
+
+void AdminServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf)
+{
+    if (!conn->connected())
+    {
+        buf->retrieveAll(); // 已经回过响应在 shutdown 了, 对端还在发的都丢掉, 别让 inputBuffer_ 一直涨
+        return;
+    }
+    std::string_view data(buf->peek(), buf->readableBytes());
+    const size_t headerEnd = data.find("\r\n\r\n");
+    if (headerEnd == std::string_view::npos)
+    {
+        if (data.size() > kMaxRequestSize)
+        {
+            buf->retrieveAll(); // 出错返回前都要清空, 否则对端接着发, 缓冲区一直涨
+            sendResponse(conn, 400, "text/plain", "request too large\n");
+        }
+        return; // 头还没收全
+    }
+
+    // 请求行: GET /path?query HTTP/1.1
+    const std::string_view requestLine = data.substr(0, data.find("\r\n"));
+    const size_t sp1 = requestLine.find(' ');
+    const size_t sp2 = requestLine.find(' ', sp1 + 1);
+    if (sp1 == std::string_view::npos || sp2 == std::string_view::npos)
+    {
+        buf->retrieveAll();
+        sendResponse(conn, 400, "text/plain", "bad request line\n");
+        return;
+    }
+    if (requestLine.substr(0, sp1) != "GET")
+    {
+        buf->retrieveAll();
+        sendResponse(conn, 405, "text/plain", "only GET is supported\n");
+        return;
+    }
+    std::string_view target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+    std::string query;
+    const size_t question = target.find('?');
+    if (question != std::string_view::npos)
+    {
+        query = std::string(target.substr(question + 1));
+        target = target.substr(0, question);
+    }
+    const std::string path(target);
+    buf->retrieveAll(); // 一个连接只处理一个请求
+
+    auto it = handlers_.find(path);
+    if (it == handlers_.end())
+    {
+        std::string body = "available paths:\n";
+        for (const auto &[p, h] : handlers_)
+        {
+            body += "  " + p + "\n";
+        }
+        sendResponse(conn, path == "/" ? 200 : 404, "text/plain", body);
+        return;
+    }
+    it->second(query, [conn](int status, const std::string &contentType, const std::string &body) {
+        sendResponse(conn, status, contentType, body);
+    });
+}
+
+void AdminServer::sendResponse(const TcpConnectionPtr &conn, int status, const std::string &contentType, const std::string &body)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    char header[256];
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+             status, statusText(status), contentType.c_str(), body.size());
+    conn->send(std::string(header) + body);
+    conn->shutdown();
+}
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "AsyncLogging.h"
+#include "LogFile.h"
+
+namespace
+{
+    size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t capacity = 4096;
+        while (capacity < n)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    // 线程退出时标记自己的环, 让后台线程写完剩下的数据后回收
+    struct LocalBufferHolder
+    {
+        const void *owner = nullptr;
+        std::shared_ptr<void> keepAlive;
+        std::atomic<bool> *abandoned = nullptr;
+
+        ~LocalBufferHolder()
+        {
+            if (abandoned)
+            {
+                abandoned->store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local LocalBufferHolder t_localBuffer;
+}
+
+AsyncLogging::AsyncLogging(const std::string &basename,
+                           off_t rollSize,
+                           int flushInterval,
+                           size_t bufferSize,
+                           OverflowPolicy policy)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , bufferSize_(roundUpPowerOfTwo(bufferSize))
+    , policy_(policy)
+    , thread_([this] { threadFunc(); }, "Logging")
+{
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    running_ = false;
+    wakeup();
+    thread_.join();
+}
+
+AsyncLogging::ThreadBuffer *AsyncLogging::localBuffer()
+{
+    LocalBufferHolder &holder = t_localBuffer;
+    if (__builtin_expect(holder.owner == this, 1))
+    {
+        return static_cast<ThreadBuffer *>(holder.keepAlive.get());
+    }
+
+    // 每个线程只走一次(一个进程一般只有一个 AsyncLogging)
+    auto buffer = std::make_shared<ThreadBuffer>(bufferSize_);
+    {
+        std::scoped_lock lock(mutex_);
+        buffers_.push_back(buffer);
+    }
+    if (holder.abandoned)
+    {
+        holder.abandoned->store(true, std::memory_order_release);
+    }
+    holder.owner = this;
+    holder.abandoned = &buffer->abandoned;
+    holder.keepAlive = buffer;
+    return buffer.get();
+}
+
+void AsyncLogging::append(const char *logline, size_t len, OverflowPolicy policy)
+{
+    ThreadBuffer *buf = localBuffer();
+    if (len > buf->capacity())
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t tail = buf->tail.load(std::memory_order_relaxed);
+    uint64_t head = buf->head.load(std::memory_order_acquire);
+    while (buf->capacity() - (tail - head) < len)
+    {
+        if (policy == kDrop || !running_.load(std::memory_order_relaxed))
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            wakeup();
+            return;
+        }
+        wakeup();
+        std::this_thread::yield();
+        head = buf->head.load(std::memory_order_acquire);
+    }
+
+    // 可能跨过环尾, 分两段拷
+    const size_t offset = tail & buf->mask;
+    const size_t first = std::min(len, buf->capacity() - offset);
+    memcpy(buf->data.get() + offset, logline, first);
+    memcpy(buf->data.get(), logline + first, len - first);
+    buf->tail.store(tail + len, std::memory_order_release);
+
+    // 过半才叫醒后台线程, 平时靠 flushInterval 超时醒来, 不在每条日志上 notify
+    if (tail + len - head > buf->capacity() / 2)
+    {
+        wakeup();
+    }
+}
+
+void AsyncLogging::wakeup()
+{
+    if (!signaled_.exchange(true, std::memory_order_acq_rel))
+    {
+        std::scoped_lock lock(mutex_);
+        cond_.notify_one();
+    }
+}
+
+void AsyncLogging::flush()
+{
+    if (!running_)
+    {
+        return;
+    }
+    std::unique_lock lock(mutex_);
+    const uint64_t ticket = ++flushRequested_;
+    signaled_.store(true, std::memory_order_release);
+    cond_.notify_one();
+    // 最多等一个刷新周期, 后台线程卡在磁盘上时不至于把 LOG_FATAL 也卡死
+    flushedCond_.wait_for(lock, std::chrono::seconds(flushInterval_ + 1), [&] {
+        return flushCompleted_ >= ticket || !running_;
+    });
+}
+
+bool AsyncLogging::drainInto(std::string &output)
+{
+    std::vector<ThreadBufferPtr> buffers;
+    {
+        std::scoped_lock lock(mutex_);
+        // 已退出且写完的线程的环在这里回收
+        buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), [](const ThreadBufferPtr &buf) {
+                           return buf->abandoned.load(std::memory_order_acquire)
+                               && buf->head.load(std::memory_order_relaxed) == buf->tail.load(std::memory_order_acquire);
+                       }),
+                       buffers_.end());
+        buffers = buffers_;
+    }
+
+    const size_t before = output.size();
+    for (const ThreadBufferPtr &buf : buffers)
+    {
+        const uint64_t head = buf->head.load(std::memory_order_relaxed);
+        const uint64_t tail = buf->tail.load(std::memory_order_acquire);
+        if (head == tail)
+        {
+            continue;
+        }
+        const size_t len = static_cast<size_t>(tail - head);
+        const size_t offset = head & buf->mask;
+        const size_t first = std::min(len, buf->capacity() - offset);
+        output.append(buf->data.get() + offset, first);
+        output.append(buf->data.get(), len - first);
+        buf->head.store(tail, std::memory_order_release);
+    }
+    return output.size() != before;
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_, 1024, fileHeader_);
+    std::string writeBuffer;
+    writeBuffer.reserve(4 * 1024 * 1024);
+
+    while (true)
+    {
+        uint64_t flushTicket = 0;
+        {
+            std::unique_lock lock(mutex_);
+            cond_.wait_for(lock, std::chrono::seconds(flushInterval_), [this] {
+                return signaled_.load(std::memory_order_acquire) || !running_.load(std::memory_order_acquire);
+            });
+            signaled_.store(false, std::memory_order_release);
+            flushTicket = flushRequested_;
+        }
+        const bool stopping = !running_.load(std::memory_order_acquire);
+
+        // 一直搬到所有环都空了为止, 搬运期间生产者可以继续往环里写
+        while (drainInto(writeBuffer))
+        {
+            output.append(writeBuffer.data(), writeBuffer.size());
+            writeBuffer.clear();
+        }
+
+        const int64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != droppedReported_)
+        {
+            if (droppedNotice_)
+            {
+                std::string notice = droppedNotice_(dropped - droppedReported_);
+                output.append(notice.data(), notice.size());
+            }
+            else
+            {
+                char buf[128];
+                int n = snprintf(buf, sizeof(buf), "[ERROR] AsyncLogging dropped %ld log messages, buffers full\n",
+                                 dropped - droppedReported_);
+                output.append(buf, static_cast<size_t>(n));
+            }
+            droppedReported_ = dropped;
+        }
+        output.flush();
+
+        {
+            std::scoped_lock lock(mutex_);
+            flushCompleted_ = flushTicket;
+        }
+        flushedCond_.notify_all();
+
+        if (stopping)
+        {
+            break;
+        }
+    }
+}
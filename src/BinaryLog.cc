@@ -0,0 +1,91 @@
+#include "BinaryLog.h"
+#include "AsyncLogging.h"
+
+BinaryLogger &BinaryLogger::instance()
+{
+    static BinaryLogger logger;
+    return logger;
+}
+
+void BinaryLogger::attach(AsyncLogging *backend)
+{
+    backend->setFileHeader([this] {
+        return fileHeader();
+    });
+    backend->setDroppedNotice([](int64_t dropped) {
+        char frame[binarylog::kFrameHeaderSize + sizeof(int64_t)];
+        frame[0] = binarylog::kFrameDropped;
+        const uint32_t len = sizeof(int64_t);
+        memcpy(frame + 1, &len, sizeof(len));
+        memcpy(frame + binarylog::kFrameHeaderSize, &dropped, sizeof(dropped));
+        return std::string(frame, sizeof(frame));
+    });
+    backend_ = backend;
+}
+
+uint32_t BinaryLogger::registerSite(BinaryLogSite &site, const char *types)
+{
+    std::string frame;
+    uint32_t id;
+    {
+        std::scoped_lock lock(mutex_);
+        id = site.id.load(std::memory_order_relaxed);
+        if (id != 0) // 别的线程抢先注册了
+        {
+            return id;
+        }
+        id = static_cast<uint32_t>(descriptors_.size() + 1);
+        frame = descriptorFrame(site, id, types);
+        descriptors_.push_back(frame);
+        site.id.store(id, std::memory_order_release);
+    }
+    // 注册线程在自己的第一条记录前写描述; 注册之后才开的新文件, 文件头里也会带上它.
+    // 环满了也不能丢(kDrop 下丢了, 当前文件里这个调用点的记录就全成了 unknown format id), 每个调用点只等这一次
+    backend_->append(frame.data(), frame.size(), AsyncLogging::kBlock);
+    return id;
+}
+
+std::string BinaryLogger::fileHeader()
+{
+    std::string header(binarylog::kMagic, sizeof(binarylog::kMagic));
+    std::scoped_lock lock(mutex_);
+    for (const std::string &frame : descriptors_)
+    {
+        header += frame;
+    }
+    return header;
+}
+
+void BinaryLogger::finishFrame(char *frame, char type, char *end)
+{
+    const uint32_t len = static_cast<uint32_t>(end - frame - binarylog::kFrameHeaderSize);
+    frame[0] = type;
+    memcpy(frame + 1, &len, sizeof(len));
+    backend_->append(frame, static_cast<size_t>(end - frame));
+}
+
+std::string BinaryLogger::descriptorFrame(const BinaryLogSite &site, uint32_t id, const std::string &types)
+{
+    const uint16_t fileLen = static_cast<uint16_t>(strnlen(site.file, UINT16_MAX));
+    const uint16_t fmtLen = static_cast<uint16_t>(strnlen(site.format, UINT16_MAX));
+    const uint8_t nargs = static_cast<uint8_t>(types.size());
+    const uint8_t level = static_cast<uint8_t>(site.level);
+    const uint32_t line = static_cast<uint32_t>(site.line);
+
+    std::string payload;
+    payload.append(reinterpret_cast<const char *>(&id), sizeof(id));
+    payload.append(reinterpret_cast<const char *>(&level), sizeof(level));
+    payload.append(reinterpret_cast<const char *>(&line), sizeof(line));
+    payload.append(reinterpret_cast<const char *>(&fileLen), sizeof(fileLen));
+    payload.append(site.file, fileLen);
+    payload.append(reinterpret_cast<const char *>(&fmtLen), sizeof(fmtLen));
+    payload.append(site.format, fmtLen);
+    payload.append(reinterpret_cast<const char *>(&nargs), sizeof(nargs));
+    payload.append(types);
+
+    std::string frame(1, binarylog::kFrameDescriptor);
+    const uint32_t len = static_cast<uint32_t>(payload.size());
+    frame.append(reinterpret_cast<const char *>(&len), sizeof(len));
+    frame += payload;
+    return frame;
+}
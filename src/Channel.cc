@@ -3,6 +3,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "Tracer.h"
 
 // EventLoop: ChannelList Poller
 Channel::Channel(EventLoop *loop, int fd)
@@ -47,6 +48,7 @@ void Channel::remove()
 
 void Channel::handleEvent(Timestamp receiveTime)
 {
+    TraceScope trace("handleEvent", static_cast<uint64_t>(fd_));
     if (tied_)
     {
         std::shared_ptr<void> guard = tie_.lock();
@@ -99,4 +101,14 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
             writeCallback_();
         }
     }
-}
\ No newline at end of file
+}
+
+std::string Channel::describe() const
+{
+    std::string result = "fd=" + std::to_string(fd_);
+    if (describeCallback_)
+    {
+        result += " " + describeCallback_();
+    }
+    return result;
+}
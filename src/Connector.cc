@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <errno.h>
+#include <random>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+namespace
+{
+    int createNonblocking()
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if (sockfd < 0)
+        {
+            LOG_FATAL("%s:%s:%d connect socket create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+        return sockfd;
+    }
+
+    int getSocketError(int sockfd)
+    {
+        int optval = 0;
+        socklen_t optlen = sizeof(optval);
+        if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+        {
+            return errno;
+        }
+        return optval;
+    }
+
+    // 本地地址和对端地址完全相同: 连本机某个没人监听的端口时, 内核恰好把这个端口分配成源端口, 于是自己连上了自己
+    bool isSelfConnect(int sockfd)
+    {
+        sockaddr_in local{};
+        sockaddr_in peer{};
+        socklen_t len = sizeof(local);
+        if (::getsockname(sockfd, (sockaddr *)&local, &len) < 0)
+        {
+            return false;
+        }
+        len = sizeof(peer);
+        if (::getpeername(sockfd, (sockaddr *)&peer, &len) < 0)
+        {
+            return false;
+        }
+        return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+    }
+
+    // [delay/2, delay] 之间均匀取值(equal jitter)
+    double withJitter(double delay)
+    {
+        thread_local std::mt19937 rng(std::random_device{}());
+        return std::uniform_real_distribution<double>(delay / 2, delay)(rng);
+    }
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+{
+    LOG_DEBUG("Connector::ctor[%p]\n", this);
+}
+
+Connector::~Connector()
+{
+    LOG_DEBUG("Connector::dtor[%p]\n", this);
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop([self = shared_from_this()] { self->startInLoop(); });
+}
+
+void Connector::startInLoop()
+{
+    if (state_ != kDisconnected)
+    {
+        return; // 已经在连了(重复 start, 或 restart 和到期的重试定时器撞在一起)
+    }
+    if (connect_)
+    {
+        connect();
+    }
+    else
+    {
+        LOG_DEBUG("Connector::startInLoop do not connect\n");
+    }
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop([self = shared_from_this()] { self->stopInLoop(); });
+}
+
+void Connector::stopInLoop()
+{
+    loop_->cancel(retryTimer_);
+    if (state_ == kConnecting)
+    {
+        state_ = kDisconnected;
+        int sockfd = removeAndResetChannel();
+        retry(sockfd); // connect_ 已经是 false, 这里只会关掉 sockfd
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = createNonblocking();
+    int ret = ::connect(sockfd, (const sockaddr *)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+        retry(sockfd);
+        break;
+
+    case EACCES:
+    case EPERM:
+    case EAFNOSUPPORT:
+    case EALREADY:
+    case EBADF:
+    case EFAULT:
+    case ENOTSOCK:
+        LOG_ERROR("Connector::connect to %s error:%d\n", serverAddr_.toIpPort().c_str(), savedErrno);
+        ::close(sockfd);
+        break;
+
+    default:
+        LOG_ERROR("Connector::connect to %s unexpected error:%d\n", serverAddr_.toIpPort().c_str(), savedErrno);
+        ::close(sockfd);
+        break;
+    }
+}
+
+void Connector::restart()
+{
+    loop_->cancel(retryTimer_);
+    state_ = kDisconnected;
+    retryDelay_ = initRetryDelay_;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::connecting(int sockfd)
+{
+    state_ = kConnecting;
+    channel_ = std::make_unique<Channel>(loop_, sockfd);
+    channel_->setWriteCallback([this] { handleWrite(); });
+    channel_->setErrorCallback([this] { handleError(); });
+    channel_->setDescribeCallback([this] { return "connector " + serverAddr_.toIpPort(); });
+    // 原版这里说 tie 用不了, 那是因为原版的 Connector 有时不由 shared_ptr 管; 这里一定是, 可以 tie 住
+    channel_->tie(shared_from_this());
+    // 非阻塞 connect 完成(成功或失败)时 fd 可写
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 现在还在 Channel::handleEvent 里, 不能立刻析构 channel_, 放到这一轮的 pendingFunctors 里
+    loop_->queueInLoop([self = shared_from_this()] { self->channel_.reset(); });
+    return sockfd;
+}
+
+void Connector::handleWrite()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if (err)
+    {
+        LOG_ERROR("Connector::handleWrite - SO_ERROR = %d %s\n", err, strerror(err));
+        retry(sockfd);
+    }
+    else if (isSelfConnect(sockfd))
+    {
+        LOG_ERROR("Connector::handleWrite - self connect to %s\n", serverAddr_.toIpPort().c_str());
+        retry(sockfd);
+    }
+    else
+    {
+        if (connect_)
+        {
+            state_ = kConnected;
+            retryDelay_ = initRetryDelay_; // 连上了, 下次断线重连从头退避
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            state_ = kDisconnected; // 连上的同时被 stop 了, 没有连接交出去, 不能停在 kConnected
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    LOG_ERROR("Connector::handleError state=%d\n", state_);
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_DEBUG("SO_ERROR = %d %s\n", err, strerror(err));
+        retry(sockfd);
+    }
+}
+
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    state_ = kDisconnected;
+    if (connect_)
+    {
+        const double delay = withJitter(retryDelay_);
+        LOG_INFO("Connector::retry - retry connecting to %s in %.3f seconds\n", serverAddr_.toIpPort().c_str(), delay);
+        // 只持有 weak_ptr: 退避期间 TcpClient 析构了, Connector 跟着析构, 定时器到期什么都不做
+        retryTimer_ = loop_->runAfter(delay, [weakSelf = weak_from_this()] {
+            if (ConnectorPtr self = weakSelf.lock())
+            {
+                self->startInLoop();
+            }
+        });
+        retryDelay_ = std::min(retryDelay_ * 2, maxRetryDelay_);
+    }
+    else
+    {
+        LOG_DEBUG("Connector::retry do not connect\n");
+    }
+}
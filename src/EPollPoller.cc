@@ -40,6 +40,12 @@ void EPollPoller::updateChannel(Channel *channel) // 这是修改Channel感兴
 
     if (index == kNew || index == kDeleted) // 未被注册或者已经被Poller删除.
     {
+        if (index == kDeleted && channel->isNoneEvent())
+        {
+            // 停了读也没在写的 channel 已经 DEL 掉了, 这时再 disableAll(比如 handleClose)不能 ADD 回去:
+            // 事件为空也会收到 EPOLLHUP, 连接会被 handleClose 第二次
+            return;
+        }
         if (index == kNew) // 未被注册.
         {
             int fd = channel->fd();
@@ -8,6 +8,11 @@
 #include "Logger.h"
 #include "Channel.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "LoopStats.h"
+#include "TscClock.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
 
 // 防止一个线程创建多个EventLoop
 // __thread就是thread_local, 每个线程独占的变量, 之前是用于线程id
@@ -68,8 +73,10 @@ EventLoop::EventLoop()
     , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid()) // good
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(std::make_unique<TimerQueue>(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(std::make_unique<Channel>(this, wakeupFd_))
+    , stats_(std::make_unique<LoopStats>())
 {
     LOG_DEBUG("EventLoop created %p in thread %d\n", this, threadId_);
     if (t_loopInThisThread)
@@ -88,12 +95,20 @@ EventLoop::EventLoop()
     wakeupChannel_->setReadCallback([this](Timestamp) { 
         handleRead(); 
     });
+    wakeupChannel_->setDescribeCallback([] { return std::string("wakeup"); });
+
+    registerMetrics();
     
     // 每一个EventLoop都将监听其wakeupChannel_的EPOLL读事件了
     wakeupChannel_->enableReading(); 
 }
 EventLoop::~EventLoop()
 {
+    for (uint64_t id : metricCallbacks_)
+    {
+        MetricsRegistry::instance().remove(id);
+    }
+    delete perf_.load(std::memory_order_acquire); // 引用它的回调 gauge 上面已经注销了
     wakeupChannel_->disableAll(); // 给Channel移除所有感兴趣的事件
     wakeupChannel_->remove();     // 把Channel从EventLoop上删除掉
     ::close(wakeupFd_);
@@ -111,9 +126,21 @@ void EventLoop::loop()
     // 监听两类fd  一种是client的fd,   一种是mainReactor的wakeupfd(在loop初始化时绑定了操作)
     while (!quit_)
     {
+        iterationsMetric_.inc();
         activeChannels_.clear();
+        // 统计关着的时候只多这一次 relaxed load, 其余照旧
+        if (statsEnabled_.load(std::memory_order_relaxed))
+        {
+            const uint64_t start = TscClock::now();
+            pollOnce();
+            stats_->pollWaitNs.record(TscClock::toNanoseconds(TscClock::now() - start));
+            stats_->eventsPerIteration.record(activeChannels_.size());
+            dispatchWithStats();
+            doPendingFunctorsWithStats();
+            continue;
+        }
         // activeChannels_是一个vector却用指针传入而不是用引用. 是因为, google代码规范曾经规定, 入参constT&, 出参T*
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        pollOnce();
         for (Channel *channel : activeChannels_)
         {
             // Poller监听哪些channel发生了事件 然后上报给EventLoop 通知channel处理相应的事件
@@ -131,6 +158,13 @@ void EventLoop::loop()
     looping_ = false;
 }
 
+void EventLoop::pollOnce()
+{
+    TraceScope trace("epoll_wait");
+    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    trace.setArg(activeChannels_.size());
+}
+
 void EventLoop::handleRead()
 {
     uint64_t one = 1;
@@ -142,8 +176,163 @@ void EventLoop::handleRead()
 }
 
 
+void EventLoop::registerMetrics()
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string labels = "loop=\"" + std::to_string(threadId_) + "\"";
+    iterationsMetric_ = registry.counter("muduo_loop_iterations_total", "EventLoop poll iterations", labels);
+    functorsMetric_ = registry.counter("muduo_loop_functors_total", "Pending functors executed", labels);
+
+    // 直方图导出成分位数 gauge(纳秒/个数), 只有 setStatsEnabled(true) 之后才有数据
+    struct Exported
+    {
+        const char *name;
+        const char *help;
+        const Histogram LoopStats::*histogram;
+    };
+    static const Exported kExported[] = {
+        {"muduo_loop_poll_wait_ns", "epoll_wait time per iteration", &LoopStats::pollWaitNs},
+        {"muduo_loop_dispatch_ns", "Channel::handleEvent time", &LoopStats::dispatchNs},
+        {"muduo_loop_pending_functors_ns", "doPendingFunctors time per iteration", &LoopStats::pendingFunctorsNs},
+        {"muduo_loop_events_per_iteration", "Active channels per iteration", &LoopStats::eventsPerIteration},
+        {"muduo_loop_functors_per_iteration", "Pending functors per iteration", &LoopStats::functorsPerIteration},
+    };
+    for (const Exported &e : kExported)
+    {
+        for (const char *quantile : {"0.5", "0.99", "0.999"})
+        {
+            const double q = std::stod(quantile);
+            const Histogram *histogram = &((*stats_).*(e.histogram));
+            metricCallbacks_.push_back(registry.addCallbackGauge(
+                e.name, e.help, labels + ",quantile=\"" + quantile + "\"", [histogram, q] {
+                    return static_cast<double>(histogram->snapshot().percentile(q));
+                }));
+        }
+    }
+    metricCallbacks_.push_back(registry.addCallbackGauge(
+        "muduo_loop_slow_callbacks", "Callbacks slower than the slow-callback threshold", labels, [this] {
+            return static_cast<double>(stats_->slowCallbacks.load(std::memory_order_relaxed));
+        }));
+}
+
+void EventLoop::setPerfCountersEnabled(bool on)
+{
+    runInLoop([this, on] {
+        PerfCounters *perf = perf_.load(std::memory_order_relaxed);
+        if (!perf)
+        {
+            if (!on)
+            {
+                return;
+            }
+            perf = new PerfCounters; // 计的是构造它的线程, 所以必须在这里创建
+            if (!perf->valid())
+            {
+                LOG_ERROR("EventLoop %p perf counters unavailable, check /proc/sys/kernel/perf_event_paranoid\n", this);
+            }
+            perf_.store(perf, std::memory_order_release);
+            registerPerfMetrics(perf);
+        }
+        perf->setActive(on);
+    });
+}
+
+std::string EventLoop::perfReport() const
+{
+    const PerfCounters *perf = perf_.load(std::memory_order_acquire);
+    return perf ? perf->report() : std::string();
+}
+
+void EventLoop::registerPerfMetrics(PerfCounters *perf)
+{
+    if (!perf->valid())
+    {
+        return;
+    }
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string labels = "loop=\"" + std::to_string(threadId_) + "\"";
+    for (int c = 0; c < PerfCounters::kNumCategories; ++c)
+    {
+        for (int e = 0; e < PerfCounters::kNumEvents; ++e)
+        {
+            metricCallbacks_.push_back(registry.addCallbackGauge(
+                "muduo_loop_perf_events", "Hardware counters (user space) by callback category",
+                labels + ",category=\"" + PerfCounters::categoryName(c) + "\",event=\"" + PerfCounters::eventName(e) + "\"",
+                [perf, c, e] { return static_cast<double>(perf->total(c, e)); }));
+        }
+    }
+}
+
+void EventLoop::setStatsEnabled(bool on)
+{
+    if (on)
+    {
+        TscClock::calibrateOnce();
+    }
+    statsEnabled_.store(on, std::memory_order_relaxed);
+}
+
+void EventLoop::dispatchWithStats()
+{
+    const int64_t slowNs = slowCallbackNs_.load(std::memory_order_relaxed);
+    for (Channel *channel : activeChannels_)
+    {
+        const uint64_t start = TscClock::now();
+        channel->handleEvent(pollReturnTime_);
+        const int64_t ns = TscClock::toNanoseconds(TscClock::now() - start);
+        stats_->dispatchNs.record(ns);
+        // channel 在本轮里还活着: 连接关闭时 connectDestroyed 是 queueInLoop 进来的, 要等到下面的 doPendingFunctors
+        if (ns > slowNs)
+        {
+            reportSlowCallback("channel", channel->describe(), ns);
+        }
+    }
+}
+
+void EventLoop::doPendingFunctorsWithStats()
+{
+    TraceScope trace("doPendingFunctors");
+    PerfScope perf(PerfCounters::kPendingFunctors);
+    std::vector<Functor> functors;
+    callingPendingFunctors_ = true;
+    {
+        std::scoped_lock lock(mutex_);
+        functors.swap(pendingFunctors_);
+    }
+    trace.setArg(functors.size());
+
+    const int64_t slowNs = slowCallbackNs_.load(std::memory_order_relaxed);
+    const uint64_t begin = TscClock::now();
+    uint64_t start = begin;
+    for (const Functor &functor : functors)
+    {
+        functor();
+        const uint64_t end = TscClock::now();
+        const int64_t ns = TscClock::toNanoseconds(end - start);
+        if (ns > slowNs)
+        {
+            // 只知道是哪个可调用对象的类型, 具体是谁投递的要结合业务日志看
+            reportSlowCallback("pending functor", functor.target_type().name(), ns);
+        }
+        start = end;
+    }
+    stats_->pendingFunctorsNs.record(TscClock::toNanoseconds(start - begin));
+    stats_->functorsPerIteration.record(functors.size());
+    functorsMetric_.add(static_cast<int64_t>(functors.size()));
+
+    callingPendingFunctors_ = false;
+}
+
+void EventLoop::reportSlowCallback(const char *what, const std::string &who, int64_t ns)
+{
+    stats_->slowCallbacks.fetch_add(1, std::memory_order_relaxed);
+    LOG_ERROR("EventLoop %p slow %s [%s] took %.3f ms\n", this, what, who.c_str(), static_cast<double>(ns) / 1e6);
+}
+
 void EventLoop::doPendingFunctors()
 {
+    TraceScope trace("doPendingFunctors");
+    PerfScope perf(PerfCounters::kPendingFunctors);
     std::vector<Functor> functors;
     callingPendingFunctors_ = true;
     {
@@ -153,11 +342,13 @@ void EventLoop::doPendingFunctors()
         std::scoped_lock lock(mutex_);
         functors.swap(pendingFunctors_); // 交换的方式减少了锁的临界区范围 提升效率 同时避免了死锁 如果执行functor()在临界区内 且functor()中调用queueInLoop()就会产生死锁
     }
+    trace.setArg(functors.size());
 
     for (const Functor &functor : functors)
     {
         functor(); // 执行当前loop需要执行的回调操作
     }
+    functorsMetric_.add(static_cast<int64_t>(functors.size()));
 
     callingPendingFunctors_ = false;
 }
@@ -202,9 +393,28 @@ void EventLoop::runInLoop(Functor cb)
     }
 }
 
+size_t EventLoop::queueSize() const
+{
+    std::scoped_lock lock(mutex_);
+    return pendingFunctors_.size();
+}
+
 // 把cb放入队列中 唤醒loop所在的线程执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
+    // 打开追踪时包一层: 投递处记 flow 起点, 执行处记 flow 终点, 时间线上就是一条跨线程的箭头
+    TraceScope trace("queueInLoop");
+    if (Tracer::enabled())
+    {
+        const uint64_t flowId = Tracer::newFlowId();
+        trace.setArg(flowId);
+        Tracer::record('s', "functor", flowId);
+        cb = [flowId, cb = std::move(cb)] {
+            TraceScope trace("functor", flowId);
+            Tracer::record('f', "functor", flowId);
+            cb();
+        };
+    }
     {
         std::lock_guard<std::mutex> lock(mutex_);
         pendingFunctors_.emplace_back(std::move(cb)); // 这个pendingFunctors也是当前loop的成员变量.
@@ -221,6 +431,26 @@ void EventLoop::queueInLoop(Functor cb)
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delaySeconds, TimerCallback cb)
+{
+    return runAt(addTime(Timestamp::now(), delaySeconds), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double intervalSeconds, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), intervalSeconds), intervalSeconds);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // EventLoop的方法 => Poller的方法
 void EventLoop::updateChannel(Channel *channel)
 {
@@ -62,6 +62,18 @@ EventLoop *EventLoopThreadPool::getNextLoop()
 
 
 
+size_t EventLoopThreadPool::getNextLoopIndex()
+{
+    if (loops_.empty()) // 只有baseLoop_, 下标就是0
+    {
+        return 0;
+    }
+    size_t index = next_;
+    ++next_;
+    next_ %= loops_.size();
+    return index;
+}
+
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
 {
     if (loops_.empty())
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+
+#include "FrameCodec.h"
+#include "Buffer.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+namespace
+{
+    void defaultErrorCallback(const TcpConnectionPtr &conn, FrameCodec::Error error)
+    {
+        LOG_ERROR("FrameCodec: %s from %s, closing\n", FrameCodec::errorName(error), conn->name().c_str());
+        conn->forceClose();
+    }
+}
+
+FrameCodec::FrameCodec(Type type, FrameCallback cb, size_t maxFrameSize)
+    : type_(type)
+    , maxFrameSize_(maxFrameSize)
+    , frameCallback_(std::move(cb))
+    , errorCallback_(defaultErrorCallback)
+{
+    if (type_ == Type::kDelimiter)
+    {
+        LOG_FATAL("%s:%s:%d delimiter framing needs a delimiter\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+FrameCodec::FrameCodec(std::string delimiter, FrameCallback cb, size_t maxFrameSize)
+    : type_(Type::kDelimiter)
+    , delimiter_(std::move(delimiter))
+    , maxFrameSize_(maxFrameSize)
+    , frameCallback_(std::move(cb))
+    , errorCallback_(defaultErrorCallback)
+{
+    if (delimiter_.empty())
+    {
+        LOG_FATAL("%s:%s:%d empty delimiter\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+const char *FrameCodec::errorName(Error error)
+{
+    switch (error)
+    {
+    case Error::kFrameTooLarge:
+        return "frame too large";
+    case Error::kBadHeader:
+        return "bad frame header";
+    }
+    return "unknown";
+}
+
+FrameCodec::ParseResult FrameCodec::parse(const char *data, size_t len, size_t *payloadOffset, size_t *payloadLen, size_t *frameLen, Error *error) const
+{
+    size_t headerLen = 0;
+    uint64_t length = 0;
+    switch (type_)
+    {
+    case Type::kFixed16:
+    {
+        if (len < sizeof(uint16_t))
+        {
+            return ParseResult::kIncomplete;
+        }
+        uint16_t be16;
+        memcpy(&be16, data, sizeof(be16)); // data 不一定对齐
+        length = ntohs(be16);
+        headerLen = sizeof(be16);
+        break;
+    }
+    case Type::kFixed32:
+    {
+        if (len < sizeof(uint32_t))
+        {
+            return ParseResult::kIncomplete;
+        }
+        uint32_t be32;
+        memcpy(&be32, data, sizeof(be32));
+        length = ntohl(be32);
+        headerLen = sizeof(be32);
+        break;
+    }
+    case Type::kVarint:
+    {
+        const size_t limit = std::min(len, kMaxVarintBytes);
+        for (; headerLen < limit; ++headerLen)
+        {
+            const uint8_t byte = static_cast<uint8_t>(data[headerLen]);
+            if (headerLen == kMaxVarintBytes - 1 && byte > 1)
+            {
+                *error = Error::kBadHeader; // 第 10 个字节只剩 1 位有效, 再大就溢出 64 位了
+                return ParseResult::kError;
+            }
+            length |= static_cast<uint64_t>(byte & 0x7f) << (7 * headerLen);
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        if (headerLen == limit)
+        {
+            if (limit == kMaxVarintBytes)
+            {
+                *error = Error::kBadHeader;
+                return ParseResult::kError;
+            }
+            return ParseResult::kIncomplete;
+        }
+        ++headerLen; // 算上最后那个不带续位的字节
+        break;
+    }
+    case Type::kDelimiter:
+    {
+        // 最多在 maxFrameSize + 分隔符 的范围里找, 找不到又已经攒了这么多, 就是超长
+        const size_t window = std::min(len, maxFrameSize_ + delimiter_.size());
+        size_t pos = std::string_view::npos;
+        if (delimiter_.size() == 1)
+        {
+            if (const void *hit = memchr(data, delimiter_[0], window))
+            {
+                pos = static_cast<size_t>(static_cast<const char *>(hit) - data);
+            }
+        }
+        else
+        {
+            pos = std::string_view(data, window).find(delimiter_);
+        }
+        if (pos == std::string_view::npos)
+        {
+            if (window == maxFrameSize_ + delimiter_.size())
+            {
+                *error = Error::kFrameTooLarge;
+                return ParseResult::kError;
+            }
+            return ParseResult::kIncomplete;
+        }
+        *payloadOffset = 0;
+        *payloadLen = pos;
+        *frameLen = pos + delimiter_.size();
+        return ParseResult::kComplete;
+    }
+    }
+
+    // 头一到就检查长度, 不用等一个声称 4GB 的帧慢慢收完
+    if (length > maxFrameSize_)
+    {
+        *error = Error::kFrameTooLarge;
+        return ParseResult::kError;
+    }
+    if (len - headerLen < length)
+    {
+        return ParseResult::kIncomplete;
+    }
+    *payloadOffset = headerLen;
+    *payloadLen = static_cast<size_t>(length);
+    *frameLen = headerLen + static_cast<size_t>(length);
+    return ParseResult::kComplete;
+}
+
+void FrameCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) const
+{
+    const char *data = buf->peek();
+    const size_t len = buf->readableBytes();
+    size_t consumed = 0;
+    // 一批帧全部在原地回调完再统一 retrieve, 回调期间 inputBuffer_ 不会被改, 视图一直有效
+    while (consumed < len)
+    {
+        size_t payloadOffset = 0;
+        size_t payloadLen = 0;
+        size_t frameLen = 0;
+        Error error = Error::kBadHeader;
+        const ParseResult result = parse(data + consumed, len - consumed, &payloadOffset, &payloadLen, &frameLen, &error);
+        if (result == ParseResult::kIncomplete)
+        {
+            break;
+        }
+        if (result == ParseResult::kError)
+        {
+            buf->retrieveAll();
+            errorCallback_(conn, error);
+            return;
+        }
+        frameCallback_(conn, std::string_view(data + consumed + payloadOffset, payloadLen), receiveTime);
+        consumed += frameLen;
+        if (!conn->connected())
+        {
+            // 回调里把连接关了, 剩下的帧不再交付
+            buf->retrieveAll();
+            return;
+        }
+    }
+    buf->retrieve(consumed);
+}
+
+size_t FrameCodec::encodeHeader(size_t payloadLen, char *header) const
+{
+    // 超过 maxFrameSize 的对端照样当错误关连接, 发之前就拦下; 长度头放不下的截断了会把后面的帧全读乱
+    if (payloadLen > maxFrameSize_)
+    {
+        LOG_ERROR("FrameCodec - frame of %zu bytes exceeds maxFrameSize %zu, not encoded\n", payloadLen, maxFrameSize_);
+        return 0;
+    }
+    switch (type_)
+    {
+    case Type::kFixed16:
+    {
+        if (payloadLen > UINT16_MAX)
+        {
+            LOG_ERROR("FrameCodec - frame of %zu bytes does not fit a 16-bit header, not encoded\n", payloadLen);
+            return 0;
+        }
+        const uint16_t be16 = htons(static_cast<uint16_t>(payloadLen));
+        memcpy(header, &be16, sizeof(be16));
+        return sizeof(be16);
+    }
+    case Type::kFixed32:
+    {
+        if (payloadLen > UINT32_MAX)
+        {
+            LOG_ERROR("FrameCodec - frame of %zu bytes does not fit a 32-bit header, not encoded\n", payloadLen);
+            return 0;
+        }
+        const uint32_t be32 = htonl(static_cast<uint32_t>(payloadLen));
+        memcpy(header, &be32, sizeof(be32));
+        return sizeof(be32);
+    }
+    case Type::kVarint:
+    {
+        size_t n = 0;
+        uint64_t value = payloadLen;
+        while (value >= 0x80)
+        {
+            header[n++] = static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        header[n++] = static_cast<char>(value);
+        return n;
+    }
+    case Type::kDelimiter:
+        break; // 没有长度头, encode/frame 自己查 maxFrameSize
+    }
+    return 0;
+}
+
+bool FrameCodec::encode(Buffer *out, std::string_view payload) const
+{
+    if (type_ == Type::kDelimiter)
+    {
+        if (payload.size() > maxFrameSize_)
+        {
+            LOG_ERROR("FrameCodec - frame of %zu bytes exceeds maxFrameSize %zu, not encoded\n", payload.size(), maxFrameSize_);
+            return false;
+        }
+        out->append(payload.data(), payload.size());
+        out->append(delimiter_.data(), delimiter_.size());
+        return true;
+    }
+    char header[kMaxVarintBytes];
+    const size_t headerLen = encodeHeader(payload.size(), header);
+    if (headerLen == 0)
+    {
+        return false;
+    }
+    out->append(header, headerLen);
+    out->append(payload.data(), payload.size());
+    return true;
+}
+
+bool FrameCodec::frame(Buffer *buf) const
+{
+    if (type_ == Type::kDelimiter)
+    {
+        if (buf->readableBytes() > maxFrameSize_)
+        {
+            LOG_ERROR("FrameCodec - frame of %zu bytes exceeds maxFrameSize %zu, not encoded\n", buf->readableBytes(), maxFrameSize_);
+            return false;
+        }
+        buf->append(delimiter_.data(), delimiter_.size());
+        return true;
+    }
+    char header[kMaxVarintBytes];
+    const size_t headerLen = encodeHeader(buf->readableBytes(), header);
+    if (headerLen == 0)
+    {
+        return false;
+    }
+    if (buf->prependableBytes() >= headerLen)
+    {
+        buf->prepend(header, headerLen);
+    }
+    else
+    {
+        Buffer framed(headerLen + buf->readableBytes());
+        framed.append(header, headerLen);
+        framed.append(buf->peek(), buf->readableBytes());
+        buf->swap(framed);
+    }
+    return true;
+}
+
+bool FrameCodec::send(const TcpConnectionPtr &conn, std::string_view payload) const
+{
+    Buffer buf(payload.size() + delimiter_.size());
+    buf.append(payload.data(), payload.size());
+    if (!frame(&buf))
+    {
+        return false;
+    }
+    conn->send(&buf);
+    return true;
+}
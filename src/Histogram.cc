@@ -0,0 +1,78 @@
+#include <cstdio>
+
+#include "Histogram.h"
+
+void Histogram::Snapshot::merge(const Snapshot &other)
+{
+    for (size_t i = 0; i < kNumBuckets; ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    if (other.max > max)
+    {
+        max = other.max;
+    }
+}
+
+uint64_t Histogram::Snapshot::percentile(double q) const
+{
+    // 各桶是分开读的, 快照里桶的总和可能和 count 差一点, 以桶的总和为准
+    uint64_t total = 0;
+    for (uint64_t c : counts)
+    {
+        total += c;
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+    if (rank >= total)
+    {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen > rank)
+        {
+            return bucketLowerBound(i);
+        }
+    }
+    return max;
+}
+
+std::string Histogram::Snapshot::toString() const
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "count=%lu mean=%.1f p50=%lu p90=%lu p99=%lu p999=%lu max=%lu",
+             count, mean(), percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), max);
+    return buf;
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snap;
+    for (size_t i = 0; i < kNumBuckets; ++i)
+    {
+        snap.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    snap.count = count_.load(std::memory_order_relaxed);
+    snap.sum = sum_.load(std::memory_order_relaxed);
+    snap.max = max_.load(std::memory_order_relaxed);
+    return snap;
+}
+
+void Histogram::reset()
+{
+    for (auto &c : counts_)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
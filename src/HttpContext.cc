@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+#include "HttpContext.h"
+#include "Buffer.h"
+#include "HttpScanner.h"
+
+namespace
+{
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    HttpRequest::Method parseMethod(std::string_view m)
+    {
+        switch (m.size())
+        {
+        case 3:
+            if (m == "GET") return HttpRequest::Method::kGet;
+            if (m == "PUT") return HttpRequest::Method::kPut;
+            break;
+        case 4:
+            if (m == "POST") return HttpRequest::Method::kPost;
+            if (m == "HEAD") return HttpRequest::Method::kHead;
+            break;
+        case 5:
+            if (m == "PATCH") return HttpRequest::Method::kPatch;
+            break;
+        case 6:
+            if (m == "DELETE") return HttpRequest::Method::kDelete;
+            break;
+        case 7:
+            if (m == "OPTIONS") return HttpRequest::Method::kOptions;
+            break;
+        }
+        return HttpRequest::Method::kInvalid;
+    }
+
+    // 严格的十进制/十六进制解析: 不接受空串、符号、空白, 超过 limit 返回 false
+    bool parseSize(std::string_view s, int base, size_t limit, size_t *out)
+    {
+        if (s.empty() || s.size() > 16)
+        {
+            return false;
+        }
+        size_t value = 0;
+        for (char c : s)
+        {
+            int digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (base == 16 && c >= 'a' && c <= 'f')
+                digit = c - 'a' + 10;
+            else if (base == 16 && c >= 'A' && c <= 'F')
+                digit = c - 'A' + 10;
+            else
+                return false;
+            value = value * base + digit;
+            if (value > limit)
+            {
+                return false;
+            }
+        }
+        *out = value;
+        return true;
+    }
+}
+
+void HttpContext::reset()
+{
+    state_ = State::kHeaders;
+    scanned_ = 0;
+    headerLen_ = 0;
+    bodyLen_ = 0;
+    pos_ = 0;
+    chunkRemaining_ = 0;
+    chunkedBody_.clear(); // 容量留着
+    requestLength_ = 0;
+    errorStatus_ = 0;
+    expectContinue_ = false;
+    request_.headers_.clear();
+    request_.body_ = {};
+}
+
+bool HttpContext::takeExpectContinue()
+{
+    if (expectContinue_ && state_ != State::kHeaders)
+    {
+        expectContinue_ = false;
+        return true;
+    }
+    return false;
+}
+
+bool HttpContext::parseHeaderBlock(const char *data, size_t len)
+{
+    // 最后的空行不算. 每一行都以 \r\n 结尾, 所以扫描停在 end 之前的字节总能安全地看它后面一个字节
+    const char *const end = data + len - 2;
+
+    // 请求行: METHOD SP request-target SP HTTP-version CRLF
+    const char *p = data;
+    const char *q = HttpScanner::skipToken(p, end);
+    if (q == p || *q != ' ')
+    {
+        errorStatus_ = 400;
+        return false;
+    }
+    request_.methodString_ = std::string_view(p, q - p);
+    request_.method_ = parseMethod(request_.methodString_);
+    if (request_.method_ == HttpRequest::Method::kInvalid)
+    {
+        errorStatus_ = 501;
+        return false;
+    }
+    p = q + 1;
+    q = HttpScanner::skipTarget(p, end);
+    if (q == p || *q != ' ')
+    {
+        errorStatus_ = 400;
+        return false;
+    }
+    const std::string_view target(p, q - p);
+    p = q + 1;
+    q = HttpScanner::skipFieldValue(p, end);
+    if (*q != '\r' || q[1] != '\n')
+    {
+        errorStatus_ = 400;
+        return false;
+    }
+    const std::string_view version(p, q - p);
+    if (version == "HTTP/1.1")
+    {
+        request_.version_ = HttpRequest::Version::kHttp11;
+    }
+    else if (version == "HTTP/1.0")
+    {
+        request_.version_ = HttpRequest::Version::kHttp10;
+    }
+    else
+    {
+        errorStatus_ = version.substr(0, 5) == "HTTP/" ? 505 : 400;
+        return false;
+    }
+    const size_t question = target.find('?');
+    request_.path_ = target.substr(0, question);
+    request_.query_ = question == std::string_view::npos ? std::string_view() : target.substr(question + 1);
+
+    // 头: field-name ":" OWS field-value OWS CRLF
+    // name 必须全是 tchar 并且紧跟冒号, 这样 obs-fold(行首空白)和冒号前的空白(RFC 9112 要求拒绝)顺带就拒了
+    request_.headers_.clear();
+    p = q + 2;
+    while (p < end)
+    {
+        const char *colon = HttpScanner::skipToken(p, end);
+        if (colon == p || *colon != ':')
+        {
+            errorStatus_ = 400;
+            return false;
+        }
+        const char *vb = colon + 1;
+        while (*vb == ' ' || *vb == '\t')
+        {
+            ++vb;
+        }
+        const char *eol = HttpScanner::skipFieldValue(vb, end);
+        if (*eol != '\r' || eol[1] != '\n')
+        {
+            errorStatus_ = 400; // 裸 \r 或者值里有控制字符
+            return false;
+        }
+        const char *ve = eol;
+        while (ve > vb && (ve[-1] == ' ' || ve[-1] == '\t'))
+        {
+            --ve;
+        }
+        if (request_.headers_.size() == kMaxHeaders)
+        {
+            errorStatus_ = 431;
+            return false;
+        }
+        request_.headers_.push_back({std::string_view(p, colon - p), std::string_view(vb, ve - vb)});
+        p = eol + 2;
+    }
+
+    request_.keepAlive_ = request_.version_ == HttpRequest::Version::kHttp11 ? !request_.headerHasToken("Connection", "close")
+                                                                           : request_.headerHasToken("Connection", "keep-alive");
+    return true;
+}
+
+bool HttpContext::prepareBody()
+{
+    // 不能用 header() 只看第一个: 前后两跳各认一个就是请求走私. 重复的 Content-Length 只允许值完全一样,
+    // Transfer-Encoding 只允许出现一次(编码列表拆成多行的不支持, 反正只认 chunked)
+    std::string_view transferEncoding;
+    std::string_view contentLength;
+    bool hasTransferEncoding = false;
+    bool hasContentLength = false;
+    for (const HttpRequest::Header &h : request_.headers())
+    {
+        if (iequals(h.name, "Transfer-Encoding"))
+        {
+            if (hasTransferEncoding)
+            {
+                errorStatus_ = 400;
+                return false;
+            }
+            hasTransferEncoding = true;
+            transferEncoding = h.value;
+        }
+        else if (iequals(h.name, "Content-Length"))
+        {
+            if (hasContentLength && h.value != contentLength)
+            {
+                errorStatus_ = 400;
+                return false;
+            }
+            hasContentLength = true;
+            contentLength = h.value;
+        }
+    }
+    if (hasTransferEncoding)
+    {
+        if (hasContentLength)
+        {
+            errorStatus_ = 400;
+            return false;
+        }
+        if (!iequals(transferEncoding, "chunked"))
+        {
+            errorStatus_ = 501;
+            return false;
+        }
+        state_ = State::kChunkSize;
+        pos_ = headerLen_;
+    }
+    else
+    {
+        bodyLen_ = 0;
+        if (hasContentLength && !parseSize(contentLength, 10, maxBodyBytes_, &bodyLen_))
+        {
+            // 不是合法数字(包括空值)是 400, 太大是 413; parseSize 不区分, 全是数字就当太大
+            errorStatus_ = !contentLength.empty() && contentLength.find_first_not_of("0123456789") == std::string_view::npos ? 413 : 400;
+            return false;
+        }
+        state_ = State::kBody;
+    }
+    expectContinue_ = iequals(request_.header("Expect"), "100-continue");
+    return true;
+}
+
+HttpContext::Result HttpContext::parse(const Buffer *buf, Timestamp receiveTime)
+{
+    const char *data = buf->peek();
+    const size_t len = buf->readableBytes();
+    bool headersFresh = false; // request_ 里的 string_view 是不是指向当前这块内存
+
+    if (state_ == State::kHeaders)
+    {
+        const size_t limit = std::min(len, maxHeaderBytes_);
+        const char *end = HttpScanner::findHeaderEnd(data + (scanned_ > 3 ? scanned_ - 3 : 0), data + limit);
+        if (end == nullptr)
+        {
+            scanned_ = limit;
+            return len >= maxHeaderBytes_ ? fail(431) : Result::kIncomplete;
+        }
+        headerLen_ = end - data + 4;
+        if (!parseHeaderBlock(data, headerLen_) || !prepareBody())
+        {
+            return Result::kError;
+        }
+        headersFresh = true;
+    }
+
+    if (state_ == State::kBody)
+    {
+        if (len < headerLen_ + bodyLen_)
+        {
+            return Result::kIncomplete;
+        }
+        request_.body_ = std::string_view(data + headerLen_, bodyLen_);
+        requestLength_ = headerLen_ + bodyLen_;
+    }
+    else
+    {
+        // chunked: chunk-size [;ext] CRLF data CRLF ... 0 CRLF *(trailer CRLF) CRLF
+        for (;;)
+        {
+            if (state_ == State::kChunkData)
+            {
+                if (len < pos_ + chunkRemaining_ + 2)
+                {
+                    return Result::kIncomplete;
+                }
+                if (data[pos_ + chunkRemaining_] != '\r' || data[pos_ + chunkRemaining_ + 1] != '\n')
+                {
+                    return fail(400);
+                }
+                chunkedBody_.append(data + pos_, chunkRemaining_);
+                pos_ += chunkRemaining_ + 2;
+                state_ = State::kChunkSize;
+                continue;
+            }
+            const std::string_view rest(data + pos_, len - pos_);
+            const size_t eol = rest.find("\r\n");
+            if (eol == std::string_view::npos)
+            {
+                // 一行 chunk-size 或 trailer 不会这么长
+                return rest.size() > maxHeaderBytes_ ? fail(400) : Result::kIncomplete;
+            }
+            if (state_ == State::kChunkSize)
+            {
+                std::string_view sizeField = rest.substr(0, eol);
+                sizeField = sizeField.substr(0, sizeField.find(';'));
+                size_t size = 0;
+                if (!parseSize(sizeField, 16, maxBodyBytes_ - chunkedBody_.size(), &size))
+                {
+                    return fail(sizeField.find_first_not_of("0123456789abcdefABCDEF") == std::string_view::npos && !sizeField.empty() ? 413 : 400);
+                }
+                pos_ += eol + 2;
+                if (size == 0)
+                {
+                    state_ = State::kTrailers;
+                }
+                else
+                {
+                    chunkRemaining_ = size;
+                    state_ = State::kChunkData;
+                }
+                continue;
+            }
+            // kTrailers: trailer 字段直接忽略, 空行结束
+            pos_ += eol + 2;
+            if (eol == 0)
+            {
+                break;
+            }
+        }
+        request_.body_ = chunkedBody_;
+        requestLength_ = pos_;
+    }
+
+    if (!headersFresh)
+    {
+        // 头是前几次 parse 切的, Buffer 可能已经搬过家, 重新切一遍
+        parseHeaderBlock(data, headerLen_);
+    }
+    request_.receiveTime_ = receiveTime;
+    expectContinue_ = false;
+    return Result::kComplete;
+}
@@ -0,0 +1,43 @@
+#include <strings.h>
+
+#include "HttpRequest.h"
+
+std::string_view HttpRequest::header(std::string_view name) const
+{
+    for (const Header &h : headers_)
+    {
+        if (h.name.size() == name.size() && ::strncasecmp(h.name.data(), name.data(), name.size()) == 0)
+        {
+            return h.value;
+        }
+    }
+    return {};
+}
+
+bool HttpRequest::headerHasToken(std::string_view name, std::string_view token) const
+{
+    std::string_view list = header(name);
+    while (!list.empty())
+    {
+        const size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+        {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t'))
+        {
+            item.remove_suffix(1);
+        }
+        if (item.size() == token.size() && ::strncasecmp(item.data(), token.data(), token.size()) == 0)
+        {
+            return true;
+        }
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
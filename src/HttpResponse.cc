@@ -0,0 +1,161 @@
+#include <cstdio>
+#include <ctime>
+
+#include "HttpResponse.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+bool HttpStream::write(std::string_view data)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || !conn->connected())
+    {
+        return false;
+    }
+    if (data.empty())
+    {
+        return true; // 空块就是结束标记, 不能发
+    }
+    std::string chunk;
+    if (chunked_)
+    {
+        char size[32];
+        const int n = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+        chunk.reserve(n + data.size() + 2);
+        chunk.append(size, n).append(data).append("\r\n");
+    }
+    else
+    {
+        chunk.assign(data);
+    }
+    // 一律 queueInLoop: 在 HttpCallback 里写的块要排在响应头后面, 响应头是回调返回之后才发的
+    EventLoop *loop = conn->getLoop();
+    loop->queueInLoop([conn = std::move(conn), chunk = std::move(chunk)] { conn->send(chunk); });
+    return true;
+}
+
+void HttpStream::finish()
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        return;
+    }
+    EventLoop *loop = conn->getLoop();
+    loop->queueInLoop([conn = std::move(conn), chunked = chunked_, close = close_, onFinish = onFinish_] {
+        if (chunked)
+        {
+            conn->send("0\r\n\r\n");
+        }
+        onFinish(conn, close || !chunked);
+    });
+    conn_.reset(); // 只能 finish 一次
+}
+
+void HttpResponse::addHeader(std::string_view name, std::string_view value)
+{
+    headers_.append(name).append(": ").append(value).append("\r\n");
+}
+
+HttpStream HttpResponse::startStream()
+{
+    HttpStream stream;
+    if (conn_ == nullptr)
+    {
+        LOG_ERROR("HttpResponse::startStream - response is not bound to a connection\n");
+        return stream;
+    }
+    streaming_ = true;
+    if (!chunkedAllowed_)
+    {
+        closeConnection_ = true; // HTTP/1.0: 没有 chunked, 靠关连接表示响应结束
+    }
+    stream.conn_ = *conn_;
+    stream.onFinish_ = *onStreamFinish_;
+    stream.chunked_ = chunkedAllowed_;
+    stream.close_ = closeConnection_;
+    return stream;
+}
+
+void HttpResponse::appendHeadTo(Buffer *out) const
+{
+    char line[128];
+    const int n = snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", statusCode_,
+                           statusMessage_.empty() ? statusMessage(statusCode_) : statusMessage_.c_str());
+    out->append(line, static_cast<size_t>(std::min<int>(n, sizeof(line) - 1)));
+    out->append(headers_.data(), headers_.size());
+    if (streaming_)
+    {
+        if (chunkedAllowed_)
+        {
+            out->append("Transfer-Encoding: chunked\r\n", 28);
+        }
+    }
+    else
+    {
+        const int len = snprintf(line, sizeof(line), "Content-Length: %zu\r\n", body_.size());
+        out->append(line, static_cast<size_t>(len));
+    }
+    if (closeConnection_)
+    {
+        out->append("Connection: close\r\n", 19);
+    }
+    else
+    {
+        out->append("Connection: keep-alive\r\n", 24);
+    }
+    const std::string_view date = dateHeader();
+    out->append(date.data(), date.size());
+    out->append("\r\n", 2);
+}
+
+std::string_view HttpResponse::dateHeader()
+{
+    thread_local time_t t_cachedSecond = 0;
+    thread_local char t_cached[64];
+    thread_local size_t t_cachedLen = 0;
+    const time_t now = static_cast<time_t>(Timestamp::coarseNow().microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+    if (now != t_cachedSecond)
+    {
+        tm tmTime;
+        ::gmtime_r(&now, &tmTime);
+        t_cachedLen = ::strftime(t_cached, sizeof(t_cached), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tmTime);
+        t_cachedSecond = now;
+    }
+    return std::string_view(t_cached, t_cachedLen);
+}
+
+const char *HttpResponse::statusMessage(int code)
+{
+    switch (code)
+    {
+    case 100: return "Continue";
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 413: return "Content Too Large";
+    case 414: return "URI Too Long";
+    case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Unknown";
+    }
+}
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "HttpResponseCache.h"
+#include "HttpResponse.h"
+#include "Logger.h"
+
+namespace
+{
+    // 键: "<method>\0<path>\0<vary1>\0<vary2>...", \0 不会出现在 path 和头的值里(HttpScanner 拒掉了控制字符)
+    void appendKeyPart(std::string *key, std::string_view part)
+    {
+        key->append(part);
+        key->push_back('\0');
+    }
+
+    // 线程快照, 见 HttpResponseCache::lookup
+    struct Snapshot
+    {
+        const void *owner = nullptr;
+        uint64_t version = 0; // 0 不是合法版本号, 空槽一定会去锁里拿
+        std::shared_ptr<const std::unordered_map<std::string, HttpResponseCache::EntryPtr>> map;
+    };
+
+    // 每个线程几个槽, 按 owner 认: 一个线程上轮流查两个缓存(比如两个 HttpServer 共用 loop)不会互相挤掉以致每次都进锁
+    constexpr size_t kSnapshotSlots = 4;
+    struct ThreadSnapshots
+    {
+        Snapshot slots[kSnapshotSlots];
+        size_t next = 0;    // 槽满了轮流换掉
+        uint64_t epoch = 0; // 见 HttpResponseCache::destroyedEpoch_
+        std::string key;    // 拼键用, 容量复用
+    };
+    thread_local ThreadSnapshots t_snapshots;
+}
+
+HttpResponseCache::HttpResponseCache(std::string name, std::vector<std::string> varyHeaders)
+    : name_(std::move(name))
+    , varyHeaders_(std::move(varyHeaders))
+    , map_(std::make_shared<const Map>())
+    , version_(nextVersion_.fetch_add(1, std::memory_order_relaxed))
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string cache = "cache=\"" + name_ + "\"";
+    hits_ = registry.counter("muduo_http_cache_lookups_total", "HTTP response cache lookups, by result", cache + ",result=\"hit\"");
+    misses_ = registry.counter("muduo_http_cache_lookups_total", "HTTP response cache lookups, by result", cache + ",result=\"miss\"");
+}
+
+HttpResponseCache::~HttpResponseCache()
+{
+    // 本线程的槽立刻放掉. 别的线程的槽碰不到(lookup 不加锁), 它们下一次 lookup 看到纪元变了把槽全部清空,
+    // 不会一直攥着已经析构的缓存的表
+    for (Snapshot &snapshot : t_snapshots.slots)
+    {
+        if (snapshot.owner == this)
+        {
+            snapshot = Snapshot{};
+        }
+    }
+    destroyedEpoch_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string HttpResponseCache::makeKey(HttpRequest::Method method, std::string_view path,
+                                       std::initializer_list<std::string_view> varyValues) const
+{
+    if (varyValues.size() != 0 && varyValues.size() != varyHeaders_.size())
+    {
+        LOG_ERROR("HttpResponseCache[%s] - %zu vary values for %zu vary headers\n",
+                  name_.c_str(), varyValues.size(), varyHeaders_.size());
+    }
+    std::string key;
+    key.push_back(static_cast<char>(method));
+    key.push_back('\0');
+    appendKeyPart(&key, path);
+    auto value = varyValues.begin();
+    for (size_t i = 0; i < varyHeaders_.size(); ++i)
+    {
+        appendKeyPart(&key, value != varyValues.end() ? *value++ : std::string_view());
+    }
+    return key;
+}
+
+template <typename F>
+void HttpResponseCache::update(F &&mutate)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto map = std::make_shared<Map>(*map_);
+    mutate(*map);
+    map_ = std::move(map);
+    version_.store(nextVersion_.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+}
+
+bool HttpResponseCache::put(HttpRequest::Method method, std::string_view path, const HttpResponse &response,
+                            std::initializer_list<std::string_view> varyValues)
+{
+    if (method != HttpRequest::Method::kGet)
+    {
+        LOG_ERROR("HttpResponseCache[%s] - only GET responses are cached\n", name_.c_str());
+        return false;
+    }
+    if (response.streaming())
+    {
+        LOG_ERROR("HttpResponseCache[%s] - streaming response for %.*s cannot be cached\n",
+                  name_.c_str(), static_cast<int>(path.size()), path.data());
+        return false;
+    }
+    auto entry = std::make_shared<Entry>();
+    char line[128];
+    int n = snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", response.statusCode_,
+                     response.statusMessage_.empty() ? HttpResponse::statusMessage(response.statusCode_) : response.statusMessage_.c_str());
+    entry->wire_.reserve(static_cast<size_t>(n) + response.headers_.size() + 32 + 2 + response.body_.size());
+    entry->wire_.append(line, std::min<size_t>(static_cast<size_t>(n), sizeof(line) - 1));
+    entry->wire_.append(response.headers_);
+    n = snprintf(line, sizeof(line), "Content-Length: %zu\r\n", response.body_.size());
+    entry->wire_.append(line, static_cast<size_t>(n));
+    entry->headLen_ = entry->wire_.size();
+    entry->wire_.append("\r\n").append(response.body_);
+
+    std::string key = makeKey(method, path, varyValues);
+    update([&](Map &map) { map[std::move(key)] = std::move(entry); });
+    return true;
+}
+
+void HttpResponseCache::erase(HttpRequest::Method method, std::string_view path, std::initializer_list<std::string_view> varyValues)
+{
+    const std::string key = makeKey(method, path, varyValues);
+    update([&](Map &map) { map.erase(key); });
+}
+
+void HttpResponseCache::clear()
+{
+    update([](Map &map) { map.clear(); });
+}
+
+size_t HttpResponseCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return map_->size();
+}
+
+HttpResponseCache::EntryPtr HttpResponseCache::lookup(const HttpRequest &request) const
+{
+    HttpRequest::Method method = request.method();
+    if (method == HttpRequest::Method::kHead)
+    {
+        method = HttpRequest::Method::kGet;
+    }
+    else if (method != HttpRequest::Method::kGet)
+    {
+        return nullptr; // 只缓存 GET
+    }
+
+    ThreadSnapshots &snapshots = t_snapshots;
+    const uint64_t epoch = destroyedEpoch_.load(std::memory_order_relaxed);
+    if (snapshots.epoch != epoch)
+    {
+        // 有缓存析构了, 不知道是哪个, 全部清掉; 活着的下面按需重新拿, 析构缓存本来就少见
+        for (Snapshot &snapshot : snapshots.slots)
+        {
+            snapshot = Snapshot{};
+        }
+        snapshots.epoch = epoch;
+    }
+    Snapshot *snapshot = nullptr;
+    Snapshot *vacant = nullptr;
+    for (Snapshot &slot : snapshots.slots)
+    {
+        if (slot.owner == this)
+        {
+            snapshot = &slot;
+            break;
+        }
+        if (slot.owner == nullptr && vacant == nullptr)
+        {
+            vacant = &slot;
+        }
+    }
+    if (snapshot == nullptr)
+    {
+        snapshot = vacant != nullptr ? vacant : &snapshots.slots[snapshots.next++ % kSnapshotSlots];
+        *snapshot = Snapshot{};
+        snapshot->owner = this;
+    }
+    const uint64_t version = version_.load(std::memory_order_acquire);
+    if (snapshot->version != version)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot->version = version_.load(std::memory_order_relaxed);
+        snapshot->map = map_;
+    }
+
+    std::string &key = snapshots.key;
+    key.clear();
+    key.push_back(static_cast<char>(method));
+    key.push_back('\0');
+    appendKeyPart(&key, request.path());
+    for (const std::string &name : varyHeaders_)
+    {
+        appendKeyPart(&key, request.header(name));
+    }
+    const auto it = snapshot->map->find(key);
+    if (it == snapshot->map->end())
+    {
+        misses_.inc();
+        return nullptr;
+    }
+    hits_.inc();
+    return it->second;
+}
@@ -0,0 +1,280 @@
+#include "HttpScanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MUDUO_HTTP_SCANNER_X86 1
+#endif
+
+namespace
+{
+    // RFC 9110 tchar: "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." / "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+    struct TokenTable
+    {
+        bool ok[256] = {};
+        constexpr TokenTable()
+        {
+            for (int c = '0'; c <= '9'; ++c) ok[c] = true;
+            for (int c = 'a'; c <= 'z'; ++c) ok[c] = true;
+            for (int c = 'A'; c <= 'Z'; ++c) ok[c] = true;
+            for (const char *p = "!#$%&'*+-.^_`|~"; *p; ++p) ok[static_cast<unsigned char>(*p)] = true;
+        }
+    };
+    constexpr TokenTable kToken;
+
+    // ---------------------------------------------------------------- 标量
+
+    const char *findHeaderEndScalar(const char *p, const char *end)
+    {
+        for (; end - p >= 4; ++p)
+        {
+            if (p[0] == '\r' && p[1] == '\n' && p[2] == '\r' && p[3] == '\n')
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    const char *skipTokenScalar(const char *p, const char *end)
+    {
+        while (p < end && kToken.ok[static_cast<unsigned char>(*p)])
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    // kStopAtSpace: request-target(遇到 <= 0x20 就停); 否则是 field value(HTAB 和空格放过)
+    template <bool kStopAtSpace>
+    const char *skipTextScalar(const char *p, const char *end)
+    {
+        for (; p < end; ++p)
+        {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            if (c == 0x7f || c < (kStopAtSpace ? 0x21 : 0x20))
+            {
+                if (kStopAtSpace || c != '\t')
+                {
+                    return p;
+                }
+            }
+        }
+        return end;
+    }
+
+#ifdef MUDUO_HTTP_SCANNER_X86
+    // ---------------------------------------------------------------- SSE2 / SSE4.2, 16 字节
+
+    __attribute__((target("sse4.2"))) const char *findHeaderEndSse42(const char *p, const char *end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        // 错开 0/1/2/3 字节各读一次, 四个比较结果按位与, 第 i 位为 1 就是 p+i 开始有 \r\n\r\n
+        while (end - p >= 16 + 3)
+        {
+            const __m128i m0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), cr);
+            const __m128i m1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1)), lf);
+            const __m128i m2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2)), cr);
+            const __m128i m3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 3)), lf);
+            const int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(m0, m1), _mm_and_si128(m2, m3)));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+            p += 16;
+        }
+        return findHeaderEndScalar(p, end);
+    }
+
+    __attribute__((target("sse4.2"))) const char *skipTokenSse42(const char *p, const char *end)
+    {
+        // 非 tchar 的区间(pcmpestri 的 RANGES 模式, 两两一对): 控制字符和空格、"、()、,、/、:;<=>?@、[\]、{ 到 0xff.
+        // 8 对正好 16 字节. 最后一对把 tchar 里的 | 和 ~ 也算进去了, 停下来之后再查一次表
+        alignas(16) static const char kRanges[16] = {
+            '\x00', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', '\xff',
+        };
+        const __m128i ranges = _mm_load_si128(reinterpret_cast<const __m128i *>(kRanges));
+        while (end - p >= 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const int idx = _mm_cmpestri(ranges, 16, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+            if (idx == 16)
+            {
+                p += 16;
+                continue;
+            }
+            p += idx;
+            if (!kToken.ok[static_cast<unsigned char>(*p)])
+            {
+                return p;
+            }
+            ++p;
+        }
+        return skipTokenScalar(p, end);
+    }
+
+    template <bool kStopAtSpace>
+    __attribute__((target("sse4.2"))) const char *skipTextSse42(const char *p, const char *end)
+    {
+        // 无符号 c <= limit 等价于 min(c, limit) == c
+        const __m128i limit = _mm_set1_epi8(kStopAtSpace ? 0x20 : 0x1f);
+        const __m128i del = _mm_set1_epi8(0x7f);
+        const __m128i tab = _mm_set1_epi8('\t');
+        while (end - p >= 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i bad = _mm_cmpeq_epi8(_mm_min_epu8(v, limit), v);
+            if (!kStopAtSpace)
+            {
+                bad = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), bad);
+            }
+            bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, del));
+            const int mask = _mm_movemask_epi8(bad);
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+            p += 16;
+        }
+        return skipTextScalar<kStopAtSpace>(p, end);
+    }
+
+    // ---------------------------------------------------------------- AVX2, 32 字节
+
+    __attribute__((target("avx2"))) const char *findHeaderEndAvx2(const char *p, const char *end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        while (end - p >= 32 + 3)
+        {
+            const __m256i m0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), cr);
+            const __m256i m1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1)), lf);
+            const __m256i m2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2)), cr);
+            const __m256i m3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 3)), lf);
+            const uint32_t mask = static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(m0, m1), _mm256_and_si256(m2, m3))));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return findHeaderEndSse42(p, end);
+    }
+
+    template <bool kStopAtSpace>
+    __attribute__((target("avx2"))) const char *skipTextAvx2(const char *p, const char *end)
+    {
+        const __m256i limit = _mm256_set1_epi8(kStopAtSpace ? 0x20 : 0x1f);
+        const __m256i del = _mm256_set1_epi8(0x7f);
+        const __m256i tab = _mm256_set1_epi8('\t');
+        while (end - p >= 32)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i bad = _mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v);
+            if (!kStopAtSpace)
+            {
+                bad = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), bad);
+            }
+            bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(v, del));
+            const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(bad));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return skipTextSse42<kStopAtSpace>(p, end);
+    }
+#endif
+}
+
+const HttpScanner::Impl HttpScanner::kScalarImpl = {
+    findHeaderEndScalar,
+    skipTokenScalar,
+    skipTextScalar<true>,
+    skipTextScalar<false>,
+};
+const HttpScanner::Impl *HttpScanner::impl_ = &HttpScanner::kScalarImpl;
+HttpScanner::Level HttpScanner::level_ = HttpScanner::Level::kScalar;
+
+namespace
+{
+    // 进程启动时选一次
+    struct HttpScannerInit
+    {
+        HttpScannerInit() { HttpScanner::setLevel(HttpScanner::preferred()); }
+    } g_httpScannerInit;
+}
+
+HttpScanner::Level HttpScanner::detect()
+{
+#ifdef MUDUO_HTTP_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Level::kAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return Level::kSse42;
+    }
+#endif
+    return Level::kScalar;
+}
+
+HttpScanner::Level HttpScanner::preferred()
+{
+    const Level best = detect();
+    return best == Level::kAvx2 ? Level::kSse42 : best;
+}
+
+const HttpScanner::Impl *HttpScanner::implFor(Level level)
+{
+#ifdef MUDUO_HTTP_SCANNER_X86
+    static const Impl kSse42Impl = {
+        findHeaderEndSse42,
+        skipTokenSse42,
+        skipTextSse42<true>,
+        skipTextSse42<false>,
+    };
+    // token 没有好用的 32 字节写法(pcmpestri 没有 AVX2 版), header name 又短, AVX2 档也用 SSE4.2 的
+    static const Impl kAvx2Impl = {
+        findHeaderEndAvx2,
+        skipTokenSse42,
+        skipTextAvx2<true>,
+        skipTextAvx2<false>,
+    };
+    switch (level)
+    {
+    case Level::kAvx2: return &kAvx2Impl;
+    case Level::kSse42: return &kSse42Impl;
+    case Level::kScalar: break;
+    }
+#else
+    (void)level;
+#endif
+    return &kScalarImpl;
+}
+
+void HttpScanner::setLevel(Level level)
+{
+    const Level best = detect();
+    if (static_cast<int>(level) > static_cast<int>(best))
+    {
+        level = best;
+    }
+    impl_ = implFor(level);
+    level_ = level;
+}
+
+const char *HttpScanner::levelName(Level level)
+{
+    switch (level)
+    {
+    case Level::kAvx2: return "avx2";
+    case Level::kSse42: return "sse4.2";
+    case Level::kScalar: return "scalar";
+    }
+    return "unknown";
+}
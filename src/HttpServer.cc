@@ -0,0 +1,288 @@
+#include <any>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+#include "HttpServer.h"
+#include "HttpContext.h"
+#include "Logger.h"
+
+HttpServer::HttpServer(EventLoop *loop,
+                       const InetAddress &listenAddr,
+                       const std::string &name,
+                       TcpServer::Option option)
+    : loop_(loop)
+    , server_(loop, listenAddr, name, option)
+    , httpCallback_([](const HttpRequest &, HttpResponse *resp) {
+        resp->setStatusCode(404);
+        resp->setBodyView("not found\n");
+    })
+{
+    server_.setConnectionCallback([this](const TcpConnectionPtr &conn) {
+        onConnection(conn);
+    });
+    server_.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) {
+        onMessage(conn, buf, receiveTime);
+    });
+    streamFinishCallback_ = [this](const TcpConnectionPtr &conn, bool close) {
+        onStreamFinished(conn, close);
+    };
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true); // 响应都是一次写完的, 不需要 Nagle 帮忙攒
+        conn->setContext(HttpContext(maxHeaderBytes_, maxBodyBytes_));
+    }
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+namespace
+{
+    /**
+     * 一批流水线请求的响应. 普通响应的头(和小的体)拷进 out; 缓存命中的条目和大块的体只记指针,
+     * flush 时按顺序拼成一次 writev, 不往 out/outputBuffer_ 里拷. out 可能扩容搬家, 所以它的那几段记偏移量.
+     **/
+    class ResponseBatch
+    {
+    public:
+        inline static constexpr size_t kMaxPieces = 256; // 攒到这么多块先发一次
+
+        Buffer &out() { return out_; }
+        // data 必须活到 flush
+        void gather(std::string_view data)
+        {
+            seal();
+            pieces_.push_back({data.data(), 0, data.size()});
+        }
+        void hold(HttpResponseCache::EntryPtr entry) { held_.push_back(std::move(entry)); }
+        bool full() const { return pieces_.size() >= kMaxPieces; }
+
+        void flush(const TcpConnectionPtr &conn)
+        {
+            seal();
+            if (pieces_.size() == 1 && pieces_[0].data == nullptr)
+            {
+                conn->send(&out_); // 全在 out 里, 最常见
+            }
+            else if (!pieces_.empty())
+            {
+                views_.clear();
+                for (const Piece &piece : pieces_)
+                {
+                    views_.emplace_back(piece.data ? piece.data : out_.peek() + piece.offset, piece.len);
+                }
+                conn->sendv(views_.data(), views_.size());
+            }
+            out_.retrieveAll();
+            pieces_.clear();
+            held_.clear();
+            sealed_ = 0;
+        }
+
+    private:
+        // out 里还没记进 pieces_ 的那段收成一块
+        void seal()
+        {
+            if (out_.readableBytes() > sealed_)
+            {
+                pieces_.push_back({nullptr, sealed_, out_.readableBytes() - sealed_});
+                sealed_ = out_.readableBytes();
+            }
+        }
+
+        struct Piece
+        {
+            const char *data; // nullptr 表示在 out_ 里, 从 offset 开始
+            size_t offset;
+            size_t len;
+        };
+        Buffer out_;
+        std::vector<Piece> pieces_;
+        std::vector<std::string_view> views_;
+        std::vector<HttpResponseCache::EntryPtr> held_; // 缓存条目活到 writev 之后
+        size_t sealed_ = 0;
+    };
+
+    constexpr std::string_view kConnectionClose = "Connection: close\r\n";
+    constexpr std::string_view kConnectionKeepAlive = "Connection: keep-alive\r\n";
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    HttpContext *context = std::any_cast<HttpContext>(conn->getMutableContext());
+    if (!conn->connected())
+    {
+        buf->retrieveAll(); // 已经在关了(出错或者 Connection: close), 后面的请求不再处理
+        return;
+    }
+    if (context->streaming())
+    {
+        return; // 流式响应还没写完, 流水线上后面的请求先留在缓冲区里, 写完了再接着处理
+    }
+
+    // 这一批请求的响应攒在一起, 最后一次发出去. 每个 loop 线程一个, 容量复用
+    thread_local ResponseBatch t_batch;
+    ResponseBatch &batch = t_batch;
+    Buffer &out = batch.out();
+    for (;;)
+    {
+        const HttpContext::Result result = context->parse(buf, receiveTime);
+        if (result == HttpContext::Result::kIncomplete)
+        {
+            if (context->takeExpectContinue())
+            {
+                out.append("HTTP/1.1 100 Continue\r\n\r\n", 25);
+            }
+            break;
+        }
+        if (result == HttpContext::Result::kError)
+        {
+            batch.flush(conn);
+            sendError(conn, &out, context->errorStatus());
+            buf->retrieveAll();
+            return;
+        }
+
+        const HttpRequest &request = context->request();
+        const bool head = request.method() == HttpRequest::Method::kHead;
+        if (upgradeCallback_ && !request.header("Upgrade").empty())
+        {
+            batch.flush(conn); // 前面流水线上的响应先发, 101 要排在它们后面
+            MessageCallback next = upgradeCallback_(conn, request);
+            if (next)
+            {
+                buf->retrieve(context->requestLength());
+                context->reset();
+                context->setStreaming(true); // 换回调之前再有数据来也不按 HTTP 解析了
+                // 不能在这里直接 setMessageCallback: 正在执行的就是旧的那个回调. 推迟到这一轮事件处理完
+                conn->getLoop()->queueInLoop([conn, next = std::move(next)] {
+                    conn->setContext(std::any()); // HttpContext 没用了
+                    conn->setMessageCallback(next);
+                    Buffer *input = conn->inputBuffer();
+                    if (conn->connected() && input->readableBytes() > 0)
+                    {
+                        next(conn, input, Timestamp::now());
+                    }
+                });
+                return;
+            }
+        }
+        if (responseCache_)
+        {
+            if (HttpResponseCache::EntryPtr entry = responseCache_->lookup(request))
+            {
+                const bool close = !request.keepAlive();
+                batch.gather(entry->head());
+                batch.gather(close ? kConnectionClose : kConnectionKeepAlive);
+                batch.gather(HttpResponse::dateHeader());
+                batch.gather(head ? entry->tail().substr(0, 2) : entry->tail());
+                batch.hold(std::move(entry));
+                buf->retrieve(context->requestLength());
+                context->reset();
+                if (close)
+                {
+                    batch.flush(conn);
+                    conn->shutdown();
+                    buf->retrieveAll();
+                    return;
+                }
+                if (batch.full())
+                {
+                    batch.flush(conn);
+                }
+                continue;
+            }
+        }
+
+        HttpResponse response(!request.keepAlive());
+        response.bindConnection(&conn, request.version() == HttpRequest::Version::kHttp11, &streamFinishCallback_);
+        httpCallback_(request, &response);
+
+        response.appendHeadTo(&out);
+        const std::string_view body = head ? std::string_view() : response.body();
+        if (response.streaming() && !body.empty())
+        {
+            // 第一块直接跟在头后面. HTTP/1.0 不分块, 原样发
+            if (response.chunkedAllowed_)
+            {
+                char size[32];
+                const int n = snprintf(size, sizeof(size), "%zx\r\n", body.size());
+                out.append(size, static_cast<size_t>(n));
+                out.append(body.data(), body.size());
+                out.append("\r\n", 2);
+            }
+            else
+            {
+                out.append(body.data(), body.size());
+            }
+        }
+        else if (body.size() <= kGatherThreshold)
+        {
+            out.append(body.data(), body.size());
+        }
+        else
+        {
+            // 大块的体不往 Buffer 里拷, 和前面攒的一起 writev. 体归 response 管, 出了这一轮就没了, 所以现在就发
+            batch.gather(body);
+            batch.flush(conn);
+        }
+        // 体可能是指向请求的视图, 发完(或拷进 outputBuffer_)之后才能 retrieve
+        buf->retrieve(context->requestLength());
+        context->reset();
+
+        if (response.closeConnection() && !response.streaming())
+        {
+            batch.flush(conn);
+            conn->shutdown();
+            buf->retrieveAll();
+            return;
+        }
+        if (response.streaming())
+        {
+            context->setStreaming(true);
+            break;
+        }
+        if (batch.full())
+        {
+            batch.flush(conn);
+        }
+    }
+    batch.flush(conn);
+}
+
+void HttpServer::onStreamFinished(const TcpConnectionPtr &conn, bool close)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    if (close)
+    {
+        conn->shutdown();
+        return;
+    }
+    HttpContext *context = std::any_cast<HttpContext>(conn->getMutableContext());
+    context->setStreaming(false);
+    if (conn->inputBuffer()->readableBytes() > 0)
+    {
+        onMessage(conn, conn->inputBuffer(), Timestamp::now());
+    }
+}
+
+void HttpServer::sendError(const TcpConnectionPtr &conn, Buffer *out, int status)
+{
+    HttpResponse response(true);
+    response.setStatusCode(status);
+    response.setContentType("text/plain");
+    response.setBody(std::string(HttpResponse::statusMessage(status)) + "\n");
+    response.appendHeadTo(out);
+    out->append(response.body().data(), response.body().size());
+    conn->send(out);
+    conn->shutdown();
+}
@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "Inspector.h"
+#include "EventLoop.h"
+#include "LoopStats.h"
+#include "TcpServer.h"
+#include "Logger.h"
+
+namespace
+{
+    // "a=1&b=2" 里取 key 的值, 没有返回空串
+    std::string queryValue(const std::string &query, const std::string &key)
+    {
+        size_t pos = 0;
+        while (pos <= query.size())
+        {
+            size_t end = query.find('&', pos);
+            if (end == std::string::npos)
+            {
+                end = query.size();
+            }
+            const size_t eq = query.find('=', pos);
+            if (eq != std::string::npos && eq < end && query.compare(pos, eq - pos, key) == 0 && eq - pos == key.size())
+            {
+                return query.substr(eq + 1, end - eq - 1);
+            }
+            pos = end + 1;
+        }
+        return std::string();
+    }
+
+    int queryInt(const std::string &query, const std::string &key, int defaultValue)
+    {
+        const std::string value = queryValue(query, key);
+        return value.empty() ? defaultValue : atoi(value.c_str());
+    }
+
+    bool readFile(const char *path, std::string *out)
+    {
+        FILE *fp = ::fopen(path, "re");
+        if (!fp)
+        {
+            return false;
+        }
+        char buf[4096];
+        size_t n;
+        while ((n = ::fread(buf, 1, sizeof(buf), fp)) > 0)
+        {
+            out->append(buf, n);
+        }
+        ::fclose(fp);
+        return true;
+    }
+
+    // 目录里除 . 和 .. 以外的项, 用来数 fd 和线程
+    std::vector<std::string> listDir(const char *path)
+    {
+        std::vector<std::string> names;
+        DIR *dir = ::opendir(path);
+        if (!dir)
+        {
+            return names;
+        }
+        while (dirent *entry = ::readdir(dir))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                names.emplace_back(entry->d_name);
+            }
+        }
+        ::closedir(dir);
+        return names;
+    }
+
+    struct ThreadCpu
+    {
+        std::string tid;
+        std::string comm;
+        int64_t ticks = 0; // utime + stime, 单位 clock tick
+    };
+
+    // /proc/self/task/<tid>/stat: "tid (comm) state ppid ... utime(14) stime(15) ..."
+    std::vector<ThreadCpu> sampleThreadCpu()
+    {
+        std::vector<ThreadCpu> threads;
+        for (const std::string &tid : listDir("/proc/self/task"))
+        {
+            std::string stat;
+            if (!readFile(("/proc/self/task/" + tid + "/stat").c_str(), &stat))
+            {
+                continue; // 线程刚退出
+            }
+            const size_t open = stat.find('(');
+            const size_t close = stat.rfind(')'); // comm 里可能有括号, 从后面找
+            if (open == std::string::npos || close == std::string::npos)
+            {
+                continue;
+            }
+            ThreadCpu t;
+            t.tid = tid;
+            t.comm = stat.substr(open + 1, close - open - 1);
+            unsigned long utime = 0, stime = 0;
+            if (::sscanf(stat.c_str() + close + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2)
+            {
+                t.ticks = static_cast<int64_t>(utime + stime);
+                threads.push_back(std::move(t));
+            }
+        }
+        return threads;
+    }
+
+    std::string formatMallinfo(const char *title, const struct mallinfo2 &mi)
+    {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%-8s in_use=%zu arena=%zu mmap=%zu free=%zu releasable=%zu\n",
+                 title, mi.uordblks, mi.arena, mi.hblkhd, mi.fordblks, mi.keepcost);
+        return buf;
+    }
+
+    // gperftools 的入口, 进程链接了 libprofiler/libtcmalloc 才找得到
+    template <typename Func>
+    Func findSymbol(const char *name)
+    {
+        return reinterpret_cast<Func>(::dlsym(RTLD_DEFAULT, name));
+    }
+}
+
+Inspector::Inspector(AdminServer *admin)
+    : state_(std::make_shared<State>())
+{
+    std::shared_ptr<State> state = state_;
+    admin->addHandler("/inspect/connections", [state](const std::string &query, const AdminServer::Responder &respond) {
+        respond(200, "text/plain", connections(*state, query));
+    });
+    admin->addHandler("/inspect/tcpinfo", [state](const std::string &query, const AdminServer::Responder &respond) {
+        respond(200, "text/plain", tcpInfo(*state, query));
+    });
+    admin->addHandler("/inspect/loops", [state](const std::string &, const AdminServer::Responder &respond) {
+        respond(200, "text/plain", loops(*state));
+    });
+    admin->addHandler("/inspect/proc", [](const std::string &, const AdminServer::Responder &respond) {
+        respond(200, "text/plain", process());
+    });
+    // handler 一定在 admin loop 里执行, 这时 admin 已经 start 过了
+    admin->addHandler("/pprof/profile", [state, admin](const std::string &query, const AdminServer::Responder &respond) {
+        cpuProfile(state, admin->getLoop(), queryInt(query, "seconds", 30), respond);
+    });
+    admin->addHandler("/pprof/heap", [state, admin](const std::string &query, const AdminServer::Responder &respond) {
+        heapProfile(state, admin->getLoop(), queryInt(query, "seconds", 30), respond);
+    });
+}
+
+Inspector::~Inspector()
+{
+    // 已经注册的 handler 还会继续工作, 只是看不到任何 server/loop 了
+    std::scoped_lock lock(state_->mutex);
+    state_->servers.clear();
+    state_->loops.clear();
+}
+
+void Inspector::addServer(TcpServer *server)
+{
+    std::scoped_lock lock(state_->mutex);
+    state_->servers.push_back(server);
+}
+
+void Inspector::removeServer(TcpServer *server)
+{
+    std::scoped_lock lock(state_->mutex);
+    auto &servers = state_->servers;
+    servers.erase(std::remove(servers.begin(), servers.end(), server), servers.end());
+}
+
+void Inspector::addLoop(EventLoop *loop)
+{
+    std::scoped_lock lock(state_->mutex);
+    state_->loops.push_back(loop);
+}
+
+void Inspector::removeLoop(EventLoop *loop)
+{
+    std::scoped_lock lock(state_->mutex);
+    auto &loops = state_->loops;
+    loops.erase(std::remove(loops.begin(), loops.end(), loop), loops.end());
+}
+
+std::string Inspector::connections(State &state, const std::string &query)
+{
+    const std::string serverName = queryValue(query, "server");
+    const size_t limit = static_cast<size_t>(std::max(queryInt(query, "limit", 1000), 0));
+    const Timestamp now = Timestamp::coarseNow();
+
+    // 持锁期间 server 不会被 removeServer, 所以整个拼接都在锁里
+    std::scoped_lock lock(state.mutex);
+    std::string out;
+    char line[512];
+    for (TcpServer *server : state.servers)
+    {
+        if (!serverName.empty() && server->name() != serverName)
+        {
+            continue;
+        }
+        std::vector<TcpConnectionPtr> conns = server->connectionsSnapshot();
+        // 存活最久的在前面, 泄漏/卡死的连接一眼就能看到
+        std::sort(conns.begin(), conns.end(), [](const TcpConnectionPtr &a, const TcpConnectionPtr &b) {
+            return a->createTime() < b->createTime();
+        });
+        snprintf(line, sizeof(line), "server %s %s connections=%zu\n",
+                 server->name().c_str(), server->ipPort().c_str(), conns.size());
+        out += line;
+        out += "  id                  loop     age_s     state           in_cap     out_queued out_cap    peer\n";
+        for (size_t i = 0; i < conns.size() && i < limit; ++i)
+        {
+            const TcpConnectionPtr &conn = conns[i];
+            snprintf(line, sizeof(line), "  %-19llu %-8d %-9.1f %-15s %-10zu %-10zu %-10zu %s%s\n",
+                     static_cast<unsigned long long>(conn->id()),
+                     conn->getLoop()->threadId(),
+                     timeDifference(now, conn->createTime()),
+                     conn->stateToString(),
+                     conn->inputBufferBytes(),
+                     conn->outputQueuedBytes(),
+                     conn->outputBufferBytes(),
+                     conn->peerAddress().toIpPort().c_str(),
+                     conn->pausedForBudget() ? " (paused by budget)" : "");
+            out += line;
+        }
+        if (conns.size() > limit)
+        {
+            snprintf(line, sizeof(line), "  ... %zu more\n", conns.size() - limit);
+            out += line;
+        }
+    }
+    return out;
+}
+
+std::string Inspector::tcpInfo(State &state, const std::string &query)
+{
+    const std::string serverName = queryValue(query, "server");
+    const size_t limit = static_cast<size_t>(std::max(queryInt(query, "limit", 100), 0));
+
+    std::scoped_lock lock(state.mutex);
+    std::string out;
+    for (TcpServer *server : state.servers)
+    {
+        if (!serverName.empty() && server->name() != serverName)
+        {
+            continue;
+        }
+        out += "server " + server->name() + " (last sampling round, setTcpInfoSampleInterval)\n";
+        out += server->tcpInfoStats().toString();
+
+        // 每个连接现查一次, 写队列堆得最多的在前面.
+        // outputQueuedBytes 在 io 线程里一直变, 先各读一次再排序, 比较器里现读会破坏严格弱序
+        std::vector<std::pair<size_t, TcpConnectionPtr>> queued;
+        for (TcpConnectionPtr &conn : server->connectionsSnapshot())
+        {
+            queued.emplace_back(conn->outputQueuedBytes(), std::move(conn));
+        }
+        std::sort(queued.begin(), queued.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+        for (size_t i = 0; i < queued.size() && i < limit; ++i)
+        {
+            const auto &[bytes, conn] = queued[i];
+            TcpInfoSample sample;
+            if (conn->getTcpInfo(&sample))
+            {
+                out += "  " + conn->peerAddress().toIpPort() + " out_queued=" +
+                       std::to_string(bytes) + " " + sample.toString() + "\n";
+            }
+        }
+    }
+    return out;
+}
+
+std::string Inspector::loops(State &state)
+{
+    std::scoped_lock lock(state.mutex);
+    std::vector<EventLoop *> loops = state.loops;
+    for (TcpServer *server : state.servers)
+    {
+        for (EventLoop *loop : server->loops())
+        {
+            if (std::find(loops.begin(), loops.end(), loop) == loops.end())
+            {
+                loops.push_back(loop);
+            }
+        }
+    }
+
+    std::string out;
+    char line[256];
+    for (EventLoop *loop : loops)
+    {
+        snprintf(line, sizeof(line), "loop %p tid=%d pending_functors=%zu iterations=%lld stats=%s\n",
+                 static_cast<void *>(loop), loop->threadId(), loop->queueSize(),
+                 static_cast<long long>(loop->iterations()), loop->statsEnabled() ? "on" : "off");
+        out += line;
+        if (loop->statsEnabled())
+        {
+            out += loop->stats().report();
+        }
+        out += loop->perfReport();
+    }
+    return out;
+}
+
+std::string Inspector::process()
+{
+    std::string out;
+    readFile("/proc/self/status", &out);
+    char line[128];
+    snprintf(line, sizeof(line), "OpenedFiles:\t%zu\n", listDir("/proc/self/fd").size());
+    out += line;
+    out += "Threads:\n";
+    for (const ThreadCpu &t : sampleThreadCpu())
+    {
+        snprintf(line, sizeof(line), "  %-8s %-16s cpu_ticks=%lld\n", t.tid.c_str(), t.comm.c_str(), static_cast<long long>(t.ticks));
+        out += line;
+    }
+    return out;
+}
+
+void Inspector::cpuProfile(const std::shared_ptr<State> &state, EventLoop *loop, int seconds, const AdminServer::Responder &respond)
+{
+    if (state->profiling)
+    {
+        respond(503, "text/plain", "another profiling window is running\n");
+        return;
+    }
+    seconds = std::clamp(seconds, 1, kMaxProfileSeconds);
+    state->profiling = true;
+
+    using ProfilerStartFunc = int (*)(const char *);
+    using ProfilerStopFunc = void (*)();
+    ProfilerStartFunc profilerStart = findSymbol<ProfilerStartFunc>("ProfilerStart");
+    ProfilerStopFunc profilerStop = findSymbol<ProfilerStopFunc>("ProfilerStop");
+    std::string profilePath;
+    if (profilerStart && profilerStop)
+    {
+        profilePath = "/tmp/muduo." + std::to_string(::getpid()) + "." +
+                      std::to_string(Timestamp::now().microSecondsSinceEpoch()) + ".prof";
+        if (!profilerStart(profilePath.c_str()))
+        {
+            LOG_ERROR("ProfilerStart(%s) failed\n", profilePath.c_str());
+            profilePath.clear();
+        }
+    }
+
+    const Timestamp start = Timestamp::now();
+    loop->runAfter(seconds, [state, respond, profilePath, profilerStop, start, before = sampleThreadCpu()] {
+        if (!profilePath.empty())
+        {
+            profilerStop();
+        }
+        state->profiling = false;
+
+        const double elapsed = timeDifference(Timestamp::now(), start);
+        const double ticksPerSecond = static_cast<double>(::sysconf(_SC_CLK_TCK));
+        struct Usage
+        {
+            const ThreadCpu *thread;
+            double percent;
+        };
+        const std::vector<ThreadCpu> after = sampleThreadCpu();
+        std::vector<Usage> usages;
+        for (const ThreadCpu &t : after)
+        {
+            int64_t ticks = t.ticks;
+            for (const ThreadCpu &b : before)
+            {
+                if (b.tid == t.tid)
+                {
+                    ticks -= b.ticks;
+                    break;
+                }
+            }
+            usages.push_back({&t, 100.0 * ticks / ticksPerSecond / elapsed});
+        }
+        std::sort(usages.begin(), usages.end(), [](const Usage &a, const Usage &b) { return a.percent > b.percent; });
+
+        std::string out;
+        char line[256];
+        snprintf(line, sizeof(line), "cpu profile window %.1fs\n", elapsed);
+        out += line;
+        for (const Usage &u : usages)
+        {
+            snprintf(line, sizeof(line), "  %-8s %-16s %6.1f%%\n", u.thread->tid.c_str(), u.thread->comm.c_str(), u.percent);
+            out += line;
+        }
+        out += profilePath.empty() ? "gperftools profiler not linked, per-thread usage only\n"
+                                   : "pprof file: " + profilePath + "\n";
+        respond(200, "text/plain", out);
+    });
+}
+
+void Inspector::heapProfile(const std::shared_ptr<State> &state, EventLoop *loop, int seconds, const AdminServer::Responder &respond)
+{
+    if (state->profiling)
+    {
+        respond(503, "text/plain", "another profiling window is running\n");
+        return;
+    }
+    seconds = std::clamp(seconds, 1, kMaxProfileSeconds);
+    state->profiling = true;
+
+    using HeapProfilerStartFunc = void (*)(const char *);
+    using HeapProfilerDumpFunc = void (*)(const char *);
+    using HeapProfilerStopFunc = void (*)();
+    HeapProfilerStartFunc heapStart = findSymbol<HeapProfilerStartFunc>("HeapProfilerStart");
+    HeapProfilerDumpFunc heapDump = findSymbol<HeapProfilerDumpFunc>("HeapProfilerDump");
+    HeapProfilerStopFunc heapStop = findSymbol<HeapProfilerStopFunc>("HeapProfilerStop");
+    std::string prefix;
+    if (heapStart && heapDump && heapStop)
+    {
+        prefix = "/tmp/muduo." + std::to_string(::getpid()) + "." +
+                 std::to_string(Timestamp::now().microSecondsSinceEpoch());
+        heapStart(prefix.c_str());
+    }
+
+    const Timestamp start = Timestamp::now();
+    loop->runAfter(seconds, [state, respond, prefix, heapDump, heapStop, start, before = ::mallinfo2()] {
+        if (!prefix.empty())
+        {
+            heapDump("inspector");
+            heapStop();
+        }
+        state->profiling = false;
+
+        const struct mallinfo2 after = ::mallinfo2();
+        std::string out;
+        char line[256];
+        snprintf(line, sizeof(line), "heap profile window %.1fs\n", timeDifference(Timestamp::now(), start));
+        out += line;
+        out += formatMallinfo("before", before);
+        out += formatMallinfo("after", after);
+        snprintf(line, sizeof(line), "delta    in_use=%+lld arena=%+lld mmap=%+lld\n",
+                 static_cast<long long>(after.uordblks) - static_cast<long long>(before.uordblks),
+                 static_cast<long long>(after.arena) - static_cast<long long>(before.arena),
+                 static_cast<long long>(after.hblkhd) - static_cast<long long>(before.hblkhd));
+        out += line;
+        out += prefix.empty() ? "tcmalloc heap profiler not linked, malloc counters only\n"
+                              : "heap profile: " + prefix + ".*.heap\n";
+        respond(200, "text/plain", out);
+    });
+}
@@ -0,0 +1,142 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "LogFile.h"
+
+LogFile::LogFile(const std::string &basename, off_t rollSize, int flushInterval, int checkEveryN, HeaderFunc header)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , checkEveryN_(checkEveryN)
+    , header_(std::move(header))
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *logline, size_t len)
+{
+    if (!fp_)
+    {
+        return;
+    }
+
+    // 后台线程独占这个 FILE, 用不加锁的版本
+    size_t written = 0;
+    while (written != len)
+    {
+        size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+        if (n == 0)
+        {
+            // 这里不能再打日志了, 会递归回到自己
+            int err = ::ferror(fp_);
+            if (err)
+            {
+                fprintf(stderr, "LogFile::append() failed %s\n", strerror(err));
+            }
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += static_cast<off_t>(written);
+
+    if (writtenBytes_ > rollSize_)
+    {
+        rollFile();
+        return;
+    }
+
+    if (++count_ >= checkEveryN_)
+    {
+        count_ = 0;
+        time_t now = ::time(nullptr);
+        time_t thisPeriod = now / kRollPerSeconds * kRollPerSeconds;
+        if (thisPeriod != startOfPeriod_)
+        {
+            rollFile();
+        }
+        else if (now - lastFlush_ > flushInterval_)
+        {
+            lastFlush_ = now;
+            ::fflush(fp_);
+        }
+    }
+}
+
+void LogFile::flush()
+{
+    if (fp_)
+    {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile()
+{
+    time_t now = 0;
+    std::string filename = getLogFileName(basename_, &now);
+    time_t start = now / kRollPerSeconds * kRollPerSeconds;
+
+    // 文件名精确到秒, 一秒内写满多次就继续写同一个文件, 避免覆盖
+    if (now <= lastRoll_)
+    {
+        return false;
+    }
+
+    FILE *fp = ::fopen(filename.c_str(), "ae"); // e: O_CLOEXEC
+    if (!fp)
+    {
+        fprintf(stderr, "LogFile::rollFile() open %s failed: %s\n", filename.c_str(), strerror(errno));
+        return false;
+    }
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof(buffer_));
+
+    lastRoll_ = now;
+    lastFlush_ = now;
+    startOfPeriod_ = start;
+    writtenBytes_ = 0;
+
+    if (header_)
+    {
+        std::string header = header_();
+        ::fwrite_unlocked(header.data(), 1, header.size(), fp_);
+        writtenBytes_ = static_cast<off_t>(header.size());
+    }
+    return true;
+}
+
+std::string LogFile::getLogFileName(const std::string &basename, time_t *now)
+{
+    std::string filename;
+    filename.reserve(basename.size() + 64);
+    filename = basename;
+
+    char timebuf[32];
+    tm tm_time{};
+    *now = ::time(nullptr);
+    gmtime_r(now, &tm_time);
+    strftime(timebuf, sizeof(timebuf), ".%Y%m%d-%H%M%S.", &tm_time);
+    filename += timebuf;
+
+    char hostname[256] = "unknownhost";
+    ::gethostname(hostname, sizeof(hostname) - 1);
+    filename += hostname;
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof(pidbuf), ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
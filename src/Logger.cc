@@ -1,4 +1,5 @@
-#include <iostream> // 虽然只有两个函数, 但也不适合放到头文件中, 因为这个iostream有点大, 影响编译速度.
+#include <cstdio>
+#include <cstring>
 
 #include "Logger.h"
 #include "Timestamp.h"
@@ -11,9 +12,13 @@ Logger &Logger::instance() // 又是一个单例
 
 void Logger::log(LogLevel level, const char* msg)
 {
-    if (level < logLevel_)
+    if (!enabled(level))
         return;
+    logf(level, "%s", msg);
+}
 
+size_t Logger::beginLine(LogLevel level)
+{
     const char* pre = nullptr;
     switch (level)
     {
@@ -31,5 +36,48 @@ void Logger::log(LogLevel level, const char* msg)
         break;
     }
 
-    fprintf(stdout, "%s%s : %s\n", pre, Timestamp::now().toString().c_str(), msg);
+    // 前缀直接拼进行缓冲, 时间部分走 Timestamp::formatTo 的按秒缓存, 不再构造临时 std::string
+    size_t len = strlen(pre);
+    memcpy(t_line, pre, len);
+    len += Timestamp::now().formatTo(t_line + len, kMaxLineSize - len);
+    memcpy(t_line + len, " : ", 3);
+    return len + 3;
+}
+
+void Logger::finishLine(LogLevel level, size_t prefixLen, int bodyLen)
+{
+    if (bodyLen < 0)
+    {
+        return;
+    }
+    size_t len = prefixLen + static_cast<size_t>(bodyLen);
+    if (len >= kMaxLineSize) // 被截断了, snprintf 写到了 kMaxLineSize - 1
+    {
+        len = kMaxLineSize - 1;
+    }
+    // 老代码的格式串大多自带 \n, 有了就不再补, 没有才加
+    if (len == 0 || t_line[len - 1] != '\n')
+    {
+        if (len == kMaxLineSize - 1)
+        {
+            --len;
+        }
+        t_line[len++] = '\n';
+    }
+    output_(t_line, len);
+
+    if (level == LogLevel::FATAL) // 马上要 exit 了, 异步后端里还没落盘的也要写出去
+    {
+        flush_();
+    }
+}
+
+void Logger::defaultOutput(const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, stdout);
+}
+
+void Logger::defaultFlush()
+{
+    ::fflush(stdout);
 }
@@ -0,0 +1,17 @@
+#include <cstdio>
+
+#include "LoopStats.h"
+
+std::string LoopStats::report() const
+{
+    std::string result;
+    result += "pollWaitNs          " + pollWaitNs.snapshot().toString() + "\n";
+    result += "dispatchNs          " + dispatchNs.snapshot().toString() + "\n";
+    result += "pendingFunctorsNs   " + pendingFunctorsNs.snapshot().toString() + "\n";
+    result += "eventsPerIteration  " + eventsPerIteration.snapshot().toString() + "\n";
+    result += "functorsPerIteration " + functorsPerIteration.snapshot().toString() + "\n";
+    char buf[64];
+    snprintf(buf, sizeof(buf), "slowCallbacks       %lu\n", slowCallbacks.load(std::memory_order_relaxed));
+    result += buf;
+    return result;
+}
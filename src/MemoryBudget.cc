@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "MemoryBudget.h"
+#include "CurrentThread.h"
+
+MemoryBudget &MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+MemoryBudget::Counter &MemoryBudget::localCounter()
+{
+    thread_local Counter *t_counter = nullptr;
+    if (__builtin_expect(t_counter == nullptr, 0)) // 每个线程只在第一次进来时登记
+    {
+        size_t index = numCounters_.fetch_add(1);
+        t_counter = index < kMaxCounters ? &counters_[index] : &overflow_;
+        t_counter->tid = CurrentThread::tid();
+    }
+    return *t_counter;
+}
+
+int64_t MemoryBudget::usedBytes() const
+{
+    const size_t n = std::min(numCounters_.load(std::memory_order_acquire), kMaxCounters);
+    int64_t total = overflow_.bytes.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i)
+    {
+        total += counters_[i].bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::string MemoryBudget::report() const
+{
+    std::string out;
+    char buf[128];
+    snprintf(buf, sizeof(buf), "limit=%ld used=%ld rejectedAccepts=%ld pausedReads=%ld pausedNow=%ld closedConnections=%ld\n",
+             limit(), usedBytes(), rejectedAccepts(), pausedReads(), pausedNow(), closedConnections());
+    out += buf;
+    const size_t n = std::min(numCounters_.load(std::memory_order_acquire), kMaxCounters);
+    for (size_t i = 0; i < n; ++i)
+    {
+        snprintf(buf, sizeof(buf), "  tid=%d bytes=%ld\n",
+                 counters_[i].tid.load(std::memory_order_relaxed),
+                 counters_[i].bytes.load(std::memory_order_relaxed));
+        out += buf;
+    }
+    return out;
+}
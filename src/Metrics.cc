@@ -0,0 +1,208 @@
+#include <cstdio>
+
+#include "Metrics.h"
+#include "Logger.h"
+
+int64_t Counter::value() const
+{
+    return MetricsRegistry::instance().sum(index_);
+}
+
+std::atomic<int64_t> *Counter::acquireThreadBlock()
+{
+    // 线程退出时把计数块还回注册表(局部类和本函数有一样的访问权限)
+    struct ThreadBlockHolder
+    {
+        std::atomic<int64_t> *block = nullptr;
+        ~ThreadBlockHolder()
+        {
+            if (block)
+            {
+                t_values = nullptr;
+                MetricsRegistry::instance().releaseBlock(block);
+            }
+        }
+    };
+    thread_local ThreadBlockHolder holder;
+
+    holder.block = MetricsRegistry::instance().acquireBlock();
+    return holder.block;
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    // 故意不析构: 线程退出(包括静态析构之后的)还会来还块
+    static MetricsRegistry *registry = new MetricsRegistry;
+    return *registry;
+}
+
+std::atomic<int64_t> *MetricsRegistry::acquireBlock()
+{
+    std::scoped_lock lock(mutex_);
+    if (!freeBlocks_.empty())
+    {
+        std::atomic<int64_t> *block = freeBlocks_.back();
+        freeBlocks_.pop_back();
+        return block;
+    }
+    blocks_.emplace_back(new std::atomic<int64_t>[kMaxSeries]());
+    return blocks_.back().get();
+}
+
+void MetricsRegistry::releaseBlock(std::atomic<int64_t> *block)
+{
+    std::scoped_lock lock(mutex_);
+    freeBlocks_.push_back(block);
+}
+
+int64_t MetricsRegistry::sum(uint32_t index)
+{
+    std::scoped_lock lock(mutex_);
+    int64_t total = 0;
+    for (const auto &block : blocks_)
+    {
+        total += block[index].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+MetricsRegistry::Family &MetricsRegistry::family(const std::string &name, const std::string &help, Type type)
+{
+    auto it = familyIndex_.find(name);
+    if (it != familyIndex_.end())
+    {
+        return families_[it->second];
+    }
+    familyIndex_[name] = families_.size();
+    families_.push_back(Family{name, help, type, {}});
+    return families_.back();
+}
+
+Counter MetricsRegistry::registerSeries(const std::string &name, const std::string &help, Type type, const std::string &labels)
+{
+    std::scoped_lock lock(mutex_);
+    Family &f = family(name, help, type);
+    for (const Series &s : f.series)
+    {
+        if (s.labels == labels && s.index != 0)
+        {
+            return Counter(s.index);
+        }
+    }
+    if (nextIndex_ >= kMaxSeries)
+    {
+        LOG_ERROR("MetricsRegistry: too many series, %s{%s} is not exported\n", name.c_str(), labels.c_str());
+        return Counter();
+    }
+    Series s;
+    s.labels = labels;
+    s.index = nextIndex_++;
+    f.series.push_back(std::move(s));
+    return Counter(f.series.back().index);
+}
+
+Counter MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    return registerSeries(name, help, Type::kCounter, labels);
+}
+
+Counter MetricsRegistry::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    return registerSeries(name, help, Type::kGauge, labels);
+}
+
+uint64_t MetricsRegistry::addCallbackGauge(const std::string &name, const std::string &help, const std::string &labels,
+                                           std::function<double()> callback)
+{
+    std::scoped_lock lock(mutex_);
+    Family &f = family(name, help, Type::kGauge);
+    Series s;
+    s.labels = labels;
+    s.callbackId = nextCallbackId_++;
+    s.callback = std::move(callback);
+    f.series.push_back(std::move(s));
+    return f.series.back().callbackId;
+}
+
+uint64_t MetricsRegistry::addCollector(std::function<void(std::string &)> collector)
+{
+    std::scoped_lock lock(mutex_);
+    const uint64_t id = nextCallbackId_++;
+    collectors_.emplace_back(id, std::move(collector));
+    return id;
+}
+
+void MetricsRegistry::remove(uint64_t callbackId)
+{
+    std::scoped_lock lock(mutex_);
+    for (Family &f : families_)
+    {
+        for (auto it = f.series.begin(); it != f.series.end(); ++it)
+        {
+            if (it->callbackId == callbackId)
+            {
+                f.series.erase(it);
+                return;
+            }
+        }
+    }
+    for (auto it = collectors_.begin(); it != collectors_.end(); ++it)
+    {
+        if (it->first == callbackId)
+        {
+            collectors_.erase(it);
+            return;
+        }
+    }
+}
+
+std::string MetricsRegistry::scrape()
+{
+    // 持锁期间执行回调: 回调里不能再注册/删除指标. remove() 也要拿这把锁, 所以回调返回前被捕获的对象不会析构
+    std::scoped_lock lock(mutex_);
+
+    // 先一次性把所有线程块加起来, 每个块顺序扫一遍, 不按 series 跳着读
+    std::vector<int64_t> totals(nextIndex_, 0);
+    for (const auto &block : blocks_)
+    {
+        for (uint32_t i = 1; i < nextIndex_; ++i)
+        {
+            totals[i] += block[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::string out;
+    out.reserve(4096);
+    char buf[64];
+    for (const Family &f : families_)
+    {
+        if (f.series.empty())
+        {
+            continue;
+        }
+        out += "# HELP " + f.name + " " + f.help + "\n";
+        out += "# TYPE " + f.name + (f.type == Type::kCounter ? " counter\n" : " gauge\n");
+        for (const Series &s : f.series)
+        {
+            out += f.name;
+            if (!s.labels.empty())
+            {
+                out += "{" + s.labels + "}";
+            }
+            if (s.callback)
+            {
+                snprintf(buf, sizeof(buf), " %.17g\n", s.callback());
+            }
+            else
+            {
+                snprintf(buf, sizeof(buf), " %ld\n", totals[s.index]);
+            }
+            out += buf;
+        }
+    }
+    for (const auto &[id, collector] : collectors_)
+    {
+        collector(out);
+    }
+    return out;
+}
@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PerfCounters.h"
+#include "Logger.h"
+
+namespace
+{
+    int perfEventOpen(uint64_t config, int groupFd)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = groupFd < 0 ? 1 : 0; // 组长先关着, 组员跟着组长开关
+        attr.exclude_kernel = 1;             // perf_event_paranoid=2 也允许, 只看我们自己的代码
+        attr.exclude_hv = 1;
+        // pid=0 cpu=-1: 本线程, 跟着线程跑到哪个核都计
+        return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    const uint64_t kConfigs[PerfCounters::kNumEvents] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+}
+
+const char *PerfCounters::eventName(int event)
+{
+    static const char *const kNames[kNumEvents] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+    return kNames[event];
+}
+
+const char *PerfCounters::categoryName(int category)
+{
+    static const char *const kNames[kNumCategories] = {"loop", "read_dispatch", "write", "pending_functors", "user_callback"};
+    return kNames[category];
+}
+
+PerfCounters::PerfCounters()
+{
+    const long pageSize = ::sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < kNumEvents; ++i)
+    {
+        fds_[i] = -1;
+        pages_[i] = nullptr;
+        if (i != kCycles && fds_[kCycles] < 0)
+        {
+            continue; // 组长都开不了, 其余的也不用试了
+        }
+        fds_[i] = perfEventOpen(kConfigs[i], i == kCycles ? -1 : fds_[kCycles]);
+        if (fds_[i] < 0)
+        {
+            // 虚拟机里常常只有 cycles/instructions, 缺的那一项就一直是 0
+            LOG_ERROR("PerfCounters: perf_event_open(%s) failed: %s\n", eventName(i), strerror(errno));
+            continue;
+        }
+        void *page = ::mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fds_[i], 0);
+        if (page != MAP_FAILED)
+        {
+            pages_[i] = static_cast<perf_event_mmap_page *>(page);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    if (t_current == this)
+    {
+        t_current = nullptr;
+    }
+    const long pageSize = ::sysconf(_SC_PAGESIZE);
+    // 组员先关, 组长最后
+    for (int i = kNumEvents - 1; i >= 0; --i)
+    {
+        if (pages_[i])
+        {
+            ::munmap(pages_[i], pageSize);
+        }
+        if (fds_[i] >= 0)
+        {
+            ::close(fds_[i]);
+        }
+    }
+}
+
+void PerfCounters::setActive(bool on)
+{
+    if (!valid())
+    {
+        return;
+    }
+    if (on)
+    {
+        ::ioctl(fds_[kCycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        for (int i = 0; i < kNumEvents; ++i)
+        {
+            last_[i] = readCounter(i);
+        }
+        category_ = kLoop;
+        t_current = this;
+    }
+    else
+    {
+        charge();
+        t_current = nullptr;
+        ::ioctl(fds_[kCycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+uint64_t PerfCounters::readCounter(int event) const
+{
+    if (fds_[event] < 0)
+    {
+        return 0;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    // 内核文档里的 rdpmc 读法: 用 lock 当 seqlock, index 为 0 表示当前没在 PMU 上(或不允许 rdpmc)
+    if (const perf_event_mmap_page *pc = pages_[event])
+    {
+        uint32_t seq;
+        uint64_t count = 0;
+        bool usable = false;
+        do
+        {
+            seq = pc->lock;
+            __asm__ __volatile__("" ::: "memory");
+            const uint32_t index = pc->index;
+            count = pc->offset;
+            usable = pc->cap_user_rdpmc && index != 0;
+            if (usable)
+            {
+                uint32_t lo, hi;
+                __asm__ __volatile__("rdpmc" : "=a"(lo), "=d"(hi) : "c"(index - 1));
+                const uint16_t width = pc->pmc_width;
+                int64_t pmc = static_cast<int64_t>((static_cast<uint64_t>(hi) << 32) | lo);
+                pmc <<= 64 - width; // 计数器只有 width 位, 符号扩展
+                pmc >>= 64 - width;
+                count += static_cast<uint64_t>(pmc);
+            }
+            __asm__ __volatile__("" ::: "memory");
+        } while (pc->lock != seq);
+        if (usable)
+        {
+            return count;
+        }
+    }
+#endif
+    uint64_t value = 0;
+    if (::read(fds_[event], &value, sizeof(value)) != sizeof(value))
+    {
+        return 0;
+    }
+    return value;
+}
+
+void PerfCounters::charge()
+{
+    for (int i = 0; i < kNumEvents; ++i)
+    {
+        const uint64_t now = readCounter(i);
+        std::atomic<uint64_t> &total = totals_[category_][i];
+        total.store(total.load(std::memory_order_relaxed) + (now - last_[i]), std::memory_order_relaxed);
+        last_[i] = now;
+    }
+}
+
+std::string PerfCounters::report() const
+{
+    if (!valid())
+    {
+        return "perf counters unavailable (perf_event_open failed)\n";
+    }
+    std::string out;
+    char line[256];
+    for (int c = 0; c < kNumCategories; ++c)
+    {
+        const double cycles = static_cast<double>(total(c, kCycles));
+        const double instructions = static_cast<double>(total(c, kInstructions));
+        const double perKilo = instructions > 0 ? 1000.0 / instructions : 0.0;
+        snprintf(line, sizeof(line), "perf %-16s cycles=%-14.0f instructions=%-14.0f ipc=%.2f cache_miss/ki=%.2f branch_miss/ki=%.2f\n",
+                 categoryName(c), cycles, instructions, cycles > 0 ? instructions / cycles : 0.0,
+                 static_cast<double>(total(c, kCacheMisses)) * perKilo,
+                 static_cast<double>(total(c, kBranchMisses)) * perKilo);
+        out += line;
+    }
+    return out;
+}
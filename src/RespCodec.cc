@@ -0,0 +1,589 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "RespCodec.h"
+#include "Buffer.h"
+
+namespace
+{
+    // from 开始找 "\r\n", 返回 '\r' 的位置, 没有返回 len
+    size_t findCrlf(const char *data, size_t len, size_t from)
+    {
+        while (from < len)
+        {
+            const void *cr = memchr(data + from, '\r', len - from);
+            if (cr == nullptr)
+            {
+                return len;
+            }
+            const size_t pos = static_cast<const char *>(cr) - data;
+            if (pos + 1 >= len)
+            {
+                return len; // '\n' 还没到
+            }
+            if (data[pos + 1] == '\n')
+            {
+                return pos;
+            }
+            from = pos + 1;
+        }
+        return len;
+    }
+
+    // 严格的十进制整数(可带负号), 不接受空串、空白和多余字符
+    bool parseInt(const char *begin, const char *end, int64_t *out)
+    {
+        if (begin == end)
+        {
+            return false;
+        }
+        const auto [ptr, ec] = std::from_chars(begin, end, *out);
+        return ec == std::errc() && ptr == end;
+    }
+
+    // 长度行("*3", "$5")最多这么长, 超过还没见到 \r\n 就是协议错误, 不用等
+    constexpr size_t kMaxLengthLine = 32;
+
+    // 先确保空间再 memcpy, 比连着几次 append 少几次检查
+    struct Appender
+    {
+        explicit Appender(Buffer *buf, size_t reserve) : buf(buf)
+        {
+            buf->ensureWritableBytes(reserve);
+            p = buf->beginWrite();
+        }
+        ~Appender() { buf->hasWritten(static_cast<size_t>(p - buf->beginWrite())); }
+
+        void put(char c) { *p++ = c; }
+        void put(const char *data, size_t len)
+        {
+            memcpy(p, data, len);
+            p += len;
+        }
+        void crlf()
+        {
+            p[0] = '\r';
+            p[1] = '\n';
+            p += 2;
+        }
+        void number(int64_t n) { p = std::to_chars(p, p + 20, n).ptr; }
+
+        Buffer *buf;
+        char *p;
+    };
+
+    // 类型字节 + 最长 20 位数字 + \r\n
+    constexpr size_t kMaxHeaderLen = 1 + 20 + 2;
+}
+
+bool RespCommand::is(std::string_view name) const
+{
+    const std::string_view cmd = argv_[0];
+    if (cmd.size() != name.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < cmd.size(); ++i)
+    {
+        // 只折 ASCII 字母, 命令名都是 ASCII
+        auto upper = [](char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c - 32) : c; };
+        if (upper(cmd[i]) != upper(name[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+RespContext::Result RespContext::parse(const char *data, size_t len, std::vector<std::string_view> *args, size_t *consumed)
+{
+    if (len == 0 || len < needBytes_)
+    {
+        return Result::kIncomplete;
+    }
+    needBytes_ = 0;
+    return data[0] == '*' ? parseMultiBulk(data, len, args, consumed) : parseInline(data, len, args, consumed);
+}
+
+RespContext::Result RespContext::parseMultiBulk(const char *data, size_t len, std::vector<std::string_view> *args, size_t *consumed)
+{
+    size_t lineEnd = findCrlf(data, len, 1);
+    if (lineEnd == len)
+    {
+        return len > kMaxLengthLine ? fail("invalid multibulk length") : Result::kIncomplete;
+    }
+    int64_t argc;
+    if (!parseInt(data + 1, data + lineEnd, &argc) || argc > static_cast<int64_t>(maxArgs_))
+    {
+        return fail("invalid multibulk length");
+    }
+    size_t pos = lineEnd + 2;
+    if (argc <= 0)
+    {
+        *consumed = pos; // "*0" / "*-1", 空命令
+        return Result::kComplete;
+    }
+
+    const size_t base = args->size();
+    for (int64_t i = 0; i < argc; ++i)
+    {
+        if (pos >= len)
+        {
+            args->resize(base);
+            return Result::kIncomplete;
+        }
+        if (data[pos] != '$')
+        {
+            args->resize(base);
+            return fail("expected '$'");
+        }
+        lineEnd = findCrlf(data, len, pos + 1);
+        if (lineEnd == len)
+        {
+            args->resize(base);
+            return len - pos > kMaxLengthLine ? fail("invalid bulk length") : Result::kIncomplete;
+        }
+        int64_t n;
+        if (!parseInt(data + pos + 1, data + lineEnd, &n) || n < 0 || static_cast<uint64_t>(n) > maxBulkBytes_)
+        {
+            args->resize(base);
+            return fail("invalid bulk length");
+        }
+        pos = lineEnd + 2;
+        const size_t bulkLen = static_cast<size_t>(n);
+        if (len < pos + bulkLen + 2)
+        {
+            // 大 value 分好几次到: 记住至少要多少字节, 没到之前别再从头解析
+            needBytes_ = pos + bulkLen + 2;
+            args->resize(base);
+            return Result::kIncomplete;
+        }
+        if (data[pos + bulkLen] != '\r' || data[pos + bulkLen + 1] != '\n')
+        {
+            args->resize(base);
+            return fail("invalid bulk terminator");
+        }
+        args->emplace_back(data + pos, bulkLen);
+        pos += bulkLen + 2;
+    }
+    *consumed = pos;
+    return Result::kComplete;
+}
+
+RespContext::Result RespContext::parseInline(const char *data, size_t len, std::vector<std::string_view> *args, size_t *consumed)
+{
+    const void *nl = memchr(data, '\n', std::min(len, kMaxInlineBytes + 1));
+    if (nl == nullptr)
+    {
+        return len > kMaxInlineBytes ? fail("too big inline request") : Result::kIncomplete;
+    }
+    const size_t lineLen = static_cast<const char *>(nl) - data;
+    size_t end = lineLen;
+    if (end > 0 && data[end - 1] == '\r')
+    {
+        --end;
+    }
+
+    const size_t base = args->size();
+    size_t pos = 0;
+    while (pos < end)
+    {
+        while (pos < end && (data[pos] == ' ' || data[pos] == '\t'))
+        {
+            ++pos;
+        }
+        const size_t start = pos;
+        while (pos < end && data[pos] != ' ' && data[pos] != '\t')
+        {
+            ++pos;
+        }
+        if (pos > start)
+        {
+            if (args->size() - base >= maxArgs_)
+            {
+                args->resize(base);
+                return fail("too many arguments");
+            }
+            args->emplace_back(data + start, pos - start);
+        }
+    }
+    *consumed = lineLen + 1;
+    return Result::kComplete;
+}
+
+void RespWriter::header(char type, int64_t n)
+{
+    Appender a(out_, kMaxHeaderLen);
+    a.put(type);
+    a.number(n);
+    a.crlf();
+}
+
+void RespWriter::status(std::string_view s)
+{
+    Appender a(out_, s.size() + 3);
+    a.put('+');
+    a.put(s.data(), s.size());
+    a.crlf();
+}
+
+void RespWriter::error(std::string_view msg)
+{
+    Appender a(out_, msg.size() + 3);
+    a.put('-');
+    a.put(msg.data(), msg.size());
+    a.crlf();
+}
+
+void RespWriter::integer(int64_t value)
+{
+    header(':', value);
+}
+
+void RespWriter::bulk(std::string_view value)
+{
+    Appender a(out_, kMaxHeaderLen + value.size() + 2);
+    a.put('$');
+    a.number(static_cast<int64_t>(value.size()));
+    a.crlf();
+    a.put(value.data(), value.size());
+    a.crlf();
+}
+
+void RespWriter::null()
+{
+    if (protocol_ >= 3)
+    {
+        out_->append("_\r\n", 3);
+    }
+    else
+    {
+        out_->append("$-1\r\n", 5);
+    }
+}
+
+void RespWriter::nullArray()
+{
+    if (protocol_ >= 3)
+    {
+        out_->append("_\r\n", 3);
+    }
+    else
+    {
+        out_->append("*-1\r\n", 5);
+    }
+}
+
+void RespWriter::array(size_t count)
+{
+    header('*', static_cast<int64_t>(count));
+}
+
+void RespWriter::map(size_t pairs)
+{
+    if (protocol_ >= 3)
+    {
+        header('%', static_cast<int64_t>(pairs));
+    }
+    else
+    {
+        header('*', static_cast<int64_t>(pairs * 2));
+    }
+}
+
+void RespWriter::set(size_t count)
+{
+    header(protocol_ >= 3 ? '~' : '*', static_cast<int64_t>(count));
+}
+
+void RespWriter::push(size_t count)
+{
+    header(protocol_ >= 3 ? '>' : '*', static_cast<int64_t>(count));
+}
+
+void RespWriter::boolean(bool value)
+{
+    if (protocol_ >= 3)
+    {
+        out_->append(value ? "#t\r\n" : "#f\r\n", 4);
+    }
+    else
+    {
+        out_->append(value ? ":1\r\n" : ":0\r\n", 4);
+    }
+}
+
+void RespWriter::doubleValue(double value)
+{
+    char text[32];
+    int n;
+    if (std::isinf(value))
+    {
+        n = snprintf(text, sizeof(text), value > 0 ? "inf" : "-inf");
+    }
+    else if (std::isnan(value))
+    {
+        n = snprintf(text, sizeof(text), "nan");
+    }
+    else
+    {
+        n = snprintf(text, sizeof(text), "%.17g", value);
+    }
+    if (protocol_ >= 3)
+    {
+        Appender a(out_, static_cast<size_t>(n) + 3);
+        a.put(',');
+        a.put(text, static_cast<size_t>(n));
+        a.crlf();
+    }
+    else
+    {
+        bulk(std::string_view(text, static_cast<size_t>(n)));
+    }
+}
+
+void RespWriter::appendCommand(Buffer *out, std::initializer_list<std::string_view> args)
+{
+    appendCommand(out, args.begin(), args.size());
+}
+
+void RespWriter::appendCommand(Buffer *out, const std::string_view *args, size_t count)
+{
+    size_t total = kMaxHeaderLen;
+    for (size_t i = 0; i < count; ++i)
+    {
+        total += kMaxHeaderLen + args[i].size() + 2;
+    }
+    Appender a(out, total);
+    a.put('*');
+    a.number(static_cast<int64_t>(count));
+    a.crlf();
+    for (size_t i = 0; i < count; ++i)
+    {
+        a.put('$');
+        a.number(static_cast<int64_t>(args[i].size()));
+        a.crlf();
+        a.put(args[i].data(), args[i].size());
+        a.crlf();
+    }
+}
+
+ssize_t RespReply::length(const char *data, size_t len)
+{
+    // 不递归: remaining 是还差几个值没看到, 聚合类型把子元素个数加进去
+    size_t pos = 0;
+    int64_t remaining = 1;
+    while (remaining > 0)
+    {
+        if (pos >= len)
+        {
+            return 0;
+        }
+        const char type = data[pos];
+        const size_t lineEnd = findCrlf(data, len, pos + 1);
+        if (lineEnd == len)
+        {
+            return 0;
+        }
+        const char *line = data + pos + 1;
+        const char *lineStop = data + lineEnd;
+        pos = lineEnd + 2;
+        --remaining;
+
+        int64_t n = 0;
+        switch (type)
+        {
+        case '+':
+        case '-':
+        case ',':
+        case '(':
+            break;
+        case '_':
+            if (line != lineStop)
+            {
+                return -1;
+            }
+            break;
+        case '#':
+            if (lineStop - line != 1 || (*line != 't' && *line != 'f'))
+            {
+                return -1;
+            }
+            break;
+        case ':':
+            if (!parseInt(line, lineStop, &n))
+            {
+                return -1;
+            }
+            break;
+        case '$':
+        case '!':
+        case '=':
+            if (!parseInt(line, lineStop, &n) || n < -1 || (n == -1 && type != '$'))
+            {
+                return -1;
+            }
+            if (n >= 0)
+            {
+                const size_t bulkLen = static_cast<size_t>(n);
+                if (len < pos + bulkLen + 2)
+                {
+                    return 0;
+                }
+                if (data[pos + bulkLen] != '\r' || data[pos + bulkLen + 1] != '\n')
+                {
+                    return -1;
+                }
+                pos += bulkLen + 2;
+            }
+            break;
+        case '*':
+        case '~':
+        case '>':
+        case '%':
+        case '|':
+            // 元素个数不可能超过剩下的字节数, 顺便挡住溢出
+            if (!parseInt(line, lineStop, &n) || n < -1 || (n == -1 && type != '*') || n > static_cast<int64_t>(len))
+            {
+                return -1;
+            }
+            if (n > 0)
+            {
+                // map/属性是 n 对; 属性后面还跟着它修饰的那个值
+                remaining += type == '%' ? 2 * n : type == '|' ? 2 * n + 1 : n;
+            }
+            else if (type == '|')
+            {
+                remaining += 1;
+            }
+            break;
+        default:
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(pos);
+}
+
+namespace
+{
+    // 已经确认 data 里是一个完整、格式正确的回复(RespReply::length), 这里不再检查格式
+    bool parseValue(const char *data, size_t len, size_t *pos, RespReply::Value *out, int depth)
+    {
+        using Type = RespReply::Type;
+        if (depth > RespReply::kMaxDepth)
+        {
+            return false;
+        }
+        for (;;)
+        {
+            const char type = data[*pos];
+            const char *line = data + *pos + 1;
+            const char *lineStop = data + findCrlf(data, len, *pos + 1);
+            *pos = static_cast<size_t>(lineStop - data) + 2;
+            int64_t n = 0;
+
+            switch (type)
+            {
+            case '|':
+            {
+                // 属性: 读掉丢弃, 接着解后面那个值
+                parseInt(line, lineStop, &n);
+                RespReply::Value ignored;
+                for (int64_t i = 0; i < 2 * n; ++i)
+                {
+                    if (!parseValue(data, len, pos, &ignored, depth + 1))
+                    {
+                        return false;
+                    }
+                }
+                continue;
+            }
+            case '+':
+                out->type = Type::kSimpleString;
+                out->str = std::string_view(line, lineStop - line);
+                return true;
+            case '-':
+                out->type = Type::kError;
+                out->str = std::string_view(line, lineStop - line);
+                return true;
+            case '(':
+                out->type = Type::kBigNumber;
+                out->str = std::string_view(line, lineStop - line);
+                return true;
+            case '_':
+                out->type = Type::kNull;
+                return true;
+            case '#':
+                out->type = Type::kBoolean;
+                out->integer = *line == 't';
+                return true;
+            case ':':
+                out->type = Type::kInteger;
+                parseInt(line, lineStop, &out->integer);
+                return true;
+            case ',':
+            {
+                out->type = Type::kDouble;
+                const std::string text(line, lineStop - line); // strtod 要 \0 结尾
+                out->number = strtod(text.c_str(), nullptr);
+                return true;
+            }
+            case '$':
+            case '!':
+            case '=':
+            {
+                parseInt(line, lineStop, &n);
+                if (n < 0)
+                {
+                    out->type = Type::kNull;
+                    return true;
+                }
+                out->type = type == '!' ? Type::kError : Type::kBulkString;
+                out->str = std::string_view(data + *pos, static_cast<size_t>(n));
+                if (type == '=' && out->str.size() >= 4)
+                {
+                    out->str.remove_prefix(4); // "txt:" / "mkd:"
+                }
+                *pos += static_cast<size_t>(n) + 2;
+                return true;
+            }
+            default: // * ~ > %
+            {
+                parseInt(line, lineStop, &n);
+                if (n < 0)
+                {
+                    out->type = Type::kNull;
+                    return true;
+                }
+                out->type = type == '*' ? Type::kArray : type == '~' ? Type::kSet : type == '>' ? Type::kPush : Type::kMap;
+                const size_t count = static_cast<size_t>(type == '%' ? 2 * n : n);
+                out->elements.resize(count);
+                for (RespReply::Value &element : out->elements)
+                {
+                    if (!parseValue(data, len, pos, &element, depth + 1))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            }
+        }
+    }
+}
+
+ssize_t RespReply::parse(const char *data, size_t len, Value *out)
+{
+    const ssize_t total = length(data, len);
+    if (total <= 0)
+    {
+        return total;
+    }
+    size_t pos = 0;
+    *out = Value();
+    return parseValue(data, static_cast<size_t>(total), &pos, out, 0) ? total : -1;
+}
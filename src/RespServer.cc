@@ -0,0 +1,190 @@
+#include <any>
+#include <string_view>
+#include <vector>
+
+#include "RespServer.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+RespServer::RespServer(EventLoop *loop,
+                       const InetAddress &listenAddr,
+                       const std::string &name,
+                       TcpServer::Option option)
+    : loop_(loop)
+    , server_(loop, listenAddr, name, option)
+    , commandHandler_([](const TcpConnectionPtr &, const RespCommand *, size_t count, RespWriter *reply) {
+        for (size_t i = 0; i < count; ++i)
+        {
+            reply->error("ERR unknown command");
+        }
+    })
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string server = "server=\"" + name + "\"";
+    commands_ = registry.counter("muduo_resp_commands_total", "RESP commands dispatched", server);
+    batches_ = registry.counter("muduo_resp_batches_total", "RESP command batches dispatched (one per flush)", server);
+    protocolErrors_ = registry.counter("muduo_resp_protocol_errors_total", "RESP connections closed on protocol errors", server);
+
+    server_.setConnectionCallback([this](const TcpConnectionPtr &conn) {
+        onConnection(conn);
+    });
+    server_.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) {
+        onMessage(conn, buf, receiveTime);
+    });
+}
+
+void RespServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true); // 回复都是一批一次写完的
+        conn->setContext(RespContext(maxBulkBytes_, maxArgs_));
+    }
+}
+
+namespace
+{
+    // 一批命令的参数和回复, 每个 loop 线程一个, 容量复用
+    struct CommandBatch
+    {
+        std::vector<std::string_view> args;            // 所有命令的参数首尾相连
+        std::vector<std::pair<size_t, size_t>> ranges; // 每条命令在 args 里的 [起点, 个数). args 会扩容, 解完再转成 RespCommand
+        std::vector<RespCommand> commands;
+        Buffer out;
+    };
+}
+
+void RespServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    RespContext *context = std::any_cast<RespContext>(conn->getMutableContext());
+    if (!conn->connected())
+    {
+        buf->retrieveAll(); // 已经在关了(QUIT 或者协议错误), 后面的命令不再处理
+        return;
+    }
+
+    thread_local CommandBatch t_batch;
+    CommandBatch &batch = t_batch;
+    for (;;)
+    {
+        batch.args.clear();
+        batch.ranges.clear();
+        batch.commands.clear();
+
+        // 1. 解出缓冲区里所有完整的命令(最多 kMaxBatch 条)
+        const char *data = buf->peek();
+        const size_t len = buf->readableBytes();
+        size_t consumed = 0;
+        RespContext::Result result = RespContext::Result::kIncomplete;
+        while (batch.ranges.size() < kMaxBatch)
+        {
+            const size_t before = batch.args.size();
+            size_t n = 0;
+            result = context->parse(data + consumed, len - consumed, &batch.args, &n);
+            if (result != RespContext::Result::kComplete)
+            {
+                break;
+            }
+            consumed += n;
+            if (batch.args.size() > before) // 空行和 "*0" 直接跳过
+            {
+                batch.ranges.emplace_back(before, batch.args.size() - before);
+            }
+        }
+        for (const auto &[begin, count] : batch.ranges)
+        {
+            batch.commands.emplace_back(batch.args.data() + begin, count);
+        }
+
+        // 2. 整批交给 CommandHandler, 遇到 HELLO/QUIT 在那儿切开
+        Buffer &out = batch.out;
+        bool quit = false;
+        size_t start = 0;
+        for (size_t i = 0; i <= batch.commands.size() && !quit; ++i)
+        {
+            const bool last = i == batch.commands.size();
+            const bool builtin = !last && (batch.commands[i].is("HELLO") || batch.commands[i].is("QUIT"));
+            if (!last && !builtin)
+            {
+                continue;
+            }
+            if (i > start)
+            {
+                RespWriter writer(&out, context->protocol()); // HELLO 可能刚换了协议版本, 每段重新取
+                commandHandler_(conn, batch.commands.data() + start, i - start, &writer);
+            }
+            start = i + 1;
+            if (builtin)
+            {
+                if (batch.commands[i].is("HELLO"))
+                {
+                    hello(conn, context, batch.commands[i], &out);
+                }
+                else
+                {
+                    out.append("+OK\r\n", 5);
+                    quit = true;
+                }
+            }
+        }
+        commands_.add(static_cast<int64_t>(batch.commands.size()));
+        batches_.inc();
+
+        // 3. 出错的话错误信息排在前面那些命令的回复后面, 一起发
+        const bool error = result == RespContext::Result::kError && !quit;
+        if (error)
+        {
+            protocolErrors_.inc();
+            RespWriter(&out, context->protocol()).error(std::string("ERR Protocol error: ") + context->error());
+            LOG_DEBUG("RespServer - %s protocol error: %s\n", conn->name().c_str(), context->error());
+        }
+        if (out.readableBytes() > 0)
+        {
+            conn->send(&out);
+        }
+        out.retrieveAll(); // 连接已经断了的话 send 不会取走
+        buf->retrieve(consumed);
+
+        if (error || quit)
+        {
+            conn->shutdown();
+            buf->retrieveAll();
+            return;
+        }
+        if (result != RespContext::Result::kComplete || !conn->connected())
+        {
+            return; // 剩下的不完整, 等下次读; 凑满 kMaxBatch 的话接着解下一批
+        }
+    }
+}
+
+void RespServer::hello(const TcpConnectionPtr &conn, RespContext *context, const RespCommand &cmd, Buffer *out)
+{
+    if (cmd.size() >= 2)
+    {
+        const std::string_view version = cmd[1];
+        if (version != "2" && version != "3")
+        {
+            RespWriter(out, context->protocol()).error("NOPROTO unsupported protocol version");
+            return;
+        }
+        context->setProtocol(version[0] - '0');
+    }
+    // AUTH/SETNAME 这些选项不认, 忽略. 回复的字段和 redis 一样, 客户端库握手时会看 proto
+    RespWriter writer(out, context->protocol());
+    writer.map(7);
+    writer.bulk("server");
+    writer.bulk("muduo");
+    writer.bulk("version");
+    writer.bulk("7.0.0");
+    writer.bulk("proto");
+    writer.integer(context->protocol());
+    writer.bulk("id");
+    writer.integer(static_cast<int64_t>(conn->id()));
+    writer.bulk("mode");
+    writer.bulk("standalone");
+    writer.bulk("role");
+    writer.bulk("master");
+    writer.bulk("modules");
+    writer.array(0);
+}
@@ -0,0 +1,251 @@
+#include <arpa/inet.h>
+#include <future>
+
+#include "RpcChannel.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+RpcChannel::RpcChannel(EventLoop *loop, const InetAddress &serverAddr, const std::string &name)
+    : loop_(loop)
+    , client_(loop, serverAddr, name)
+    , codec_(FrameCodec::Type::kFixed32, [this](const TcpConnectionPtr &, std::string_view frame, Timestamp) {
+        onFrame(frame);
+    })
+    , name_(name)
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string channel = "channel=\"" + name_ + "\"";
+    calls_ = registry.counter("muduo_rpc_client_calls_total", "RPC calls issued", channel);
+    timeouts_ = registry.counter("muduo_rpc_client_timeouts_total", "RPC calls that hit their deadline", channel);
+
+    client_.setConnectionCallback([this](const TcpConnectionPtr &conn) {
+        onConnection(conn);
+    });
+    client_.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) {
+        codec_.onMessage(conn, buf, receiveTime);
+    });
+}
+
+RpcChannel::~RpcChannel()
+{
+    auto teardown = [this] {
+        *alive_ = false;
+        if (deadlineTimerArmed_)
+        {
+            loop_->cancel(deadlineTimer_);
+        }
+        // 到 ~TcpClient 的 cleanupInLoop 之间还隔着别的 functor, 正在进行的 connect 可能在这中间完成,
+        // 新连接会带上捕获了 this 的回调. 先停掉 connector, 再把 client_ 上的回调也换掉
+        const ConnectionCallback ignoreConnection = [](const TcpConnectionPtr &) {};
+        const MessageCallback discardMessage = [](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); };
+        client_.stop();
+        client_.setConnectionCallback(ignoreConnection);
+        client_.setMessageCallback(discardMessage);
+        if (TcpConnectionPtr conn = client_.connection())
+        {
+            // TcpClient 析构时关掉连接, 关闭回调会晚一点在 loop 里跑, 那时候 this 已经没了, 先把捕获了 this 的回调换掉
+            conn->setConnectionCallback(ignoreConnection);
+            conn->setMessageCallback(discardMessage);
+        }
+        conn_.reset();
+        failAll(RpcStatus::kUnavailable);
+    };
+    if (loop_->isInLoopThread())
+    {
+        teardown();
+    }
+    else
+    {
+        std::promise<void> done;
+        loop_->runInLoop([&teardown, &done] {
+            teardown();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void RpcChannel::callEncoded(Buffer *frame, double timeoutSeconds, ResponseHandler &&handler)
+{
+    // 调用线程编码时 id 填的是 0, 这里补上: 长度 4 + kind/status/保留 4 + 方法 id 4 之后就是请求 id
+    const uint64_t id = nextId_++;
+    memcpy(frame->peek() + RpcFrame::kLengthBytes + 8, &id, sizeof(id));
+    batch_.append(frame->peek(), frame->readableBytes());
+    addPending(id, timeoutSeconds, std::move(handler));
+    scheduleFlush();
+}
+
+void RpcChannel::addPending(uint64_t id, double timeoutSeconds, ResponseHandler &&handler)
+{
+    calls_.inc();
+    Timestamp deadline;
+    if (timeoutSeconds > 0)
+    {
+        deadline = addTime(Timestamp::now(), timeoutSeconds);
+        if (deadlines_.size() > 2 * pending_.size() + 1024)
+        {
+            compactDeadlines(); // 完成的调用不从堆里删, 堆里大半是死的了就重建一次
+        }
+        deadlines_.emplace(deadline.microSecondsSinceEpoch(), id);
+        armDeadlineTimer();
+    }
+    pending_.emplace(id, Pending{std::move(handler), deadline});
+}
+
+void RpcChannel::scheduleFlush()
+{
+    if (!flushQueued_ && conn_)
+    {
+        flushQueued_ = true;
+        // 这一轮事件处理完再发, 同一轮里发起的调用合成一次 write
+        loop_->queueInLoop([this, alive = std::weak_ptr<bool>(alive_)] {
+            if (auto p = alive.lock(); p && *p)
+            {
+                flush();
+            }
+        });
+    }
+}
+
+void RpcChannel::flush()
+{
+    flushQueued_ = false;
+    if (conn_ && batch_.readableBytes() > 0)
+    {
+        conn_->send(&batch_);
+    }
+}
+
+void RpcChannel::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setTcpNoDelay(true);
+        conn_ = conn;
+        dropAbandoned();
+        flush(); // 连上之前攒下的调用
+    }
+    else
+    {
+        conn_.reset();
+        batch_.retrieveAll();
+        failAll(RpcStatus::kUnavailable);
+    }
+}
+
+void RpcChannel::dropAbandoned()
+{
+    // 没连上时攒在 batch_ 里的请求, 等连上的工夫可能已经超时回调过了; 再发出去服务端照样执行, 副作用就多了一次
+    Buffer live;
+    const char *p = batch_.peek();
+    const char *end = p + batch_.readableBytes();
+    while (p < end)
+    {
+        uint32_t be32;
+        memcpy(&be32, p, sizeof(be32));
+        const size_t len = RpcFrame::kLengthBytes + ntohl(be32);
+        uint64_t id;
+        memcpy(&id, p + RpcFrame::kLengthBytes + 8, sizeof(id));
+        if (pending_.count(id) > 0)
+        {
+            live.append(p, len);
+        }
+        p += len;
+    }
+    batch_.swap(live);
+}
+
+void RpcChannel::onFrame(std::string_view frame)
+{
+    RpcFrame::Header header;
+    std::string_view payload;
+    if (!RpcFrame::parse(frame, &header, &payload) || header.kind != RpcFrame::kResponse)
+    {
+        LOG_ERROR("RpcChannel[%s] - malformed frame from server, closing\n", name_.c_str());
+        if (conn_)
+        {
+            conn_->forceClose();
+        }
+        return;
+    }
+    const auto it = pending_.find(header.id);
+    if (it == pending_.end())
+    {
+        return; // 已经超时回调过了
+    }
+    // 先摘下来再回调: 回调里可能再发起调用, 改 pending_
+    ResponseHandler handler = std::move(it->second.handler);
+    pending_.erase(it);
+    RpcReader reader(payload);
+    handler(header.status, header.status == RpcStatus::kOk ? &reader : nullptr);
+}
+
+void RpcChannel::checkDeadlines()
+{
+    deadlineTimerArmed_ = false;
+    const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    while (!deadlines_.empty())
+    {
+        const auto [deadline, id] = deadlines_.top();
+        const auto it = pending_.find(id);
+        if (it == pending_.end())
+        {
+            deadlines_.pop(); // 已经完成了, 不管到没到期都扔掉
+            continue;
+        }
+        if (deadline > now)
+        {
+            break;
+        }
+        deadlines_.pop();
+        ResponseHandler handler = std::move(it->second.handler);
+        pending_.erase(it);
+        timeouts_.inc();
+        handler(RpcStatus::kDeadlineExceeded, nullptr);
+    }
+    if (!deadlines_.empty())
+    {
+        armDeadlineTimer(); // 回调里发起了新调用的话已经挂上了, 这里什么也不做
+    }
+}
+
+void RpcChannel::armDeadlineTimer()
+{
+    if (deadlineTimerArmed_)
+    {
+        return;
+    }
+    deadlineTimerArmed_ = true;
+    deadlineTimer_ = loop_->runAfter(kDeadlineTick, [this, alive = std::weak_ptr<bool>(alive_)] {
+        if (auto p = alive.lock(); p && *p)
+        {
+            checkDeadlines();
+        }
+    });
+}
+
+void RpcChannel::compactDeadlines()
+{
+    std::vector<Deadline> live;
+    live.reserve(pending_.size());
+    for (const auto &[id, call] : pending_)
+    {
+        if (call.deadline.valid())
+        {
+            live.emplace_back(call.deadline.microSecondsSinceEpoch(), id);
+        }
+    }
+    deadlines_ = decltype(deadlines_)(std::greater<Deadline>(), std::move(live));
+}
+
+void RpcChannel::failAll(RpcStatus status)
+{
+    // 先整个换出来再回调, 回调里发起的新调用进新的表
+    std::unordered_map<uint64_t, Pending> pending;
+    pending.swap(pending_);
+    deadlines_ = {};
+    for (auto &[id, call] : pending)
+    {
+        call.handler(status, nullptr);
+    }
+}
@@ -0,0 +1,65 @@
+#include "RpcCodec.h"
+
+const char *rpcStatusName(RpcStatus status)
+{
+    switch (status)
+    {
+    case RpcStatus::kOk:
+        return "ok";
+    case RpcStatus::kMethodNotFound:
+        return "method_not_found";
+    case RpcStatus::kBadMessage:
+        return "bad_message";
+    case RpcStatus::kDeadlineExceeded:
+        return "deadline_exceeded";
+    case RpcStatus::kUnavailable:
+        return "unavailable";
+    case RpcStatus::kInternal:
+        return "internal";
+    }
+    return "unknown";
+}
+
+size_t RpcFrame::begin(Buffer *out, const Header &header)
+{
+    const size_t start = out->readableBytes();
+    RpcWriter w(out);
+    w.fixed(uint32_t{0}); // 长度, finish 时回填
+    w.fixed(static_cast<uint8_t>(header.kind));
+    w.fixed(static_cast<uint8_t>(header.status));
+    w.fixed(uint16_t{0});
+    w.fixed(header.method);
+    w.fixed(header.id);
+    w.fixed(header.timeoutMs);
+    return start;
+}
+
+void RpcFrame::finish(Buffer *out, size_t start)
+{
+    // out 可能在写负载时扩容搬家了, 所以按偏移量回填
+    const uint32_t len = static_cast<uint32_t>(out->readableBytes() - start - kLengthBytes);
+    char *p = out->peek() + start;
+    p[0] = static_cast<char>(len >> 24);
+    p[1] = static_cast<char>(len >> 16);
+    p[2] = static_cast<char>(len >> 8);
+    p[3] = static_cast<char>(len);
+}
+
+bool RpcFrame::parse(std::string_view frame, Header *header, std::string_view *payload)
+{
+    RpcReader r(frame);
+    const uint8_t kind = r.fixed<uint8_t>();
+    const uint8_t status = r.fixed<uint8_t>();
+    r.fixed<uint16_t>();
+    header->method = r.fixed<uint32_t>();
+    header->id = r.fixed<uint64_t>();
+    header->timeoutMs = r.fixed<uint32_t>();
+    if (!r.ok() || kind > kResponse || status > static_cast<uint8_t>(RpcStatus::kInternal))
+    {
+        return false;
+    }
+    header->kind = static_cast<Kind>(kind);
+    header->status = static_cast<RpcStatus>(status);
+    *payload = frame.substr(kHeaderBytes);
+    return true;
+}
@@ -0,0 +1,131 @@
+#include "RpcServer.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+namespace
+{
+    // 一次 onMessage 里同步产生的回复攒在 out, 最后一次 send; 其余时候(异步回复)用 scratch. 每个线程一份.
+    // out 和同线程的 scratch 容量复用; 跨线程回复时 send 把 scratch 整个 swap 给了 loop, 下次从空 Buffer 重新长
+    struct ReplyBatch
+    {
+        const TcpConnection *conn = nullptr; // 正在处理哪个连接的请求
+        Buffer out;
+        Buffer scratch;
+    };
+    thread_local ReplyBatch t_replies;
+
+    Counter &lateReplies()
+    {
+        static Counter counter = MetricsRegistry::instance().counter("muduo_rpc_late_replies_total",
+                                                                     "RPC replies dropped because the deadline had passed or the connection was gone");
+        return counter;
+    }
+}
+
+bool RpcResponder::expired() const
+{
+    return deadline_.valid() && deadline_ < Timestamp::coarseNow();
+}
+
+void RpcResponder::fail(RpcStatus status)
+{
+    respond(status, [](RpcWriter &) {});
+}
+
+Buffer *RpcResponder::beginResponse(const TcpConnectionPtr &conn)
+{
+    ReplyBatch &batch = t_replies;
+    return batch.conn == conn.get() ? &batch.out : &batch.scratch;
+}
+
+void RpcResponder::endResponse(const TcpConnectionPtr &conn, Buffer *out)
+{
+    ReplyBatch &batch = t_replies;
+    if (out == &batch.scratch)
+    {
+        conn->send(out); // 跨线程时 swap 走, 不再拷
+        out->retrieveAll();
+    }
+}
+
+void RpcResponder::dropped(const TcpConnectionPtr &)
+{
+    lateReplies().inc();
+}
+
+RpcServer::RpcServer(EventLoop *loop,
+                     const InetAddress &listenAddr,
+                     const std::string &name,
+                     TcpServer::Option option)
+    : loop_(loop)
+    , server_(loop, listenAddr, name, option)
+    , codec_(FrameCodec::Type::kFixed32, [this](const TcpConnectionPtr &conn, std::string_view frame, Timestamp receiveTime) {
+        onFrame(conn, frame, receiveTime);
+    })
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string server = "server=\"" + name + "\"";
+    calls_ = registry.counter("muduo_rpc_server_calls_total", "RPC requests received", server);
+    notFound_ = registry.counter("muduo_rpc_server_method_not_found_total", "RPC requests for unknown methods", server);
+
+    server_.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setTcpNoDelay(true); // 回复都是一批一次写完的
+        }
+    });
+    server_.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime) {
+        onMessage(conn, buf, receiveTime);
+    });
+}
+
+void RpcServer::addMethod(uint32_t id, std::string_view name, Invoker invoker)
+{
+    auto [it, inserted] = methods_.try_emplace(id, Method{std::string(name), std::move(invoker)});
+    if (!inserted)
+    {
+        // 同名注册两次, 或者两个名字的哈希撞了. 都是写代码时就该发现的问题
+        LOG_FATAL("RpcServer - method %.*s conflicts with %s (id %u)\n",
+                  static_cast<int>(name.size()), name.data(), it->second.name.c_str(), id);
+    }
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    ReplyBatch &batch = t_replies;
+    batch.conn = conn.get();
+    codec_.onMessage(conn, buf, receiveTime);
+    batch.conn = nullptr;
+    if (batch.out.readableBytes() > 0)
+    {
+        conn->send(&batch.out);
+        batch.out.retrieveAll(); // 连接已经断了的话 send 不会取走
+    }
+}
+
+void RpcServer::onFrame(const TcpConnectionPtr &conn, std::string_view frame, Timestamp receiveTime)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    RpcFrame::Header header;
+    std::string_view payload;
+    if (!RpcFrame::parse(frame, &header, &payload) || header.kind != RpcFrame::kRequest)
+    {
+        LOG_ERROR("RpcServer - %s sent a malformed frame, closing\n", conn->name().c_str());
+        conn->forceClose();
+        return;
+    }
+    calls_.inc();
+    const Timestamp deadline = header.timeoutMs > 0 ? addTime(receiveTime, header.timeoutMs / 1000.0) : Timestamp();
+    const auto it = methods_.find(header.method);
+    if (it == methods_.end())
+    {
+        notFound_.inc();
+        RpcResponder(conn, header.id, deadline).fail(RpcStatus::kMethodNotFound);
+        return;
+    }
+    RpcReader reader(payload);
+    it->second.invoker(conn, header.id, deadline, reader);
+}
@@ -2,10 +2,13 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 
 #include "Socket.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "TcpInfo.h"
 
 Socket::~Socket()
 {
@@ -89,4 +92,28 @@ void Socket::setKeepAlive(bool on)
     // 这对于检测网络中失效的对等方非常有用。
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
-}
\ No newline at end of file
+}
+bool Socket::getTcpInfo(TcpInfoSample *sample) const
+{
+    tcp_info info{};
+    socklen_t len = sizeof(info);
+    if (::getsockopt(sockfd_, SOL_TCP, TCP_INFO, &info, &len) < 0)
+    {
+        return false;
+    }
+    sample->when = Timestamp::now();
+    sample->rttUs = info.tcpi_rtt;
+    sample->rttVarUs = info.tcpi_rttvar;
+    sample->rtoUs = info.tcpi_rto;
+    sample->cwnd = info.tcpi_snd_cwnd;
+    sample->ssthresh = info.tcpi_snd_ssthresh;
+    sample->mss = info.tcpi_snd_mss;
+    sample->unacked = info.tcpi_unacked;
+    sample->lost = info.tcpi_lost;
+    sample->retransmitting = info.tcpi_retransmits;
+    sample->totalRetrans = info.tcpi_total_retrans;
+    // 这两个拿不到不算失败, 留 0
+    ::ioctl(sockfd_, SIOCOUTQ, &sample->sendQueueBytes);
+    ::ioctl(sockfd_, SIOCINQ, &sample->recvQueueBytes);
+    return true;
+}
@@ -0,0 +1,161 @@
+#include <future>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+    if (loop == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d loop is null!\n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop))
+    , connector_(std::make_shared<Connector>(loop, serverAddr))
+    , name_(nameArg)
+    , namePrefix_(std::make_shared<const std::string>(name_ + ":" + serverAddr.toIpPort()))
+    , connectionCallback_([](const TcpConnectionPtr &) {}) // TcpConnection 建立/断开时直接调用, 不能为空
+    , retry_(false)
+    , connect_(true)
+    , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback([this](int sockfd) {
+        newConnection(sockfd);
+    });
+    LOG_INFO("TcpClient::TcpClient[%s] - connector %p\n", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient()
+{
+    LOG_INFO("TcpClient::~TcpClient[%s] - connector %p\n", name_.c_str(), connector_.get());
+    // 原版在这里跨线程改 closeCallback(注释里自己也说不是100%安全), 这里统一切到loop线程里做完再返回
+    if (loop_->isInLoopThread())
+    {
+        cleanupInLoop();
+    }
+    else
+    {
+        std::promise<void> done;
+        loop_->runInLoop([this, &done] {
+            cleanupInLoop();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+void TcpClient::cleanupInLoop()
+{
+    connect_ = false;
+    TcpConnectionPtr conn;
+    {
+        std::scoped_lock lock(mutex_);
+        conn = std::move(connection_);
+    }
+    if (conn)
+    {
+        // 连接可能比 TcpClient 活得久(用户还拿着), 关闭时别再回调 removeConnection
+        conn->setCloseCallback([](const TcpConnectionPtr &c) {
+            c->getLoop()->queueInLoop([c] { c->connectDestroyed(); });
+        });
+        if (conn.use_count() == 1)
+        {
+            conn->forceClose();
+        }
+    }
+    // 新连接回调捕获了 this, 先摘掉; Connector 本身由 shared_ptr 管, 还有重试定时器/待执行的回调引用它也没关系
+    connector_->setNewConnectionCallback([](int sockfd) { ::close(sockfd); });
+    connector_->stop();
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s\n", name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::scoped_lock lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    sockaddr_in peer{};
+    sockaddr_in local{};
+    socklen_t addrlen = sizeof(peer);
+    if (::getpeername(sockfd, (sockaddr *)&peer, &addrlen) < 0)
+    {
+        LOG_ERROR("TcpClient::newConnection getpeername");
+    }
+    addrlen = sizeof(local);
+    if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
+    {
+        LOG_ERROR("TcpClient::newConnection getsockname");
+    }
+
+    TcpConnectionPtr conn = std::make_shared<TcpConnection>(loop_,
+                                                            namePrefix_,
+                                                            nextConnId_++,
+                                                            sockfd,
+                                                            InetAddress(local),
+                                                            InetAddress(peer));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    if (highWaterMarkCallback_)
+    {
+        conn->setHighWaterMarkCallback(highWaterMarkCallback_, highWaterMark_);
+    }
+    conn->setCloseCallback([this](const TcpConnectionPtr &c) {
+        removeConnection(c);
+    });
+    {
+        std::scoped_lock lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    {
+        std::scoped_lock lock(mutex_);
+        if (connection_ == conn)
+        {
+            connection_.reset();
+        }
+    }
+
+    // 和 TcpServer 一样, 当前还在 handleClose 里, connectDestroyed 放到这一轮的 pendingFunctors 里
+    loop_->queueInLoop([conn] { conn->connectDestroyed(); });
+    if (retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::removeConnection[%s] - reconnecting to %s\n", name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+    else
+    {
+        // 不重连的话 Connector 还停在 kConnected, 之后再 connect() 会被当成重复 start 忽略掉
+        connector_->resetState();
+    }
+}
@@ -1,18 +1,23 @@
 #include <functional>
 #include <string>
+#include <utility>
 #include <cerrno>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <fcntl.h> // for open
 #include <unistd.h> // for close
 
 #include "TcpConnection.h"
 #include "Logger.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "MemoryBudget.h"
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -28,15 +33,43 @@ TcpConnection::TcpConnection(EventLoop *loop,
                              int sockfd,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
+    : TcpConnection(loop, nameArg, nullptr, 0, sockfd, localAddr, peerAddr)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                             std::shared_ptr<const std::string> namePrefix,
+                             uint64_t sequence,
+                             int sockfd,
+                             const InetAddress &localAddr,
+                             const InetAddress &peerAddr)
+    : TcpConnection(loop, std::string(), std::move(namePrefix), sequence, sockfd, localAddr, peerAddr)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                             const std::string &nameArg,
+                             std::shared_ptr<const std::string> namePrefix,
+                             uint64_t sequence,
+                             int sockfd,
+                             const InetAddress &localAddr,
+                             const InetAddress &peerAddr)
     : loop_(CheckLoopNotNull(loop))
     , name_(nameArg)
+    , namePrefix_(std::move(namePrefix))
+    , sequence_(sequence)
+    , id_(0)
     , state_(kConnecting)
-    , reading_(true)
+    , createTime_(Timestamp::coarseNow())
+    , readPauseMask_(0)
+    , backpressureHolds_(0)
     , socket_(std::make_unique<Socket>(sockfd))
     , channel_(std::make_unique<Channel>(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024) // 64M
+    , lowWaterMark_(0) // 默认发空了才算降到低水位
+    , aboveHighWaterMark_(false)
 {
     channel_->setReadCallback([this](Timestamp receiveTime){
         handleRead(receiveTime);
@@ -44,14 +77,41 @@ TcpConnection::TcpConnection(EventLoop *loop,
     channel_->setWriteCallback([this] { handleWrite(); });
     channel_->setCloseCallback([this] { handleClose(); });
     channel_->setErrorCallback([this] { handleError(); });
+    channel_->setDescribeCallback([this] { return "conn " + name(); });
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
+    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name().c_str(), sockfd);
     socket_->setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), channel_->fd(), (int)state_);
+    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name().c_str(), channel_->fd(), (int)state_);
+}
+
+std::string TcpConnection::name() const
+{
+    if (!namePrefix_)
+    {
+        return name_;
+    }
+    return *namePrefix_ + "#" + std::to_string(sequence_);
+}
+
+const char *TcpConnection::stateToString() const
+{
+    switch (state_)
+    {
+    case kDisconnected:
+        return "kDisconnected";
+    case kConnecting:
+        return "kConnecting";
+    case kConnected:
+        return "kConnected";
+    case kDisconnecting:
+        return "kDisconnecting";
+    default:
+        return "unknown state";
+    }
 }
 
 void TcpConnection::setTcpNoDelay(bool on)
@@ -59,6 +119,27 @@ void TcpConnection::setTcpNoDelay(bool on)
     socket_->setTcpNoDelay(on);
 }
 
+int TcpConnection::fd() const
+{
+    return channel_->fd();
+}
+
+bool TcpConnection::getTcpInfo(TcpInfoSample *sample) const
+{
+    return socket_->getTcpInfo(sample);
+}
+
+const TcpInfoSample &TcpConnection::sampleTcpInfo()
+{
+    TcpInfoSample sample;
+    if (socket_->getTcpInfo(&sample))
+    {
+        sample.newRetrans = tcpInfo_.when.valid() ? sample.totalRetrans - tcpInfo_.totalRetrans : 0;
+        tcpInfo_ = sample;
+    }
+    return tcpInfo_;
+}
+
 /*
 我感觉send非常关键啊, 
 1. 目前代码中send是在OnMessage中调用的, 而OnMessage回调, 从main函数->TcpServer->TcpConnection->channel这样一层层传递回调的. 
@@ -86,6 +167,7 @@ void onMessage(...) {
         conn->send(result); 
     });
 }
+   库里现在自带了 WorkStealingPool, 上面的写法对应 pool.offload(conn->getLoop(), work, continuation), continuation 直接回到 subLoop 执行.
 4. 最后是buf的生命周期问题, 施磊老师重构的muduo, 没考虑清楚这一点, 应该参考muduo源码, buf要额外处理. 我把buf命名成message, 并已处理.
 5. isInLoopThread()的逻辑已经在runInLoop中有了, 不可以直接调用loop_->runInLoop吗? 我一开始就是从这个逻辑点, 延伸出这么一大片逻辑思考. 这里这样做是性能优化.
 */
@@ -147,6 +229,8 @@ void TcpConnection::send(Buffer* buf)
  **/
 void TcpConnection::sendInLoop(const void *data, size_t len)
 {
+    TraceScope trace("sendInLoop", len);
+    PerfScope perf(PerfCounters::kWrite);
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
@@ -164,6 +248,11 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         if (nwrote >= 0)
         {
             remaining = len - nwrote;
+            metrics_.bytesSent.add(nwrote);
+            if (remaining > 0) // 内核发送缓冲区满了, 剩下的要进 outputBuffer_
+            {
+                metrics_.writeEagain.inc();
+            }
             if (remaining == 0 && writeCompleteCallback_)
             {
                 // 既然在这里数据全部发送完成，就不用再给channel设置epollout事件了
@@ -177,7 +266,11 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         else // nwrote < 0
         {
             nwrote = 0;
-            if (errno != EWOULDBLOCK) // EWOULDBLOCK表示非阻塞情况下没有数据后的正常返回 等同于EAGAIN
+            if (errno == EWOULDBLOCK)
+            {
+                metrics_.writeEagain.inc();
+            }
+            else // EWOULDBLOCK表示非阻塞情况下没有数据后的正常返回 等同于EAGAIN
             {
                 LOG_ERROR("TcpConnection::sendInLoop");
                 if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE RESET
@@ -194,18 +287,144 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     // 卡码笔记有些傻逼注释, 不会写就别写, 我已经删除. 所以学东西要学一手的, 二手的什么垃圾.
     if (!faultError && remaining > 0)
     {
-        // 目前发送缓冲区剩余的待发送的数据的长度
-        size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) // testserver中没设置这个回调, 程序比较简单, 不用也罢. 但  在生产环境中，不设置高水位回调是一个巨大的隐患，可能会导致内存耗尽（OOM）。
+        appendOutput((const char *)data + nwrote, remaining);
+    }
+}
+
+void TcpConnection::appendOutput(const char *data, size_t len)
+{
+    // 目前发送缓冲区剩余的待发送的数据的长度
+    size_t oldLen = outputBuffer_.readableBytes();
+    if (oldLen + len >= highWaterMark_ && oldLen < highWaterMark_) // testserver中没设置这个回调, 程序比较简单, 不用也罢. 但  在生产环境中，不设置高水位回调是一个巨大的隐患，可能会导致内存耗尽（OOM）。
+    {
+        onOutputAboveHighWaterMark(oldLen + len);
+    }
+    outputBuffer_.append(data, len);
+    outputQueuedBytes_.store(outputBuffer_.readableBytes(), std::memory_order_relaxed);
+    if (!channel_->isWriting())
+    {
+        channel_->enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+    }
+    updateMemoryAccounting(); // append可能扩容
+}
+
+void TcpConnection::sendv(std::string_view head, std::string_view body)
+{
+    const std::string_view pieces[2] = {head, body};
+    sendv(pieces, 2);
+}
+
+void TcpConnection::sendv(const std::string_view *pieces, size_t count)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendvInLoop(pieces, count);
+        }
+        else
         {
-            loop_->queueInLoop([self = shared_from_this(), waterMark = oldLen + remaining] {
-                self->highWaterMarkCallback_(self, waterMark);
+            size_t total = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                total += pieces[i].size();
+            }
+            std::string msg;
+            msg.reserve(total);
+            for (size_t i = 0; i < count; ++i)
+            {
+                msg.append(pieces[i]);
+            }
+            loop_->runInLoop([self = shared_from_this(), msg = std::move(msg)] {
+                self->sendInLoop(msg.data(), msg.size());
             });
         }
-        outputBuffer_.append((char *)data + nwrote, remaining);
-        if (!channel_->isWriting())
+    }
+}
+
+void TcpConnection::sendvInLoop(const std::string_view *pieces, size_t count)
+{
+    TraceScope trace("sendvInLoop", count);
+    PerfScope perf(PerfCounters::kWrite);
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+
+    size_t done = 0;    // 完整写出去的块数
+    size_t partial = 0; // 第 done 块写出去的字节数
+    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    {
+        iovec vec[64];
+        while (done < count)
         {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+            int n = 0;
+            size_t batchBytes = 0;
+            for (size_t i = done; i < count && n < 64; ++i)
+            {
+                if (pieces[i].empty())
+                {
+                    continue;
+                }
+                vec[n].iov_base = const_cast<char *>(pieces[i].data());
+                vec[n].iov_len = pieces[i].size();
+                batchBytes += pieces[i].size();
+                ++n;
+            }
+            if (n == 0)
+            {
+                done = count; // 剩下的全是空块
+                break;
+            }
+            const ssize_t wrote = ::writev(channel_->fd(), vec, n);
+            if (wrote < 0)
+            {
+                if (errno == EWOULDBLOCK)
+                {
+                    metrics_.writeEagain.inc();
+                    break;
+                }
+                LOG_ERROR("TcpConnection::sendvInLoop");
+                if (errno == EPIPE || errno == ECONNRESET)
+                {
+                    return;
+                }
+                break;
+            }
+            metrics_.bytesSent.add(wrote);
+            // 按块推进 done/partial
+            size_t left = static_cast<size_t>(wrote);
+            while (done < count && left >= pieces[done].size())
+            {
+                left -= pieces[done].size();
+                ++done;
+            }
+            partial = left;
+            if (static_cast<size_t>(wrote) < batchBytes)
+            {
+                metrics_.writeEagain.inc(); // 内核发送缓冲区满了
+                break;
+            }
+        }
+        if (done == count)
+        {
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop([self = shared_from_this()] {
+                    self->writeCompleteCallback_(self);
+                });
+            }
+            return;
+        }
+    }
+    // 写了一部分(或者前面还有积压), 剩下的按顺序进 outputBuffer_
+    for (size_t i = done; i < count; ++i)
+    {
+        const size_t skip = i == done ? partial : 0;
+        if (pieces[i].size() > skip)
+        {
+            appendOutput(pieces[i].data() + skip, pieces[i].size() - skip);
         }
     }
 }
@@ -229,6 +448,165 @@ void TcpConnection::shutdownInLoop()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // queueInLoop而不是runInLoop: 可能正在本连接的回调里调用, 推迟到这一轮事件处理完
+        loop_->queueInLoop([self = shared_from_this()] { self->forceCloseInLoop(); });
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose(); // 和对端关闭走同一条路径, 最终由TcpServer::removeConnection回收
+    }
+}
+
+void TcpConnection::startRead(ReadPauseReason reason)
+{
+    loop_->runInLoop([self = shared_from_this(), reason] { self->startReadInLoop(reason); });
+}
+
+void TcpConnection::stopRead(ReadPauseReason reason)
+{
+    loop_->runInLoop([self = shared_from_this(), reason] { self->stopReadInLoop(reason); });
+}
+
+void TcpConnection::startReadInLoop(uint8_t reason)
+{
+    readPauseMask_ &= static_cast<uint8_t>(~reason);
+    // 连接已经断开的话 channel 已经从 poller 移除了, 不能再 enable, 否则会被重新注册进 epoll
+    if (state_ != kConnected && state_ != kDisconnecting)
+    {
+        return;
+    }
+    if (readPauseMask_ == 0 && !channel_->isReading()) // 还有别的原因停着就继续停着
+    {
+        channel_->enableReading();
+    }
+}
+
+void TcpConnection::stopReadInLoop(uint8_t reason)
+{
+    readPauseMask_ |= reason;
+    if (state_ != kConnected && state_ != kDisconnecting)
+    {
+        return;
+    }
+    if (channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::holdForBackpressure()
+{
+    loop_->runInLoop([self = shared_from_this()] {
+        if (++self->backpressureHolds_ == 1)
+        {
+            self->stopReadInLoop(kPauseByBackpressure);
+        }
+    });
+}
+
+void TcpConnection::releaseBackpressure()
+{
+    loop_->runInLoop([self = shared_from_this()] {
+        if (self->backpressureHolds_ > 0 && --self->backpressureHolds_ == 0)
+        {
+            self->startReadInLoop(kPauseByBackpressure);
+        }
+    });
+}
+
+void TcpConnection::addBackpressurePeer(const TcpConnectionPtr &upstream)
+{
+    backpressurePeers_.push_back(upstream);
+    if (aboveHighWaterMark_) // 加进来时已经堆积了, 和其它上游一样压住, 降到低水位时一起松开
+    {
+        upstream->holdForBackpressure();
+    }
+}
+
+void TcpConnection::setWantWritable(bool on)
+{
+    if (state_ != kConnected && state_ != kDisconnecting)
+    {
+        return;
+    }
+    if (on && !channel_->isWriting())
+    {
+        channel_->enableWriting();
+    }
+    else if (!on && channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    {
+        channel_->disableWriting();
+    }
+}
+
+void TcpConnection::onOutputAboveHighWaterMark(size_t waterMark)
+{
+    if (highWaterMarkCallback_)
+    {
+        loop_->queueInLoop([self = shared_from_this(), waterMark] {
+            self->highWaterMarkCallback_(self, waterMark);
+        });
+    }
+    if (aboveHighWaterMark_)
+    {
+        // 排到高低水位之间又涨回来: 上游已经压着了, 再压一次 backpressureHolds_ 就多记一份, 降到低水位只松一份, 上游永远停读
+        return;
+    }
+    aboveHighWaterMark_ = true;
+    metrics_.highWaterEvents.inc();
+    // 上游可能在别的 subLoop 上, holdForBackpressure 内部会 runInLoop 切过去
+    for (const auto &peer : backpressurePeers_)
+    {
+        if (TcpConnectionPtr upstream = peer.lock())
+        {
+            upstream->holdForBackpressure();
+        }
+    }
+}
+
+void TcpConnection::onOutputBelowLowWaterMark()
+{
+    if (lowWaterMarkCallback_)
+    {
+        loop_->queueInLoop([self = shared_from_this(), waterMark = outputBuffer_.readableBytes()] {
+            self->lowWaterMarkCallback_(self, waterMark);
+        });
+    }
+    releaseBackpressurePeers();
+}
+
+void TcpConnection::releaseBackpressurePeers()
+{
+    if (!aboveHighWaterMark_)
+    {
+        return; // 没压着谁
+    }
+    aboveHighWaterMark_ = false;
+    // 顺便清理已经断开的上游
+    auto it = backpressurePeers_.begin();
+    while (it != backpressurePeers_.end())
+    {
+        if (TcpConnectionPtr upstream = it->lock())
+        {
+            upstream->releaseBackpressure(); // 只松开自己这一份, 别的下游还压着的话上游照样停着
+            ++it;
+        }
+        else
+        {
+            it = backpressurePeers_.erase(it);
+        }
+    }
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
@@ -237,7 +615,11 @@ void TcpConnection::connectEstablished()
     // 那如果在TcpConnection和Channel销毁(包括fd从epoll销毁)的中间, epoll又有事件发生, Channel还要执行吗? 通过tie_这个weak_ptr去检查TcpConnection是否挂掉了. 挂掉了就别干了.
     // 他们的销毁会跨线程吗? 答: connections_是在TcpServer中, 主Reactor, 所以connections_.erase时会跨线程.
 
-    channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    if (readPauseMask_ == 0) // 建立之前就 stopRead 了的先不读
+    {
+        channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    }
+    updateMemoryAccounting(); // 两个Buffer的初始容量也算
 
     // 新连接建立 执行回调  这个回调就是testserver里面的用户注册的onConnection
     connectionCallback_(shared_from_this());
@@ -247,23 +629,109 @@ void TcpConnection::connectEstablished()
 // AI说的: TcpConnection对象的销毁, 除了“户口登记”和“户口注销”是在 MainLoop，其他的“生老病死”全都在 SubLoop。
 void TcpConnection::connectDestroyed()
 {
-    if (state_ == kConnected)
+    // shutdown() 之后(kDisconnecting)还能有协程挂在 readUntil 上, 没走 handleClose 也要把它叫醒
+    if (state_ == kConnected || state_ == kDisconnecting)
     {
         setState(kDisconnected);
         channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
+        if (IoBypass bypass = std::exchange(bypass_, {}); bypass.closed) // 没走 handleClose 就被销毁(比如 TcpServer 析构)
+        {
+            bypass.closed();
+        }
         connectionCallback_(shared_from_this()); // 这儿调用用户注册的回调函数 删除连接和建立连接都是onConnection, 应该分开的.
+        notifyWaiter(readWaiter_);
+        notifyWaiter(writeWaiter_);
     }
     channel_->remove(); // 把channel从poller中删除掉
+    releaseBackpressurePeers(); // 没走 handleClose 就被销毁时还压着上游
+
+    if (pausedForBudget_.exchange(false))
+    {
+        MemoryBudget::instance().onResumedReading();
+    }
+    // 在loop线程里把记账清零, 析构可能发生在别的线程, 那样会记到别的线程的计数器上
+    MemoryBudget::instance().add(-static_cast<int64_t>(inputBufferBytes_ + outputBufferBytes_));
+    inputBufferBytes_ = 0;
+    outputBufferBytes_ = 0;
+    outputQueuedBytes_ = 0;
+}
+
+void TcpConnection::updateMemoryAccounting()
+{
+    if (state_ == kDisconnected && inputBufferBytes_ == 0 && outputBufferBytes_ == 0)
+    {
+        return; // 已经在connectDestroyed里清零了, 不要再记上
+    }
+    const size_t in = inputBuffer_.internalCapacity();
+    const size_t out = outputBuffer_.internalCapacity();
+    const size_t oldIn = inputBufferBytes_.load(std::memory_order_relaxed);
+    const size_t oldOut = outputBufferBytes_.load(std::memory_order_relaxed);
+    if (in != oldIn || out != oldOut) // 绝大多数时候容量不变, 只有两次load和比较
+    {
+        MemoryBudget &budget = MemoryBudget::instance();
+        budget.add(static_cast<int64_t>(in + out) - static_cast<int64_t>(oldIn + oldOut));
+        inputBufferBytes_.store(in, std::memory_order_relaxed);
+        outputBufferBytes_.store(out, std::memory_order_relaxed);
+        // inputBuffer_在涨而且已经超预算: 自己就是要停的那个, 不等TcpServer的定时检查(那时可能已经多读了上百MB).
+        // 只停 TcpServer 管着的: 恢复靠它的定时检查, 没人管的停了就再也不会恢复
+        if (budgetManaged_ && in > oldIn && (budget.policy() & MemoryBudget::kPauseReading) && budget.overBudget())
+        {
+            if (!pausedForBudget_.exchange(true))
+            {
+                stopReadInLoop(kPauseByBudget);
+                budget.onPausedReading();
+            }
+        }
+    }
+}
+
+void TcpConnection::pauseReadingForBudget()
+{
+    if (!pausedForBudget_.exchange(true))
+    {
+        stopRead(kPauseByBudget);
+        MemoryBudget::instance().onPausedReading();
+    }
+}
+
+void TcpConnection::resumeReadingForBudget()
+{
+    if (pausedForBudget_.exchange(false))
+    {
+        startRead(kPauseByBudget);
+        MemoryBudget::instance().onResumedReading();
+    }
 }
 
 // 读是相对服务器而言的 当对端客户端有数据到达 服务器端检测到EPOLLIN 就会触发该fd上的回调 handleRead取读走对端发来的数据
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    TraceScope trace("handleRead");
+    PerfScope perf(PerfCounters::kReadDispatch);
+    if (bypass_.readable) // 旁路IO自己读 fd, 连 EOF 和出错也由它处理
+    {
+        bypass_.readable();
+        return;
+    }
     int savedErrno = 0;
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    updateMemoryAccounting(); // readFd可能扩容, 这是内存增长的主要来源
     if (n > 0) // 有数据到达
     {
+        metrics_.bytesReceived.add(n);
+        trace.setArg(static_cast<uint64_t>(n));
+        if (readWaiter_.notify) // 有协程在 co_await readExactly/readUntil, 直接在这里恢复它, 不走 onMessage
+        {
+            notifyWaiter(readWaiter_);
+            return;
+        }
+        if (!messageCallback_) // 纯协程用法可以不设置onMessage, 数据留在inputBuffer_里等协程来读
+        {
+            return;
+        }
         // 已建立连接的用户有可读事件发生了 调用用户传入的回调操作onMessage shared_from_this就是获取了TcpConnection的智能指针
+        TRACE_SCOPE("onMessage"); // 用户代码单独一段, 时间线上和库本身的开销分得开
+        PerfScope perf(PerfCounters::kUserCallback);
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime); // 这个很重要啊, 这个函数就是main函数中设置的用户回调onMessage, 而这个handleRead又是注册给channel的回调, 最终是在subLoop中调用的.
         /*
         举例: sp1->对象(this), sp2 = sp1, 这样才能共享(共享一个控制块). 如果你用this创建一个sp2(创建一个新的控制块), 那么sp2和sp1不知道对方的存在, 导致double delete.
@@ -284,13 +752,26 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 
 void TcpConnection::handleWrite()
 {
+    TRACE_SCOPE("handleWrite");
+    PerfScope perf(PerfCounters::kWrite);
     if (channel_->isWriting()) // isWritable命名更合理吧, 判断是否可写. 看它对EPOLLOUT事件是否感兴趣.
     {
+        if (outputBuffer_.readableBytes() == 0 && bypass_.writable) // 是旁路IO通过 setWantWritable 关注的可写
+        {
+            bypass_.writable();
+            return;
+        }
         int savedErrno = 0;
         ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
         if (n > 0)
         {
+            metrics_.bytesSent.add(n);
             outputBuffer_.retrieve(n);//从缓冲区读取reable区域的数据移动readindex下标
+            outputQueuedBytes_.store(outputBuffer_.readableBytes(), std::memory_order_relaxed);
+            if (aboveHighWaterMark_ && outputBuffer_.readableBytes() <= lowWaterMark_)
+            {
+                onOutputBelowLowWaterMark();
+            }
             if (outputBuffer_.readableBytes() == 0)
             {
                 channel_->disableWriting();
@@ -302,10 +783,15 @@ void TcpConnection::handleWrite()
                         self->writeCompleteCallback_(self);
                     });
                 }
+                if (bypass_.writable) // 旁路IO等 outputBuffer_ 发完才能接着写自己的数据
+                {
+                    bypass_.writable();
+                }
                 if (state_ == kDisconnecting)
                 {
                     shutdownInLoop(); // 在当前所属的loop中把TcpConnection删除掉
                 }
+                notifyWaiter(writeWaiter_); // co_await conn->write(...) 在等发送完
             }
         }
         else
@@ -326,6 +812,14 @@ void TcpConnection::handleClose()
     channel_->disableAll();
 
     TcpConnectionPtr connPtr(shared_from_this());
+    releaseBackpressurePeers(); // 下游没了, 别让上游一直停读
+    // 唤醒挂起的协程, 它们会看到连接已断开
+    notifyWaiter(readWaiter_);
+    notifyWaiter(writeWaiter_);
+    if (IoBypass bypass = std::exchange(bypass_, {}); bypass.closed) // 先摘掉, 回调里释放的对象不会再被调到
+    {
+        bypass.closed();
+    }
     connectionCallback_(connPtr); // 调用用户自定义的连接事件处理函数onConnectionCallback, 新连接和断开连接都可以调用.
     closeCallback_(connPtr);      // 执行关闭连接的回调 执行的是TcpServer::removeConnection回调方法   // must be the last line
 }
@@ -343,7 +837,7 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d\n", name_.c_str(), err);
+    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d\n", name().c_str(), err);
 }
 
 // 新增的零拷贝发送函数
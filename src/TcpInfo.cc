@@ -0,0 +1,13 @@
+#include <cstdio>
+
+#include "TcpInfo.h"
+
+std::string TcpInfoSample::toString() const
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "rtt=%uus rttvar=%uus rto=%uus cwnd=%u ssthresh=%u mss=%u unacked=%u lost=%u retrans=%u/%u sndq=%d rcvq=%d",
+             rttUs, rttVarUs, rtoUs, cwnd, ssthresh, mss, unacked, lost, retransmitting, totalRetrans,
+             sendQueueBytes, recvQueueBytes);
+    return buf;
+}
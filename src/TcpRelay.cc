@@ -0,0 +1,407 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "TcpRelay.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "TcpConnection.h"
+
+namespace
+{
+    // 每个线程(每个 loop)一个空闲管道池, 还回来的都是空管道. 线程退出时关掉
+    struct PipePool
+    {
+        std::vector<std::pair<int, int>> idle;
+
+        ~PipePool()
+        {
+            for (const auto &[readFd, writeFd] : idle)
+            {
+                ::close(readFd);
+                ::close(writeFd);
+            }
+        }
+    };
+    thread_local PipePool t_pipes;
+
+    struct RelayMetrics
+    {
+        Counter sessions;
+        Counter splicedBytes;
+        Counter copiedBytes;
+        Counter pipesCreated;
+    };
+
+    RelayMetrics &relayMetrics()
+    {
+        static RelayMetrics metrics = [] {
+            MetricsRegistry &registry = MetricsRegistry::instance();
+            RelayMetrics m;
+            m.sessions = registry.gauge("muduo_relay_sessions", "Active TcpRelay sessions");
+            m.splicedBytes = registry.counter("muduo_relay_bytes_total", "Bytes relayed between connections", "mode=\"splice\"");
+            m.copiedBytes = registry.counter("muduo_relay_bytes_total", "Bytes relayed between connections", "mode=\"copy\"");
+            m.pipesCreated = registry.counter("muduo_relay_pipes_created_total", "Pipes created for splice (not taken from the idle pool)");
+            return m;
+        }();
+        return metrics;
+    }
+
+    bool acquirePipe(int *readFd, int *writeFd)
+    {
+        PipePool &pool = t_pipes;
+        if (!pool.idle.empty())
+        {
+            std::tie(*readFd, *writeFd) = pool.idle.back();
+            pool.idle.pop_back();
+            return true;
+        }
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            LOG_ERROR("TcpRelay - pipe2 failed, errno=%d, falling back to copying\n", errno);
+            return false;
+        }
+        ::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(TcpRelay::kPipeSize)); // 失败就用默认大小
+        relayMetrics().pipesCreated.inc();
+        *readFd = fds[0];
+        *writeFd = fds[1];
+        return true;
+    }
+
+    // 管道里还有没写出去的数据(会话异常结束)就不回收了, 下一个会话会读到上一个的残留
+    void releasePipe(int readFd, int writeFd, bool empty)
+    {
+        PipePool &pool = t_pipes;
+        if (empty && pool.idle.size() < TcpRelay::kMaxIdlePipes)
+        {
+            pool.idle.emplace_back(readFd, writeFd);
+            return;
+        }
+        ::close(readFd);
+        ::close(writeFd);
+    }
+}
+
+std::shared_ptr<TcpRelay> TcpRelay::start(const TcpConnectionPtr &a,
+                                          const TcpConnectionPtr &b,
+                                          InspectCallback inspectAToB,
+                                          InspectCallback inspectBToA)
+{
+    if (a->getLoop() != b->getLoop() || !a->getLoop()->isInLoopThread())
+    {
+        // splice 要在一个线程里同时操作两个 fd, 代理应该在前端连接的 loop 上连后端
+        LOG_FATAL("TcpRelay - %s and %s must share the loop that calls start()\n", a->name().c_str(), b->name().c_str());
+    }
+    if (!a->connected() || !b->connected())
+    {
+        a->forceClose();
+        b->forceClose();
+        return nullptr;
+    }
+    std::shared_ptr<TcpRelay> relay(new TcpRelay(a, b, std::move(inspectAToB), std::move(inspectBToA)));
+    relay->attach();
+    return relay;
+}
+
+TcpRelay::TcpRelay(const TcpConnectionPtr &a, const TcpConnectionPtr &b, InspectCallback inspectAToB, InspectCallback inspectBToA)
+    : conns_{a, b}
+{
+    dirs_[0].inspect = std::move(inspectAToB);
+    dirs_[1].inspect = std::move(inspectBToA);
+    for (Direction &d : dirs_)
+    {
+        if (!d.inspect && !acquirePipe(&d.pipeRead, &d.pipeWrite))
+        {
+            d.pipeRead = d.pipeWrite = -1;
+        }
+    }
+    relayMetrics().sessions.inc();
+}
+
+TcpRelay::~TcpRelay()
+{
+    for (const Direction &d : dirs_)
+    {
+        if (d.pipeRead >= 0)
+        {
+            releasePipe(d.pipeRead, d.pipeWrite, d.piped == 0);
+        }
+    }
+    relayMetrics().sessions.dec();
+}
+
+void TcpRelay::attach()
+{
+    for (int side = 0; side < 2; ++side)
+    {
+        auto self = shared_from_this();
+        conns_[side]->setIoBypass({
+            [self, side] { self->onReadable(side); },
+            [self, side] { self->onWritable(side); },
+            [self, side] { self->onClosed(side); },
+        });
+    }
+    // 接管之前已经读进 inputBuffer_ 的(比如代理为了选后端先读的几个字节)先按拷贝转发, 之后的才走 splice
+    for (int side = 0; side < 2; ++side)
+    {
+        Buffer *pending = conns_[side]->inputBuffer();
+        if (pending->readableBytes() > 0)
+        {
+            forward(side, pending);
+        }
+    }
+}
+
+void TcpRelay::onReadable(int side)
+{
+    Direction &d = dirs_[side];
+    TcpConnection *src = conns_[side].get();
+    if (d.done || d.eof)
+    {
+        src->stopRead(TcpConnection::kPauseByRelay); // 停读之前已经在这一轮的就绪列表里了
+        return;
+    }
+    if (d.pipeRead < 0)
+    {
+        int savedErrno = 0;
+        Buffer *buf = src->inputBuffer();
+        const ssize_t n = buf->readFd(src->fd(), &savedErrno);
+        if (n > 0)
+        {
+            forward(side, buf);
+        }
+        else if (n == 0)
+        {
+            onEof(side);
+        }
+        else if (savedErrno != EAGAIN && savedErrno != EINTR)
+        {
+            LOG_ERROR("TcpRelay - read from %s failed, errno=%d\n", src->name().c_str(), savedErrno);
+            fail(side);
+        }
+        return;
+    }
+    if (d.piped > 0)
+    {
+        pause(side);
+        return;
+    }
+    const ssize_t n = ::splice(src->fd(), nullptr, d.pipeWrite, nullptr, kPipeSize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0)
+    {
+        d.piped = static_cast<size_t>(n);
+        d.bytes += n;
+        relayMetrics().splicedBytes.add(n);
+        flush(side);
+    }
+    else if (n == 0)
+    {
+        onEof(side);
+    }
+    else if (errno != EAGAIN && errno != EINTR)
+    {
+        LOG_ERROR("TcpRelay - splice from %s failed, errno=%d\n", src->name().c_str(), errno);
+        fail(side);
+    }
+}
+
+void TcpRelay::onWritable(int side)
+{
+    if (finished_)
+    {
+        closeIfDrained(side);
+        return;
+    }
+    const int from = 1 - side;
+    Direction &d = dirs_[from];
+    if (d.done)
+    {
+        return;
+    }
+    if (d.pipeRead >= 0)
+    {
+        flush(from);
+    }
+    else
+    {
+        resume(from); // outputBuffer_ 发空了才会回调到这里
+    }
+}
+
+void TcpRelay::onClosed(int side)
+{
+    conns_[side].reset();
+    const int other = 1 - side;
+    if (!finished_)
+    {
+        // 发往 side 的方向没法再写了, 剩下的丢掉
+        Direction &in = dirs_[other];
+        in.eof = true;
+        in.done = true;
+        if (conns_[other])
+        {
+            conns_[other]->stopRead(TcpConnection::kPauseByRelay);
+        }
+        // side 发出的方向: 已经收下的照样写给对端, 写完关掉对端
+        Direction &out = dirs_[side];
+        out.eof = true;
+        if (out.piped == 0)
+        {
+            finishDirection(side);
+        }
+        else
+        {
+            checkFinished();
+        }
+    }
+}
+
+void TcpRelay::forward(int from, Buffer *buf)
+{
+    Direction &d = dirs_[from];
+    if (d.inspect)
+    {
+        d.inspect(buf);
+    }
+    const size_t n = buf->readableBytes();
+    d.bytes += n;
+    relayMetrics().copiedBytes.add(n);
+    TcpConnection *dst = conns_[1 - from].get();
+    dst->send(buf);
+    buf->retrieveAll(); // 对端已经断开的话 send 不会取走
+    if (dst->outputQueuedBytes() > kCopyHighWaterMark)
+    {
+        pause(from); // 发空时 handleWrite 回调 onWritable 恢复
+    }
+}
+
+void TcpRelay::flush(int from)
+{
+    Direction &d = dirs_[from];
+    TcpConnection *dst = conns_[1 - from].get();
+    if (dst->outputQueuedBytes() > 0)
+    {
+        // outputBuffer_ 里的是先到的(接管之前 send 的), 等它发空, handleWrite 会回调 onWritable
+        pause(from);
+        return;
+    }
+    while (d.piped > 0)
+    {
+        const ssize_t n = ::splice(d.pipeRead, nullptr, dst->fd(), nullptr, d.piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            d.piped -= static_cast<size_t>(n);
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        else
+        {
+            LOG_ERROR("TcpRelay - splice to %s failed, errno=%d\n", dst->name().c_str(), errno);
+            fail(1 - from);
+            return;
+        }
+    }
+    if (d.piped > 0)
+    {
+        pause(from);
+        dst->setWantWritable(true);
+        return;
+    }
+    dst->setWantWritable(false);
+    resume(from);
+    if (d.eof)
+    {
+        finishDirection(from);
+    }
+}
+
+void TcpRelay::pause(int from)
+{
+    Direction &d = dirs_[from];
+    if (!d.paused)
+    {
+        d.paused = true;
+        if (conns_[from])
+        {
+            conns_[from]->stopRead(TcpConnection::kPauseByRelay);
+        }
+    }
+}
+
+void TcpRelay::resume(int from)
+{
+    Direction &d = dirs_[from];
+    if (d.paused)
+    {
+        d.paused = false;
+        if (conns_[from] && !d.eof)
+        {
+            conns_[from]->startRead(TcpConnection::kPauseByRelay);
+        }
+    }
+}
+
+void TcpRelay::onEof(int from)
+{
+    Direction &d = dirs_[from];
+    d.eof = true;
+    conns_[from]->stopRead(TcpConnection::kPauseByRelay); // 读端已经关了, 水平触发下不停读会一直报可读
+    if (d.piped == 0)
+    {
+        finishDirection(from);
+    }
+}
+
+void TcpRelay::finishDirection(int from)
+{
+    Direction &d = dirs_[from];
+    if (d.done)
+    {
+        return;
+    }
+    d.done = true;
+    if (conns_[1 - from])
+    {
+        conns_[1 - from]->shutdown(); // outputBuffer_ 里还有的话发完再关写端
+    }
+    checkFinished();
+}
+
+void TcpRelay::checkFinished()
+{
+    if (finished_ || !dirs_[0].done || !dirs_[1].done)
+    {
+        return;
+    }
+    // 两边都不读也不写了, 连接已经不在 epoll 里, 等不到 EPOLLHUP, 自己关
+    finished_ = true;
+    for (int side = 0; side < 2; ++side)
+    {
+        closeIfDrained(side);
+    }
+}
+
+void TcpRelay::closeIfDrained(int side)
+{
+    if (conns_[side] && conns_[side]->outputQueuedBytes() == 0)
+    {
+        conns_[side]->forceClose();
+    }
+}
+
+void TcpRelay::fail(int side)
+{
+    // 只关出错的这一边, 它的 closed 回调走 onClosed: 另一个方向已经收下的数据照样写给对端, 写完再关对端
+    conns_[side]->forceClose();
+}
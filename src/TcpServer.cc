@@ -1,8 +1,11 @@
 #include <functional>
+#include <algorithm>
+#include <vector>
 
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "MemoryBudget.h"
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -20,6 +23,7 @@ TcpServer::TcpServer(EventLoop *loop,
     : loop_(CheckLoopNotNull(loop))
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
+    , namePrefix_(std::make_shared<const std::string>(name_ + "-" + ipPort_))
     , acceptor_(std::make_unique<Acceptor>(loop, listenAddr, option == Option::kReusePort)) // make_unique 和 make_shared 返回的都是右值, 不用move
     , threadPool_(std::make_shared<EventLoopThreadPool>(loop, name_))
     , connectionCallback_()
@@ -33,27 +37,66 @@ TcpServer::TcpServer(EventLoop *loop,
     acceptor_->setNewConnectionCallback([this](int sockfd, const InetAddress &peerAddr) {
         newConnection(sockfd, peerAddr);
     });
+
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string labels = "server=\"" + name_ + "\"";
+    acceptor_->setMetricsLabels(labels);
+    openedMetric_ = registry.counter("muduo_connections_opened_total", "Connections established", labels);
+    closedMetric_ = registry.counter("muduo_connections_closed_total", "Connections closed", labels);
+    connectionsMetric_ = registry.gauge("muduo_connections", "Live connections", labels);
+    connectionMetrics_.bytesReceived = registry.counter("muduo_bytes_received_total", "Bytes read from sockets", labels);
+    connectionMetrics_.bytesSent = registry.counter("muduo_bytes_sent_total", "Bytes written to sockets", labels);
+    connectionMetrics_.writeEagain = registry.counter("muduo_write_eagain_total", "Writes that hit EAGAIN or left data in outputBuffer", labels);
+    connectionMetrics_.highWaterEvents = registry.counter("muduo_high_water_mark_events_total", "outputBuffer crossed the high water mark", labels);
+    // 写队列深度要遍历所有连接, 只在抓取时算
+    metricCallbacks_.push_back(registry.addCallbackGauge(
+        "muduo_output_queued_bytes", "Bytes waiting in outputBuffers (write queue depth)", labels, [this] {
+            size_t total = 0;
+            for (const TcpConnectionPtr &conn : connectionsSnapshot())
+            {
+                total += conn->outputQueuedBytes();
+            }
+            return static_cast<double>(total);
+        }));
+    metricCallbacks_.push_back(registry.addCallbackGauge(
+        "muduo_buffer_memory_bytes", "Capacity of input and output Buffers (what MemoryBudget counts)", labels, [this] {
+            size_t total = 0;
+            for (const TcpConnectionPtr &conn : connectionsSnapshot())
+            {
+                total += conn->inputBufferBytes() + conn->outputBufferBytes();
+            }
+            return static_cast<double>(total);
+        }));
 }
 
 TcpServer::~TcpServer()
 {
-    for(auto &[name, connPtr] : connections_) // C++17 结构化绑定
+    for (uint64_t id : metricCallbacks_)
+    {
+        MetricsRegistry::instance().remove(id);
+    }
+    for (const ConnectionShardPtr &shard : shards_)
     {
-        TcpConnectionPtr conn(std::move(connPtr));
-
-        // 销毁连接
-        // conn->getLoop()->runInLoop(
-        //     std::bind(&TcpConnection::connectDestroyed, conn)); // 这个bind会拷贝conn参数, 导致引用计数+1.
-        // 这里又要从主线程切换subLoop线程去删除, 践行one loop per thread.
-        conn->getLoop()->runInLoop([conn] {
-            conn->connectDestroyed();
+        shard->loop->cancel(shard->memoryCheckTimer);
+        shard->loop->cancel(shard->tcpInfoTimer);
+        // 这里又要从主线程切换subLoop线程去删除, 践行one loop per thread. 分片按值捕获shared_ptr, TcpServer析构完也还活着
+        shard->loop->runInLoop([shard] {
+            std::vector<TcpConnectionPtr> conns;
+            {
+                std::scoped_lock lock(shard->mutex);
+                conns.reserve(shard->connections.size());
+                shard->connections.forEach([&](const TcpConnectionPtr &conn) { conns.push_back(conn); });
+                shard->connections.clear();
+            }
+            shard->connectionsGauge.add(-static_cast<int64_t>(conns.size()));
+            shard->closedCounter.add(static_cast<int64_t>(conns.size()));
+            // 要想彻底删除一个TcpConnection对象，就必须要调用这个对象的connecDestroyed()方法
+            // 因为引用计数归0会触发~TcpConnection, 这个析构就无所谓再主线程还是工作线程了.
+            for (const TcpConnectionPtr &conn : conns)
+            {
+                conn->connectDestroyed();
+            }
         });
-
-        // 要想彻底删除一个TcpConnection对象，就必须要调用这个对象的connecDestroyed()方法
-        // 因为引用计数归0会触发~TcpConnection, 这个析构就无所谓再主线程还是工作线程了.
-
-        // bind会内部会拷贝一个conn, 有点类似thread传参机制.
-        // bind可以用lambda代替, 但不能是引用捕获. 如果是引用捕获, 后续runInLoop拷贝整个lambda表达式, 对里面的conn也会用引用拷贝, 而不是值拷贝.
     }
 }
 
@@ -75,6 +118,33 @@ void TcpServer::start()
     if (started_.exchange(true) == false)    // 防止一个TcpServer对象被start多次, 用线程安全的写法, 
     {
         threadPool_->start(threadInitCallback_);    // 启动底层的loop线程池
+
+        std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+        shards_.reserve(loops.size());
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            auto shard = std::make_shared<ConnectionShard>(loops[i], static_cast<uint32_t>(i), name_);
+            shard->connectionsGauge = connectionsMetric_;
+            shard->closedCounter = closedMetric_;
+            // 没设置预算时checkMemoryBudget立即返回, 开销可以忽略
+            shard->memoryCheckTimer = loops[i]->runEvery(kMemoryCheckInterval, [weakShard = std::weak_ptr<ConnectionShard>(shard),
+                                                                                 numShards = loops.size()] {
+                if (ConnectionShardPtr shard = weakShard.lock())
+                {
+                    checkMemoryBudget(*shard, numShards);
+                }
+            });
+            if (tcpInfoInterval_ > 0)
+            {
+                shard->tcpInfoTimer = loops[i]->runEvery(tcpInfoInterval_, [weakShard = std::weak_ptr<ConnectionShard>(shard)] {
+                    if (ConnectionShardPtr shard = weakShard.lock())
+                    {
+                        sampleTcpInfo(*shard);
+                    }
+                });
+            }
+            shards_.push_back(std::move(shard));
+        }
         // loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get())); //让这个EventLoop，也就是mainloop来执行Acceptor的listen函数，开启服务端监听
         loop_->runInLoop([this] {
             acceptor_->listen();
@@ -85,17 +155,15 @@ void TcpServer::start()
 // 有一个新用户连接，acceptor会执行这个回调操作，负责将mainLoop接收到的请求连接(acceptChannel_会有读事件发生)通过回调轮询分发给subLoop去处理
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) // 注意: Acceptor中accept获取新连接的fd, 然后调用这个回调, 所以sockfd和peerAddr就是新连接.
 {
-   // 轮询算法 选择一个subLoop 来管理connfd对应的channel
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    // char buf[64] = {0};
-    // snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    // std::string connName = name_ + buf;
-    std::string connName = name_ + "-" + ipPort_ + "#" + std::to_string(nextConnId_);
-    ++nextConnId_;  // 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
-
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s\n",
-             name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
-    
+    // 轮询算法 选择一个subLoop 来管理connfd对应的channel, 连接也登记在该loop的分片里
+    const ConnectionShardPtr &shard = shards_[threadPool_->getNextLoopIndex()];
+    EventLoop *ioLoop = shard->loop;
+    // 以前这里每个连接都拼一次 name_ + "-" + ipPort_ + "#" + id, 现在只记序号, 名字等到打日志时再拼
+    const uint64_t sequence = nextConnId_++;  // 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
+
+    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s#%lu] from %s\n",
+             name_.c_str(), namePrefix_->c_str(), sequence, peerAddr.toIpPort().c_str());
+
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
     sockaddr_in local{};
     socklen_t addrlen = sizeof(local);
@@ -107,53 +175,269 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) // 注意
     InetAddress localAddr(local); // 对吧, 这儿命名为localAddr, 而peerAddr是对端的.
     // new改成make_shared
     TcpConnectionPtr conn = std::make_shared<TcpConnection> (ioLoop,
-                                            connName,
+                                            namePrefix_,
+                                            sequence,
                                             sockfd,     // fd
                                             localAddr,  // 本地IP+Port
                                             peerAddr);  // 对端IP+Port, 这些整合在一起就是TcpConnection
-    connections_[connName] = conn;
 
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setHighWaterMarkCallback(highWaterMarkCallback_, highWaterMark_);
+    conn->setLowWaterMarkCallback(lowWaterMarkCallback_, lowWaterMark_);
+    conn->setMetrics(connectionMetrics_);
+    conn->setBudgetManaged(true); // 超预算停读的, 由本分片的 checkMemoryBudget 恢复
+    openedMetric_.inc();
 
     // 设置了如何关闭连接的回调(这个非常核心!!!) 
     // 好, 那总结一下TcpConnection的关闭情况, 
     // 1. 服务器主动关闭, 逻辑是conn->shutdown, testserver中有但被注释了.
     // 2. 客户端断开连接, epoll_wait发现的事EPOLLIN事件, channel发生readCallback, 如果读取为0, 就表明客户端关闭, 然后调用handleClose. TcpConnection里面的handleRead触发了handleClose
     // 3. 其他情况, 例如RST, epoll_wait发现是EPOLLHUP事件, 直接触发handleClose的回调.
-    conn->setCloseCallback([this](const TcpConnectionPtr &conn) { // 注意, 这儿的conn与外面的conn重名了, 小心
-        removeConnection(conn);
+    conn->setCloseCallback([weakShard = std::weak_ptr<ConnectionShard>(shard)](const TcpConnectionPtr &conn) { // 注意, 这儿的conn与外面的conn重名了, 小心
+        removeConnection(weakShard, conn);
     });
 
     // 这个runInLoop就是切换线程执行回调, 从主Reactor/主线程/mainLoop 切换 到从Reactor/subLoop, 之前也讲过, "切换线程"这个词很准确啊. 都以前讲EventLoop好好讨论过的逻辑.
     // ioLoop->runInLoop(
     //     std::bind(&TcpConnection::connectEstablished, conn));
-    ioLoop->runInLoop([conn] {
+    // 登记到分片也放到ioLoop里做, 分片只有它自己的loop线程写
+    ioLoop->runInLoop([shard, conn] {
+        {
+            std::scoped_lock lock(shard->mutex);
+            conn->setId(shard->connections.insert(conn));
+        }
+        shard->connectionsGauge.inc();
         conn->connectEstablished();
     });
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+// 在连接所属的ioLoop中执行(TcpConnection::handleClose回调过来), 以前要 runInLoop 切回baseLoop删map再切回来, 现在就地删除
+void TcpServer::removeConnection(const std::weak_ptr<ConnectionShard> &weakShard, const TcpConnectionPtr &conn)
 {
-    // loop_->runInLoop(
-    //     std::bind(&TcpServer::removeConnectionInLoop, this, conn));
-    loop_->runInLoop([this, conn] {
-        removeConnectionInLoop(conn);
+    LOG_INFO("TcpServer::removeConnection - connection %s\n", conn->name().c_str());
+
+    if (ConnectionShardPtr shard = weakShard.lock())
+    {
+        bool erased;
+        {
+            std::scoped_lock lock(shard->mutex);
+            erased = shard->connections.erase(conn->id());
+        }
+        if (erased)
+        {
+            shard->connectionsGauge.dec();
+            shard->closedCounter.inc();
+        }
+    }
+    // 仍然用queueInLoop推迟: 现在还在Channel::handleEvent里, 不能当场把channel移除
+    conn->getLoop()->queueInLoop([conn] {
+        conn->connectDestroyed();
     });
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+void TcpServer::checkMemoryBudget(ConnectionShard &shard, size_t numShards)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-             name_.c_str(), conn->name().c_str());
+    MemoryBudget &budget = MemoryBudget::instance();
+    if (!budget.enabled())
+    {
+        return;
+    }
 
-    connections_.erase(conn->name());
-    EventLoop *ioLoop = conn->getLoop();
-    // ioLoop->queueInLoop(
-    //     std::bind(&TcpConnection::connectDestroyed, conn));
-    ioLoop->queueInLoop([conn] {
-        conn->connectDestroyed();
+    if (!budget.overBudget())
+    {
+        if (budget.pausedNow() > 0 && budget.belowResumeMark())
+        {
+            size_t resumed = 0;
+            // 分片只有本loop线程会写, 本线程读不用加锁
+            shard.connections.forEach([&](const TcpConnectionPtr &conn) {
+                if (conn->pausedForBudget())
+                {
+                    conn->resumeReadingForBudget();
+                    ++resumed;
+                }
+            });
+            if (resumed > 0)
+            {
+                LOG_INFO("TcpServer [%s] memory back under budget, resumed %zu connections\n", shard.serverName.c_str(), resumed);
+            }
+        }
+        return;
+    }
+
+    // 每个分片各自处理一份超出量, 所有分片加起来大致就是总超出量
+    const int64_t excess = (budget.usedBytes() - budget.limit() + static_cast<int64_t>(numShards) - 1) / static_cast<int64_t>(numShards);
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(shard.connections.size());
+    shard.connections.forEach([&](const TcpConnectionPtr &conn) { conns.push_back(conn); });
+
+    // 读得多的先停: 它们的inputBuffer_还在涨. 停读不会立刻释放内存, 但能止住增长
+    if (budget.policy() & MemoryBudget::kPauseReading)
+    {
+        std::sort(conns.begin(), conns.end(), [](const TcpConnectionPtr &a, const TcpConnectionPtr &b) {
+            return a->inputBufferBytes() > b->inputBufferBytes();
+        });
+        int64_t covered = 0;
+        for (const TcpConnectionPtr &conn : conns)
+        {
+            if (covered >= excess)
+            {
+                break;
+            }
+            covered += static_cast<int64_t>(conn->inputBufferBytes());
+            conn->pauseReadingForBudget();
+        }
+    }
+
+    // outputBuffer_ 堆积最多的就是读得最慢的对端, 关掉它们才真正释放内存
+    if (budget.policy() & MemoryBudget::kCloseSlowConsumer)
+    {
+        std::sort(conns.begin(), conns.end(), [](const TcpConnectionPtr &a, const TcpConnectionPtr &b) {
+            return a->outputBufferBytes() > b->outputBufferBytes();
+        });
+        int64_t freed = 0;
+        for (const TcpConnectionPtr &conn : conns)
+        {
+            if (freed >= excess || conn->outputBufferBytes() == 0)
+            {
+                break;
+            }
+            freed += static_cast<int64_t>(conn->inputBufferBytes() + conn->outputBufferBytes());
+            LOG_ERROR("TcpServer [%s] over memory budget, closing slow consumer [%s] outputBuffer=%zu\n",
+                      shard.serverName.c_str(), conn->name().c_str(), conn->outputBufferBytes());
+            conn->forceClose();
+            budget.onClosedConnection();
+        }
+    }
+}
+
+std::vector<TcpConnectionPtr> TcpServer::connectionsSnapshot() const
+{
+    std::vector<TcpConnectionPtr> conns;
+    for (const ConnectionShardPtr &shard : shards_)
+    {
+        std::scoped_lock lock(shard->mutex);
+        shard->connections.forEach([&](const TcpConnectionPtr &conn) { conns.push_back(conn); });
+    }
+    return conns;
+}
+
+std::vector<EventLoop *> TcpServer::loops() const
+{
+    std::vector<EventLoop *> loops;
+    for (const ConnectionShardPtr &shard : shards_)
+    {
+        loops.push_back(shard->loop);
+    }
+    return loops;
+}
+
+size_t TcpServer::numConnections() const
+{
+    size_t n = 0;
+    for (const ConnectionShardPtr &shard : shards_)
+    {
+        std::scoped_lock lock(shard->mutex);
+        n += shard->connections.size();
+    }
+    return n;
+}
+
+std::string TcpServer::memoryUsageReport(size_t topN) const
+{
+    std::vector<TcpConnectionPtr> conns = connectionsSnapshot();
+    auto bytesOf = [](const TcpConnectionPtr &conn) { return conn->inputBufferBytes() + conn->outputBufferBytes(); };
+    topN = std::min(topN, conns.size());
+    std::partial_sort(conns.begin(), conns.begin() + topN, conns.end(),
+                      [&](const TcpConnectionPtr &a, const TcpConnectionPtr &b) { return bytesOf(a) > bytesOf(b); });
+
+    std::string out = MemoryBudget::instance().report();
+    char buf[256];
+    for (size_t i = 0; i < topN; ++i)
+    {
+        snprintf(buf, sizeof(buf), "  %s input=%zu output=%zu\n",
+                 conns[i]->name().c_str(), conns[i]->inputBufferBytes(), conns[i]->outputBufferBytes());
+        out += buf;
+    }
+    return out;
+}
+
+void TcpServer::sampleTcpInfo(ConnectionShard &shard)
+{
+    // 在本loop线程里, 分片只有本线程写, 遍历不用加锁
+    auto stats = std::make_shared<TcpInfoStats>();
+    shard.connections.forEach([&](const TcpConnectionPtr &conn) {
+        if (!conn->connected())
+        {
+            return;
+        }
+        const TcpInfoSample &sample = conn->sampleTcpInfo();
+        if (!sample.when.valid())
+        {
+            return;
+        }
+        stats->rttUs.record(sample.rttUs);
+        stats->rttVarUs.record(sample.rttVarUs);
+        stats->cwnd.record(sample.cwnd);
+        stats->unacked.record(sample.unacked);
+        stats->newRetrans.record(sample.newRetrans);
+        stats->sendQueueBytes.record(static_cast<uint64_t>(std::max(sample.sendQueueBytes, 0)));
+        stats->recvQueueBytes.record(static_cast<uint64_t>(std::max(sample.recvQueueBytes, 0)));
+        stats->outputQueuedBytes.record(conn->outputQueuedBytes());
+        if (sample.retransmitting > 0)
+        {
+            ++stats->retransmittingConnections;
+        }
     });
-}
\ No newline at end of file
+
+    std::scoped_lock lock(shard.mutex);
+    shard.tcpInfo = std::move(stats);
+}
+
+TcpServer::TcpInfoStats TcpServer::tcpInfoStats() const
+{
+    TcpInfoStats total;
+    for (const ConnectionShardPtr &shard : shards_)
+    {
+        std::shared_ptr<const TcpInfoStats> stats;
+        {
+            std::scoped_lock lock(shard->mutex);
+            stats = shard->tcpInfo;
+        }
+        if (stats)
+        {
+            total.merge(*stats);
+        }
+    }
+    return total;
+}
+
+void TcpServer::TcpInfoStats::merge(const TcpInfoStats &other)
+{
+    rttUs.merge(other.rttUs);
+    rttVarUs.merge(other.rttVarUs);
+    cwnd.merge(other.cwnd);
+    unacked.merge(other.unacked);
+    newRetrans.merge(other.newRetrans);
+    sendQueueBytes.merge(other.sendQueueBytes);
+    recvQueueBytes.merge(other.recvQueueBytes);
+    outputQueuedBytes.merge(other.outputQueuedBytes);
+    retransmittingConnections += other.retransmittingConnections;
+}
+
+std::string TcpServer::TcpInfoStats::toString() const
+{
+    std::string out;
+    out += "rtt_us            " + rttUs.toString() + "\n";
+    out += "rttvar_us         " + rttVarUs.toString() + "\n";
+    out += "cwnd              " + cwnd.toString() + "\n";
+    out += "unacked           " + unacked.toString() + "\n";
+    out += "new_retrans       " + newRetrans.toString() + "\n";
+    out += "send_queue_bytes  " + sendQueueBytes.toString() + "\n";
+    out += "recv_queue_bytes  " + recvQueueBytes.toString() + "\n";
+    out += "output_queued     " + outputQueuedBytes.toString() + "\n";
+    out += "retransmitting_connections " + std::to_string(retransmittingConnections) + "\n";
+    return out;
+}
@@ -0,0 +1,182 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "TimerQueue.h"
+#include "Timer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+namespace
+{
+    int createTimerfd()
+    {
+        // CLOCK_MONOTONIC 不受系统改时间影响; 和 eventfd 一样设置非阻塞 + CLOEXEC
+        int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0)
+        {
+            LOG_FATAL("timerfd_create error:%d\n", errno);
+        }
+        return timerfd;
+    }
+
+    // 距离when还有多久, 至少100us, 避免设置成0导致timerfd被解除
+    timespec howMuchTimeFromNow(Timestamp when)
+    {
+        int64_t microseconds = when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+        if (microseconds < 100)
+        {
+            microseconds = 100;
+        }
+        timespec ts{};
+        ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+        ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+        return ts;
+    }
+
+    void readTimerfd(int timerfd)
+    {
+        uint64_t howmany = 0;
+        ssize_t n = ::read(timerfd, &howmany, sizeof(howmany));
+        if (n != sizeof(howmany))
+        {
+            LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8\n", n);
+        }
+    }
+
+    // 重新设置timerfd的到期时间, 唤醒loop靠的就是这个
+    void resetTimerfd(int timerfd, Timestamp expiration)
+    {
+        itimerspec newValue{};
+        itimerspec oldValue{};
+        newValue.it_value = howMuchTimeFromNow(expiration);
+        if (::timerfd_settime(timerfd, 0, &newValue, &oldValue) < 0)
+        {
+            LOG_ERROR("timerfd_settime error:%d\n", errno);
+        }
+    }
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+    , callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallback([this](Timestamp) {
+        handleRead();
+    });
+    timerfdChannel_.setDescribeCallback([] { return std::string("timerfd"); });
+    // timerfd 一直在读, 不需要的时候用 timerfd_settime 解除, 不去改 epoll
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+    // timers_ 持有 unique_ptr, 自动释放
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    Timer *timer = new Timer(std::move(cb), when, interval); // 所有权在 addTimerInLoop 中交给 timers_
+    TimerId id(timer->sequence());
+    loop_->runInLoop([this, timer] {
+        addTimerInLoop(timer);
+    });
+    return id;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop([this, timerId] {
+        cancelInLoop(timerId);
+    });
+}
+
+void TimerQueue::addTimerInLoop(Timer *timer)
+{
+    Timestamp expiration = timer->expiration();
+    bool earliestChanged = insert(std::unique_ptr<Timer>(timer));
+    if (earliestChanged)
+    {
+        resetTimerfd(timerfd_, expiration);
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    auto it = activeTimers_.find(timerId.sequence());
+    if (it != activeTimers_.end())
+    {
+        timers_.erase(Entry(it->second, it->first));
+        activeTimers_.erase(it);
+    }
+    else if (callingExpiredTimers_)
+    {
+        // 正在执行到期回调, 该定时器已经被 getExpired 取出, 记下来让 reset 不再 restart 它
+        cancelingTimers_.insert(timerId.sequence());
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    Timestamp now(Timestamp::now());
+    readTimerfd(timerfd_);
+
+    std::vector<std::unique_ptr<Timer>> expired = getExpired(now);
+
+    callingExpiredTimers_ = true;
+    cancelingTimers_.clear();
+    for (const auto &timer : expired)
+    {
+        timer->run(); // 回调里可以安全地 addTimer/cancel
+    }
+    callingExpiredTimers_ = false;
+
+    reset(expired, now);
+}
+
+std::vector<std::unique_ptr<Timer>> TimerQueue::getExpired(Timestamp now)
+{
+    std::vector<std::unique_ptr<Timer>> expired;
+    // 哨兵: 到期时间 <= now 的都算到期
+    auto end = timers_.upper_bound(Entry(now, INT64_MAX));
+    for (auto it = timers_.begin(); it != end; ++it)
+    {
+        activeTimers_.erase(it->first.second);
+        expired.push_back(std::move(it->second));
+    }
+    timers_.erase(timers_.begin(), end);
+    return expired;
+}
+
+void TimerQueue::reset(std::vector<std::unique_ptr<Timer>> &expired, Timestamp now)
+{
+    for (auto &timer : expired)
+    {
+        if (timer->repeat() && cancelingTimers_.count(timer->sequence()) == 0)
+        {
+            timer->restart(now);
+            insert(std::move(timer));
+        }
+        // 否则 unique_ptr 离开作用域时释放
+    }
+
+    if (!timers_.empty())
+    {
+        resetTimerfd(timerfd_, timers_.begin()->first.first);
+    }
+}
+
+bool TimerQueue::insert(std::unique_ptr<Timer> timer)
+{
+    Timestamp when = timer->expiration();
+    bool earliestChanged = timers_.empty() || when < timers_.begin()->first.first;
+    int64_t sequence = timer->sequence();
+    timers_.emplace(Entry(when, sequence), std::move(timer));
+    activeTimers_.emplace(sequence, when);
+    return earliestChanged;
+}
@@ -1,8 +1,18 @@
 #include <chrono> // 获取微妙级的时间
+#include <cstring>
 #include <time.h> // 格式化年月日
 
 #include "Timestamp.h"
 
+namespace
+{
+    // 每个线程缓存上一次格式化的秒和 "YYYY/MM/DD HH:MM:SS" 前缀.
+    // localtime_r 要拿 glibc 的时区锁, 还可能 stat /etc/localtime, 一秒只做一次
+    thread_local time_t t_lastSecond = -1;
+    thread_local char t_time[32];
+    thread_local size_t t_timeLen = 0;
+}
+
 Timestamp Timestamp::now()
 {
     using namespace std::chrono;
@@ -10,23 +20,59 @@ Timestamp Timestamp::now()
     return Timestamp(us);
 }
 
+Timestamp Timestamp::coarseNow()
+{
+    timespec ts{};
+    ::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
 std::string Timestamp::toString() const
 {
     char buf[64];
+    size_t len = formatTo(buf, sizeof(buf));
+    return std::string(buf, len);
+}
+
+size_t Timestamp::formatTo(char *buf, size_t size) const
+{
     // 1. 分离出秒
-    const time_t seconds = microSecondsSinceEpoch_ / 1'000'000;
+    const time_t seconds = microSecondsSinceEpoch_ / kMicroSecondsPerSecond;
     // 2. 分离出微秒
-    const int microseconds = microSecondsSinceEpoch_ % 1'000'000; // 计算剩余的微秒数
-    tm tm_time{};
-    localtime_r(&seconds, &tm_time); // 负责把“时间戳”转换成“年月日时分秒”的结构体 tm。可惜没有微妙.
-    // 3. 拼接: 秒级时间 + 微秒
-    snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d.%06d",
-             tm_time.tm_year + 1900,
-             tm_time.tm_mon + 1,
-             tm_time.tm_mday,
-             tm_time.tm_hour,
-             tm_time.tm_min,
-             tm_time.tm_sec,
-             microseconds); // 这里填微秒.
-    return buf;
+    const int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond); // 计算剩余的微秒数
+    if (seconds != t_lastSecond)
+    {
+        t_lastSecond = seconds;
+        tm tm_time{};
+        localtime_r(&seconds, &tm_time); // 负责把“时间戳”转换成“年月日时分秒”的结构体 tm。可惜没有微妙.
+        int n = snprintf(t_time, sizeof(t_time), "%4d/%02d/%02d %02d:%02d:%02d",
+                         tm_time.tm_year + 1900,
+                         tm_time.tm_mon + 1,
+                         tm_time.tm_mday,
+                         tm_time.tm_hour,
+                         tm_time.tm_min,
+                         tm_time.tm_sec);
+        t_timeLen = n > 0 ? static_cast<size_t>(n) : 0;
+    }
+    if (size <= t_timeLen + 7)
+    {
+        if (size > 0)
+        {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+    // 3. 拼接: 秒级时间 + 微秒. 微秒手写 6 位十进制, 不走 snprintf
+    memcpy(buf, t_time, t_timeLen);
+    char *p = buf + t_timeLen;
+    *p++ = '.';
+    int us = microseconds;
+    for (int i = 5; i >= 0; --i)
+    {
+        p[i] = static_cast<char>('0' + us % 10);
+        us /= 10;
+    }
+    p += 6;
+    *p = '\0';
+    return static_cast<size_t>(p - buf);
 }
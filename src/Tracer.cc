@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <mutex>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Tracer.h"
+#include "CurrentThread.h"
+#include "Timestamp.h"
+#include "Logger.h"
+
+namespace
+{
+    int g_signalPipe[2] = {-1, -1};
+
+    void onDumpSignal(int)
+    {
+        const int savedErrno = errno;
+        char c = 1;
+        ssize_t n = ::write(g_signalPipe[1], &c, 1); // async-signal-safe, 满了就丢, 反正已经有一次 dump 在排队
+        (void)n;
+        errno = savedErrno;
+    }
+
+    void appendEscaped(std::string &out, const char *s)
+    {
+        for (; *s; ++s)
+        {
+            if (*s == '"' || *s == '\\')
+            {
+                out += '\\';
+            }
+            out += *s;
+        }
+    }
+}
+
+void Tracer::setEnabled(bool on)
+{
+    if (on)
+    {
+        TscClock::calibrateOnce(); // 先校准再打开, 缓冲区里的 ticks 都按同一个比例换算
+    }
+    enabled_.store(on, std::memory_order_relaxed);
+}
+
+Tracer::Ring *Tracer::registerThread()
+{
+    auto ring = std::make_shared<Ring>();
+    ring->tid = CurrentThread::tid();
+    char name[16] = {};
+    ::prctl(PR_GET_NAME, name);
+    ring->threadName = name;
+    ring->slots = std::make_unique<Ring::Slot[]>(kEventsPerThread);
+    {
+        std::scoped_lock lock(ringsMutex_);
+        rings_.push_back(ring);
+    }
+    t_ring = ring.get();
+
+    // 线程退出时把缓冲区标成 retired, 短命线程多的时候不至于每个都占 1.5MB
+    struct RingHolder
+    {
+        Ring *ring = nullptr;
+        ~RingHolder() { retireThread(ring); }
+    };
+    static thread_local RingHolder holder;
+    holder.ring = t_ring;
+    return t_ring;
+}
+
+void Tracer::retireThread(Ring *ring)
+{
+    t_ring = nullptr;
+    std::scoped_lock lock(ringsMutex_);
+    ring->retired = true;
+    size_t retired = 0;
+    for (const std::shared_ptr<Ring> &r : rings_)
+    {
+        retired += r->retired ? 1 : 0;
+    }
+    // rings_ 按注册顺序排, 从前往后删最早的; 正在 dump 的线程手里还有 shared_ptr, 不会读到释放的内存
+    for (auto it = rings_.begin(); retired > kMaxRetiredThreads && it != rings_.end();)
+    {
+        if ((*it)->retired)
+        {
+            it = rings_.erase(it);
+            --retired;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool Tracer::dump(const std::string &path)
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::scoped_lock lock(ringsMutex_);
+        rings = rings_;
+    }
+
+    const pid_t pid = ::getpid();
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    char line[256];
+    bool first = true;
+    auto append = [&](const char *text) {
+        if (!first)
+        {
+            out += ",\n";
+        }
+        first = false;
+        out += text;
+    };
+
+    size_t total = 0;
+    for (const std::shared_ptr<Ring> &p : rings)
+    {
+        Ring &ring = *p;
+        std::string meta = "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) +
+                           ",\"tid\":" + std::to_string(ring.tid) + ",\"args\":{\"name\":\"";
+        appendEscaped(meta, ring.threadName.c_str());
+        meta += "\"}}";
+        append(meta.c_str());
+
+        // 先把可能有效的区间整体拷出来, 再看这期间写线程有没有绕过来覆盖, 被覆盖的丢掉
+        const uint64_t head = ring.head.load(std::memory_order_acquire);
+        const uint64_t begin = head > kEventsPerThread ? head - kEventsPerThread : 0;
+        struct Event
+        {
+            uint64_t ticks;
+            const char *name;
+            uint64_t phaseArg;
+        };
+        std::vector<Event> events;
+        events.reserve(head - begin);
+        for (uint64_t i = begin; i < head; ++i)
+        {
+            const Ring::Slot &slot = ring.slots[i & (kEventsPerThread - 1)];
+            events.push_back({slot.ticks.load(std::memory_order_relaxed),
+                              slot.name.load(std::memory_order_relaxed),
+                              slot.phaseArg.load(std::memory_order_relaxed)});
+        }
+        // 下标 < headAfter - N 的已经被覆盖; 写线程这时可能正在写 headAfter 号, 它和 headAfter - N 号是同一个槽, 读到的可能半新半旧, 一并丢掉
+        const uint64_t headAfter = ring.head.load(std::memory_order_acquire);
+        const uint64_t firstIntact = headAfter + 1 > kEventsPerThread ? headAfter + 1 - kEventsPerThread : 0;
+        const size_t skip = firstIntact > begin ? std::min<size_t>(firstIntact - begin, events.size()) : 0;
+
+        for (size_t i = skip; i < events.size(); ++i)
+        {
+            const Event &e = events[i];
+            if (!e.name)
+            {
+                continue;
+            }
+            const char phase = static_cast<char>(e.phaseArg >> 56);
+            const uint64_t arg = e.phaseArg & Ring::kArgMask;
+            const double ts = static_cast<double>(TscClock::toNanoseconds(e.ticks)) / 1000.0;
+            std::string event = "{\"name\":\"";
+            appendEscaped(event, e.name);
+            if (phase == 's' || phase == 'f')
+            {
+                // flow 事件靠 id 配对, 'f' 绑定到它所在的那个 slice(bp:e)
+                snprintf(line, sizeof(line), "\",\"cat\":\"flow\",\"ph\":\"%c\",\"id\":%llu,%s\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                         phase, static_cast<unsigned long long>(arg), phase == 'f' ? "\"bp\":\"e\"," : "",
+                         ts, pid, ring.tid);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "\",\"cat\":\"muduo\",\"ph\":\"%c\",%s\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%llu}}",
+                         phase, phase == 'i' ? "\"s\":\"t\"," : "", ts, pid, ring.tid, static_cast<unsigned long long>(arg));
+            }
+            event += line;
+            append(event.c_str());
+            ++total;
+        }
+    }
+    out += "\n]}\n";
+
+    FILE *fp = ::fopen(path.c_str(), "we");
+    if (!fp)
+    {
+        LOG_ERROR("Tracer::dump open %s failed: %d\n", path.c_str(), errno);
+        return false;
+    }
+    const bool ok = ::fwrite(out.data(), 1, out.size(), fp) == out.size();
+    ::fclose(fp);
+    LOG_INFO("Tracer::dump %zu events from %zu threads to %s\n", total, rings.size(), path.c_str());
+    return ok;
+}
+
+void Tracer::dumpOnSignal(int signo, const std::string &pathPrefix)
+{
+    static std::once_flag installed;
+    bool first = false;
+    std::call_once(installed, [&] {
+        first = true;
+        if (::pipe2(g_signalPipe, O_CLOEXEC) < 0)
+        {
+            LOG_ERROR("Tracer::dumpOnSignal pipe2 failed: %d\n", errno);
+            return;
+        }
+        ::fcntl(g_signalPipe[1], F_SETFL, O_NONBLOCK);
+
+        // 后台线程常驻到进程退出, 平时阻塞在 read 上
+        std::thread([pathPrefix] {
+            char c;
+            while (::read(g_signalPipe[0], &c, 1) > 0)
+            {
+                char suffix[64];
+                snprintf(suffix, sizeof(suffix), ".%d.%lld.json", ::getpid(),
+                         static_cast<long long>(Timestamp::now().microSecondsSinceEpoch()));
+                dump(pathPrefix + suffix);
+            }
+        }).detach();
+
+        struct sigaction sa{};
+        sa.sa_handler = onDumpSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        ::sigaction(signo, &sa, nullptr);
+    });
+    if (!first)
+    {
+        LOG_ERROR("Tracer::dumpOnSignal already installed, ignoring signal %d\n", signo);
+    }
+}
@@ -0,0 +1,71 @@
+#include <mutex>
+#include <thread>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "TscClock.h"
+#include "Logger.h"
+
+namespace
+{
+    int64_t monotonicNanoseconds()
+    {
+        timespec ts{};
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // CPUID.80000007H:EDX[8], 频率恒定且深度睡眠也不停, 各核之间由内核同步
+    bool hasInvariantTsc()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+        {
+            return false;
+        }
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+#else
+        return false;
+#endif
+    }
+}
+
+void TscClock::calibrate(int calibrateMs)
+{
+    if (!hasInvariantTsc())
+    {
+        usingTsc_.store(false, std::memory_order_release);
+        ticksPerNanosecond_.store(1.0, std::memory_order_relaxed);
+        nanosecondsPerTick_.store(1.0, std::memory_order_relaxed);
+        LOG_INFO("TscClock: no invariant TSC, falling back to CLOCK_MONOTONIC\n");
+        return;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    const int64_t ns0 = monotonicNanoseconds();
+    const uint64_t tsc0 = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(calibrateMs));
+    const int64_t ns1 = monotonicNanoseconds();
+    const uint64_t tsc1 = __rdtsc();
+
+    const double ratio = static_cast<double>(tsc1 - tsc0) / static_cast<double>(ns1 - ns0);
+    if (ratio <= 0.0)
+    {
+        return;
+    }
+    ticksPerNanosecond_.store(ratio, std::memory_order_relaxed);
+    nanosecondsPerTick_.store(1.0 / ratio, std::memory_order_relaxed);
+    usingTsc_.store(true, std::memory_order_release); // 比例写完再发布, 见 TscClock.h
+    LOG_INFO("TscClock: calibrated %.3f GHz over %d ms\n", ratio, calibrateMs);
+#endif
+}
+
+void TscClock::calibrateOnce()
+{
+    static std::once_flag calibrated;
+    std::call_once(calibrated, [] { calibrate(); });
+}
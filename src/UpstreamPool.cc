@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <future>
+
+#include "UpstreamPool.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+#include "TscClock.h"
+
+namespace
+{
+    constexpr int kNumStatus = 5;
+
+    uint64_t backendKey(const InetAddress &addr)
+    {
+        const sockaddr_in *sa = addr.getSockAddr();
+        return (static_cast<uint64_t>(sa->sin_addr.s_addr) << 16) | sa->sin_port;
+    }
+}
+
+const char *UpstreamPool::statusName(Status status)
+{
+    static const char *const kNames[kNumStatus] = {"ok", "closed", "timeout", "overloaded", "protocol_error"};
+    return kNames[static_cast<int>(status)];
+}
+
+UpstreamPool::UpstreamPool(const std::vector<EventLoop *> &loops, const std::string &name, ResponseParser parser, Options options)
+    : name_(name)
+    , parser_(std::move(parser))
+    , options_(std::move(options))
+{
+    TscClock::calibrateOnce();
+
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string labels = "pool=\"" + name_ + "\"";
+    for (int i = 0; i < kNumStatus; ++i)
+    {
+        requestsMetric_[i] = registry.counter("muduo_upstream_requests_total", "Upstream requests completed, by result",
+                                              labels + ",status=\"" + statusName(static_cast<Status>(i)) + "\"");
+    }
+    connectionsMetric_ = registry.gauge("muduo_upstream_connections", "Established upstream connections", labels);
+    connectsMetric_ = registry.counter("muduo_upstream_connects_total", "Upstream connections created", labels);
+
+    // 超时判断的粒度: requestTimeout 的 1/4, 超时最多晚这么久才报
+    const double sweepInterval = std::clamp(options_.requestTimeout / 4, 0.01, 1.0);
+    for (EventLoop *loop : loops)
+    {
+        auto lp = std::make_unique<LoopPool>();
+        lp->loop = loop;
+        LoopPool *raw = lp.get();
+        lp->sweepTimer = loop->runEvery(sweepInterval, [this, raw] { sweep(*raw); });
+        loopPools_.push_back(std::move(lp));
+    }
+}
+
+UpstreamPool::UpstreamPool(const std::vector<EventLoop *> &loops, const std::string &name, ResponseParser parser)
+    : UpstreamPool(loops, name, std::move(parser), Options())
+{
+}
+
+UpstreamPool::~UpstreamPool()
+{
+    for (const auto &lp : loopPools_)
+    {
+        if (lp->loop->isInLoopThread())
+        {
+            teardown(*lp);
+        }
+        else
+        {
+            std::promise<void> done;
+            LoopPool *raw = lp.get();
+            lp->loop->runInLoop([this, raw, &done] {
+                teardown(*raw);
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+}
+
+UpstreamPool::LoopPool *UpstreamPool::localPool(EventLoop *loop) const
+{
+    // loop 个数和核数一个量级, 线性找比哈希快
+    for (const auto &lp : loopPools_)
+    {
+        if (loop ? lp->loop == loop : lp->loop->isInLoopThread())
+        {
+            return lp.get();
+        }
+    }
+    return nullptr;
+}
+
+UpstreamPool::Backend &UpstreamPool::backendFor(LoopPool &lp, const InetAddress &addr)
+{
+    std::unique_ptr<Backend> &backend = lp.backends[backendKey(addr)];
+    if (!backend)
+    {
+        backend = std::make_unique<Backend>();
+        backend->owner = &lp;
+        backend->addr = addr;
+    }
+    return *backend;
+}
+
+void UpstreamPool::request(const InetAddress &backend, std::string request, ResponseCallback callback)
+{
+    LoopPool *lp = localPool(nullptr);
+    if (lp == nullptr)
+    {
+        LOG_FATAL("UpstreamPool::request[%s] - not called in one of the pool's loops\n", name_.c_str());
+    }
+    requestInLoop(*lp, backend, std::move(request), std::move(callback));
+}
+
+void UpstreamPool::request(EventLoop *loop, const InetAddress &backend, std::string request, ResponseCallback callback)
+{
+    LoopPool *lp = localPool(loop);
+    if (lp == nullptr)
+    {
+        LOG_FATAL("UpstreamPool::request[%s] - loop %p does not belong to the pool\n", name_.c_str(), loop);
+    }
+    loop->runInLoop([this, lp, backend, request = std::move(request), callback = std::move(callback)]() mutable {
+        requestInLoop(*lp, backend, std::move(request), std::move(callback));
+    });
+}
+
+void UpstreamPool::requestInLoop(LoopPool &lp, const InetAddress &addr, std::string &&request, ResponseCallback &&callback)
+{
+    Backend &backend = backendFor(lp, addr);
+    const uint64_t startTicks = TscClock::now();
+    const Timestamp deadline = addTime(Timestamp::coarseNow(), options_.requestTimeout);
+
+    // 已经有人在排队就别插队, 保持请求的先后顺序
+    if (backend.waiting.empty() && backend.inFlight < options_.maxInFlightPerBackend &&
+        trySend(backend, request, callback, deadline, startTicks))
+    {
+        return;
+    }
+    if (backend.waiting.size() >= options_.maxQueuedPerBackend)
+    {
+        fail(backend, callback, Status::kOverloaded);
+        return;
+    }
+    backend.waiting.push_back(Waiting{std::move(request), std::move(callback), deadline, startTicks});
+}
+
+bool UpstreamPool::trySend(Backend &backend, const std::string &request, ResponseCallback &callback, Timestamp deadline, uint64_t startTicks)
+{
+    Conn *best = nullptr;
+    bool connecting = false;
+    for (const ConnPtr &conn : backend.conns)
+    {
+        if (!conn->connection)
+        {
+            connecting = true;
+            continue;
+        }
+        // 已经断开、还没走到 connectDestroyed 的连接, send 会被静默丢掉
+        if (!conn->connection->connected() || conn->pending.size() >= options_.maxPipelineDepth)
+        {
+            continue;
+        }
+        if (best == nullptr || conn->pending.size() < best->pending.size())
+        {
+            best = conn.get();
+        }
+    }
+    // 没有空闲连接就再开一条(同一时间只开一条), 这次先流水线在最闲的连接上, 新连接连上后排队的请求会分过去
+    if ((best == nullptr || !best->pending.empty()) && !connecting && backend.conns.size() < options_.maxConnectionsPerBackend)
+    {
+        newConn(backend);
+    }
+    if (best == nullptr)
+    {
+        return false;
+    }
+    sendOn(*best, request, Pending{std::move(callback), deadline, startTicks});
+    ++backend.inFlight;
+    return true;
+}
+
+void UpstreamPool::sendOn(Conn &conn, const std::string &request, Pending pending)
+{
+    const Timestamp now = Timestamp::coarseNow();
+    if (pending.callback)
+    {
+        conn.lastUsed = now;
+    }
+    conn.lastActive = now;
+    conn.pending.push_back(std::move(pending));
+    conn.connection->send(request);
+}
+
+void UpstreamPool::drainWaiting(Backend &backend)
+{
+    while (!backend.waiting.empty() && backend.inFlight < options_.maxInFlightPerBackend)
+    {
+        Waiting &front = backend.waiting.front();
+        if (!trySend(backend, front.request, front.callback, front.deadline, front.startTicks))
+        {
+            break;
+        }
+        backend.waiting.pop_front();
+    }
+}
+
+void UpstreamPool::newConn(Backend &backend)
+{
+    auto conn = std::make_shared<Conn>();
+    conn->backend = &backend;
+    conn->lastUsed = conn->lastActive = Timestamp::coarseNow();
+    conn->client = std::make_unique<TcpClient>(backend.owner->loop, backend.addr, name_);
+
+    // 连接可能比 Conn 活得久(正在关闭), 回调只拿 weak_ptr, 摘下来之后的回调直接忽略
+    std::weak_ptr<Conn> weakConn = conn;
+    conn->client->setConnectionCallback([this, weakConn](const TcpConnectionPtr &connection) {
+        ConnPtr self = weakConn.lock();
+        if (self && !self->retired)
+        {
+            onConnection(self, connection);
+        }
+    });
+    conn->client->setMessageCallback([this, weakConn](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        ConnPtr self = weakConn.lock();
+        if (self && !self->retired)
+        {
+            onMessage(self, buf);
+        }
+        else
+        {
+            buf->retrieveAll();
+        }
+    });
+    backend.conns.push_back(conn);
+    connectsMetric_.inc();
+    // 连不上时 Connector 自己按退避重试, 排队的请求等到超时为止
+    conn->client->connect();
+}
+
+void UpstreamPool::onConnection(const ConnPtr &conn, const TcpConnectionPtr &connection)
+{
+    if (connection->connected())
+    {
+        connection->setTcpNoDelay(true); // 流水线上的小请求不能等 Nagle
+        conn->connection = connection;
+        conn->lastActive = Timestamp::coarseNow();
+        connectionsMetric_.inc();
+        drainWaiting(*conn->backend);
+    }
+    else
+    {
+        retire(conn, Status::kClosed);
+    }
+}
+
+void UpstreamPool::onMessage(const ConnPtr &conn, Buffer *buf)
+{
+    Backend &backend = *conn->backend;
+    conn->lastActive = Timestamp::coarseNow();
+    while (buf->readableBytes() > 0)
+    {
+        if (conn->pending.empty())
+        {
+            LOG_ERROR("UpstreamPool[%s] - %zu unsolicited bytes from %s\n", name_.c_str(), buf->readableBytes(), backend.addr.toIpPort().c_str());
+            retire(conn, Status::kProtocolError);
+            return;
+        }
+        const ssize_t n = parser_(buf);
+        if (n == 0)
+        {
+            break;
+        }
+        if (n < 0 || static_cast<size_t>(n) > buf->readableBytes())
+        {
+            LOG_ERROR("UpstreamPool[%s] - bad response from %s\n", name_.c_str(), backend.addr.toIpPort().c_str());
+            retire(conn, Status::kProtocolError);
+            return;
+        }
+        Pending pending = std::move(conn->pending.front());
+        conn->pending.pop_front();
+        if (pending.callback) // 空的是健康探测, 能解析出响应就算健康
+        {
+            --backend.inFlight;
+            backend.owner->latencyUs.record(static_cast<uint64_t>(TscClock::toMicroseconds(TscClock::now() - pending.startTicks)));
+            requestsMetric_[static_cast<int>(Status::kOk)].inc();
+            pending.callback(Status::kOk, buf->peek(), static_cast<size_t>(n));
+        }
+        buf->retrieve(static_cast<size_t>(n));
+    }
+    // 流水线空出了位置, 把排队的补上
+    drainWaiting(backend);
+}
+
+void UpstreamPool::retire(const ConnPtr &conn, Status status)
+{
+    if (conn->retired)
+    {
+        return;
+    }
+    conn->retired = true;
+    Backend &backend = *conn->backend;
+    if (conn->connection)
+    {
+        connectionsMetric_.dec();
+        conn->connection->forceClose(); // 超时/协议错误时连接还好好的, 已经断开的这里什么都不做
+    }
+    for (Pending &pending : conn->pending)
+    {
+        if (pending.callback)
+        {
+            --backend.inFlight;
+            fail(backend, pending.callback, status);
+        }
+    }
+    conn->pending.clear();
+    backend.conns.erase(std::find(backend.conns.begin(), backend.conns.end(), conn));
+    // 这里可能就在这条连接自己的回调里, TcpClient 放到这一轮的 pendingFunctors 里再析构.
+    // 不在这里补连接: 后端一 accept 就关的话会变成不退避的重连风暴, 排队的请求交给巡检或下一个请求去补
+    backend.owner->loop->queueInLoop([doomed = conn] {});
+}
+
+void UpstreamPool::fail(Backend &backend, ResponseCallback &callback, Status status)
+{
+    requestsMetric_[static_cast<int>(status)].inc();
+    // 不在调用栈里直接回调: 调用方可能正在遍历连接/队列, 用户回调里再发请求会把它们改掉
+    backend.owner->loop->queueInLoop([callback = std::move(callback), status] { callback(status, nullptr, 0); });
+}
+
+void UpstreamPool::sweep(LoopPool &lp)
+{
+    const Timestamp now = Timestamp::coarseNow();
+    for (auto it = lp.backends.begin(); it != lp.backends.end();)
+    {
+        Backend &backend = *it->second;
+        // 超时时间都一样, 队列按 deadline 有序
+        while (!backend.waiting.empty() && backend.waiting.front().deadline < now)
+        {
+            fail(backend, backend.waiting.front().callback, Status::kTimeout);
+            backend.waiting.pop_front();
+        }
+
+        const std::vector<ConnPtr> conns = backend.conns; // retire 会改 backend.conns
+        for (const ConnPtr &conn : conns)
+        {
+            if (!conn->pending.empty())
+            {
+                if (conn->pending.front().deadline < now)
+                {
+                    LOG_ERROR("UpstreamPool[%s] - %s timed out with %zu requests in flight, closing\n",
+                              name_.c_str(), backend.addr.toIpPort().c_str(), conn->pending.size());
+                    retire(conn, Status::kTimeout);
+                }
+            }
+            else if (backend.waiting.empty() && timeDifference(now, conn->lastUsed) > options_.idleTimeout)
+            {
+                retire(conn, Status::kClosed);
+            }
+            else if (conn->connection && conn->connection->connected() && !options_.healthCheckRequest.empty() &&
+                     timeDifference(now, conn->lastActive) > options_.healthCheckInterval)
+            {
+                sendOn(*conn, options_.healthCheckRequest, Pending{{}, addTime(now, options_.requestTimeout), 0});
+            }
+        }
+
+        drainWaiting(backend);
+        if (backend.conns.empty() && backend.waiting.empty())
+        {
+            it = lp.backends.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void UpstreamPool::teardown(LoopPool &lp)
+{
+    lp.loop->cancel(lp.sweepTimer);
+    for (auto &entry : lp.backends)
+    {
+        Backend &backend = *entry.second;
+        for (Waiting &waiting : backend.waiting)
+        {
+            fail(backend, waiting.callback, Status::kClosed);
+        }
+        backend.waiting.clear();
+        const std::vector<ConnPtr> conns = backend.conns;
+        for (const ConnPtr &conn : conns)
+        {
+            retire(conn, Status::kClosed);
+        }
+    }
+    lp.backends.clear();
+}
+
+Histogram::Snapshot UpstreamPool::latencySnapshot() const
+{
+    Histogram::Snapshot total;
+    for (const auto &lp : loopPools_)
+    {
+        total.merge(lp->latencyUs.snapshot());
+    }
+    return total;
+}
+
+std::string UpstreamPool::report() const
+{
+    std::string out;
+    for (const auto &lp : loopPools_)
+    {
+        auto collect = [&lp] {
+            std::string text;
+            char line[256];
+            for (const auto &entry : lp->backends)
+            {
+                const Backend &backend = *entry.second;
+                size_t established = 0;
+                for (const ConnPtr &conn : backend.conns)
+                {
+                    established += conn->connection ? 1 : 0;
+                }
+                snprintf(line, sizeof(line), "loop=%p backend=%s connections=%zu established=%zu in_flight=%zu queued=%zu\n",
+                         lp->loop, backend.addr.toIpPort().c_str(), backend.conns.size(), established, backend.inFlight, backend.waiting.size());
+                text += line;
+            }
+            return text;
+        };
+        if (lp->loop->isInLoopThread())
+        {
+            out += collect();
+        }
+        else
+        {
+            std::promise<std::string> result;
+            lp->loop->runInLoop([&result, &collect] { result.set_value(collect()); });
+            out += result.get_future().get();
+        }
+    }
+    return out;
+}
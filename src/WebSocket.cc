@@ -0,0 +1,445 @@
+#include <cstring>
+
+#include "WebSocket.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MUDUO_WEBSOCKET_X86 1
+#endif
+
+namespace
+{
+    void unmaskScalar(char *data, size_t len, const uint8_t mask[4])
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            data[i] = static_cast<char>(data[i] ^ mask[i & 3]);
+        }
+    }
+
+#ifdef MUDUO_WEBSOCKET_X86
+    // 掩码 4 字节一循环, 16/32 都是 4 的倍数, 所以每个向量用同一个(平铺的)掩码. 尾巴走标量, 相位还是从 0 开始
+    void unmaskSse2(char *data, size_t len, const uint8_t mask[4])
+    {
+        uint32_t m;
+        memcpy(&m, mask, 4);
+        const __m128i key = _mm_set1_epi32(static_cast<int>(m));
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i *p = reinterpret_cast<__m128i *>(data + i);
+            _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key));
+        }
+        unmaskScalar(data + i, len - i, mask);
+    }
+
+    __attribute__((target("avx2"))) void unmaskAvx2(char *data, size_t len, const uint8_t mask[4])
+    {
+        uint32_t m;
+        memcpy(&m, mask, 4);
+        const __m256i key = _mm256_set1_epi32(static_cast<int>(m));
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32)
+        {
+            __m256i *p = reinterpret_cast<__m256i *>(data + i);
+            _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), key));
+        }
+        unmaskSse2(data + i, len - i, mask);
+    }
+#endif
+
+    using UnmaskFunc = void (*)(char *, size_t, const uint8_t *);
+
+    UnmaskFunc selectUnmask()
+    {
+#ifdef MUDUO_WEBSOCKET_X86
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? unmaskAvx2 : unmaskSse2; // SSE2 是 x86-64 的基线
+#else
+        return unmaskScalar;
+#endif
+    }
+
+    // 控制帧和小消息不值得走一次间接调用
+    constexpr size_t kSimdThreshold = 32;
+
+    // 只校验结构(续字节个数、过长编码、代理区、> U+10FFFF), ASCII 8 字节一跳
+    bool validUtf8(std::string_view s)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(s.data());
+        const unsigned char *const end = p + s.size();
+        while (p < end)
+        {
+            if (end - p >= 8)
+            {
+                uint64_t word;
+                memcpy(&word, p, 8);
+                if ((word & 0x8080808080808080ULL) == 0)
+                {
+                    p += 8;
+                    continue;
+                }
+            }
+            const unsigned char c = *p;
+            if (c < 0x80)
+            {
+                ++p;
+                continue;
+            }
+            size_t n;
+            uint32_t cp;
+            if ((c & 0xE0) == 0xC0)
+            {
+                n = 1;
+                cp = c & 0x1F;
+            }
+            else if ((c & 0xF0) == 0xE0)
+            {
+                n = 2;
+                cp = c & 0x0F;
+            }
+            else if ((c & 0xF8) == 0xF0)
+            {
+                n = 3;
+                cp = c & 0x07;
+            }
+            else
+            {
+                return false;
+            }
+            if (static_cast<size_t>(end - p) <= n)
+            {
+                return false;
+            }
+            for (size_t i = 1; i <= n; ++i)
+            {
+                if ((p[i] & 0xC0) != 0x80)
+                {
+                    return false;
+                }
+                cp = (cp << 6) | (p[i] & 0x3F);
+            }
+            static constexpr uint32_t kMin[4] = {0, 0x80, 0x800, 0x10000};
+            if (cp < kMin[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            {
+                return false;
+            }
+            p += n + 1;
+        }
+        return true;
+    }
+
+    bool isControl(WebSocket::Opcode opcode) { return (static_cast<uint8_t>(opcode) & 0x8) != 0; }
+}
+
+WebSocket::WebSocket(const TcpConnectionPtr &conn, const Options &options, MessageCallback messageCallback)
+    : conn_(conn)
+    , id_(conn->id())
+    , options_(options)
+    , messageCallback_(std::move(messageCallback))
+    , lastReceive_(Timestamp::coarseNow())
+{
+}
+
+void WebSocket::unmask(char *data, size_t len, const uint8_t mask[4])
+{
+    static const UnmaskFunc impl = selectUnmask();
+    if (len < kSimdThreshold)
+    {
+        unmaskScalar(data, len, mask);
+        return;
+    }
+    impl(data, len, mask);
+}
+
+size_t WebSocket::writeHeader(char *out, Opcode opcode, size_t payloadLen)
+{
+    out[0] = static_cast<char>(0x80 | static_cast<uint8_t>(opcode));
+    if (payloadLen < 126)
+    {
+        out[1] = static_cast<char>(payloadLen);
+        return 2;
+    }
+    if (payloadLen <= 0xFFFF)
+    {
+        out[1] = 126;
+        out[2] = static_cast<char>(payloadLen >> 8);
+        out[3] = static_cast<char>(payloadLen);
+        return 4;
+    }
+    out[1] = 127;
+    for (int i = 0; i < 8; ++i)
+    {
+        out[2 + i] = static_cast<char>(static_cast<uint64_t>(payloadLen) >> (56 - 8 * i));
+    }
+    return 10;
+}
+
+std::shared_ptr<const Buffer> WebSocket::makeFrame(std::string_view payload, Opcode opcode)
+{
+    Buffer buf(payload.size());
+    buf.append(payload.data(), payload.size());
+    return makeFrame(std::move(buf), opcode);
+}
+
+std::shared_ptr<const Buffer> WebSocket::makeFrame(Buffer &&payload, Opcode opcode)
+{
+    char header[kMaxHeaderBytes];
+    const size_t n = writeHeader(header, opcode, payload.readableBytes());
+    auto frame = std::make_shared<Buffer>(0);
+    frame->swap(payload);
+    if (frame->prependableBytes() >= n)
+    {
+        frame->prepend(header, n);
+    }
+    else
+    {
+        // 正常走不到: kCheapPrepend 够放最长的帧头
+        Buffer copy(n + frame->readableBytes());
+        copy.append(header, n);
+        copy.append(frame->peek(), frame->readableBytes());
+        frame->swap(copy);
+    }
+    return frame;
+}
+
+bool WebSocket::connected() const
+{
+    TcpConnectionPtr conn = conn_.lock();
+    return conn && conn->connected() && !closeSent_.load(std::memory_order_relaxed);
+}
+
+bool WebSocket::send(std::string_view payload, Opcode opcode)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || !conn->connected() || closeSent_.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    char header[kMaxHeaderBytes];
+    const size_t n = writeHeader(header, opcode, payload.size());
+    conn->sendv(std::string_view(header, n), payload);
+    return true;
+}
+
+bool WebSocket::sendFrame(const std::shared_ptr<const Buffer> &frame)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || !conn->connected() || closeSent_.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    EventLoop *loop = conn->getLoop();
+    if (loop->isInLoopThread())
+    {
+        conn->send(frame->peek(), frame->readableBytes());
+    }
+    else
+    {
+        // 带着引用投递过去, 不拷负载
+        loop->queueInLoop([conn = std::move(conn), frame] { conn->send(frame->peek(), frame->readableBytes()); });
+    }
+    return true;
+}
+
+void WebSocket::ping(std::string_view payload)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (conn && conn->connected())
+    {
+        sendControl(conn, Opcode::kPing, payload.substr(0, 125));
+    }
+}
+
+void WebSocket::close(uint16_t code, std::string_view reason)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || closeSent_.exchange(true))
+    {
+        return;
+    }
+    char payload[125];
+    payload[0] = static_cast<char>(code >> 8);
+    payload[1] = static_cast<char>(code);
+    reason = reason.substr(0, sizeof(payload) - 2);
+    reason.copy(payload + 2, reason.size());
+    sendControl(conn, Opcode::kClose, std::string_view(payload, 2 + reason.size()));
+    conn->shutdown(); // 数据发完后半关闭, 客户端回 close 之后自己断开
+}
+
+void WebSocket::sendControl(const TcpConnectionPtr &conn, Opcode opcode, std::string_view payload)
+{
+    char header[kMaxHeaderBytes];
+    const size_t n = writeHeader(header, opcode, payload.size());
+    conn->sendv(std::string_view(header, n), payload);
+}
+
+void WebSocket::fail(const TcpConnectionPtr &conn, uint16_t code)
+{
+    LOG_DEBUG("WebSocket %s - closing with %d\n", conn->name().c_str(), code);
+    close(code);
+    conn->inputBuffer()->retrieveAll();
+}
+
+void WebSocket::onMessage(const WebSocketPtr &self, const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    if (closeSent_.load(std::memory_order_relaxed))
+    {
+        buf->retrieveAll(); // 已经发过 close, 只等对方断开
+        return;
+    }
+    lastReceive_ = receiveTime;
+    awaitingPong_ = false; // 收到任何东西都说明对方活着
+
+    while (buf->readableBytes() >= 2)
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(buf->peek());
+        const bool fin = (p[0] & 0x80) != 0;
+        const auto opcode = static_cast<Opcode>(p[0] & 0x0F);
+        const bool masked = (p[1] & 0x80) != 0;
+        const uint8_t len7 = p[1] & 0x7F;
+        if ((p[0] & 0x70) != 0 || !masked) // 没协商扩展, RSV 必须是 0; 客户端的帧必须带掩码
+        {
+            fail(conn, kProtocolError);
+            return;
+        }
+        const size_t lengthBytes = len7 == 126 ? 2 : len7 == 127 ? 8 : 0;
+        const size_t headerLen = 2 + lengthBytes + 4;
+        if (buf->readableBytes() < headerLen)
+        {
+            break;
+        }
+        uint64_t payloadLen = len7;
+        if (lengthBytes > 0)
+        {
+            payloadLen = 0;
+            for (size_t i = 0; i < lengthBytes; ++i)
+            {
+                payloadLen = (payloadLen << 8) | p[2 + i];
+            }
+            // 必须用最短编码, 64 位长度最高位必须是 0
+            if ((len7 == 126 && payloadLen < 126) || (len7 == 127 && (payloadLen <= 0xFFFF || (payloadLen >> 63) != 0)))
+            {
+                fail(conn, kProtocolError);
+                return;
+            }
+        }
+        if (isControl(opcode) && (!fin || payloadLen > 125))
+        {
+            fail(conn, kProtocolError);
+            return;
+        }
+        if (payloadLen + fragments_.size() > options_.maxMessageBytes)
+        {
+            fail(conn, kMessageTooBig);
+            return;
+        }
+        if (buf->readableBytes() < headerLen + payloadLen)
+        {
+            break; // 等剩下的负载. Buffer 会按需扩容, 上限已经被 maxMessageBytes 卡住
+        }
+
+        uint8_t mask[4];
+        memcpy(mask, p + 2 + lengthBytes, 4);
+        char *payload = buf->peek() + headerLen;
+        unmask(payload, payloadLen, mask);
+        // 先处理再 retrieve: 不分片的消息直接把 inputBuffer_ 里的这段交给回调
+        if (!handleFrame(self, conn, opcode, fin, payload, payloadLen))
+        {
+            return;
+        }
+        buf->retrieve(headerLen + payloadLen);
+    }
+}
+
+bool WebSocket::handleFrame(const WebSocketPtr &self, const TcpConnectionPtr &conn, Opcode opcode, bool fin, char *payload, size_t len)
+{
+    switch (opcode)
+    {
+    case Opcode::kText:
+    case Opcode::kBinary:
+        if (fragmentOpcode_ != Opcode::kContinuation)
+        {
+            fail(conn, kProtocolError); // 上一条分片消息还没完
+            return false;
+        }
+        if (fin)
+        {
+            return deliver(self, conn, std::string_view(payload, len), opcode);
+        }
+        fragmentOpcode_ = opcode;
+        fragments_.assign(payload, len);
+        return true;
+
+    case Opcode::kContinuation:
+        if (fragmentOpcode_ == Opcode::kContinuation)
+        {
+            fail(conn, kProtocolError);
+            return false;
+        }
+        fragments_.append(payload, len);
+        if (fin)
+        {
+            const Opcode messageOpcode = fragmentOpcode_;
+            fragmentOpcode_ = Opcode::kContinuation;
+            const bool ok = deliver(self, conn, fragments_, messageOpcode);
+            fragments_.clear();
+            return ok;
+        }
+        return true;
+
+    case Opcode::kPing:
+        sendControl(conn, Opcode::kPong, std::string_view(payload, len));
+        return true;
+
+    case Opcode::kPong:
+        return true; // awaitingPong_ 在 onMessage 开头已经清了
+
+    case Opcode::kClose:
+    {
+        uint16_t code = kNormalClosure;
+        if (len == 1)
+        {
+            fail(conn, kProtocolError);
+            return false;
+        }
+        if (len >= 2)
+        {
+            code = static_cast<uint16_t>((static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]));
+            // 1004-1006/1015 只在本地表示状态, 不能出现在帧里; 1016-2999 还没分配
+            const bool validCode = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) || (code >= 3000 && code <= 4999);
+            if (!validCode || !validUtf8(std::string_view(payload + 2, len - 2)))
+            {
+                fail(conn, kProtocolError);
+                return false;
+            }
+        }
+        close(code); // 原样回一个 close, 握手完成
+        conn->inputBuffer()->retrieveAll();
+        return false;
+    }
+
+    default:
+        fail(conn, kProtocolError);
+        return false;
+    }
+}
+
+bool WebSocket::deliver(const WebSocketPtr &self, const TcpConnectionPtr &conn, std::string_view payload, Opcode opcode)
+{
+    if (opcode == Opcode::kText && !validUtf8(payload))
+    {
+        fail(conn, kInvalidPayload);
+        return false;
+    }
+    if (messageCallback_)
+    {
+        messageCallback_(self, payload, opcode);
+    }
+    // 回调里可能 close 了
+    return !closeSent_.load(std::memory_order_relaxed);
+}
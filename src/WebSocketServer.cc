@@ -0,0 +1,334 @@
+#include <cstring>
+#include <future>
+
+#include "WebSocketServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+namespace
+{
+    // 握手只要对 (key + GUID) 算一次 SHA-1, 一个 60 字节的输入, 不值得为它引入 OpenSSL
+    void sha1(std::string_view input, uint8_t digest[20])
+    {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+        std::string msg(input);
+        const uint64_t bitLen = static_cast<uint64_t>(input.size()) * 8;
+        msg.push_back(static_cast<char>(0x80));
+        while (msg.size() % 64 != 56)
+        {
+            msg.push_back('\0');
+        }
+        for (int i = 7; i >= 0; --i)
+        {
+            msg.push_back(static_cast<char>(bitLen >> (8 * i)));
+        }
+
+        for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+        {
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(msg.data() + chunk);
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+            {
+                w[i] = (uint32_t(p[4 * i]) << 24) | (uint32_t(p[4 * i + 1]) << 16) | (uint32_t(p[4 * i + 2]) << 8) | p[4 * i + 3];
+            }
+            for (int i = 16; i < 80; ++i)
+            {
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i)
+            {
+                uint32_t f, k;
+                if (i < 20)
+                {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }
+                else if (i < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if (i < 60)
+                {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                const uint32_t t = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = t;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        for (int i = 0; i < 5; ++i)
+        {
+            digest[4 * i] = static_cast<uint8_t>(h[i] >> 24);
+            digest[4 * i + 1] = static_cast<uint8_t>(h[i] >> 16);
+            digest[4 * i + 2] = static_cast<uint8_t>(h[i] >> 8);
+            digest[4 * i + 3] = static_cast<uint8_t>(h[i]);
+        }
+    }
+
+    std::string base64(const uint8_t *data, size_t len)
+    {
+        static constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        out.reserve((len + 2) / 3 * 4);
+        for (size_t i = 0; i < len; i += 3)
+        {
+            const uint32_t n = (uint32_t(data[i]) << 16) | (i + 1 < len ? uint32_t(data[i + 1]) << 8 : 0) | (i + 2 < len ? data[i + 2] : 0);
+            out.push_back(kAlphabet[(n >> 18) & 63]);
+            out.push_back(kAlphabet[(n >> 12) & 63]);
+            out.push_back(i + 1 < len ? kAlphabet[(n >> 6) & 63] : '=');
+            out.push_back(i + 2 < len ? kAlphabet[n & 63] : '=');
+        }
+        return out;
+    }
+
+    // RFC 6455 4.2.2
+    std::string acceptKey(std::string_view clientKey)
+    {
+        static constexpr std::string_view kGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        std::string input(clientKey);
+        input.append(kGuid);
+        uint8_t digest[20];
+        sha1(input, digest);
+        return base64(digest, sizeof(digest));
+    }
+
+    // 握手失败: 回个错误, 发完关掉. 返回的回调把之后到的数据都丢掉, 不再按 HTTP 解析
+    MessageCallback rejectHandshake(const TcpConnectionPtr &conn, std::string_view response)
+    {
+        conn->send(response.data(), response.size());
+        conn->shutdown();
+        return [](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); };
+    }
+
+    constexpr std::string_view kBadRequest = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    constexpr std::string_view kUpgradeRequired =
+        "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    // 保活定时器的粒度. pingInterval/pongTimeout 是秒级的, 每秒扫一遍足够
+    constexpr double kSweepInterval = 1.0;
+}
+
+WebSocketServer::WebSocketServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name, TcpServer::Option option)
+    : loop_(loop)
+    , name_(name)
+    , httpServer_(loop, listenAddr, name, option)
+{
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    const std::string server = "server=\"" + name_ + "\"";
+    connections_ = registry.gauge("muduo_websocket_connections", "Open WebSocket connections", server);
+    handshakeFailures_ = registry.counter("muduo_websocket_handshake_failures_total", "Rejected WebSocket upgrade requests", server);
+
+    httpServer_.setUpgradeCallback([this](const TcpConnectionPtr &conn, const HttpRequest &request) { return onUpgrade(conn, request); });
+    httpServer_.setConnectionCallback([this](const TcpConnectionPtr &conn) { onConnection(conn); });
+}
+
+WebSocketServer::~WebSocketServer()
+{
+    for (const auto &state : loopStates_)
+    {
+        // 取消定时器, 清空连接表. 连接本身由 TcpServer 析构时关闭, 关闭时 onConnection 在表里找不到, 不会再回调
+        auto teardown = [raw = state.get()] {
+            raw->loop->cancel(raw->sweepTimer);
+            raw->sockets.clear();
+        };
+        if (state->loop->isInLoopThread())
+        {
+            teardown();
+        }
+        else
+        {
+            std::promise<void> done;
+            state->loop->runInLoop([&teardown, &done] {
+                teardown();
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+}
+
+void WebSocketServer::start()
+{
+    // TcpServer::start 在 baseLoop 线程里会同步 listen, 但 accept 要等回到 loop 里才发生, 这之前 loopStates_ 已经建好了
+    loop_->runInLoop([this] { startInLoop(); });
+}
+
+void WebSocketServer::startInLoop()
+{
+    if (started_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    httpServer_.start();
+    for (EventLoop *loop : httpServer_.tcpServer().loops())
+    {
+        auto state = std::make_unique<LoopState>();
+        state->loop = loop;
+        if (pingInterval_ > 0)
+        {
+            LoopState *raw = state.get();
+            // 在析构里取消, 所以这里可以直接捕获裸指针
+            state->sweepTimer = loop->runEvery(kSweepInterval, [this, raw] { sweep(*raw); });
+        }
+        loopStates_.push_back(std::move(state));
+    }
+    started_.store(true, std::memory_order_release);
+}
+
+WebSocketServer::LoopState *WebSocketServer::localState(EventLoop *loop) const
+{
+    // loop 个数和核数一个量级, 线性找比哈希快
+    for (const auto &state : loopStates_)
+    {
+        if (state->loop == loop)
+        {
+            return state.get();
+        }
+    }
+    return nullptr;
+}
+
+MessageCallback WebSocketServer::onUpgrade(const TcpConnectionPtr &conn, const HttpRequest &request)
+{
+    if (!request.headerHasToken("Upgrade", "websocket"))
+    {
+        return nullptr; // 别的协议(h2c 之类)不管, 当普通请求处理
+    }
+    const std::string_view key = request.header("Sec-WebSocket-Key");
+    if (request.method() != HttpRequest::Method::kGet || request.version() != HttpRequest::Version::kHttp11 ||
+        !request.headerHasToken("Connection", "upgrade") || key.size() != 24) // 16 字节随机数的 base64
+    {
+        handshakeFailures_.inc();
+        return rejectHandshake(conn, kBadRequest);
+    }
+    if (request.header("Sec-WebSocket-Version") != "13")
+    {
+        handshakeFailures_.inc();
+        return rejectHandshake(conn, kUpgradeRequired);
+    }
+    LoopState *state = localState(conn->getLoop());
+    if (state == nullptr)
+    {
+        LOG_ERROR("WebSocketServer[%s] - connection %s on an unknown loop\n", name_.c_str(), conn->name().c_str());
+        return rejectHandshake(conn, kBadRequest);
+    }
+
+    std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    response.append(acceptKey(key)).append("\r\n\r\n");
+    conn->send(response);
+
+    auto ws = std::make_shared<WebSocket>(conn, options_, messageCallback_);
+    state->sockets.emplace(ws->id(), ws);
+    connections_.inc();
+    if (openCallback_)
+    {
+        openCallback_(ws, request);
+    }
+    return [ws](const TcpConnectionPtr &c, Buffer *buf, Timestamp receiveTime) { ws->onMessage(ws, c, buf, receiveTime); };
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        return;
+    }
+    LoopState *state = localState(conn->getLoop());
+    if (state == nullptr)
+    {
+        return;
+    }
+    auto it = state->sockets.find(conn->id());
+    if (it == state->sockets.end())
+    {
+        return; // 普通 HTTP 连接, 或者析构时表已经清了
+    }
+    WebSocketPtr ws = std::move(it->second);
+    state->sockets.erase(it);
+    connections_.dec();
+    if (closeCallback_)
+    {
+        closeCallback_(ws);
+    }
+}
+
+void WebSocketServer::sweep(LoopState &state)
+{
+    const Timestamp now = Timestamp::coarseNow();
+    // 先挑出来再动手: forceClose 在 loop 线程里会同步回调 onConnection, 从表里删东西
+    std::vector<TcpConnectionPtr> dead;
+    for (auto &[id, ws] : state.sockets)
+    {
+        if (ws->awaitingPong_)
+        {
+            if (timeDifference(now, ws->pingSentAt_) > pongTimeout_)
+            {
+                if (TcpConnectionPtr conn = ws->connection())
+                {
+                    dead.push_back(std::move(conn));
+                }
+            }
+        }
+        else if (timeDifference(now, ws->lastReceive_) > pingInterval_)
+        {
+            // 发过 close 还没断的(对方不回 close)也走这里: ping 发不出去, 超时后一样断开
+            if (!ws->closeSent_.load(std::memory_order_relaxed))
+            {
+                ws->ping();
+            }
+            ws->awaitingPong_ = true;
+            ws->pingSentAt_ = now;
+        }
+    }
+    for (const TcpConnectionPtr &conn : dead)
+    {
+        LOG_DEBUG("WebSocketServer[%s] - %s pong timeout\n", name_.c_str(), conn->name().c_str());
+        conn->forceClose();
+    }
+}
+
+void WebSocketServer::broadcast(std::string_view payload, WebSocket::Opcode opcode)
+{
+    if (!started_.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    broadcast(WebSocket::makeFrame(payload, opcode));
+}
+
+void WebSocketServer::broadcast(const std::shared_ptr<const Buffer> &frame)
+{
+    if (!started_.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    for (const auto &state : loopStates_)
+    {
+        LoopState *raw = state.get();
+        raw->loop->runInLoop([raw, frame] {
+            for (const auto &[id, ws] : raw->sockets)
+            {
+                ws->sendFrame(frame);
+            }
+        });
+    }
+}
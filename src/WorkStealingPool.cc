@@ -0,0 +1,181 @@
+#include <algorithm>
+
+#include "WorkStealingPool.h"
+#include "Logger.h"
+
+namespace
+{
+    // 当前线程是哪个池的第几个 worker, 用于 submit 时判断能不能直接压自己的队列
+    thread_local WorkStealingPool *t_pool = nullptr;
+    thread_local size_t t_workerIndex = 0;
+}
+
+WorkStealingPool::WorkStealingPool(const std::string &nameArg)
+    : name_(nameArg)
+{
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    stop();
+}
+
+void WorkStealingPool::start()
+{
+    if (started_)
+    {
+        return;
+    }
+    started_ = true;
+    stopping_ = false;
+
+    const int n = numThreads_ > 0 ? numThreads_ : 1;
+    workers_.reserve(n);
+    for (int i = 0; i < n; ++i)
+    {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // 先把所有 Worker 建好再起线程, 偷取时会遍历 workers_
+    for (int i = 0; i < n; ++i)
+    {
+        workers_[i]->thread = std::make_unique<Thread>([this, i] { workerLoop(i); },
+                                                       name_ + std::to_string(i));
+        workers_[i]->thread->start();
+    }
+    LOG_INFO("WorkStealingPool [%s] started with %d workers\n", name_.c_str(), n);
+}
+
+void WorkStealingPool::stop()
+{
+    if (!started_)
+    {
+        return;
+    }
+    {
+        std::scoped_lock lock(sleepMutex_);
+        stopping_ = true;
+    }
+    sleepCond_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker->thread->join();
+    }
+    workers_.clear();
+    started_ = false;
+}
+
+bool WorkStealingPool::submit(Task task)
+{
+    pending_.fetch_add(1); // 先计数再入队, 否则 worker 可能先取走任务把计数减成"负数"
+    if (t_pool == this)
+    {
+        // worker 内派生的子任务, 无锁. stop() 期间也收: 当前 worker 跑完手上的任务会接着把它取出来
+        workers_[t_workerIndex]->deque.push(new Task(std::move(task)));
+    }
+    else
+    {
+        // 计数在前、检查 stopping_ 在后: worker 看到 pending_ == 0 才退出, 那时 stopping_ 已经是 true,
+        // 这里要么被拒绝, 要么计数被还在跑的 worker 看到, 不会有任务留在没人取的注入队列里
+        if (stopping_.load())
+        {
+            pending_.fetch_sub(1);
+            LOG_ERROR("WorkStealingPool [%s] submit after stop, task rejected\n", name_.c_str());
+            return false;
+        }
+        std::scoped_lock lock(injectMutex_);
+        injectQueue_.push_back(new Task(std::move(task)));
+    }
+    notifyIfIdle();
+    return true;
+}
+
+void WorkStealingPool::notifyIfIdle()
+{
+    if (idle_.load() > 0)
+    {
+        // 加锁再通知: 将要睡眠的 worker 在 idle_++ 之后持锁检查 pending_, 这里拿到锁说明它要么已经在 wait 要么看到了新任务
+        {
+            std::scoped_lock lock(sleepMutex_);
+        }
+        sleepCond_.notify_one();
+    }
+}
+
+void WorkStealingPool::workerLoop(size_t index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+
+    while (true)
+    {
+        Task *task = nullptr;
+        for (int spin = 0; spin < kSpinRounds && task == nullptr; ++spin)
+        {
+            task = findTask(index);
+        }
+        if (task)
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock lock(sleepMutex_);
+        idle_.fetch_add(1);
+        sleepCond_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+        idle_.fetch_sub(1);
+        if (stopping_ && pending_.load() == 0)
+        {
+            break;
+        }
+    }
+
+    t_pool = nullptr;
+}
+
+// 顺序: 自己的队列 -> 注入队列 -> 从其他 worker 偷
+WorkStealingPool::Task *WorkStealingPool::findTask(size_t index)
+{
+    if (Task *task = workers_[index]->deque.pop())
+    {
+        return task;
+    }
+
+    {
+        std::unique_lock lock(injectMutex_, std::try_to_lock); // 抢不到锁说明别的 worker 正在领, 先去偷
+        if (lock.owns_lock() && !injectQueue_.empty())
+        {
+            Task *task = injectQueue_.front();
+            injectQueue_.pop_front();
+            // 顺手多领一些到自己队列, 让其他 worker 能从这里偷, 减少注入队列的锁竞争
+            size_t batch = std::min(injectQueue_.size(), injectQueue_.size() / workers_.size() + 1);
+            while (batch-- > 0)
+            {
+                workers_[index]->deque.push(injectQueue_.front());
+                injectQueue_.pop_front();
+            }
+            return task;
+        }
+    }
+
+    const size_t n = workers_.size();
+    for (size_t i = 1; i < n; ++i)
+    {
+        size_t victim = (index + i) % n;
+        if (workers_[victim]->deque.sizeApprox() == 0)
+        {
+            continue;
+        }
+        if (Task *task = workers_[victim]->deque.steal())
+        {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void WorkStealingPool::runTask(Task *task)
+{
+    pending_.fetch_sub(1);
+    (*task)();
+    delete task;
+}
@@ -0,0 +1,325 @@
+// muduo-logcat: 把 BinaryLogger 写的二进制日志解码成和 Logger 一样的文本
+//   muduo-logcat server.blog.20250101-120000.host.1234.log [更多文件...]
+// 多个文件按命令行顺序输出; 格式描述从所有文件里收集, 所以滚动边界上的记录也能解出来.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BinaryLog.h"
+#include "Timestamp.h"
+
+namespace
+{
+    struct Descriptor
+    {
+        LogLevel level;
+        uint32_t line;
+        std::string file;
+        std::string format;
+        std::string types;
+    };
+
+    std::unordered_map<uint32_t, Descriptor> g_descriptors;
+
+    template <typename T>
+    bool get(const char *&p, const char *end, T *value)
+    {
+        if (static_cast<size_t>(end - p) < sizeof(T))
+        {
+            return false;
+        }
+        memcpy(value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    const char *levelName(LogLevel level)
+    {
+        switch (level)
+        {
+        case LogLevel::DEBUG:
+            return "[DEBUG] ";
+        case LogLevel::INFO:
+            return "[INFO] ";
+        case LogLevel::ERROR:
+            return "[ERROR] ";
+        case LogLevel::FATAL:
+            return "[FATAL] ";
+        }
+        return "[?] ";
+    }
+
+    bool parseDescriptor(const char *p, const char *end)
+    {
+        uint32_t id = 0;
+        uint8_t level = 0;
+        uint16_t len = 0;
+        uint8_t nargs = 0;
+        Descriptor d;
+        if (!get(p, end, &id) || !get(p, end, &level) || !get(p, end, &d.line) || !get(p, end, &len)
+            || static_cast<size_t>(end - p) < len)
+        {
+            return false;
+        }
+        d.level = static_cast<LogLevel>(level);
+        d.file.assign(p, len);
+        p += len;
+        if (!get(p, end, &len) || static_cast<size_t>(end - p) < len)
+        {
+            return false;
+        }
+        d.format.assign(p, len);
+        p += len;
+        if (!get(p, end, &nargs) || static_cast<size_t>(end - p) < nargs)
+        {
+            return false;
+        }
+        d.types.assign(p, nargs);
+        g_descriptors[id] = std::move(d);
+        return true;
+    }
+
+    struct Arg
+    {
+        char type;
+        int64_t i;
+        uint64_t u;
+        double d;
+        std::string s;
+    };
+
+    bool decodeArgs(const char *p, const char *end, const std::string &types, std::vector<Arg> *args)
+    {
+        for (char type : types)
+        {
+            Arg arg{type, 0, 0, 0.0, {}};
+            bool ok = true;
+            switch (type)
+            {
+            case 'i':
+                ok = get(p, end, &arg.i);
+                break;
+            case 'u':
+            case 'p':
+                ok = get(p, end, &arg.u);
+                break;
+            case 'd':
+                ok = get(p, end, &arg.d);
+                break;
+            case 's':
+            {
+                uint32_t len = 0;
+                ok = get(p, end, &len) && static_cast<size_t>(end - p) >= len;
+                if (ok)
+                {
+                    arg.s.assign(p, len);
+                    p += len;
+                }
+                break;
+            }
+            default:
+                ok = false;
+            }
+            if (!ok)
+            {
+                return false;
+            }
+            args->push_back(std::move(arg));
+        }
+        return true;
+    }
+
+    // 按格式串逐个转换说明符重新 snprintf, 整数统一换成 ll 长度修饰(记录里都是 8 字节)
+    std::string render(const std::string &format, const std::vector<Arg> &args)
+    {
+        std::string out;
+        size_t next = 0;
+        char buf[2048];
+        for (size_t i = 0; i < format.size(); ++i)
+        {
+            if (format[i] != '%')
+            {
+                out += format[i];
+                continue;
+            }
+            if (i + 1 < format.size() && format[i + 1] == '%')
+            {
+                out += '%';
+                ++i;
+                continue;
+            }
+
+            std::string spec = "%";
+            size_t j = i + 1;
+            for (; j < format.size() && strchr("-+ #0123456789.*", format[j]); ++j)
+            {
+                if (format[j] == '*' && next < args.size()) // 宽度/精度从参数取
+                {
+                    spec += std::to_string(args[next++].i);
+                }
+                else
+                {
+                    spec += format[j];
+                }
+            }
+            while (j < format.size() && strchr("hlLqjzt", format[j])) // 原来的长度修饰丢掉
+            {
+                ++j;
+            }
+            if (j >= format.size())
+            {
+                break;
+            }
+            const char conv = format[j];
+            i = j;
+            if (next >= args.size())
+            {
+                out += "<missing>";
+                continue;
+            }
+            const Arg &arg = args[next++];
+            int n = 0;
+            if (strchr("di", conv))
+            {
+                n = snprintf(buf, sizeof(buf), (spec + "lld").c_str(), static_cast<long long>(arg.type == 'i' ? arg.i : static_cast<int64_t>(arg.u)));
+            }
+            else if (strchr("uoxX", conv))
+            {
+                n = snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), static_cast<unsigned long long>(arg.type == 'u' ? arg.u : static_cast<uint64_t>(arg.i)));
+            }
+            else if (conv == 'c')
+            {
+                n = snprintf(buf, sizeof(buf), (spec + "c").c_str(), static_cast<int>(arg.type == 'u' ? static_cast<int64_t>(arg.u) : arg.i));
+            }
+            else if (strchr("eEfFgGaA", conv))
+            {
+                n = snprintf(buf, sizeof(buf), (spec + conv).c_str(), arg.d);
+            }
+            else if (conv == 's')
+            {
+                n = snprintf(buf, sizeof(buf), (spec + "s").c_str(), arg.s.c_str());
+            }
+            else if (conv == 'p')
+            {
+                n = snprintf(buf, sizeof(buf), (spec + "p").c_str(), reinterpret_cast<void *>(static_cast<uintptr_t>(arg.u)));
+            }
+            if (n > 0)
+            {
+                out.append(buf, std::min(static_cast<size_t>(n), sizeof(buf) - 1));
+            }
+        }
+        if (out.empty() || out.back() != '\n')
+        {
+            out += '\n';
+        }
+        return out;
+    }
+
+    // 对整个文件逐帧调用 func(type, payload, end), 文件损坏时返回 false
+    template <typename Func>
+    bool forEachFrame(const std::string &data, const char *filename, Func &&func)
+    {
+        if (data.size() < sizeof(binarylog::kMagic) || memcmp(data.data(), binarylog::kMagic, sizeof(binarylog::kMagic)) != 0)
+        {
+            fprintf(stderr, "%s: not a muduo binary log\n", filename);
+            return false;
+        }
+        const char *p = data.data() + sizeof(binarylog::kMagic);
+        const char *end = data.data() + data.size();
+        while (p < end)
+        {
+            char type = 0;
+            uint32_t len = 0;
+            if (!get(p, end, &type) || !get(p, end, &len) || static_cast<size_t>(end - p) < len)
+            {
+                fprintf(stderr, "%s: truncated frame at offset %ld\n", filename, static_cast<long>(p - data.data()));
+                return false;
+            }
+            func(type, p, p + len);
+            p += len;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s binary-log-file...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> contents;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in)
+        {
+            fprintf(stderr, "%s: cannot open\n", argv[i]);
+            return 1;
+        }
+        contents.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    // 第一遍: 收集所有格式描述
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        forEachFrame(contents[i], argv[i + 1], [](char type, const char *p, const char *end) {
+            if (type == binarylog::kFrameDescriptor)
+            {
+                parseDescriptor(p, end);
+            }
+        });
+    }
+
+    // 第二遍: 解码记录
+    int status = 0;
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        bool ok = forEachFrame(contents[i], argv[i + 1], [](char type, const char *p, const char *end) {
+            if (type == binarylog::kFrameDropped)
+            {
+                int64_t dropped = 0;
+                get(p, end, &dropped);
+                printf("[ERROR] AsyncLogging dropped %ld log messages, buffers full\n", dropped);
+                return;
+            }
+            if (type != binarylog::kFrameRecord)
+            {
+                return;
+            }
+            uint32_t id = 0;
+            int64_t timeUs = 0;
+            int32_t tid = 0;
+            if (!get(p, end, &id) || !get(p, end, &timeUs) || !get(p, end, &tid))
+            {
+                return;
+            }
+            auto it = g_descriptors.find(id);
+            if (it == g_descriptors.end())
+            {
+                printf("[?] %s %d : <unknown format id %u>\n", Timestamp(timeUs).toString().c_str(), tid, id);
+                return;
+            }
+            const Descriptor &d = it->second;
+            std::vector<Arg> args;
+            if (!decodeArgs(p, end, d.types, &args))
+            {
+                printf("[?] %s %d : <corrupt record for %s:%u>\n", Timestamp(timeUs).toString().c_str(), tid, d.file.c_str(), d.line);
+                return;
+            }
+            printf("%s%s %d : %s", levelName(d.level), Timestamp(timeUs).toString().c_str(), tid, render(d.format, args).c_str());
+        });
+        if (!ok)
+        {
+            status = 1;
+        }
+    }
+    return status;
+}